@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "asset_archive.h"
+
+static_assert(sizeof(asset_archive_header) % 8 == 0 && sizeof(asset_archive_entry) % 8 == 0, "Archive tables must stay aligned");
+
+static uint64_t AlignOffset(uint64_t Offset)
+{
+    return (Offset + ASSET_ARCHIVE_ALIGNMENT - 1) & ~(ASSET_ARCHIVE_ALIGNMENT - 1);
+}
+
+static uint64_t HashName(const char* Name, size_t Size)
+{
+    return File::Hash(Name, Size);
+}
+
+static bool IsHeaderCompatible(const asset_archive_header& Header, size_t FileSize)
+{
+    uint64_t EntriesEnd = sizeof(asset_archive_header) + (uint64_t)Header.EntryCount * sizeof(asset_archive_entry);
+    return Header.Magic      == ASSET_ARCHIVE_MAGIC
+        && Header.Version    == ASSET_ARCHIVE_VERSION
+        && Header.EndianTest == ASSET_ARCHIVE_ENDIAN_TEST
+        && Header.HeaderSize == sizeof(asset_archive_header)
+        && Header.EntrySize  == sizeof(asset_archive_entry)
+        && Header.FileSize   == FileSize
+        && EntriesEnd == Header.NamesOffset
+        && Header.NamesOffset + Header.NamesSize <= FileSize;
+}
+
+static uint64_t HashTable(const void* Data, const asset_archive_header& Header)
+{
+    // Entries and names are contiguous after the header
+    return File::Hash((const uint8_t*)Data + sizeof(asset_archive_header), (size_t)(Header.NamesOffset + Header.NamesSize - sizeof(asset_archive_header)));
+}
+
+static bool AreEntriesValid(const asset_archive& Archive)
+{
+    const asset_archive_header& Header = *Archive.Header;
+    for (uint32_t i = 0; i < Header.EntryCount; ++i)
+    {
+        const asset_archive_entry& Entry = Archive.Entries[i];
+        if ((uint64_t)Entry.NameOffset + Entry.NameSize > Header.NamesSize
+            || Entry.Offset % ASSET_ARCHIVE_ALIGNMENT != 0 || Entry.Offset + Entry.Size > Header.FileSize
+            || (i > 0 && Archive.Entries[i - 1].NameHash > Entry.NameHash))
+            return false;
+    }
+    return true;
+}
+
+bool AssetArchive::Open(asset_archive* Archive, const char* Filename)
+{
+    *Archive = {};
+
+    file_mapping Mapping;
+    if (!File::Map(&Mapping, Filename))
+        return false;
+
+    const asset_archive_header* Header = (const asset_archive_header*)Mapping.Data;
+    if (Mapping.Size < sizeof(asset_archive_header) || !IsHeaderCompatible(*Header, Mapping.Size) || HashTable(Mapping.Data, *Header) != Header->TableHash)
+    {
+        printf("Incompatible archive: %s\n", Filename);
+        File::Unmap(&Mapping);
+        return false;
+    }
+
+    Archive->Mapping = Mapping;
+    Archive->Header  = Header;
+    Archive->Entries = (const asset_archive_entry*)((const uint8_t*)Mapping.Data + sizeof(asset_archive_header));
+    Archive->Names   = (const char*)Mapping.Data + Header->NamesOffset;
+    if (!AreEntriesValid(*Archive))
+    {
+        printf("Incompatible archive: %s\n", Filename);
+        AssetArchive::Close(Archive);
+        return false;
+    }
+
+    printf("Opened archive: %s (%d entries, %d MB)\n", Filename, (int)Header->EntryCount, (int)(Header->FileSize >> 20));
+    return true;
+}
+
+void AssetArchive::Close(asset_archive* Archive)
+{
+    File::Unmap(&Archive->Mapping);
+    *Archive = {};
+}
+
+bool AssetArchive::Verify(const asset_archive& Archive)
+{
+    bool Valid = true;
+    for (uint32_t i = 0; i < Archive.Header->EntryCount; ++i)
+    {
+        const asset_archive_entry& Entry = Archive.Entries[i];
+        if (File::Hash((const uint8_t*)Archive.Mapping.Data + Entry.Offset, (size_t)Entry.Size) != Entry.ContentHash)
+        {
+            fprintf(stderr, "Corrupted archive entry: %.*s\n", (int)Entry.NameSize, Archive.Names + Entry.NameOffset);
+            Valid = false;
+        }
+    }
+    return Valid;
+}
+
+const asset_archive_entry* AssetArchive::Find(const asset_archive& Archive, const char* Name)
+{
+    if (Archive.Header == nullptr)
+        return nullptr;
+
+    // Binary search on the hash, then names of the same hash are compared
+    size_t NameSize = strlen(Name);
+    uint64_t NameHash = HashName(Name, NameSize);
+    const asset_archive_entry* End = Archive.Entries + Archive.Header->EntryCount;
+    const asset_archive_entry* Entry = std::lower_bound(Archive.Entries, End, NameHash,
+        [](const asset_archive_entry& Entry, uint64_t Hash) { return Entry.NameHash < Hash; });
+    for (; Entry != End && Entry->NameHash == NameHash; ++Entry)
+    {
+        if (Entry->NameSize == NameSize && memcmp(Archive.Names + Entry->NameOffset, Name, NameSize) == 0)
+            return Entry;
+    }
+    return nullptr;
+}
+
+bool AssetArchive::Write(const char* Filename, const std::vector<std::string>& Files)
+{
+    // Table and names first, the blobs follow in the given order
+    std::vector<asset_archive_entry> Entries(Files.size());
+    std::string Names;
+    for (size_t i = 0; i < Files.size(); ++i)
+    {
+        Entries[i] = {};
+        Entries[i].NameHash   = HashName(Files[i].c_str(), Files[i].size());
+        Entries[i].NameOffset = (uint32_t)Names.size();
+        Entries[i].NameSize   = (uint32_t)Files[i].size();
+        Names += Files[i];
+    }
+
+    asset_archive_header Header = {};
+    Header.Magic       = ASSET_ARCHIVE_MAGIC;
+    Header.Version     = ASSET_ARCHIVE_VERSION;
+    Header.EndianTest  = ASSET_ARCHIVE_ENDIAN_TEST;
+    Header.HeaderSize  = sizeof(asset_archive_header);
+    Header.EntryCount  = (uint32_t)Entries.size();
+    Header.EntrySize   = sizeof(asset_archive_entry);
+    Header.NamesOffset = sizeof(asset_archive_header) + Entries.size() * sizeof(asset_archive_entry);
+    Header.NamesSize   = Names.size();
+
+    // Temporary file, renamed once complete (a running app may have the archive mapped)
+    std::string TempFilename = std::string(Filename) + ".tmp";
+    FILE* ArchiveFile = fopen(TempFilename.c_str(), "wb");
+    if (ArchiveFile == nullptr)
+    {
+        fprintf(stderr, "Cannot write archive: %s\n", Filename);
+        return false;
+    }
+
+    // Tables are rewritten once the blobs are written (offsets and hashes)
+    std::vector<uint8_t> Tables((size_t)Header.NamesOffset, 0);
+    bool Written = fwrite(Tables.data(), 1, Tables.size(), ArchiveFile) == Tables.size()
+        && fwrite(Names.data(), 1, Names.size(), ArchiveFile) == Names.size();
+    uint64_t Offset = Header.NamesOffset + Header.NamesSize;
+    static const uint8_t Zeros[ASSET_ARCHIVE_ALIGNMENT] = {};
+    for (size_t i = 0; i < Files.size() && Written; ++i)
+    {
+        file_mapping Mapping;
+        if (!File::Map(&Mapping, Files[i].c_str()))
+        {
+            fprintf(stderr, "Cannot read '%s' for the archive\n", Files[i].c_str());
+            Written = false;
+            break;
+        }
+
+        uint64_t BlobOffset = AlignOffset(Offset);
+        Written = fwrite(Zeros, 1, (size_t)(BlobOffset - Offset), ArchiveFile) == BlobOffset - Offset
+            && fwrite(Mapping.Data, 1, Mapping.Size, ArchiveFile) == Mapping.Size;
+        Entries[i].Offset      = BlobOffset;
+        Entries[i].Size        = Mapping.Size;
+        Entries[i].ContentHash = File::Hash(Mapping.Data, Mapping.Size);
+        Offset = BlobOffset + Mapping.Size;
+        File::Unmap(&Mapping);
+    }
+    Header.FileSize = Offset;
+
+    std::vector<asset_archive_entry> SortedEntries = Entries;
+    std::stable_sort(SortedEntries.begin(), SortedEntries.end(),
+        [](const asset_archive_entry& A, const asset_archive_entry& B) { return A.NameHash < B.NameHash; });
+
+    std::vector<uint8_t> Table(SortedEntries.size() * sizeof(asset_archive_entry) + Names.size());
+    if (!SortedEntries.empty())
+        memcpy(Table.data(), SortedEntries.data(), SortedEntries.size() * sizeof(asset_archive_entry));
+    if (!Names.empty())
+        memcpy(Table.data() + SortedEntries.size() * sizeof(asset_archive_entry), Names.data(), Names.size());
+    Header.TableHash = File::Hash(Table.data(), Table.size());
+
+    Written = Written && fseek(ArchiveFile, 0, SEEK_SET) == 0
+        && fwrite(&Header, sizeof(Header), 1, ArchiveFile) == 1
+        && fwrite(SortedEntries.data(), sizeof(asset_archive_entry), SortedEntries.size(), ArchiveFile) == SortedEntries.size();
+    fclose(ArchiveFile);
+
+    if (!Written)
+    {
+        fprintf(stderr, "Cannot write archive: %s\n", Filename);
+        remove(TempFilename.c_str());
+        return false;
+    }
+
+    remove(Filename);
+    if (rename(TempFilename.c_str(), Filename) != 0)
+    {
+        fprintf(stderr, "Cannot write archive: %s\n", Filename);
+        remove(TempFilename.c_str());
+        return false;
+    }
+
+    printf("Saved archive: %s (%d entries, %d MB)\n", Filename, (int)Header.EntryCount, (int)(Header.FileSize >> 20));
+    return true;
+}
+
+// Mounted archive
+static asset_archive MountedArchive = {};
+
+bool AssetArchive::Mount(const char* Filename)
+{
+    AssetArchive::Unmount();
+    return AssetArchive::Open(&MountedArchive, Filename);
+}
+
+void AssetArchive::Unmount()
+{
+    AssetArchive::Close(&MountedArchive);
+}
+
+bool AssetArchive::Map(file_mapping* Mapping, const char* Name)
+{
+    *Mapping = {};
+
+    // Blobs are not hashed here (that would read every page up front), the table is checked by Mount
+    const asset_archive_entry* Entry = AssetArchive::Find(MountedArchive, Name);
+    if (Entry == nullptr || Entry->Size == 0)
+        return false;
+
+    Mapping->Data = (const uint8_t*)MountedArchive.Mapping.Data + Entry->Offset;
+    Mapping->Size = (size_t)Entry->Size;
+    Mapping->IsView = true;
+    return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "file.h"
+
+// Packed asset archive, written by the bake tool next to its manifest ("media/assets.pack") and mapped once at startup.
+// File layout: [asset_archive_header][entries sorted by NameHash][names][blobs], blobs are aligned on 64 bytes and stored
+// in manifest order (sequential reads at startup). Entries are the baked cache files, looked up with their loose file name.
+
+const uint32_t ASSET_ARCHIVE_MAGIC       = 0x4B434150; // "PACK"
+const uint32_t ASSET_ARCHIVE_VERSION     = 2;
+const uint32_t ASSET_ARCHIVE_ENDIAN_TEST = 0x01020304;
+const uint64_t ASSET_ARCHIVE_ALIGNMENT   = 64;
+
+struct asset_archive_header
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t EndianTest;
+    uint32_t HeaderSize;
+    uint32_t EntryCount;
+    uint32_t EntrySize;
+    uint64_t NamesOffset;
+    uint64_t NamesSize;
+    uint64_t FileSize;
+    uint64_t TableHash; // File::Hash of the entries and names, checked when the archive is opened
+};
+
+struct asset_archive_entry
+{
+    uint64_t NameHash;    // File::Hash of the name
+    uint64_t ContentHash; // File::Hash of the blob, checked by Verify only (entries are paged in lazily)
+    uint64_t Offset;
+    uint64_t Size;
+    uint32_t NameOffset;  // In the names block, not null terminated
+    uint32_t NameSize;
+};
+
+struct asset_archive
+{
+    file_mapping Mapping;
+    const asset_archive_header* Header;
+    const asset_archive_entry* Entries;
+    const char* Names;
+};
+
+namespace AssetArchive
+{
+bool Open(asset_archive* Archive, const char* Filename);
+void Close(asset_archive* Archive);
+
+// Hash every blob (reads the whole archive), false if one is corrupted
+bool Verify(const asset_archive& Archive);
+
+// Entry of a file name (as given to File::Map), nullptr if absent
+const asset_archive_entry* Find(const asset_archive& Archive, const char* Name);
+
+// Pack the files in the given order, false if one cannot be read or the archive cannot be written
+bool Write(const char* Filename, const std::vector<std::string>& Files);
+
+// Archive searched by Map (one at a time, mount before loading assets from several threads)
+bool Mount(const char* Filename);
+void Unmount();
+
+// View of a mounted archive entry (File::Unmap does not unmap views), false if absent
+bool Map(file_mapping* Mapping, const char* Name);
+}
@@ -1,43 +1,137 @@
+#include <cfloat>
 
 #include "asteroid_mesh.h"
 
 asteroid_mesh::asteroid_mesh(GL::cache& GLCache)
+    : GLCache(GLCache)
 {
     // Create mesh
     {
-        // Use vbo from GLCache
-        VBO = GLCache.LoadObj("media/rock.obj", 1.f, &MeshVertexCount, &MeshDesc);
+        // Use vbo/ibo from GLCache
+        Mesh = GLCache.LoadObjAsync("media/rock.obj", 1.f, VERTEX_LAYOUT_PACKED);
+        VBO = Mesh->VertexBuffer;
 
         glGenVertexArrays(1, &VAO);
 
         glBindVertexArray(VAO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Mesh->IndexBuffer);
 
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, MeshDesc.Stride, (void*)(size_t)MeshDesc.PositionOffset);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, MeshDesc.Stride, (void*)(size_t)MeshDesc.UVOffset);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, MeshDesc.Stride, (void*)(size_t)MeshDesc.NormalOffset);
+        GL::VertexAttribPointer(0, Mesh->Descriptor, VERTEX_ATTRIBUTE_POSITION);
+        GL::VertexAttribPointer(1, Mesh->Descriptor, VERTEX_ATTRIBUTE_UV);
+        GL::VertexAttribPointer(2, Mesh->Descriptor, VERTEX_ATTRIBUTE_NORMAL);
+    }
+
+    // Instance matrices (one mat4 = 4 vec4 attributes)
+    {
+        glGenBuffers(1, &InstanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, InstanceVBO);
+        for (int i = 0; i < 4; ++i)
+        {
+            glEnableVertexAttribArray(3 + i);
+            glVertexAttribDivisor(3 + i, 1);
+        }
+        SetInstanceAttributes(0);
+
+        glBindVertexArray(0);
     }
 
     // Gen texture
     {
-        DiffuseTexture = GLCache.LoadTexture("media/rock.png", IMG_FLIP | IMG_GEN_MIPMAPS);
+        DiffuseTexture = GLCache.LoadTextureStreamed("media/rock.png", IMG_FLIP | IMG_GEN_MIPMAPS | IMG_COMPRESS);
     }
 }
 
 asteroid_mesh::~asteroid_mesh()
 {
-    glDeleteBuffers(1, &VAO);
-    glDeleteBuffers(1, &VBO);
+    // VBO belongs to GLCache
+    GLCache.ReleaseMesh(Mesh->VertexBuffer);
+    GLCache.ReleaseTexture(DiffuseTexture);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &InstanceVBO);
+}
+
+void asteroid_mesh::SetInstanceAttributes(size_t Offset)
+{
+    // Expects VAO and InstanceVBO to be bound
+    for (int i = 0; i < 4; ++i)
+        glVertexAttribPointer(3 + i, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(Offset + i * sizeof(v4)));
 }
 
+void asteroid_mesh::SetInstances(const std::vector<mat4>& Matrices)
+{
+    InstanceMatrices = Matrices;
+}
 
-void asteroid_mesh::Draw(int instance)
+void asteroid_mesh::Draw(const mat4& ProjectionMatrix, const mat4& ViewMatrix)
 {
+    int InstanceCount = (int)InstanceMatrices.size();
+    int LodCount = UseLods ? Mesh->LodCount : 1;
+    for (int& Count : LodInstanceCounts)
+        Count = 0;
+    if (InstanceCount == 0)
+        return;
+
+    GLint Viewport[4];
+    glGetIntegerv(GL_VIEWPORT, Viewport);
+    float ProjectionScale = MeshLod::GetProjectionScale(ProjectionMatrix, (float)Viewport[3]);
+    v3 ViewPosition = Mat4::Inverse(ViewMatrix).c[3].xyz;
+
+    // Bounding sphere of the mesh cache (tighter than the sphere around the box)
+    v3 Center = Mesh->BoundsCenter;
+    float Radius = Mesh->BoundsRadius;
+
+    // Select LODs, then group instances by LOD (counting sort) so each LOD is one instanced draw
+    // The nearest instance drives the texture resolution (the texture is assumed to span the mesh diameter)
+    float TextureScreenSize = 0.f;
+    std::vector<uint8_t> InstanceLods(InstanceCount);
+    for (int i = 0; i < InstanceCount; ++i)
+    {
+        const mat4& Model = InstanceMatrices[i];
+        float Scale = Math::Max(Vec3::Length(Model.c[0].xyz), Math::Max(Vec3::Length(Model.c[1].xyz), Vec3::Length(Model.c[2].xyz)));
+        v3 WorldCenter = (Model * v4{ Center.x, Center.y, Center.z, 1.f }).xyz;
+        float Distance = Vec3::Length(WorldCenter - ViewPosition) - Radius * Scale;
+
+        int Lod = MeshLod::SelectLod(Mesh->Lods, LodCount, Distance, Scale, ProjectionScale, MaxPixelError);
+        float ScreenSize = (Distance > 0.f) ? 2.f * Radius * Scale * ProjectionScale / Distance : FLT_MAX;
+        TextureScreenSize = Math::Max(TextureScreenSize, ScreenSize);
+        InstanceLods[i] = (uint8_t)Lod;
+        LodInstanceCounts[Lod]++;
+    }
+
+    int LodOffsets[MESH_MAX_LODS];
+    int Offset = 0;
+    for (int i = 0; i < MESH_MAX_LODS; ++i)
+    {
+        LodOffsets[i] = Offset;
+        Offset += LodInstanceCounts[i];
+    }
+
+    SortedMatrices.resize(InstanceCount);
+    for (int i = 0; i < InstanceCount; ++i)
+        SortedMatrices[LodOffsets[InstanceLods[i]]++] = InstanceMatrices[i];
+
+    GLCache.RequestTextureSize(DiffuseTexture, TextureScreenSize);
     glBindTexture(GL_TEXTURE_2D, DiffuseTexture);
-    // Draw mesh
     glBindVertexArray(VAO);
-    glDrawArraysInstanced(GL_TRIANGLES, 0, MeshVertexCount, instance);
-}
\ No newline at end of file
+    glBindBuffer(GL_ARRAY_BUFFER, InstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, InstanceCount * sizeof(mat4), SortedMatrices.data(), GL_STREAM_DRAW);
+
+    // Draw mesh
+    // NOTE: No base instance in GL 3.3, instance attributes are moved to the first instance of each LOD instead
+    int IndexSize = (Mesh->IndexType == GL_UNSIGNED_INT) ? sizeof(uint32_t) : sizeof(uint16_t);
+    int FirstInstance = 0;
+    for (int i = 0; i < LodCount; ++i)
+    {
+        int Count = LodInstanceCounts[i];
+        if (Count == 0)
+            continue;
+
+        SetInstanceAttributes(FirstInstance * sizeof(mat4));
+        glDrawElementsInstanced(GL_TRIANGLES, Mesh->Lods[i].IndexCount, Mesh->IndexType, (void*)((size_t)Mesh->Lods[i].IndexOffset * IndexSize), Count);
+        FirstInstance += Count;
+    }
+    SetInstanceAttributes(0);
+
+    glBindVertexArray(0);
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include "opengl_helpers.h"
 
 class asteroid_mesh
@@ -8,16 +10,30 @@ public:
     asteroid_mesh(GL::cache& GLCache);
     ~asteroid_mesh();
 
-    void Draw(int instance);
+    // Upload instance matrices (attributes 3 to 6) once they changed
+    void SetInstances(const std::vector<mat4>& Matrices);
+
+    // Draw every instance with the LOD selected from its projected size
+    void Draw(const mat4& ProjectionMatrix, const mat4& ViewMatrix);
 
-    // Mesh
+    // Mesh (loaded asynchronously by GLCache, empty until then)
     GLuint VBO = 0;
     GLuint VAO = 0;
-    int MeshVertexCount = 0;
-    vertex_descriptor MeshDesc;
+    const GL::cache::mesh* Mesh = nullptr;
     // Textures
     GLuint DiffuseTexture = 0;
 
+    // LOD selection
+    bool UseLods = true;
+    float MaxPixelError = MESH_LOD_MAX_PIXEL_ERROR;
+    int LodInstanceCounts[MESH_MAX_LODS] = {};
+
 private:
+    void SetInstanceAttributes(size_t Offset);
+
+    GL::cache& GLCache;
 
-};
\ No newline at end of file
+    GLuint InstanceVBO = 0;
+    std::vector<mat4> InstanceMatrices;
+    std::vector<mat4> SortedMatrices; // Instances grouped by LOD
+};
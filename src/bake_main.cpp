@@ -0,0 +1,275 @@
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "asset_archive.h"
+#include "jobs.h"
+#include "mesh_cache.h"
+#include "texture_cache.h"
+
+// Offline bake tool: builds the cache files next to the sources listed in a manifest (media/assets.txt by default),
+// so the runtime maps them instead of parsing/decoding. Outputs are rebuilt only when their sources changed (content hash).
+// The cache files are then packed in manifest order into an archive next to the manifest (media/assets.pack).
+// Usage: bake [manifest] [--force] [--verify] (--verify hashes every blob of the written archive)
+
+enum bake_type
+{
+    BAKE_MESH,
+    BAKE_TEXTURE,
+    BAKE_CUBEMAP,
+};
+
+struct bake_task
+{
+    bake_type Type;
+    std::vector<std::string> Sources; // 1 file, 6 faces for cubemaps (1 panorama for equirect)
+    float Scale;
+    mesh_codec Codec;
+    int ImageFlags;
+};
+
+enum bake_result
+{
+    BAKE_RESULT_UP_TO_DATE,
+    BAKE_RESULT_BAKED,
+    BAKE_RESULT_FAILED,
+};
+
+static bool ParseImageFlag(int* ImageFlags, const std::string& Name)
+{
+    struct { const char* Name; int Flag; } Flags[] =
+    {
+        { "FLIP",             IMG_FLIP },
+        { "FORCE_GREY",       IMG_FORCE_GREY },
+        { "FORCE_GREY_ALPHA", IMG_FORCE_GREY_ALPHA },
+        { "FORCE_RGB",        IMG_FORCE_RGB },
+        { "FORCE_RGBA",       IMG_FORCE_RGBA },
+        { "GEN_MIPMAPS",      IMG_GEN_MIPMAPS },
+        { "LINEAR",           IMG_LINEAR },
+        { "NON_COLOR",        IMG_NON_COLOR },
+        { "COMPRESS",         IMG_COMPRESS },
+        { "FLOAT32",          IMG_FLOAT32 },
+        { "FLOAT16",          IMG_FLOAT16 },
+        { "R11G11B10F",       IMG_R11G11B10F },
+        { "RGB9E5",           IMG_RGB9E5 },
+    };
+
+    for (const auto& Flag : Flags)
+    {
+        if (Name == Flag.Name)
+        {
+            *ImageFlags |= Flag.Flag;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ParseMeshCodec(mesh_codec* Codec, const std::string& Name)
+{
+    for (int i = 0; i < MESH_CODEC_COUNT; ++i)
+    {
+        std::string CodecName = MeshCodec::GetName((mesh_codec)i);
+        for (char& c : CodecName)
+            c = (char)toupper(c);
+        if (Name == CodecName)
+        {
+            *Codec = (mesh_codec)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ParseManifest(std::vector<bake_task>* Tasks, const char* Filename)
+{
+    FILE* File = fopen(Filename, "r");
+    if (File == nullptr)
+    {
+        fprintf(stderr, "Cannot open manifest '%s'\n", Filename);
+        return false;
+    }
+
+    bool Valid = true;
+    char Line[4096];
+    for (int LineNumber = 1; fgets(Line, sizeof(Line), File); ++LineNumber)
+    {
+        std::istringstream Stream(Line);
+        std::string Keyword;
+        if (!(Stream >> Keyword) || Keyword[0] == '#')
+            continue;
+
+        bake_task Task = {};
+        int SourceCount = 1;
+        if (Keyword == "mesh")
+            Task.Type = BAKE_MESH;
+        else if (Keyword == "texture")
+            Task.Type = BAKE_TEXTURE;
+        else if (Keyword == "cubemap")
+        {
+            Task.Type = BAKE_CUBEMAP;
+            SourceCount = TEXTURE_CACHE_MAX_FACES;
+        }
+        else if (Keyword == "equirect")
+        {
+            // Same flags as GL::cache::LoadEquirectCubemap
+            Task.Type = BAKE_CUBEMAP;
+            Task.ImageFlags = IMG_EQUIRECT | IMG_LINEAR;
+        }
+        else
+        {
+            fprintf(stderr, "%s(%d): unknown asset type '%s'\n", Filename, LineNumber, Keyword.c_str());
+            Valid = false;
+            continue;
+        }
+
+        Task.Sources.resize(SourceCount);
+        for (std::string& Source : Task.Sources)
+            Stream >> Source;
+
+        bool ValidTask = !Task.Sources.back().empty();
+        if (Task.Type == BAKE_MESH)
+        {
+            ValidTask = ValidTask && (Stream >> Task.Scale);
+
+            std::string Codec;
+            if (ValidTask && Stream >> Codec)
+                ValidTask = ParseMeshCodec(&Task.Codec, Codec);
+        }
+        else
+        {
+            std::string Flag;
+            while (ValidTask && Stream >> Flag)
+                ValidTask = ParseImageFlag(&Task.ImageFlags, Flag);
+        }
+
+        if (!ValidTask)
+        {
+            fprintf(stderr, "%s(%d): invalid %s\n", Filename, LineNumber, Keyword.c_str());
+            Valid = false;
+            continue;
+        }
+        Tasks->push_back(Task);
+    }
+
+    fclose(File);
+    return Valid;
+}
+
+static bake_result BakeMesh(const bake_task& Task, bool Force)
+{
+    const char* Filename = Task.Sources[0].c_str();
+
+    mesh_cache Cache = {};
+    if (!Force && MeshCache::Open(&Cache, Filename, Task.Scale, true))
+    {
+        bool SameCodec = Cache.Header->Codec == (uint32_t)Task.Codec;
+        MeshCache::Release(&Cache);
+        if (SameCodec)
+            return BAKE_RESULT_UP_TO_DATE;
+        Force = true;
+    }
+
+    // MeshCache::Load (re)builds the cache file when it cannot be opened
+    if (Force)
+        remove(MeshCache::GetCacheFilename(Filename, Task.Scale).c_str());
+
+    bool Baked = MeshCache::Load(&Cache, Filename, Task.Scale, true, Task.Codec) && Cache.Mapping.Data != nullptr;
+    MeshCache::Release(&Cache);
+    return Baked ? BAKE_RESULT_BAKED : BAKE_RESULT_FAILED;
+}
+
+static std::string GetCacheFilename(const bake_task& Task)
+{
+    if (Task.Type == BAKE_MESH)
+        return MeshCache::GetCacheFilename(Task.Sources[0].c_str(), Task.Scale);
+
+    std::vector<const char*> Faces;
+    for (const std::string& Source : Task.Sources)
+        Faces.push_back(Source.c_str());
+    return TextureCache::GetCacheFilename(Faces.data(), (int)Faces.size(), Task.ImageFlags);
+}
+
+static bake_result BakeTexture(const bake_task& Task, bool Force)
+{
+    std::vector<const char*> Faces;
+    for (const std::string& Source : Task.Sources)
+        Faces.push_back(Source.c_str());
+
+    texture_cache Cache;
+    if (!Force && TextureCache::Open(&Cache, Faces.data(), (int)Faces.size(), Task.ImageFlags))
+    {
+        TextureCache::Release(&Cache);
+        return BAKE_RESULT_UP_TO_DATE;
+    }
+
+    return TextureCache::Bake(Faces.data(), (int)Faces.size(), Task.ImageFlags) ? BAKE_RESULT_BAKED : BAKE_RESULT_FAILED;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* Manifest = "media/assets.txt";
+    bool Force = false;
+    bool Verify = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--force") == 0)
+            Force = true;
+        else if (strcmp(argv[i], "--verify") == 0)
+            Verify = true;
+        else
+            Manifest = argv[i];
+    }
+
+    std::vector<bake_task> Tasks;
+    if (!ParseManifest(&Tasks, Manifest))
+        return EXIT_FAILURE;
+
+    auto StartTime = std::chrono::steady_clock::now();
+
+    // One task per job (assets are independent, each output file is written by a single task)
+    std::atomic<int> Counts[3] = {};
+    std::vector<bake_result> Results(Tasks.size());
+    Jobs::ParallelFor((int)Tasks.size(), [&](int Index)
+    {
+        const bake_task& Task = Tasks[Index];
+        bake_result Result = (Task.Type == BAKE_MESH) ? BakeMesh(Task, Force) : BakeTexture(Task, Force);
+        if (Result == BAKE_RESULT_FAILED)
+            fprintf(stderr, "Bake failed: %s\n", Task.Sources[0].c_str());
+        Results[Index] = Result;
+        Counts[Result]++;
+    });
+
+    // Archive of the baked files, in manifest order (failed assets stay loose at runtime)
+    std::vector<std::string> CacheFiles;
+    for (size_t i = 0; i < Tasks.size(); ++i)
+    {
+        if (Results[i] != BAKE_RESULT_FAILED)
+            CacheFiles.push_back(GetCacheFilename(Tasks[i]));
+    }
+    std::string Archive = Manifest;
+    size_t Extension = Archive.find_last_of('.');
+    if (Extension != std::string::npos && Archive.find_first_of("/\\", Extension) == std::string::npos)
+        Archive.resize(Extension);
+    Archive += ".pack";
+    bool Packed = AssetArchive::Write(Archive.c_str(), CacheFiles);
+    if (Packed && Verify)
+    {
+        asset_archive Written;
+        Packed = AssetArchive::Open(&Written, Archive.c_str()) && AssetArchive::Verify(Written);
+        AssetArchive::Close(&Written);
+        printf("Verified archive: %s (%s)\n", Archive.c_str(), Packed ? "ok" : "corrupted");
+    }
+
+    double Time = std::chrono::duration<double>(std::chrono::steady_clock::now() - StartTime).count();
+    printf("Baked %d assets, %d up to date, %d failed in %.2f s (%d threads)\n",
+        Counts[BAKE_RESULT_BAKED].load(), Counts[BAKE_RESULT_UP_TO_DATE].load(), Counts[BAKE_RESULT_FAILED].load(), Time, Jobs::GetWorkerCount());
+
+    return (Counts[BAKE_RESULT_FAILED] || !Packed) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,168 @@
+#include <cstdint>
+
+#include "maths.h"
+#include "simd.h"
+
+#include "bounds.h"
+
+// EPOS-14: 3 axes and 4 diagonals, min and max point along each of them
+static const v3 ExtremeDirections[] =
+{
+    { 1.f, 0.f, 0.f },
+    { 0.f, 1.f, 0.f },
+    { 0.f, 0.f, 1.f },
+    { 1.f, 1.f, 1.f },
+    { 1.f, 1.f,-1.f },
+    { 1.f,-1.f, 1.f },
+    { 1.f,-1.f,-1.f },
+};
+const int EXTREME_DIRECTION_COUNT = sizeof(ExtremeDirections) / sizeof(ExtremeDirections[0]);
+
+static v3 GetPosition(const uint8_t* Positions, int Stride, int Index)
+{
+    return *(const v3*)(Positions + (size_t)Index * Stride);
+}
+
+// Grow the sphere just enough to contain Point (Ritter)
+static void GrowSphere(v3* Center, float* Radius, v3 Point)
+{
+    v3 ToPoint = Point - *Center;
+    float SquaredDistance = Vec3::Dot(ToPoint, ToPoint);
+    if (SquaredDistance <= *Radius * *Radius)
+        return;
+
+    float Distance = Math::Sqrt(SquaredDistance);
+
+    float NewRadius = (*Radius + Distance) * 0.5f;
+    *Center += ToPoint * ((NewRadius - *Radius) / Distance);
+    *Radius = NewRadius;
+}
+
+void Bounds::ComputeBox(v3* Min, v3* Max, const void* Positions, int Stride, int Count)
+{
+    *Min = {};
+    *Max = {};
+    if (Count <= 0)
+        return;
+
+    const uint8_t* Base = (const uint8_t*)Positions;
+    *Min = *Max = GetPosition(Base, Stride, 0);
+
+    int i = 0;
+    if (Count >= SIMD_WIDTH)
+    {
+        simd_float MinX = Simd::Set1(Min->x), MinY = Simd::Set1(Min->y), MinZ = Simd::Set1(Min->z);
+        simd_float MaxX = MinX, MaxY = MinY, MaxZ = MinZ;
+        for (; i + SIMD_WIDTH <= Count; i += SIMD_WIDTH)
+        {
+            const uint8_t* Batch = Base + (size_t)i * Stride;
+            simd_float X = Simd::LoadStrided(Batch, Stride);
+            simd_float Y = Simd::LoadStrided(Batch + sizeof(float), Stride);
+            simd_float Z = Simd::LoadStrided(Batch + 2 * sizeof(float), Stride);
+            MinX = Simd::Min(MinX, X); MaxX = Simd::Max(MaxX, X);
+            MinY = Simd::Min(MinY, Y); MaxY = Simd::Max(MaxY, Y);
+            MinZ = Simd::Min(MinZ, Z); MaxZ = Simd::Max(MaxZ, Z);
+        }
+
+        // Horizontal reduction
+        float Lanes[6][SIMD_WIDTH];
+        Simd::Store(Lanes[0], MinX); Simd::Store(Lanes[1], MinY); Simd::Store(Lanes[2], MinZ);
+        Simd::Store(Lanes[3], MaxX); Simd::Store(Lanes[4], MaxY); Simd::Store(Lanes[5], MaxZ);
+        for (int Lane = 0; Lane < SIMD_WIDTH; ++Lane)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                Min->e[c] = Math::Min(Min->e[c], Lanes[c][Lane]);
+                Max->e[c] = Math::Max(Max->e[c], Lanes[c + 3][Lane]);
+            }
+        }
+    }
+
+    for (; i < Count; ++i)
+    {
+        v3 P = GetPosition(Base, Stride, i);
+        *Min = { Math::Min(Min->x, P.x), Math::Min(Min->y, P.y), Math::Min(Min->z, P.z) };
+        *Max = { Math::Max(Max->x, P.x), Math::Max(Max->y, P.y), Math::Max(Max->z, P.z) };
+    }
+}
+
+void Bounds::ComputeSphere(v3* Center, float* Radius, const void* Positions, int Stride, int Count)
+{
+    *Center = {};
+    *Radius = 0.f;
+    if (Count <= 0)
+        return;
+
+    const uint8_t* Base = (const uint8_t*)Positions;
+
+    // Extreme points along the EPOS directions
+    int Extremes[2 * EXTREME_DIRECTION_COUNT] = {};
+    float MinProjections[EXTREME_DIRECTION_COUNT];
+    float MaxProjections[EXTREME_DIRECTION_COUNT];
+    for (int d = 0; d < EXTREME_DIRECTION_COUNT; ++d)
+        MinProjections[d] = MaxProjections[d] = Vec3::Dot(GetPosition(Base, Stride, 0), ExtremeDirections[d]);
+
+    for (int i = 1; i < Count; ++i)
+    {
+        v3 P = GetPosition(Base, Stride, i);
+        for (int d = 0; d < EXTREME_DIRECTION_COUNT; ++d)
+        {
+            float Projection = Vec3::Dot(P, ExtremeDirections[d]);
+            if (Projection < MinProjections[d]) { MinProjections[d] = Projection; Extremes[2 * d] = i; }
+            if (Projection > MaxProjections[d]) { MaxProjections[d] = Projection; Extremes[2 * d + 1] = i; }
+        }
+    }
+
+    // Initial sphere on the farthest pair of extreme points
+    v3 A = GetPosition(Base, Stride, 0);
+    v3 B = A;
+    float MaxDistance = 0.f;
+    for (int i = 0; i < 2 * EXTREME_DIRECTION_COUNT; ++i)
+    {
+        for (int j = i + 1; j < 2 * EXTREME_DIRECTION_COUNT; ++j)
+        {
+            v3 P = GetPosition(Base, Stride, Extremes[i]);
+            v3 Q = GetPosition(Base, Stride, Extremes[j]);
+            float Distance = Vec3::Length(Q - P);
+            if (Distance > MaxDistance)
+            {
+                MaxDistance = Distance;
+                A = P;
+                B = Q;
+            }
+        }
+    }
+
+    v3 RitterCenter = (A + B) * 0.5f;
+    float RitterRadius = MaxDistance * 0.5f;
+    for (int i = 0; i < 2 * EXTREME_DIRECTION_COUNT; ++i)
+        GrowSphere(&RitterCenter, &RitterRadius, GetPosition(Base, Stride, Extremes[i]));
+    for (int i = 0; i < Count; ++i)
+        GrowSphere(&RitterCenter, &RitterRadius, GetPosition(Base, Stride, i));
+
+    // The sphere around the box center is tighter on boxy point sets, keep the smallest one
+    v3 Min, Max;
+    ComputeBox(&Min, &Max, Positions, Stride, Count);
+    v3 BoxCenter = (Min + Max) * 0.5f;
+    float BoxSquaredRadius = 0.f;
+    for (int i = 0; i < Count; ++i)
+    {
+        v3 ToPoint = GetPosition(Base, Stride, i) - BoxCenter;
+        BoxSquaredRadius = Math::Max(BoxSquaredRadius, Vec3::Dot(ToPoint, ToPoint));
+    }
+    float BoxRadius = Math::Sqrt(BoxSquaredRadius);
+
+    *Center = (BoxRadius < RitterRadius) ? BoxCenter : RitterCenter;
+    *Radius = (BoxRadius < RitterRadius) ? BoxRadius : RitterRadius;
+}
+
+bounds Bounds::Compute(const vertex_full* Vertices, int Count)
+{
+    bounds Result = {};
+    if (Count <= 0)
+        return Result;
+
+    ComputeBox(&Result.Min, &Result.Max, &Vertices->Position, sizeof(vertex_full), Count);
+    ComputeSphere(&Result.Center, &Result.Radius, &Vertices->Position, sizeof(vertex_full), Count);
+    return Result;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "mesh.h"
+
+// Bounding volumes of a point set: axis aligned box and bounding sphere.
+// The sphere is not the minimal one: Ritter's growing pass seeded with the farthest pair of EPOS-14 extreme points
+// (Larsson 2008), which stays within a few percent of the minimal sphere in linear time.
+
+// Same layout in the mesh cache file
+struct bounds
+{
+    v3 Min;
+    v3 Max;
+    v3 Center; // Bounding sphere
+    float Radius;
+};
+
+namespace Bounds
+{
+// Positions are read at (uint8_t*)Positions + i * Stride, min/max are reduced SIMD_WIDTH positions at a time
+void ComputeBox(v3* Min, v3* Max, const void* Positions, int Stride, int Count);
+void ComputeSphere(v3* Center, float* Radius, const void* Positions, int Stride, int Count);
+
+bounds Compute(const vertex_full* Vertices, int Count); // Zero bounds when Count is 0
+}
@@ -34,9 +34,9 @@ out vec3 vNormal; // Vertex normal in view-space
 void main()
 {
     vUV = aUV;
-    vec4 pos4 = (uModel * vec4(aPosition, 1.0));
+    vec4 pos4 = (uModel * vec4(decodePosition(aPosition), 1.0));
     vPos = pos4.xyz / pos4.w;
-    vNormal = (uModelNormalMatrix * vec4(aNormal, 0.0)).xyz;
+    vNormal = (uModelNormalMatrix * vec4(decodeNormal(aNormal), 0.0)).xyz;
     gl_Position = uProjection * uView * pos4;
 })GLSL";
 
@@ -110,15 +110,13 @@ demo_base::demo_base(GL::cache& GLCache, GL::debug& GLDebug)
         glGenVertexArrays(1, &VAO);
         glBindVertexArray(VAO);
         
-        glBindBuffer(GL_ARRAY_BUFFER, TavernScene.MeshBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, TavernScene.Mesh->VertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, TavernScene.Mesh->IndexBuffer);
         
-        vertex_descriptor& Desc = TavernScene.MeshDesc;
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.PositionOffset);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.UVOffset);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.NormalOffset);
+        const vertex_descriptor& Desc = TavernScene.Mesh->Descriptor;
+        GL::VertexAttribPointer(0, Desc, VERTEX_ATTRIBUTE_POSITION);
+        GL::VertexAttribPointer(1, Desc, VERTEX_ATTRIBUTE_UV);
+        GL::VertexAttribPointer(2, Desc, VERTEX_ATTRIBUTE_NORMAL);
     }
 
     // Set uniforms that won't change
@@ -158,8 +156,8 @@ void demo_base::Update(const platform_io& IO)
     // Render tavern wireframe
     if (Wireframe)
     {
-        GLDebug.Wireframe.BindBuffer(TavernScene.MeshBuffer, TavernScene.MeshDesc.Stride, TavernScene.MeshDesc.PositionOffset, TavernScene.MeshVertexCount);
-        GLDebug.Wireframe.DrawArray(0, TavernScene.MeshVertexCount, ProjectionMatrix * ViewMatrix * ModelMatrix);
+        GLDebug.Wireframe.BindBuffer(TavernScene.Mesh->VertexBuffer, TavernScene.Mesh->Descriptor, TavernScene.Mesh->IndexBuffer);
+        GLDebug.Wireframe.DrawElements(TavernScene.Mesh->IndexCount, TavernScene.Mesh->IndexType, ProjectionMatrix * ViewMatrix * ModelMatrix);
     }
     
     // Display debug UI
@@ -180,6 +178,7 @@ void demo_base::DisplayDebugUI()
             ImGui::TreePop();
         }
         TavernScene.InspectLights();
+        TavernScene.InspectMeshlets();
 
         ImGui::TreePop();
     }
@@ -209,6 +208,7 @@ void demo_base::RenderTavern(const mat4& ProjectionMatrix, const mat4& ViewMatri
     glActiveTexture(GL_TEXTURE0); // Reset active texture just in case
     
     // Draw mesh
+    GL::UniformVertexDescriptor(Program, TavernScene.Mesh->Descriptor);
     glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, TavernScene.MeshVertexCount);
+    TavernScene.DrawMesh(ProjectionMatrix, ViewMatrix, ModelMatrix);
 }
\ No newline at end of file
@@ -34,9 +34,9 @@ out vec3 vNormal; // Vertex normal in view-space
 void main()
 {
     vUV = aUV;
-    vec4 pos4 = (uModel * vec4(aPosition, 1.0));
+    vec4 pos4 = (uModel * vec4(decodePosition(aPosition), 1.0));
     vPos = pos4.xyz / pos4.w;
-    vNormal = (uModelNormalMatrix * vec4(aNormal, 0.0)).xyz;
+    vNormal = (uModelNormalMatrix * vec4(decodeNormal(aNormal), 0.0)).xyz;
     gl_Position = uProjection * uView * pos4;
 })GLSL";
 
@@ -199,18 +199,16 @@ demo_framebuffer::demo_framebuffer(GL::cache& GLCache, GL::debug& GLDebug, const
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
 
-        glBindBuffer(GL_ARRAY_BUFFER, TavernScene.MeshBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, TavernScene.Mesh->VertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, TavernScene.Mesh->IndexBuffer);
 
         glGenVertexArrays(1, &tavernVAO);
         glBindVertexArray(tavernVAO);
 
-        vertex_descriptor& Desc = TavernScene.MeshDesc;
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.PositionOffset);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.UVOffset);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.NormalOffset);
+        const vertex_descriptor& Desc = TavernScene.Mesh->Descriptor;
+        GL::VertexAttribPointer(0, Desc, VERTEX_ATTRIBUTE_POSITION);
+        GL::VertexAttribPointer(1, Desc, VERTEX_ATTRIBUTE_UV);
+        GL::VertexAttribPointer(2, Desc, VERTEX_ATTRIBUTE_NORMAL);
     }
 
     
@@ -286,8 +284,8 @@ void demo_framebuffer::Update(const platform_io& IO)
     // Render tavern wireframe
     if (Wireframe)
     {
-        GLDebug.Wireframe.BindBuffer(TavernScene.MeshBuffer, TavernScene.MeshDesc.Stride, TavernScene.MeshDesc.PositionOffset, TavernScene.MeshVertexCount);
-        GLDebug.Wireframe.DrawArray(0, TavernScene.MeshVertexCount, ProjectionMatrix * ViewMatrix * ModelMatrix);
+        GLDebug.Wireframe.BindBuffer(TavernScene.Mesh->VertexBuffer, TavernScene.Mesh->Descriptor, TavernScene.Mesh->IndexBuffer);
+        GLDebug.Wireframe.DrawElements(TavernScene.Mesh->IndexCount, TavernScene.Mesh->IndexType, ProjectionMatrix * ViewMatrix * ModelMatrix);
     }
 
     glUseProgram(FramebufferProgram);
@@ -398,6 +396,7 @@ void demo_framebuffer::DisplayDebugUI()
         }
 
         TavernScene.InspectLights();
+        TavernScene.InspectMeshlets();
 
         ImGui::TreePop();
     }
@@ -427,6 +426,7 @@ void demo_framebuffer::RenderTavern(const mat4& ProjectionMatrix, const mat4& Vi
     glActiveTexture(GL_TEXTURE0); // Reset active texture just in case
 
     // Draw mesh
+    GL::UniformVertexDescriptor(Program, TavernScene.Mesh->Descriptor);
     glBindVertexArray(tavernVAO);
-    glDrawArrays(GL_TRIANGLES, 0, TavernScene.MeshVertexCount);
+    TavernScene.DrawMesh(ProjectionMatrix, ViewMatrix, ModelMatrix);
 }
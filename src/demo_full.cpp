@@ -5,6 +5,7 @@
 #include <imgui.h>
 
 #include "stb_image.h"
+#include "file.h"
 
 #include "opengl_helpers.h"
 #include "opengl_helpers_wireframe.h"
@@ -16,6 +17,7 @@
 #include "demo_full.h"
 
 const int LIGHT_BLOCK_BINDING_POINT = 0;
+const char* const HDR_SKY_FILENAME = "media/sky.hdr"; // Optional equirectangular panorama, replaces the 6 LDR faces
 
 // Vertex format
 // ==================================================
@@ -46,9 +48,9 @@ out vec3 vNormal; // Vertex normal in view-space
 void main()
 {
     vUV = aUV;
-    vec4 pos4 = (uModel * vec4(aPosition, 1.0));
+    vec4 pos4 = (uModel * vec4(decodePosition(aPosition), 1.0));
     vPos = pos4.xyz / pos4.w;
-    vNormal = (uModelNormalMatrix * vec4(aNormal, 0.0)).xyz;
+    vNormal = (uModelNormalMatrix * vec4(decodeNormal(aNormal), 0.0)).xyz;
     gl_Position = uProjection * uView * pos4;
 })GLSL";
 #pragma endregion
@@ -228,9 +230,9 @@ out vec3 vNormal; // Vertex normal in view-space
 void main()
 {
     vUV = aUV;
-    vec4 pos4 = (aInstanceMatrix * vec4(aPosition, 1.0));
+    vec4 pos4 = (aInstanceMatrix * vec4(decodePosition(aPosition), 1.0));
     vPos = pos4.xyz / pos4.w;
-    vNormal = (uModelNormalMatrix * vec4(aNormal, 0.0)).xyz;
+    vNormal = (uModelNormalMatrix * vec4(decodeNormal(aNormal), 0.0)).xyz;
     gl_Position = uProjection * uView * pos4;
 })GLSL";
 #pragma endregion
@@ -314,9 +316,7 @@ uniform sampler2D uScreenTexture;
 uniform sampler2D uBloomTexture;
 
 uniform bool uProcessHdr;
-uniform bool uProcessGamma;
 uniform bool uProcessBloom;
-uniform float uGamma;
 uniform float uExposure;
 
 // shader ouputs
@@ -335,10 +335,7 @@ void main()
 		vec3 toneMapped = vec3(1.0) - exp(-hdrColor * uExposure);
         hdrColor = toneMapped;
 	}
-    // Gamma correction
-    if (uProcessGamma)
-	    hdrColor = pow(hdrColor, vec3(1.0/uGamma));
-    
+    // Gamma correction done by the sRGB framebuffer (GL_FRAMEBUFFER_SRGB)
     FragColor = vec4(hdrColor, 1.0);
 })GLSL";
 #pragma endregion
@@ -439,7 +436,7 @@ void main()
 #pragma endregion
 
 demo_full::demo_full(GL::cache& GLCache, GL::debug& GLDebug, const platform_io& IO)
-    : GLDebug(GLDebug), TavernScene(GLCache), asteroid(GLCache)
+    : GLDebug(GLDebug), GLCache(GLCache), TavernScene(GLCache), asteroid(GLCache)
 {
     AspectRatio = (float)IO.WindowWidth / (float)IO.WindowHeight;
 
@@ -476,15 +473,13 @@ demo_full::demo_full(GL::cache& GLCache, GL::debug& GLDebug, const platform_io&
         glGenVertexArrays(1, &VAO);
         glBindVertexArray(VAO);
 
-        glBindBuffer(GL_ARRAY_BUFFER, TavernScene.MeshBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, TavernScene.Mesh->VertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, TavernScene.Mesh->IndexBuffer);
 
-        vertex_descriptor& Desc = TavernScene.MeshDesc;
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.PositionOffset);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.UVOffset);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.NormalOffset);
+        const vertex_descriptor& Desc = TavernScene.Mesh->Descriptor;
+        GL::VertexAttribPointer(0, Desc, VERTEX_ATTRIBUTE_POSITION);
+        GL::VertexAttribPointer(1, Desc, VERTEX_ATTRIBUTE_UV);
+        GL::VertexAttribPointer(2, Desc, VERTEX_ATTRIBUTE_NORMAL);
     }
 
     // Create a quad Vertex Object for FBO
@@ -513,87 +508,36 @@ demo_full::demo_full(GL::cache& GLCache, GL::debug& GLDebug, const platform_io&
 
     // Create sphere vertex array
     {
-        int VertexMeshCount = 0;
-        vertex_descriptor sphere;
-        GLuint buffer = GLCache.LoadObj("media/sphere.obj", 1.f, &VertexMeshCount, &sphere);
+        GLuint buffer = GLCache.LoadObj("media/sphere.obj", 1.f, &SphereMesh, nullptr, VERTEX_LAYOUT_PACKED);
 
         glGenVertexArrays(1, &SphereVAO);
         glBindVertexArray(SphereVAO);
 
         glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, SphereMesh.IndexBuffer);
 
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sphere.Stride, (void*)(size_t)sphere.PositionOffset);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sphere.Stride, (void*)(size_t)sphere.UVOffset);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sphere.Stride, (void*)(size_t)sphere.NormalOffset);
+        GL::VertexAttribPointer(0, SphereMesh.Descriptor, VERTEX_ATTRIBUTE_POSITION);
+        GL::VertexAttribPointer(1, SphereMesh.Descriptor, VERTEX_ATTRIBUTE_UV);
+        GL::VertexAttribPointer(2, SphereMesh.Descriptor, VERTEX_ATTRIBUTE_NORMAL);
     }
 
-    // Create a cube vertex object for Skybox
+    // Create a cube vertex object for Skybox (shared inverted cube, seen from inside)
     {
-        float skyboxVertices[] = {
-            // positions          
-            -1.0f,  1.0f, -1.0f,
-            -1.0f, -1.0f, -1.0f,
-             1.0f, -1.0f, -1.0f,
-             1.0f, -1.0f, -1.0f,
-             1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-
-            -1.0f, -1.0f,  1.0f,
-            -1.0f, -1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f,  1.0f,
-            -1.0f, -1.0f,  1.0f,
-
-             1.0f, -1.0f, -1.0f,
-             1.0f, -1.0f,  1.0f,
-             1.0f,  1.0f,  1.0f,
-             1.0f,  1.0f,  1.0f,
-             1.0f,  1.0f, -1.0f,
-             1.0f, -1.0f, -1.0f,
-
-            -1.0f, -1.0f,  1.0f,
-            -1.0f,  1.0f,  1.0f,
-             1.0f,  1.0f,  1.0f,
-             1.0f,  1.0f,  1.0f,
-             1.0f, -1.0f,  1.0f,
-            -1.0f, -1.0f,  1.0f,
-
-            -1.0f,  1.0f, -1.0f,
-             1.0f,  1.0f, -1.0f,
-             1.0f,  1.0f,  1.0f,
-             1.0f,  1.0f,  1.0f,
-            -1.0f,  1.0f,  1.0f,
-            -1.0f,  1.0f, -1.0f,
-
-            -1.0f, -1.0f, -1.0f,
-            -1.0f, -1.0f,  1.0f,
-             1.0f, -1.0f, -1.0f,
-             1.0f, -1.0f, -1.0f,
-            -1.0f, -1.0f,  1.0f,
-             1.0f, -1.0f,  1.0f
-        };
+        SkyMesh = GLCache.LoadPrimitive(PRIMITIVE_INVERTED_CUBE);
 
-        GLuint SkyBuffer = 0;
         glGenVertexArrays(1, &SkyVAO);
-        glGenBuffers(1, &SkyBuffer);
-
         glBindVertexArray(SkyVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, SkyBuffer);
 
-        glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices[0], GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, SkyMesh->VertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, SkyMesh->IndexBuffer);
 
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
+        GL::VertexAttribPointer(0, SkyMesh->Descriptor, VERTEX_ATTRIBUTE_POSITION);
         glBindVertexArray(0);
     }
 
     // Generate skybox
     {
-        std::vector<std::string> faces
+        const char* faces[6] =
         {
             "media/right.jpg",
             "media/left.jpg",
@@ -603,29 +547,13 @@ demo_full::demo_full(GL::cache& GLCache, GL::debug& GLDebug, const platform_io&
             "media/back.jpg"
         };
 
-        glGenTextures(1, &SkyTexture);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, SkyTexture);
-
-        int width, height, nrChannels;
-        unsigned char* data = nullptr;
-        for (unsigned int i = 0; i < faces.size(); i++)
-        {
-            unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-            if (data)
-            {
-                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                    0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data
-                );
-            }
-            stbi_image_free(data);
-
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        }
-        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+        // HDR panorama when available (lit values go through bloom and tone mapping), converted to a cubemap once and cached.
+        // Otherwise the LDR faces shared with demo_skybox, cached file built on first run or by the bake tool
+        file_stats HdrSkyStats;
+        if (File::GetStats(&HdrSkyStats, HDR_SKY_FILENAME))
+            SkyTexture = GLCache.LoadEquirectCubemap(HDR_SKY_FILENAME, IMG_FORCE_RGB | IMG_FLOAT16 | IMG_GEN_MIPMAPS);
+        else
+            SkyTexture = GLCache.LoadCubemap(faces, IMG_FORCE_RGB);
 
         GenCubemap(EnvironmentTexture, 128.f, 128.f, GL_RGB, GL_UNSIGNED_BYTE);
 
@@ -761,6 +689,10 @@ demo_full::demo_full(GL::cache& GLCache, GL::debug& GLDebug, const platform_io&
 
 demo_full::~demo_full()
 {
+    GLCache.ReleaseMesh(SphereMesh.VertexBuffer);
+    GLCache.ReleaseMesh(SkyMesh->VertexBuffer);
+    GLCache.ReleaseTexture(SkyTexture);
+
     // Cleanup GL
     glDeleteVertexArrays(1, &VAO);
     glDeleteVertexArrays(1, &quadVAO);
@@ -832,9 +764,7 @@ void demo_full::Update(const platform_io& IO)
     glUseProgram(HdrProgram);
     // Set uniforms
     glUniform1i(glGetUniformLocation(HdrProgram, "uProcessHdr"), processHdr);
-    glUniform1i(glGetUniformLocation(HdrProgram, "uProcessGamma"), processGamma);
     glUniform1i(glGetUniformLocation(HdrProgram, "uProcessBloom"), processBloom);
-    glUniform1f(glGetUniformLocation(HdrProgram, "uGamma"), gamma);
     glUniform1f(glGetUniformLocation(HdrProgram, "uExposure"), exposure);
 
     glDisable(GL_DEPTH_TEST);
@@ -864,7 +794,11 @@ void demo_full::Update(const platform_io& IO)
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, CBOs[hdrIndex]);
 
+    // Linear to sRGB encoding on write (the HDR pass output is kept linear in its float buffer)
+    if (processGamma)
+        glEnable(GL_FRAMEBUFFER_SRGB);
     RenderQuad();
+    glDisable(GL_FRAMEBUFFER_SRGB);
 #pragma endregion
 
     // Display debug UI
@@ -973,9 +907,7 @@ void demo_full::DisplayDebugUI()
 
             ImGui::Spacing();
 
-            ImGui::Checkbox("Process gamma", &processGamma);
-            if (processGamma)
-                ImGui::SliderFloat("Gamma", &gamma, 0.45f, 4.4f);
+            ImGui::Checkbox("Process gamma (sRGB framebuffer)", &processGamma);
 
             ImGui::Spacing();
 
@@ -999,6 +931,10 @@ void demo_full::DisplayDebugUI()
             ImGui::DragInt("Instance count", &instanceCount);
             ImGui::DragFloat("Circle radius", &instanceCircleRadius);
             ImGui::DragFloat("Offset", &instanceOffset);
+            ImGui::Checkbox("LODs", &asteroid.UseLods);
+            ImGui::SliderFloat("LOD pixel error", &asteroid.MaxPixelError, 0.1f, 20.f);
+            for (int i = 0; i < asteroid.Mesh->LodCount; ++i)
+                ImGui::Text("LOD %d: %d instances (%d triangles)", i, asteroid.LodInstanceCounts[i], (int)asteroid.Mesh->Lods[i].IndexCount / 3);
 
             ImGui::TreePop();
         }
@@ -1013,6 +949,7 @@ void demo_full::DisplayDebugUI()
             ImGui::TreePop();
         }
         TavernScene.InspectLights();
+        TavernScene.InspectMeshlets();
 
         ImGui::TreePop();
     }
@@ -1093,36 +1030,7 @@ void demo_full::GenInstanceMatrices()
         modelMatrices[i] = model;
     }
 
-    GenInstanceVBO(modelMatrices);
-}
-
-void demo_full::GenInstanceVBO(const std::vector<mat4>& modelMatrices)
-{
-    glBindVertexArray(asteroid.VAO);
-
-    GLuint instanceVBO = 0;
-    glGenBuffers(1, &instanceVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
-
-    glBufferData(GL_ARRAY_BUFFER, instanceCount * sizeof(mat4), &modelMatrices.data()[0], GL_STATIC_DRAW);
-
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)0);
-    glVertexAttribDivisor(3, 1);
-
-    glEnableVertexAttribArray(4);
-    glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(sizeof(v4)));
-    glVertexAttribDivisor(4, 1);
-
-    glEnableVertexAttribArray(5);
-    glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(2 * sizeof(v4)));
-    glVertexAttribDivisor(5, 1);
-
-    glEnableVertexAttribArray(6);
-    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(3 * sizeof(v4)));
-    glVertexAttribDivisor(6, 1);
-
-    glBindVertexArray(0);
+    asteroid.SetInstances(modelMatrices);
 }
 
 void demo_full::RenderEnvironmentMap()
@@ -1175,8 +1083,8 @@ void demo_full::RenderScene(const camera& cam, bool reflection)
     // Render tavern wireframe
     if (Wireframe)
     {
-        GLDebug.Wireframe.BindBuffer(TavernScene.MeshBuffer, TavernScene.MeshDesc.Stride, TavernScene.MeshDesc.PositionOffset, TavernScene.MeshVertexCount);
-        GLDebug.Wireframe.DrawArray(0, TavernScene.MeshVertexCount, ProjectionMatrix * ViewMatrix * ModelMatrix);
+        GLDebug.Wireframe.BindBuffer(TavernScene.Mesh->VertexBuffer, TavernScene.Mesh->Descriptor, TavernScene.Mesh->IndexBuffer);
+        GLDebug.Wireframe.DrawElements(TavernScene.Mesh->IndexCount, TavernScene.Mesh->IndexType, ProjectionMatrix * ViewMatrix * ModelMatrix);
     }
 }
 
@@ -1191,7 +1099,7 @@ void demo_full::RenderSkybox(const camera& cam, const mat4& projection)
 
     glBindVertexArray(SkyVAO);
     glBindTexture(GL_TEXTURE_CUBE_MAP, SkyTexture);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glDrawElements(GL_TRIANGLES, SkyMesh->IndexCount, SkyMesh->IndexType, nullptr);
 
     glDepthMask(GL_TRUE);
     glBindVertexArray(0);
@@ -1224,15 +1132,16 @@ void demo_full::RenderTavern(const mat4& ProjectionMatrix, const mat4& ViewMatri
     // Bind uniform buffer and textures
     glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING_POINT, TavernScene.LightsUniformBuffer);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, TavernScene.LinearDiffuseTexture);
+    glBindTexture(GL_TEXTURE_2D, TavernScene.SrgbDiffuseTexture);
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, TavernScene.EmissiveTexture);
 
     glActiveTexture(GL_TEXTURE0); // Reset active texture just in case
 
     // Draw mesh
+    GL::UniformVertexDescriptor(Program, TavernScene.Mesh->Descriptor);
     glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, TavernScene.MeshVertexCount);
+    TavernScene.DrawMesh(ProjectionMatrix, ViewMatrix, ModelMatrix);
 }
 
 void demo_full::RenderAsteroids(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix)
@@ -1253,9 +1162,10 @@ void demo_full::RenderAsteroids(const mat4& ProjectionMatrix, const mat4& ViewMa
     glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING_POINT, TavernScene.LightsUniformBuffer);
     glBindTexture(GL_TEXTURE_2D, asteroid.DiffuseTexture);
 
+    GL::UniformVertexDescriptor(InstancingProgram, asteroid.Mesh->Descriptor);
     GenInstanceMatrices();
 
-    asteroid.Draw(instanceCount);
+    asteroid.Draw(ProjectionMatrix, ViewMatrix);
 }
 
 void demo_full::RenderReflectiveSphere(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix)
@@ -1269,6 +1179,7 @@ void demo_full::RenderReflectiveSphere(const mat4& ProjectionMatrix, const mat4&
     glUniformMatrix4fv(glGetUniformLocation(ReflectiveProgram, "uModel"), 1, GL_FALSE, model.e);
     glUniformMatrix4fv(glGetUniformLocation(ReflectiveProgram, "uView"), 1, GL_FALSE, ViewMatrix.e);
     glUniformMatrix4fv(glGetUniformLocation(ReflectiveProgram, "uModelNormalMatrix"), 1, GL_FALSE, NormalMatrix.e);
+    GL::UniformVertexDescriptor(ReflectiveProgram, SphereMesh.Descriptor);
     glUniform3fv(glGetUniformLocation(ReflectiveProgram, "uViewPosition"), 1, Camera.Position.e);
 
     glBindVertexArray(SphereVAO);
@@ -1277,5 +1188,5 @@ void demo_full::RenderReflectiveSphere(const mat4& ProjectionMatrix, const mat4&
     else
         glBindTexture(GL_TEXTURE_CUBE_MAP, SkyTexture);
 
-    glDrawArrays(GL_TRIANGLES, 0, 2880);
+    glDrawElements(GL_TRIANGLES, SphereMesh.IndexCount, SphereMesh.IndexType, nullptr);
 }
@@ -32,9 +32,9 @@ public:
 private:
     void GenCubemap(GLuint& index, const float width, const float height, const GLint format, const GLint size);
     void GenInstanceMatrices();
-    void GenInstanceVBO(const std::vector<mat4>& matrices);
 
     GL::debug& GLDebug;
+    GL::cache& GLCache;
 
     // 3d camera
     camera Camera = {};
@@ -46,6 +46,7 @@ private:
     GLuint VAO = 0;
     GLuint quadVAO = 0;
     GLuint SphereVAO = 0;
+    GL::cache::mesh SphereMesh = {};
 
     const int renderIndex = 0, hdrIndex = 1;
     GLuint FBOs[2];
@@ -59,6 +60,7 @@ private:
     GLuint SkyFBO = 0;
     GLuint SkyProgram = 0;
     GLuint SkyVAO = 0;
+    const GL::cache::mesh* SkyMesh = nullptr;
     GLuint SkyTexture = 0;
 
     GLuint ReflectiveProgram = 0;
@@ -73,7 +75,6 @@ private:
     bool processHdr = true;
     bool processGamma = true;
 
-    float gamma = 2.2f;
     float exposure = 1.f;
 
     GLuint bloomCBO = 0;
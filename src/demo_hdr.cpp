@@ -44,9 +44,9 @@ out vec3 vNormal; // Vertex normal in view-space
 void main()
 {
     vUV = aUV;
-    vec4 pos4 = (uModel * vec4(aPosition, 1.0));
+    vec4 pos4 = (uModel * vec4(decodePosition(aPosition), 1.0));
     vPos = pos4.xyz / pos4.w;
-    vNormal = (uModelNormalMatrix * vec4(aNormal, 0.0)).xyz;
+    vNormal = (uModelNormalMatrix * vec4(decodeNormal(aNormal), 0.0)).xyz;
     gl_Position = uProjection * uView * pos4;
 })GLSL";
 #pragma endregion
@@ -137,9 +137,7 @@ uniform sampler2D uScreenTexture;
 uniform sampler2D uBloomTexture;
 
 uniform bool uProcessHdr;
-uniform bool uProcessGamma;
 uniform bool uProcessBloom;
-uniform float uGamma;
 uniform float uExposure;
 
 // shader ouputs
@@ -158,10 +156,7 @@ void main()
 		vec3 toneMapped = vec3(1.0) - exp(-hdrColor * uExposure);
         hdrColor = toneMapped;
 	}
-    // Gamma correction
-    if (uProcessGamma)
-	    hdrColor = pow(hdrColor, vec3(1.0/uGamma));
-    
+    // Gamma correction done by the sRGB framebuffer (GL_FRAMEBUFFER_SRGB)
     FragColor = vec4(hdrColor, 1.0);
 })GLSL";
 #pragma endregion
@@ -226,15 +221,13 @@ demo_hdr::demo_hdr(GL::cache& GLCache, GL::debug& GLDebug, const platform_io& IO
         glGenVertexArrays(1, &VAO);
         glBindVertexArray(VAO);
         
-        glBindBuffer(GL_ARRAY_BUFFER, TavernScene.MeshBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, TavernScene.Mesh->VertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, TavernScene.Mesh->IndexBuffer);
         
-        vertex_descriptor& Desc = TavernScene.MeshDesc;
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.PositionOffset);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.UVOffset);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.NormalOffset);
+        const vertex_descriptor& Desc = TavernScene.Mesh->Descriptor;
+        GL::VertexAttribPointer(0, Desc, VERTEX_ATTRIBUTE_POSITION);
+        GL::VertexAttribPointer(1, Desc, VERTEX_ATTRIBUTE_UV);
+        GL::VertexAttribPointer(2, Desc, VERTEX_ATTRIBUTE_NORMAL);
     }
 
     // Create a quad Vertex Object for FBO
@@ -416,9 +409,7 @@ void demo_hdr::Update(const platform_io& IO)
     glUseProgram(hdrProgram);
     // Set uniforms
     glUniform1i(glGetUniformLocation(hdrProgram, "uProcessHdr"), processHdr);
-    glUniform1i(glGetUniformLocation(hdrProgram, "uProcessGamma"), processGamma);
     glUniform1i(glGetUniformLocation(hdrProgram, "uProcessBloom"), processBloom);
-    glUniform1f(glGetUniformLocation(hdrProgram, "uGamma"), gamma);
     glUniform1f(glGetUniformLocation(hdrProgram, "uExposure"), exposure);
 
     glDisable(GL_DEPTH_TEST);
@@ -426,16 +417,20 @@ void demo_hdr::Update(const platform_io& IO)
     glBindTexture(GL_TEXTURE_2D, hdrCBO);
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, pingpongCBO[!horizontal]);
-        
+
+    // Linear to sRGB encoding on write (only the tone mapped quad, not the debug UI)
+    if (processGamma)
+        glEnable(GL_FRAMEBUFFER_SRGB);
     RenderQuad();
+    glDisable(GL_FRAMEBUFFER_SRGB);
 
 #pragma endregion
     
     // Render tavern wireframe
     if (Wireframe)
     {
-        GLDebug.Wireframe.BindBuffer(TavernScene.MeshBuffer, TavernScene.MeshDesc.Stride, TavernScene.MeshDesc.PositionOffset, TavernScene.MeshVertexCount);
-        GLDebug.Wireframe.DrawArray(0, TavernScene.MeshVertexCount, ProjectionMatrix * ViewMatrix * ModelMatrix);
+        GLDebug.Wireframe.BindBuffer(TavernScene.Mesh->VertexBuffer, TavernScene.Mesh->Descriptor, TavernScene.Mesh->IndexBuffer);
+        GLDebug.Wireframe.DrawElements(TavernScene.Mesh->IndexCount, TavernScene.Mesh->IndexType, ProjectionMatrix * ViewMatrix * ModelMatrix);
     }
     // Display debug UI
     this->DisplayDebugUI();
@@ -452,9 +447,7 @@ void demo_hdr::DisplayDebugUI()
 
         ImGui::Spacing();
 
-        ImGui::Checkbox("Process gamma", &processGamma);
-        if (processGamma)
-            ImGui::SliderFloat("Gamma", &gamma, 0.45f, 4.4f);
+        ImGui::Checkbox("Process gamma (sRGB framebuffer)", &processGamma);
 
         ImGui::Spacing();
 
@@ -476,6 +469,7 @@ void demo_hdr::DisplayDebugUI()
             ImGui::TreePop();
         }
         TavernScene.InspectLights();
+        TavernScene.InspectMeshlets();
 
         ImGui::TreePop();
     }
@@ -508,13 +502,14 @@ void demo_hdr::RenderTavern(const mat4& ProjectionMatrix, const mat4& ViewMatrix
     // Bind uniform buffer and textures
     glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING_POINT, TavernScene.LightsUniformBuffer);
     glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, TavernScene.LinearDiffuseTexture);
+    glBindTexture(GL_TEXTURE_2D, TavernScene.SrgbDiffuseTexture);
     glActiveTexture(GL_TEXTURE1);
     glBindTexture(GL_TEXTURE_2D, TavernScene.EmissiveTexture);
 
     glActiveTexture(GL_TEXTURE0); // Reset active texture just in case
     
     // Draw mesh
+    GL::UniformVertexDescriptor(Program, TavernScene.Mesh->Descriptor);
     glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, TavernScene.MeshVertexCount);
+    TavernScene.DrawMesh(ProjectionMatrix, ViewMatrix, ModelMatrix);
 }
@@ -39,7 +39,6 @@ private:
     bool processGamma = true;
     bool processBloom = true;
 
-    float gamma = 2.2f;
     float exposure = 1.f;
     float brightnessClamp = 0.5f;
 
@@ -36,9 +36,9 @@ out vec3 vNormal; // Vertex normal in view-space
 void main()
 {
     vUV = aUV;
-    vec4 pos4 = (aInstanceMatrix * vec4(aPosition, 1.0));
+    vec4 pos4 = (aInstanceMatrix * vec4(decodePosition(aPosition), 1.0));
     vPos = pos4.xyz / pos4.w;
-    vNormal = (uModelNormalMatrix * vec4(aNormal, 0.0)).xyz;
+    vNormal = (uModelNormalMatrix * vec4(decodeNormal(aNormal), 0.0)).xyz;
     gl_Position = uProjection * uView * pos4;
 })GLSL";
 #pragma endregion
@@ -95,7 +95,7 @@ void main()
 #pragma endregion
 
 demo_instancing::demo_instancing(GL::cache& GLCache, GL::debug& GLDebug)
-    : GLDebug(GLDebug), asteroid(GLCache)
+    : GLDebug(GLDebug), GLCache(GLCache), asteroid(GLCache)
 {
     Lights.resize(LightCount);
 
@@ -127,7 +127,7 @@ demo_instancing::demo_instancing(GL::cache& GLCache, GL::debug& GLDebug)
         this->Lights[0] = DefaultLight;
     }
 
-    Texture = GLCache.LoadTexture("media/brick.png", IMG_FLIP | IMG_GEN_MIPMAPS);
+    Texture = GLCache.LoadTextureAsync("media/brick.png", IMG_FLIP | IMG_GEN_MIPMAPS | IMG_COMPRESS);
 
     // Create a quad Vertex Object
     {
@@ -177,6 +177,8 @@ demo_instancing::demo_instancing(GL::cache& GLCache, GL::debug& GLDebug)
 
 demo_instancing::~demo_instancing()
 {
+    GLCache.ReleaseTexture(Texture);
+
     // Cleanup GL
     glDeleteVertexArrays(1, &quadVAO);
     glDeleteProgram(Program);
@@ -219,6 +221,10 @@ void demo_instancing::DisplayDebugUI()
             ImGui::TreePop();
         }
         ImGui::DragInt("Instance count", &InstanceCount);
+        ImGui::Checkbox("LODs", &asteroid.UseLods);
+        ImGui::SliderFloat("LOD pixel error", &asteroid.MaxPixelError, 0.1f, 20.f);
+        for (int i = 0; i < asteroid.Mesh->LodCount; ++i)
+            ImGui::Text("LOD %d: %d instances (%d triangles)", i, asteroid.LodInstanceCounts[i], (int)asteroid.Mesh->Lods[i].IndexCount / 3);
 
         InspectLights();
 
@@ -285,34 +291,7 @@ void demo_instancing::GenMatrices()
         }
     }
 
-    // Generate VBO
-    {
-        glBindVertexArray(asteroid.VAO);
-
-        GLuint instanceVBO = 0;
-        glGenBuffers(1, &instanceVBO);
-        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
-
-        glBufferData(GL_ARRAY_BUFFER, InstanceCount * sizeof(mat4), &modelMatrices.data()[0], GL_STATIC_DRAW);
-
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)0);
-        glVertexAttribDivisor(3, 1);
-
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(sizeof(v4)));
-        glVertexAttribDivisor(4, 1);
-
-        glEnableVertexAttribArray(5);
-        glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(2 * sizeof(v4)));
-        glVertexAttribDivisor(5, 1);
-
-        glEnableVertexAttribArray(6);
-        glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(mat4), (void*)(3 * sizeof(v4)));
-        glVertexAttribDivisor(6, 1);
-
-        glBindVertexArray(0);
-    }
+    asteroid.SetInstances(modelMatrices);
 }
 
 void demo_instancing::RenderScene(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix)
@@ -333,7 +312,7 @@ void demo_instancing::RenderScene(const mat4& ProjectionMatrix, const mat4& View
 
     GenMatrices();
 
-    RenderAsteroids();
+    RenderAsteroids(ProjectionMatrix, ViewMatrix);
 }
 
 void demo_instancing::RenderQuad()
@@ -343,10 +322,10 @@ void demo_instancing::RenderQuad()
     glBindVertexArray(0);
 }
 
-void demo_instancing::RenderAsteroids()
+void demo_instancing::RenderAsteroids(const mat4& ProjectionMatrix, const mat4& ViewMatrix)
 {
-    glUseProgram(Program);
-    asteroid.Draw(InstanceCount);
+    GL::UniformVertexDescriptor(Program, asteroid.Mesh->Descriptor);
+    asteroid.Draw(ProjectionMatrix, ViewMatrix);
 }
 
 
@@ -23,7 +23,7 @@ public:
     void DisplayDebugUI();
     void InspectLights();
     void RenderQuad();
-    void RenderAsteroids();
+    void RenderAsteroids(const mat4& ProjectionMatrix, const mat4& ViewMatrix);
 
 
     GLuint LightsUniformBuffer;
@@ -35,6 +35,7 @@ private:
     void GenMatrices();
     
     GL::debug& GLDebug;
+    GL::cache& GLCache;
     std::vector<GL::light> Lights;
 
     // 3d camera
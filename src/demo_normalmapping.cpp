@@ -9,6 +9,7 @@
 #include "color.h"
 #include "maths.h"
 #include "mesh.h"
+#include "tangents.h"
 
 #include "demo_normalmapping.h"
 
@@ -20,7 +21,7 @@ static const char* gVertexShaderStr = R"GLSL(
 layout(location = 0) in vec3 aPosition;
 layout(location = 1) in vec2 aUV;
 layout(location = 2) in vec3 aNormal;
-layout(location = 3) in vec3 aTangent;
+layout(location = 3) in vec4 aTangent; // w: bitangent sign
 
 // Uniforms
 uniform mat4 uProjection;
@@ -42,10 +43,10 @@ void main()
     vNormal = (uModelNormalMatrix * vec4(aNormal, 0.0)).xyz;
     gl_Position = uProjection * uView * pos4;
 
-    vec3 T = normalize(vec3(uModel * vec4(aTangent,   0.0)));
+    vec3 T = normalize(vec3(uModel * vec4(aTangent.xyz, 0.0)));
     vec3 N = normalize(vec3(uModel * vec4(aNormal,    0.0)));
     T = normalize(T - dot(T, N) * N);
-    vec3 B = cross(N, T);
+    vec3 B = cross(N, T) * aTangent.w;
     TBN = mat3(T, B, N);    
 
 })GLSL";
@@ -98,8 +99,9 @@ void main()
     normal = vNormal;
     if (uProcessNormalMap)
     {
-        normal = texture(uNormalTexture, vUV).rgb;
-        normal = normalize(normal * 2.0 - 1.0);
+        // Tangent space normal, z is rebuilt (2 channels normal maps are block compressed)
+        normal.xy = texture(uNormalTexture, vUV).rg * 2.0 - 1.0;
+        normal.z = sqrt(max(0.0, 1.0 - dot(normal.xy, normal.xy)));
         normal = normalize(TBN * normal);
     }
 
@@ -117,42 +119,45 @@ void main()
 #pragma endregion
 
 bag_object::bag_object(GL::cache& GLCache)
+    : GLCache(GLCache)
 {
     // Create mesh
     {
         // Use vbo from GLCache
-        MeshBuffer = GLCache.LoadObj("media/bag/bag.obj", 1.f, &this->MeshVertexCount, &MeshDesc);
+        Mesh = GLCache.LoadObjAsync("media/bag/bag.obj", 1.f);
+        MeshBuffer = Mesh->VertexBuffer;
+        const vertex_descriptor& MeshDesc = Mesh->Descriptor;
         glGenVertexArrays(1, &MeshArrayObject);
         glBindVertexArray(MeshArrayObject);
 
         glBindBuffer(GL_ARRAY_BUFFER, MeshBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Mesh->IndexBuffer);
 
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, MeshDesc.Stride, (void*)(size_t)MeshDesc.PositionOffset);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, MeshDesc.Stride, (void*)(size_t)MeshDesc.UVOffset);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, MeshDesc.Stride, (void*)(size_t)MeshDesc.NormalOffset);
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, MeshDesc.Stride, (void*)(size_t)MeshDesc.TangentOffset);
+        GL::VertexAttribPointer(0, MeshDesc, VERTEX_ATTRIBUTE_POSITION);
+        GL::VertexAttribPointer(1, MeshDesc, VERTEX_ATTRIBUTE_UV);
+        GL::VertexAttribPointer(2, MeshDesc, VERTEX_ATTRIBUTE_NORMAL);
+        GL::VertexAttribPointer(3, MeshDesc, VERTEX_ATTRIBUTE_TANGENT); // Tangents from Tangents::Generate (mesh cache)
     }
 
     // Gen texture
     {
-        DiffuseTexture = GLCache.LoadTexture("media/bag/bag_diffuse.jpg", IMG_FLIP | IMG_GEN_MIPMAPS);
+        DiffuseTexture = GLCache.LoadTextureAsync("media/bag/bag_diffuse.jpg", IMG_FLIP | IMG_GEN_MIPMAPS | IMG_COMPRESS);
         //SDiffuseTexture = GLCache.LoadTexture("media/fantasy_game_inn_diffuse.png", IMG_FLIP | IMG_GEN_MIPMAPS, (int*)nullptr, (int*)nullptr, true);
-        NormalTexture = GLCache.LoadTexture("media/bag/bag_normal.png", IMG_FLIP | IMG_GEN_MIPMAPS);
+        NormalTexture = GLCache.LoadTextureAsync("media/bag/bag_normal.png", IMG_FLIP | IMG_GEN_MIPMAPS | IMG_NON_COLOR | IMG_COMPRESS);
     }
 }
 
 bag_object::~bag_object()
 {
+    GLCache.ReleaseMesh(Mesh->VertexBuffer);
+    GLCache.ReleaseTexture(DiffuseTexture);
+    GLCache.ReleaseTexture(NormalTexture);
     glDeleteBuffers(1, &MeshArrayObject);
 }
 
 
 demo_normalmapping::demo_normalmapping(GL::cache& GLCache, GL::debug& GLDebug)
-    : GLDebug(GLDebug), BagObject(GLCache)
+    : GLDebug(GLDebug), GLCache(GLCache), BagObject(GLCache)
 {
     Lights.resize(LightCount);
 
@@ -188,78 +193,40 @@ demo_normalmapping::demo_normalmapping(GL::cache& GLCache, GL::debug& GLDebug)
         this->Lights[1] = firstLight;
     }
 
-    Texture = GLCache.LoadTexture("media/brick.png", IMG_FLIP | IMG_GEN_MIPMAPS);
-    NormalTexture = GLCache.LoadTexture("media/bricknormal.png", IMG_FLIP | IMG_GEN_MIPMAPS);
+    Texture = GLCache.LoadTextureAsync("media/brick.png", IMG_FLIP | IMG_GEN_MIPMAPS | IMG_COMPRESS);
+    NormalTexture = GLCache.LoadTextureAsync("media/bricknormal.png", IMG_FLIP | IMG_GEN_MIPMAPS | IMG_NON_COLOR | IMG_COMPRESS);
 
     // Create a quad Vertex Object
     {
-        // positions
-        v3 pos1 = { -1.0, 1.0, 0.0 };
-        v3 pos2 = { -1.0, -1.0, 0.0 };
-        v3 pos3 = { 1.0, -1.0, 0.0 };
-        v3 pos4 = { 1.0, 1.0, 0.0 };
-        // texture coordinates
-        v2 uv1 = {0.0, 1.0};
-        v2 uv2 = {0.0, 0.0};
-        v2 uv3 = {1.0, 0.0};
-        v2 uv4 = {1.0, 1.0};
-        // normal vector
-        v3 nm = { 0.0, 0.0, 1.0 };
-
-        v3 tangent1, tangent2;
-
-        // TRIANGLE 1
-        v3 edge1 = pos2 - pos1;
-        v3 edge2 = pos3 - pos1;
-        v2 deltaUV1 = uv2 - uv1;
-        v2 deltaUV2 = uv3 - uv1;
-
-        float f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-        tangent1.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-        tangent1.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-        tangent1.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-
-        // TRIANGLE 2
-        edge1 = pos3 - pos1;
-        edge2 = pos4 - pos1;
-        deltaUV1 = uv3 - uv1;
-        deltaUV2 = uv4 - uv1;
-
-        f = 1.0f / (deltaUV1.x * deltaUV2.y - deltaUV2.x * deltaUV1.y);
-
-        tangent2.x = f * (deltaUV2.y * edge1.x - deltaUV1.y * edge2.x);
-        tangent2.y = f * (deltaUV2.y * edge1.y - deltaUV1.y * edge2.y);
-        tangent2.z = f * (deltaUV2.y * edge1.z - deltaUV1.y * edge2.z);
-
-        float quadVertices[] = {
-            // positions            // texcoords  // normal         // tangent                          // bitangent
-            pos1.x, pos1.y, pos1.z, uv1.x, uv1.y, nm.x, nm.y, nm.z, tangent1.x, tangent1.y, tangent1.z,
-            pos2.x, pos2.y, pos2.z, uv2.x, uv2.y, nm.x, nm.y, nm.z, tangent1.x, tangent1.y, tangent1.z,
-            pos3.x, pos3.y, pos3.z, uv3.x, uv3.y, nm.x, nm.y, nm.z, tangent1.x, tangent1.y, tangent1.z,
-                                   
-            pos1.x, pos1.y, pos1.z, uv1.x, uv1.y,  nm.x, nm.y, nm.z, tangent2.x, tangent2.y, tangent2.z,
-            pos3.x, pos3.y, pos3.z, uv3.x, uv3.y, nm.x, nm.y, nm.z, tangent2.x, tangent2.y, tangent2.z,
-            pos4.x, pos4.y, pos4.z, uv4.x, uv4.y, nm.x, nm.y, nm.z, tangent2.x, tangent2.y, tangent2.z,
-        };                          
+        // Positions, normals and texture coordinates (tangents are generated)
+        v3 Normal = { 0.f, 0.f, 1.f };
+        std::vector<vertex_full> QuadVertices = {
+            { { -1.f,  1.f, 0.f }, Normal, { 0.f, 1.f }, {} },
+            { { -1.f, -1.f, 0.f }, Normal, { 0.f, 0.f }, {} },
+            { {  1.f, -1.f, 0.f }, Normal, { 1.f, 0.f }, {} },
+            { {  1.f,  1.f, 0.f }, Normal, { 1.f, 1.f }, {} },
+        };
+        std::vector<uint32_t> QuadIndices = { 0, 1, 2, 0, 2, 3 };
+        Tangents::Generate(QuadVertices, QuadIndices);
+
+        vertex_descriptor QuadDesc = Mesh::GetDescriptor(VERTEX_LAYOUT_FULL);
 
         // setup plane VAO
-        GLuint quadVBO = 0;
         glGenVertexArrays(1, &quadVAO);
         glGenBuffers(1, &quadVBO);
+        glGenBuffers(1, &quadIBO);
 
         glBindVertexArray(quadVAO);
         glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-
-        glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(3 * sizeof(float)));
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(5 * sizeof(float)));
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 11 * sizeof(float), (void*)(8 * sizeof(float)));
+        glBufferData(GL_ARRAY_BUFFER, QuadVertices.size() * sizeof(vertex_full), QuadVertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadIBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, QuadIndices.size() * sizeof(uint32_t), QuadIndices.data(), GL_STATIC_DRAW);
+
+        GL::VertexAttribPointer(0, QuadDesc, VERTEX_ATTRIBUTE_POSITION);
+        GL::VertexAttribPointer(1, QuadDesc, VERTEX_ATTRIBUTE_UV);
+        GL::VertexAttribPointer(2, QuadDesc, VERTEX_ATTRIBUTE_NORMAL);
+        GL::VertexAttribPointer(3, QuadDesc, VERTEX_ATTRIBUTE_TANGENT);
+        glBindVertexArray(0);
     }
 
     // Set uniforms that won't change
@@ -280,8 +247,13 @@ demo_normalmapping::demo_normalmapping(GL::cache& GLCache, GL::debug& GLDebug)
 
 demo_normalmapping::~demo_normalmapping()
 {
+    GLCache.ReleaseTexture(Texture);
+    GLCache.ReleaseTexture(NormalTexture);
+
     // Cleanup GL
     glDeleteVertexArrays(1, &quadVAO);
+    glDeleteBuffers(1, &quadVBO);
+    glDeleteBuffers(1, &quadIBO);
     glDeleteProgram(Program);
 }
 
@@ -386,7 +358,7 @@ void demo_normalmapping::RenderQuad(const mat4& ProjectionMatrix, const mat4& Vi
     glActiveTexture(GL_TEXTURE0);
 
     glBindVertexArray(quadVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, nullptr);
     glBindVertexArray(0);
 }
 
@@ -411,7 +383,7 @@ void demo_normalmapping::RenderBag(const mat4& ProjectionMatrix, const mat4& Vie
 
     // Draw mesh
     glBindVertexArray(BagObject.MeshArrayObject);
-    glDrawArrays(GL_TRIANGLES, 0, BagObject.MeshVertexCount);
+    glDrawElements(GL_TRIANGLES, BagObject.Mesh->IndexCount, BagObject.Mesh->IndexType, nullptr);
     glBindVertexArray(0);
 }
 
@@ -19,8 +19,7 @@ public:
     // Mesh
     GLuint MeshBuffer = 0;
     GLuint MeshArrayObject = 0;
-    int MeshVertexCount = 0;
-    vertex_descriptor MeshDesc;
+    const GL::cache::mesh* Mesh = nullptr; // Loaded asynchronously by GLCache
 
     // Textures
     GLuint DiffuseTexture = 0;
@@ -30,6 +29,9 @@ public:
     v3 Position = { 3.f, 0, -5.f };
     v3 Rotation = { 0, 0, 0 };
     float Scale = 0.01f;
+
+private:
+    GL::cache& GLCache;
 };
 
 class demo_normalmapping : public demo
@@ -50,6 +52,7 @@ public:
 
 private:
     GL::debug& GLDebug;
+    GL::cache& GLCache;
     std::vector<GL::light> Lights;
 
 
@@ -62,6 +65,8 @@ private:
     bag_object BagObject;
 
     GLuint quadVAO = 0;
+    GLuint quadVBO = 0;
+    GLuint quadIBO = 0;
     GLuint Texture = 0;
     GLuint NormalTexture = 0;
 
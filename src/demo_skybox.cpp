@@ -38,9 +38,9 @@ out int id;
 void main()
 {
     vUV = aUV;
-    vec4 pos4 = (uModel * vec4(aPosition, 1.0));
+    vec4 pos4 = (uModel * vec4(decodePosition(aPosition), 1.0));
     vPos = pos4.xyz / pos4.w;
-    vNormal = (uModelNormalMatrix * vec4(aNormal, 0.0)).xyz;
+    vNormal = (uModelNormalMatrix * vec4(decodeNormal(aNormal), 0.0)).xyz;
     gl_Position = uProjection * uView * pos4;
 })GLSL";
 
@@ -143,7 +143,7 @@ uniform mat4 uView;
 void main()
 {
 
-    vec4 pos4 = (uModel * vec4(aPosition, 1.0));
+    vec4 pos4 = (uModel * vec4(decodePosition(aPosition), 1.0));
     gl_Position = uProjection * uView * pos4;
 })GLSL";
 
@@ -162,7 +162,7 @@ void main()
 #pragma endregion
 
 demo_skybox::demo_skybox(GL::cache& GLCache, GL::debug& GLDebug)
-    : demo_base(GLCache, GLDebug), GLDebug(GLDebug)
+    : demo_base(GLCache, GLDebug), GLDebug(GLDebug), GLCache(GLCache)
 {
     // Create shaders
     {
@@ -191,93 +191,41 @@ demo_skybox::demo_skybox(GL::cache& GLCache, GL::debug& GLDebug)
         glGenVertexArrays(1, &VAO);
         glBindVertexArray(VAO);
 
-        glBindBuffer(GL_ARRAY_BUFFER, TavernScene.MeshBuffer);
+        glBindBuffer(GL_ARRAY_BUFFER, TavernScene.Mesh->VertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, TavernScene.Mesh->IndexBuffer);
 
-        vertex_descriptor& Desc = TavernScene.MeshDesc;
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.PositionOffset);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.UVOffset);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, Desc.Stride, (void*)(size_t)Desc.NormalOffset);
+        const vertex_descriptor& Desc = TavernScene.Mesh->Descriptor;
+        GL::VertexAttribPointer(0, Desc, VERTEX_ATTRIBUTE_POSITION);
+        GL::VertexAttribPointer(1, Desc, VERTEX_ATTRIBUTE_UV);
+        GL::VertexAttribPointer(2, Desc, VERTEX_ATTRIBUTE_NORMAL);
     }
 
     // Create sphere vertex array
     {
-        int VertexMeshCount = 0;
-        vertex_descriptor sphere;
-        GLuint buffer = GLCache.LoadObj("media/sphere.obj",1.f, &VertexMeshCount, &sphere);
+        GLuint buffer = GLCache.LoadObj("media/sphere.obj", 1.f, &SphereMesh, nullptr, VERTEX_LAYOUT_PACKED);
 
         glGenVertexArrays(1, &SphereVAO);
         glBindVertexArray(SphereVAO);
 
         glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, SphereMesh.IndexBuffer);
 
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sphere.Stride, (void*)(size_t)sphere.PositionOffset);
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sphere.Stride, (void*)(size_t)sphere.UVOffset);
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sphere.Stride, (void*)(size_t)sphere.NormalOffset);
+        GL::VertexAttribPointer(0, SphereMesh.Descriptor, VERTEX_ATTRIBUTE_POSITION);
+        GL::VertexAttribPointer(1, SphereMesh.Descriptor, VERTEX_ATTRIBUTE_UV);
+        GL::VertexAttribPointer(2, SphereMesh.Descriptor, VERTEX_ATTRIBUTE_NORMAL);
     }
 
-    // Create a vertex array and bind attribs onto the vertex buffer
+    // Create a vertex array for the skybox (shared inverted cube, seen from inside)
     {
-        float skyboxVertices[] = {
-            // positions          
-            -1.0f,  1.0f, -1.0f,
-            -1.0f, -1.0f, -1.0f,
-             1.0f, -1.0f, -1.0f,
-             1.0f, -1.0f, -1.0f,
-             1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-
-            -1.0f, -1.0f,  1.0f,
-            -1.0f, -1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f, -1.0f,
-            -1.0f,  1.0f,  1.0f,
-            -1.0f, -1.0f,  1.0f,
-
-             1.0f, -1.0f, -1.0f,
-             1.0f, -1.0f,  1.0f,
-             1.0f,  1.0f,  1.0f,
-             1.0f,  1.0f,  1.0f,
-             1.0f,  1.0f, -1.0f,
-             1.0f, -1.0f, -1.0f,
-
-            -1.0f, -1.0f,  1.0f,
-            -1.0f,  1.0f,  1.0f,
-             1.0f,  1.0f,  1.0f,
-             1.0f,  1.0f,  1.0f,
-             1.0f, -1.0f,  1.0f,
-            -1.0f, -1.0f,  1.0f,
-
-            -1.0f,  1.0f, -1.0f,
-             1.0f,  1.0f, -1.0f,
-             1.0f,  1.0f,  1.0f,
-             1.0f,  1.0f,  1.0f,
-            -1.0f,  1.0f,  1.0f,
-            -1.0f,  1.0f, -1.0f,
-
-            -1.0f, -1.0f, -1.0f,
-            -1.0f, -1.0f,  1.0f,
-             1.0f, -1.0f, -1.0f,
-             1.0f, -1.0f, -1.0f,
-            -1.0f, -1.0f,  1.0f,
-             1.0f, -1.0f,  1.0f
-        };
+        SkyMesh = GLCache.LoadPrimitive(PRIMITIVE_INVERTED_CUBE);
 
         glGenVertexArrays(1, &SkyVAO);
-        glGenBuffers(1, &SkyBuffer);
-       
         glBindVertexArray(SkyVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, SkyBuffer);
-        
-        glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices[0], GL_STATIC_DRAW);
 
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(float) * 3, (void*)0);
+        glBindBuffer(GL_ARRAY_BUFFER, SkyMesh->VertexBuffer);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, SkyMesh->IndexBuffer);
+
+        GL::VertexAttribPointer(0, SkyMesh->Descriptor, VERTEX_ATTRIBUTE_POSITION);
         glBindVertexArray(0);
     }
 
@@ -291,7 +239,7 @@ demo_skybox::demo_skybox(GL::cache& GLCache, GL::debug& GLDebug)
 
     //Create Skybox
 
-    std::vector<std::string> faces
+    const char* faces[6] =
     {
         /*"media/Sky_NightTime01FT.png",
         "media/Sky_NightTime01BK.png",
@@ -307,65 +255,25 @@ demo_skybox::demo_skybox(GL::cache& GLCache, GL::debug& GLDebug)
     "media/back.jpg"
     };
 
-    {
-        glGenTextures(1, &SkyTexture);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, SkyTexture);
-
-        int width, height, nrChannels;
-        unsigned char* data;
-        for (unsigned int i = 0; i < faces.size(); i++)
-        {
-            unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-            if (data)
-            {
-                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i,
-                    0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data
-                );
-            }
-                stbi_image_free(data);
-
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-        }
-        glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
-    }
+    // Shared with demo_full
+    SkyTexture = GLCache.LoadCubemap(faces, IMG_FORCE_RGB);
     
     GenerateCubemap(EnvironmentTexture, 128.f, 128.f, GL_RGB, GL_UNSIGNED_BYTE);
     GenerateCubemap(DepthTexture, 1024.f, 1024.f, GL_DEPTH_COMPONENT, GL_FLOAT);
 
-    vertex_descriptor Descriptor = {};
-    Descriptor.Stride = sizeof(vertex_full);
-    Descriptor.HasUV = true;
-    Descriptor.PositionOffset = OFFSETOF(vertex_full, Position);
-    Descriptor.UVOffset = OFFSETOF(vertex_full, UV);
-    Descriptor.NormalOffset = OFFSETOF(vertex_full, Normal);
-    // Create cube vertices
-    vertex_full Cube[36];
-
-    Mesh::BuildCube(Cube, Cube + 36, Descriptor);
-
-    // Upload cube to gpu (VRAM)
+    // Create cube vertex array (shared cube)
+    CubeMesh = GLCache.LoadPrimitive(PRIMITIVE_CUBE);
 
-    GLuint cube = 0;
-    glGenBuffers(1, &cube);
-    glBindBuffer(GL_ARRAY_BUFFER, cube);
-    glBufferData(GL_ARRAY_BUFFER, 36 * sizeof(vertex_full), Cube, GL_STATIC_DRAW);
-
-    // Create a vertex array
     glGenVertexArrays(1, &CubeVAO);
     glBindVertexArray(CubeVAO);
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(vertex_full), (void*)(Descriptor.PositionOffset));
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(vertex_full), (void*)(Descriptor.NormalOffset));
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(vertex_full), (void*)(Descriptor.UVOffset));
+    glBindBuffer(GL_ARRAY_BUFFER, CubeMesh->VertexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, CubeMesh->IndexBuffer);
+
+    GL::VertexAttribPointer(0, CubeMesh->Descriptor, VERTEX_ATTRIBUTE_POSITION);
+    GL::VertexAttribPointer(1, CubeMesh->Descriptor, VERTEX_ATTRIBUTE_UV);
+    GL::VertexAttribPointer(2, CubeMesh->Descriptor, VERTEX_ATTRIBUTE_NORMAL);
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
     glGenFramebuffers(1, &SkyFBO);
@@ -382,6 +290,11 @@ demo_skybox::demo_skybox(GL::cache& GLCache, GL::debug& GLDebug)
 
 demo_skybox::~demo_skybox()
 {
+    GLCache.ReleaseMesh(SphereMesh.VertexBuffer);
+    GLCache.ReleaseMesh(SkyMesh->VertexBuffer);
+    GLCache.ReleaseMesh(CubeMesh->VertexBuffer);
+    GLCache.ReleaseTexture(SkyTexture);
+
     // Cleanup GL
     glDeleteVertexArrays(1, &SkyVAO);
     glDeleteVertexArrays(1, &CubeVAO);
@@ -401,7 +314,7 @@ void demo_skybox::RenderSkybox(const camera& cam, const mat4& projection)
 
     glBindVertexArray(SkyVAO);
     glBindTexture(GL_TEXTURE_CUBE_MAP, SkyTexture);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glDrawElements(GL_TRIANGLES, SkyMesh->IndexCount, SkyMesh->IndexType, nullptr);
     
     glDepthMask(GL_TRUE);
     glUseProgram(0);
@@ -434,9 +347,10 @@ void demo_skybox::MousePicking(const platform_io& IO)
     v3 color = Color::RGB(i);
     glUniform4f(glGetUniformLocation(MousePickingProgram, "Inid"), color.r, color.g, color.b, 1.f);
 
+    GL::UniformVertexDescriptor(MousePickingProgram, SphereMesh.Descriptor);
     // Draw mesh
     glBindVertexArray(SphereVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 2880);
+    glDrawElements(GL_TRIANGLES, SphereMesh.IndexCount, SphereMesh.IndexType, nullptr);
 
     glFlush();
     glFinish();
@@ -484,6 +398,7 @@ void demo_skybox::RenderSceneWithReflection(const mat4& ProjectionMatrix, const
     glUniformMatrix4fv(glGetUniformLocation(ReflectiveProgram, "uModel"), 1, GL_FALSE, ModelMatrix.e);
     glUniformMatrix4fv(glGetUniformLocation(ReflectiveProgram, "uView"), 1, GL_FALSE, ViewMatrix.e);
     glUniformMatrix4fv(glGetUniformLocation(ReflectiveProgram, "uModelNormalMatrix"), 1, GL_FALSE, NormalMatrix.e);
+    GL::UniformVertexDescriptor(ReflectiveProgram, SphereMesh.Descriptor);
     glUniform3fv(glGetUniformLocation(ReflectiveProgram, "uViewPosition"), 1, Camera.Position.e);
 
     glBindVertexArray(SphereVAO);
@@ -492,7 +407,7 @@ void demo_skybox::RenderSceneWithReflection(const mat4& ProjectionMatrix, const
     else
         glBindTexture(GL_TEXTURE_CUBE_MAP, SkyTexture);
 
-    glDrawArrays(GL_TRIANGLES, 0, 2880);
+    glDrawElements(GL_TRIANGLES, SphereMesh.IndexCount, SphereMesh.IndexType, nullptr);
 
 }
 
@@ -522,14 +437,16 @@ void demo_skybox::RenderScene(const mat4& ProjectionMatrix, const mat4& ModelMat
     // Bind uniform buffer and textures
     glBindBufferBase(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING_POINT, TavernScene.LightsUniformBuffer);
 
+    GL::UniformVertexDescriptor(Program, SphereMesh.Descriptor);
     // Draw mesh
     glBindVertexArray(SphereVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 2880);
+    glDrawElements(GL_TRIANGLES, SphereMesh.IndexCount, SphereMesh.IndexType, nullptr);
 
     model = CameraGetMatrixEx(Camera, {0.f, -0.75f, 0.f});
     glUniformMatrix4fv(glGetUniformLocation(Program, "uModel"), 1, GL_FALSE, model.e);
+    GL::UniformVertexDescriptor(Program, CubeMesh->Descriptor);
     glBindVertexArray(CubeVAO);
-    glDrawArrays(GL_TRIANGLES, 0, 36);
+    glDrawElements(GL_TRIANGLES, CubeMesh->IndexCount, CubeMesh->IndexType, nullptr);
 }
 
 void demo_skybox::RenderEnvironmentMap(const v3& center) 
@@ -623,6 +540,7 @@ void demo_skybox::DisplayDebugUI()
         // Debug display
         ImGui::Checkbox("Dynamic Reflection", &Dynamic);
         TavernScene.InspectLights();
+        TavernScene.InspectMeshlets();
 
         ImGui::TreePop();
     }
@@ -644,6 +562,7 @@ void demo_skybox::RenderTavernEx(const mat4& ProjectionMatrix, const mat4& ViewM
     glUniform4f(glGetUniformLocation(MousePickingProgram, "Inid"), color.r, color.g, color.b, 1.f);
 
     // Draw mesh
+    GL::UniformVertexDescriptor(MousePickingProgram, TavernScene.Mesh->Descriptor);
     glBindVertexArray(VAO);
-    glDrawArrays(GL_TRIANGLES, 0, TavernScene.MeshVertexCount);
+    TavernScene.DrawMesh(ProjectionMatrix, ViewMatrix, ModelMatrix);
 }
\ No newline at end of file
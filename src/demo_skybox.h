@@ -31,13 +31,15 @@ public:
     void RenderDepthMap();
 private:
     GL::debug& GLDebug;
+    GL::cache& GLCache;
 
     GLuint SphereVAO = 0;
+    GL::cache::mesh SphereMesh = {};
     GLuint SphereBuffer = 0;
 
     GLuint SkyProgram = 0;
     GLuint SkyVAO = 0;
-    GLuint SkyBuffer = 0;
+    const GL::cache::mesh* SkyMesh = nullptr;
     GLuint SkyFBO = 0;
 
     void RenderSkybox(const camera& cam, const mat4& projection);
@@ -54,6 +56,7 @@ private:
     GLuint MousePickingProgram = 0;
 
     GLuint CubeVAO = 0;
+    const GL::cache::mesh* CubeMesh = nullptr;
 
     v3 Position = { 0.f,0.f,0.f };
     bool Dynamic = true;
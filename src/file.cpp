@@ -0,0 +1,177 @@
+#include <cstring>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#endif
+
+#include "file.h"
+
+bool File::Map(file_mapping* Mapping, const char* Filename)
+{
+    *Mapping = {};
+
+#ifdef _WIN32
+    HANDLE FileHandle = CreateFileA(Filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (FileHandle == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER FileSize;
+    if (!GetFileSizeEx(FileHandle, &FileSize) || FileSize.QuadPart == 0)
+    {
+        CloseHandle(FileHandle);
+        return false;
+    }
+
+    HANDLE MappingHandle = CreateFileMappingA(FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    const void* Data = MappingHandle ? MapViewOfFile(MappingHandle, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (Data == nullptr)
+    {
+        if (MappingHandle)
+            CloseHandle(MappingHandle);
+        CloseHandle(FileHandle);
+        return false;
+    }
+
+    Mapping->Data = Data;
+    Mapping->Size = (size_t)FileSize.QuadPart;
+    Mapping->FileHandle = FileHandle;
+    Mapping->MappingHandle = MappingHandle;
+#else
+    int FileDescriptor = open(Filename, O_RDONLY);
+    if (FileDescriptor < 0)
+        return false;
+
+    struct stat Stat;
+    if (fstat(FileDescriptor, &Stat) != 0 || Stat.st_size == 0)
+    {
+        close(FileDescriptor);
+        return false;
+    }
+
+    void* Data = mmap(nullptr, (size_t)Stat.st_size, PROT_READ, MAP_PRIVATE, FileDescriptor, 0);
+    if (Data == MAP_FAILED)
+    {
+        close(FileDescriptor);
+        return false;
+    }
+
+    Mapping->Data = Data;
+    Mapping->Size = (size_t)Stat.st_size;
+    Mapping->FileDescriptor = FileDescriptor;
+#endif
+
+    return true;
+}
+
+void File::Unmap(file_mapping* Mapping)
+{
+    if (Mapping->Data == nullptr || Mapping->IsView)
+    {
+        *Mapping = {};
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(Mapping->Data);
+    CloseHandle((HANDLE)Mapping->MappingHandle);
+    CloseHandle((HANDLE)Mapping->FileHandle);
+#else
+    munmap((void*)Mapping->Data, Mapping->Size);
+    close(Mapping->FileDescriptor);
+#endif
+
+    *Mapping = {};
+}
+
+bool File::GetStats(file_stats* Stats, const char* Filename)
+{
+#ifdef _WIN32
+    struct _stat64 Stat;
+    if (_stat64(Filename, &Stat) != 0)
+        return false;
+#else
+    struct stat Stat;
+    if (stat(Filename, &Stat) != 0)
+        return false;
+#endif
+
+    Stats->Size = (uint64_t)Stat.st_size;
+    Stats->ModificationTime = (uint64_t)Stat.st_mtime;
+    return true;
+}
+
+static inline uint64_t RotateLeft(uint64_t X, int R)
+{
+    return (X << R) | (X >> (64 - R));
+}
+
+// Word based hash (xxhash64-like single lane), good enough to detect modified files
+uint64_t File::Hash(const void* Data, size_t Size, uint64_t Seed)
+{
+    const uint64_t Prime1 = 0x9E3779B185EBCA87ull;
+    const uint64_t Prime2 = 0xC2B2AE3D27D4EB4Full;
+
+    const uint8_t* Bytes = (const uint8_t*)Data;
+    uint64_t Hash = Seed + Prime2 + (uint64_t)Size;
+
+    size_t WordCount = Size / sizeof(uint64_t);
+    for (size_t i = 0; i < WordCount; ++i)
+    {
+        uint64_t Word;
+        memcpy(&Word, Bytes + i * sizeof(uint64_t), sizeof(uint64_t));
+        Hash = RotateLeft(Hash ^ (Word * Prime2), 31) * Prime1;
+    }
+
+    for (size_t i = WordCount * sizeof(uint64_t); i < Size; ++i)
+        Hash = RotateLeft(Hash ^ (Bytes[i] * Prime1), 11) * Prime2;
+
+    // Final avalanche
+    Hash ^= Hash >> 33;
+    Hash *= Prime2;
+    Hash ^= Hash >> 29;
+    Hash *= Prime1;
+    Hash ^= Hash >> 32;
+    return Hash;
+}
+
+bool File::HashFile(uint64_t* HashOut, const char* Filename)
+{
+    file_mapping Mapping;
+    if (!File::Map(&Mapping, Filename))
+        return false;
+
+    *HashOut = File::Hash(Mapping.Data, Mapping.Size);
+    File::Unmap(&Mapping);
+    return true;
+}
+
+size_t File::GetPeakMemoryUsage()
+{
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS Counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &Counters, sizeof(Counters)))
+        return 0;
+    return Counters.PeakWorkingSetSize;
+#else
+    struct rusage Usage;
+    if (getrusage(RUSAGE_SELF, &Usage) != 0)
+        return 0;
+#ifdef __APPLE__
+    return (size_t)Usage.ru_maxrss; // Bytes on macOS
+#else
+    return (size_t)Usage.ru_maxrss * 1024; // Kilobytes on Linux
+#endif
+#endif
+}
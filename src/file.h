@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file
+struct file_mapping
+{
+    const void* Data;
+    size_t Size;
+    bool IsView; // Range of another mapping (AssetArchive::Map), Unmap only clears it
+#ifdef _WIN32
+    void* FileHandle;
+    void* MappingHandle;
+#else
+    int FileDescriptor;
+#endif
+};
+
+struct file_stats
+{
+    uint64_t Size;
+    uint64_t ModificationTime;
+};
+
+namespace File
+{
+bool Map(file_mapping* Mapping, const char* Filename);
+void Unmap(file_mapping* Mapping);
+bool GetStats(file_stats* Stats, const char* Filename);
+uint64_t Hash(const void* Data, size_t Size, uint64_t Seed = 0);
+bool HashFile(uint64_t* HashOut, const char* Filename);
+
+// Peak resident memory of the process in bytes (0 if unknown)
+size_t GetPeakMemoryUsage();
+}
@@ -0,0 +1,101 @@
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "jobs.h"
+
+int Jobs::GetWorkerCount()
+{
+    static int WorkerCount = (int)std::thread::hardware_concurrency();
+    return WorkerCount > 0 ? WorkerCount : 1;
+}
+
+void Jobs::ParallelFor(int Count, const std::function<void(int Index)>& Func)
+{
+    if (Count <= 0)
+        return;
+
+    int ThreadCount = GetWorkerCount() < Count ? GetWorkerCount() : Count;
+    if (ThreadCount == 1)
+    {
+        for (int i = 0; i < Count; ++i)
+            Func(i);
+        return;
+    }
+
+    std::atomic<int> NextIndex(0);
+    auto Worker = [&]()
+    {
+        for (int i = NextIndex++; i < Count; i = NextIndex++)
+            Func(i);
+    };
+
+    std::vector<std::thread> Threads;
+    Threads.reserve(ThreadCount - 1);
+    for (int i = 0; i < ThreadCount - 1; ++i)
+        Threads.emplace_back(Worker);
+
+    Worker();
+
+    for (std::thread& Thread : Threads)
+        Thread.join();
+}
+
+// Background workers of Jobs::Submit (one less than the hardware threads, the main thread keeps one)
+struct job_queue
+{
+    std::mutex Mutex;
+    std::condition_variable Condition;
+    std::deque<std::function<void()>> Queue;
+    std::vector<std::thread> Workers;
+    bool Quit = false;
+
+    job_queue()
+    {
+        int WorkerCount = Jobs::GetWorkerCount() > 1 ? Jobs::GetWorkerCount() - 1 : 1;
+        for (int i = 0; i < WorkerCount; ++i)
+            Workers.emplace_back([this]() { Work(); });
+    }
+
+    ~job_queue()
+    {
+        {
+            std::lock_guard<std::mutex> Lock(Mutex);
+            Quit = true;
+            Queue.clear();
+        }
+        Condition.notify_all();
+        for (std::thread& Worker : Workers)
+            Worker.join();
+    }
+
+    void Work()
+    {
+        for (;;)
+        {
+            std::function<void()> Func;
+            {
+                std::unique_lock<std::mutex> Lock(Mutex);
+                Condition.wait(Lock, [this]() { return Quit || !Queue.empty(); });
+                if (Quit)
+                    return;
+                Func = std::move(Queue.front());
+                Queue.pop_front();
+            }
+            Func();
+        }
+    }
+};
+
+void Jobs::Submit(std::function<void()> Func)
+{
+    static job_queue JobQueue;
+    {
+        std::lock_guard<std::mutex> Lock(JobQueue.Mutex);
+        JobQueue.Queue.push_back(std::move(Func));
+    }
+    JobQueue.Condition.notify_one();
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <functional>
+
+// Minimal CPU parallelism helpers (std::thread based)
+namespace Jobs
+{
+// Number of threads used by ParallelFor (hardware threads, at least 1)
+int GetWorkerCount();
+
+// Call Func(Index) for every Index in [0, Count) from several threads (the calling thread included).
+// Indices are distributed dynamically, returns once every call has finished.
+void ParallelFor(int Count, const std::function<void(int Index)>& Func);
+
+// Queue Func to run later on a background worker (workers are started on first use).
+// Jobs still queued at exit are dropped, running jobs are waited for.
+void Submit(std::function<void()> Func);
+}
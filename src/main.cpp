@@ -190,6 +190,7 @@ int main(int argc, char* argv[])
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_SRGB_CAPABLE, GLFW_TRUE); // GL_FRAMEBUFFER_SRGB on the default framebuffer
     { // Restricted scope to force access to Window with App.Window
         GLFWwindow* Window = glfwCreateWindow(WIDTH, HEIGHT, "Image Based rendering", nullptr, nullptr);
         glfwSetWindowUserPointer(Window, &App);
@@ -244,6 +245,9 @@ int main(int argc, char* argv[])
         GL::cache GLCache;
         GL::debug GLDebug;
 
+        // Baked files packed by the bake tool, loose files are used without it
+        GLCache.MountArchive("media/assets.pack");
+
         // First update to pass to demo constructors
         GLFWPlatformIOUpdate(App.Window, &App.IO);
         
@@ -264,6 +268,9 @@ int main(int argc, char* argv[])
             //std::make_unique<demo_pg_fbx>(GLDebug.Wireframe, GLCache),
             // TODO(demo): Add other demos here
         };
+        printf("Demos created in %.2fs\n", glfwGetTime() - StartTime);
+
+        bool AsyncLoadsFinished = false;
 
         // Main loop
         while (!glfwWindowShouldClose(App.Window))
@@ -326,10 +333,28 @@ int main(int argc, char* argv[])
                 ImGui::Text("[%s]", typeid(*Demos[DemoId]).name());
             }
 
+            // Upload assets loaded in background (placeholders are displayed meanwhile)
+            int PendingLoads = GLCache.FinishAsyncLoads(2.0);
+            if (PendingLoads > 0)
+            {
+                ImGui::Text("Loading %d assets...", PendingLoads);
+            }
+            else if (!AsyncLoadsFinished)
+            {
+                AsyncLoadsFinished = true;
+                printf("Async loads finished after %.2fs\n", glfwGetTime() - StartTime);
+            }
+
+            // Mip levels of streamed textures requested during the previous frame
+            GLCache.StreamTextures();
+
             // Display GPU infos
             ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
             ImGui::Checkbox("Demo window", &ShowDemoWindow);
 
+            if (ImGui::CollapsingHeader("GL cache"))
+                GLCache.InspectStats();
+
             if (ImGui::CollapsingHeader("System info"))
             {
                 ImGui::Text("GL_VERSION: %s", glGetString(GL_VERSION));
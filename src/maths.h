@@ -14,6 +14,7 @@ namespace Math
     inline float Cos(float V) { return std::cos(V); }
     inline float Sin(float V) { return std::sin(V); }
     inline float Tan(float V) { return std::tan(V); }
+    inline float Acos(float V) { return std::acos(V); }
     inline float Atan(float V) { return std::atan(V); }
     inline float Atan2(float Y, float X) { return std::atan2(Y, X); }
     
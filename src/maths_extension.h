@@ -1,3 +1,81 @@
 #pragma once
 
-// NOTE: Add your own maths functions
\ No newline at end of file
+// NOTE: Add your own maths functions
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace Math
+{
+    inline float Abs(float Value) { return std::fabs(Value); }
+    inline float Floor(float Value) { return std::floor(Value); }
+    inline float Ceil(float Value) { return std::ceil(Value); }
+    inline float Pow(float Value, float Exponent) { return std::pow(Value, Exponent); }
+
+    // IEEE 754 half precision conversion (round to nearest even, denormals and inf/nan are kept)
+    inline uint16_t FloatToHalf(float Value)
+    {
+        uint32_t Bits;
+        memcpy(&Bits, &Value, sizeof(Bits));
+
+        uint32_t Sign = Bits & 0x80000000u;
+        Bits ^= Sign;
+
+        uint16_t Half;
+        if (Bits >= (127u + 16u) << 23) // Overflow, inf or nan
+        {
+            Half = (Bits > 255u << 23) ? 0x7E00 : 0x7C00;
+        }
+        else if (Bits < 113u << 23) // Denormal or zero: let the fpu round the mantissa
+        {
+            const uint32_t DenormMagicBits = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+            float DenormMagic;
+            memcpy(&DenormMagic, &DenormMagicBits, sizeof(DenormMagic));
+
+            float Shifted;
+            memcpy(&Shifted, &Bits, sizeof(Shifted));
+            Shifted += DenormMagic;
+
+            uint32_t ShiftedBits;
+            memcpy(&ShiftedBits, &Shifted, sizeof(ShiftedBits));
+            Half = (uint16_t)(ShiftedBits - DenormMagicBits);
+        }
+        else
+        {
+            uint32_t MantissaOdd = (Bits >> 13) & 1;
+            Bits += ((uint32_t)(15 - 127) << 23) + 0xFFF; // Rebias exponent and round
+            Bits += MantissaOdd;
+            Half = (uint16_t)(Bits >> 13);
+        }
+
+        return Half | (uint16_t)(Sign >> 16);
+    }
+
+    inline float HalfToFloat(uint16_t Half)
+    {
+        uint32_t Sign = (uint32_t)(Half & 0x8000) << 16;
+        uint32_t Exponent = (Half >> 10) & 0x1F;
+        uint32_t Mantissa = Half & 0x3FF;
+
+        uint32_t Bits;
+        if (Exponent == 0x1F) // Inf or nan
+        {
+            Bits = Sign | 0x7F800000u | (Mantissa << 13);
+        }
+        else if (Exponent == 0) // Zero or denormal
+        {
+            float Value = (float)Mantissa * (1.f / 16777216.f); // 2^-24
+            memcpy(&Bits, &Value, sizeof(Bits));
+            Bits |= Sign;
+        }
+        else
+        {
+            Bits = Sign | ((Exponent + 127 - 15) << 23) | (Mantissa << 13);
+        }
+
+        float Value;
+        memcpy(&Value, &Bits, sizeof(Value));
+        return Value;
+    }
+}
@@ -1,413 +1,527 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
 #include <vector>
 #include <string>
 
 #include <tiny_obj_loader.h>
 
+#include "platform.h"
 #include "maths.h"
+#include "simd.h"
 #include "mesh.h"
+#include "primitives.h"
+#include "mesh_cache.h"
+#include "obj_parser.h"
 
 using namespace Mesh;
 
 inline bool operator==(const v3& A, const  v3& B) { return A.x == B.x && A.y == B.y && A.z == B.z; }
 
-static void* ConvertVertices(void* VerticesDst, const vertex_descriptor& Descriptor, vertex_full* VerticesSrc, int Count)
+static int16_t PackSnorm16(float Value)
+{
+    return (int16_t)std::lround(Math::Clamp(Value, -1.f, 1.f) * 32767.f);
+}
+
+// Write Count float values with the given format (padded with zeros to the stored component count)
+static void WriteAttribute(uint8_t* Dst, vertex_attribute_format Format, const float* Values, int Count)
+{
+    int Components = Mesh::GetAttributeComponents(Format, Count);
+    if (Format == VERTEX_FORMAT_FLOAT)
+    {
+        memcpy(Dst, Values, Count * sizeof(float));
+        return;
+    }
+
+    uint16_t Packed[4] = {};
+    for (int i = 0; i < Count; ++i)
+        Packed[i] = (Format == VERTEX_FORMAT_HALF) ? Math::FloatToHalf(Values[i]) : (uint16_t)PackSnorm16(Values[i]);
+    memcpy(Dst, Packed, Components * sizeof(uint16_t));
+}
+
+// Octahedral mapping of a unit vector to [-1;1]^2
+static v2 EncodeOctahedral(v3 N)
+{
+    float L1 = Math::Abs(N.x) + Math::Abs(N.y) + Math::Abs(N.z);
+    if (L1 == 0.f)
+        return { 0.f, 0.f };
+
+    v2 E = { N.x / L1, N.y / L1 };
+    if (N.z < 0.f)
+    {
+        v2 Folded = {
+            (1.f - Math::Abs(E.y)) * (E.x >= 0.f ? 1.f : -1.f),
+            (1.f - Math::Abs(E.x)) * (E.y >= 0.f ? 1.f : -1.f)
+        };
+        E = Folded;
+    }
+    return E;
+}
+
+// Quaternion of the (tangent, bitangent, normal) frame, w is kept away from 0 so its sign survives quantization
+static v4 EncodeQTangent(v3 Normal, v3 Tangent, float Handedness)
+{
+    v3 N = Vec3::Length(Normal) > 0.f ? Vec3::Normalize(Normal) : v3{ 0.f, 0.f, 1.f };
+
+    // Gram-Schmidt (pick any tangent when it is degenerated)
+    v3 T = Tangent - N * Vec3::Dot(N, Tangent);
+    if (!(Vec3::Length(T) > 1e-6f))
+        T = Math::Abs(N.x) < 0.9f ? Vec3::Cross(N, { 1.f, 0.f, 0.f }) : Vec3::Cross(N, { 0.f, 1.f, 0.f });
+    T = Vec3::Normalize(T);
+    v3 B = Vec3::Cross(N, T);
+
+    // Rotation matrix (columns T, B, N) to quaternion
+    v4 Q;
+    float Trace = T.x + B.y + N.z;
+    if (Trace > 0.f)
+    {
+        float S = Math::Sqrt(Trace + 1.f) * 2.f;
+        Q = { (B.z - N.y) / S, (N.x - T.z) / S, (T.y - B.x) / S, 0.25f * S };
+    }
+    else if (T.x > B.y && T.x > N.z)
+    {
+        float S = Math::Sqrt(1.f + T.x - B.y - N.z) * 2.f;
+        Q = { 0.25f * S, (B.x + T.y) / S, (N.x + T.z) / S, (B.z - N.y) / S };
+    }
+    else if (B.y > N.z)
+    {
+        float S = Math::Sqrt(1.f + B.y - T.x - N.z) * 2.f;
+        Q = { (B.x + T.y) / S, 0.25f * S, (N.y + B.z) / S, (N.x - T.z) / S };
+    }
+    else
+    {
+        float S = Math::Sqrt(1.f + N.z - T.x - B.y) * 2.f;
+        Q = { (N.x + T.z) / S, (N.y + B.z) / S, 0.25f * S, (T.y - B.x) / S };
+    }
+
+    if (Q.w < 0.f)
+        Q = Q * -1.f;
+
+    const float Bias = 1.f / 32767.f;
+    if (Q.w < Bias)
+    {
+        float Factor = Math::Sqrt(1.f - Bias * Bias);
+        Q = { Q.x * Factor, Q.y * Factor, Q.z * Factor, Bias };
+    }
+
+    if (Handedness < 0.f)
+        Q = Q * -1.f;
+    return Q;
+}
+
+vertex_descriptor Mesh::GetDescriptor(vertex_layout Layout, v3 BoundsMin, v3 BoundsMax)
+{
+    vertex_descriptor Descriptor = {};
+    Descriptor.PositionScale = { 1.f, 1.f, 1.f };
+
+    switch (Layout)
+    {
+    case VERTEX_LAYOUT_FULL:
+        Descriptor.Stride = sizeof(vertex_full);
+        Descriptor.HasNormal = true;
+        Descriptor.HasUV = true;
+        Descriptor.HasTangent = true;
+        Descriptor.PositionOffset = OFFSETOF(vertex_full, Position);
+        Descriptor.UVOffset = OFFSETOF(vertex_full, UV);
+        Descriptor.NormalOffset = OFFSETOF(vertex_full, Normal);
+        Descriptor.TangentOffset = OFFSETOF(vertex_full, Tangent);
+        return Descriptor;
+
+    case VERTEX_LAYOUT_PACKED:
+        Descriptor.Stride = 16;
+        Descriptor.PositionOffset = 0;
+        Descriptor.PositionFormat = VERTEX_FORMAT_SNORM16;
+        Descriptor.HasNormal = true;
+        Descriptor.NormalOffset = 8;
+        Descriptor.NormalFormat = VERTEX_FORMAT_OCTAHEDRAL;
+        Descriptor.HasUV = true;
+        Descriptor.UVOffset = 12;
+        Descriptor.UVFormat = VERTEX_FORMAT_HALF;
+        break;
+
+    case VERTEX_LAYOUT_PACKED_TANGENT:
+        Descriptor.Stride = 20;
+        Descriptor.PositionOffset = 0;
+        Descriptor.PositionFormat = VERTEX_FORMAT_SNORM16;
+        Descriptor.HasUV = true;
+        Descriptor.UVOffset = 8;
+        Descriptor.UVFormat = VERTEX_FORMAT_HALF;
+        Descriptor.HasTangent = true;
+        Descriptor.TangentOffset = 12;
+        Descriptor.TangentFormat = VERTEX_FORMAT_QTANGENT;
+        break;
+    }
+
+    // Map bounds to [-1;1]
+    Descriptor.PositionBias = (BoundsMin + BoundsMax) * 0.5f;
+    Descriptor.PositionScale = (BoundsMax - BoundsMin) * 0.5f;
+    for (int i = 0; i < 3; ++i)
+    {
+        if (Descriptor.PositionScale.e[i] <= 0.f)
+            Descriptor.PositionScale.e[i] = 1.f;
+    }
+    return Descriptor;
+}
+
+int Mesh::GetAttributeComponents(vertex_attribute_format Format, int FloatComponents)
+{
+    switch (Format)
+    {
+    case VERTEX_FORMAT_HALF:
+    case VERTEX_FORMAT_SNORM16:    return FloatComponents == 3 ? 4 : FloatComponents; // Keep 4 bytes alignment
+    case VERTEX_FORMAT_OCTAHEDRAL: return 2;
+    case VERTEX_FORMAT_QTANGENT:   return 4;
+    default:                       return FloatComponents;
+    }
+}
+
+void* Mesh::ConvertVertices(void* VerticesDst, const vertex_descriptor& Descriptor, const vertex_full* VerticesSrc, int Count)
 {
     uint8_t* Buffer = (uint8_t*)VerticesDst;
 
+    bool QuantizePosition = (Descriptor.PositionFormat != VERTEX_FORMAT_FLOAT);
+    v3 InvPositionScale = {
+        1.f / Descriptor.PositionScale.x,
+        1.f / Descriptor.PositionScale.y,
+        1.f / Descriptor.PositionScale.z
+    };
+
     for (int i = 0; i < Count; ++i)
     {
-        vertex_full& VertexSrc = VerticesSrc[i];
+        const vertex_full& VertexSrc = VerticesSrc[i];
         uint8_t* VertexStart = Buffer + i * Descriptor.Stride;
 
-        v3* PositionDst = (v3*)(VertexStart + Descriptor.PositionOffset);
-        *PositionDst = VertexSrc.Position;
+        v3 Position = VertexSrc.Position;
+        if (QuantizePosition)
+        {
+            v3 Relative = Position - Descriptor.PositionBias;
+            Position = { Relative.x * InvPositionScale.x, Relative.y * InvPositionScale.y, Relative.z * InvPositionScale.z };
+        }
+        WriteAttribute(VertexStart + Descriptor.PositionOffset, Descriptor.PositionFormat, Position.e, 3);
 
         if (Descriptor.HasNormal)
         {
-            v3* NormalDst = (v3*)(VertexStart + Descriptor.NormalOffset);
-            *NormalDst = VertexSrc.Normal;
+            if (Descriptor.NormalFormat == VERTEX_FORMAT_OCTAHEDRAL)
+            {
+                v2 Encoded = EncodeOctahedral(VertexSrc.Normal);
+                WriteAttribute(VertexStart + Descriptor.NormalOffset, VERTEX_FORMAT_SNORM16, Encoded.e, 2);
+            }
+            else
+            {
+                WriteAttribute(VertexStart + Descriptor.NormalOffset, Descriptor.NormalFormat, VertexSrc.Normal.e, 3);
+            }
         }
 
         if (Descriptor.HasUV)
-        {
-            v2* UVDst = (v2*)(VertexStart + Descriptor.UVOffset);
-            *UVDst = VertexSrc.UV;
-        }
+            WriteAttribute(VertexStart + Descriptor.UVOffset, Descriptor.UVFormat, VertexSrc.UV.e, 2);
 
         if (Descriptor.HasTangent)
         {
-            v3* TangetDst = (v3*)(VertexStart + Descriptor.TangentOffset);
-            *TangetDst = VertexSrc.Tangent;
+            if (Descriptor.TangentFormat == VERTEX_FORMAT_QTANGENT)
+            {
+                v4 QTangent = EncodeQTangent(VertexSrc.Normal, VertexSrc.Tangent.xyz, VertexSrc.Tangent.w);
+                WriteAttribute(VertexStart + Descriptor.TangentOffset, VERTEX_FORMAT_SNORM16, QTangent.e, 4);
+            }
+            else
+            {
+                WriteAttribute(VertexStart + Descriptor.TangentOffset, Descriptor.TangentFormat, VertexSrc.Tangent.e, 4);
+            }
         }
     }
 
     return Buffer + Descriptor.Stride * Count;
 }
 
+static uint32_t GetIndex(const mesh_cache& Cache, int i)
+{
+    if (Cache.Header->IndexSize == sizeof(uint16_t))
+        return ((const uint16_t*)Cache.Indices)[i];
+    return ((const uint32_t*)Cache.Indices)[i];
+}
+
 static int GetVertexCount(void* Vertices, void* End, const vertex_descriptor& Descriptor)
 {
     int SizeInBytes = (int)((uint8_t*)End - (uint8_t*)Vertices);
     return SizeInBytes / Descriptor.Stride;
 }
 
-void* Mesh::Transform(void* Vertices, void* End, const vertex_descriptor& Descriptor, const mat4& Transform)
+static bool IsAffine(const mat4& M)
 {
-    uint8_t* Buffer = (uint8_t*)Vertices;
-    int Count = GetVertexCount(Vertices, End, Descriptor);
+    return M.c[0].e[3] == 0.f && M.c[1].e[3] == 0.f && M.c[2].e[3] == 0.f && M.c[3].e[3] == 1.f;
+}
 
-    mat4 NormalMatrix = Mat4::Transpose(Mat4::Inverse(Transform));
-    for (int i = 0; i < Count; ++i)
-    {
-        uint8_t* VertexStart = Buffer + i * Descriptor.Stride;
-        
-        v3* Position = (v3*)(VertexStart + Descriptor.PositionOffset);
-        v4 TransformedPosition = Transform * Vec4::vec4(*Position, 1.f);
-        *Position = TransformedPosition.xyz / TransformedPosition.w; // normalized homogeneous coordinate
+// Degenerated normals stay null instead of NaN (minimum length of the normalization)
+const float TRANSFORM_MIN_NORMAL_LENGTH = 1e-30f;
 
-        if (Descriptor.HasNormal)
-        {
-            v3* Normal           = (v3*)(VertexStart + Descriptor.NormalOffset);
-            v4 TransformedNormal = NormalMatrix * Vec4::vec4(*Normal, 0.f);
-            *Normal              = Vec3::Normalize(TransformedNormal.xyz);
-        }
+// Scalar path (remaining vertices of the SIMD batches), same results as TransformBatch
+static void TransformVertex(uint8_t* VertexStart, const vertex_descriptor& Descriptor, const mat4& Transform, const mat4& NormalMatrix, bool Affine)
+{
+    v3* Position = (v3*)(VertexStart + Descriptor.PositionOffset);
+    v4 TransformedPosition = Transform * Vec4::vec4(*Position, 1.f);
+    *Position = Affine ? TransformedPosition.xyz : TransformedPosition.xyz / TransformedPosition.w; // normalized homogeneous coordinate
+
+    if (Descriptor.HasNormal)
+    {
+        v3* Normal           = (v3*)(VertexStart + Descriptor.NormalOffset);
+        v4 TransformedNormal = NormalMatrix * Vec4::vec4(*Normal, 0.f);
+        *Normal              = TransformedNormal.xyz / Math::Max(Vec3::Length(TransformedNormal.xyz), TRANSFORM_MIN_NORMAL_LENGTH);
     }
-    return Buffer + Descriptor.Stride * Count;
 }
 
-void* Mesh::BuildQuad(void* Vertices, void* End, const vertex_descriptor& Descriptor)
+// Lanes hold the same component of SIMD_WIDTH consecutive vertices
+static void TransformBatch(uint8_t* Vertices, const vertex_descriptor& Descriptor, const simd_float Transform[16], const simd_float NormalMatrix[16], bool Affine)
 {
-    if (GetVertexCount(Vertices, End, Descriptor) < 6)
+    int Stride = Descriptor.Stride;
+
+    uint8_t* Position = Vertices + Descriptor.PositionOffset;
+    simd_float X = Simd::LoadStrided(Position + 0, Stride);
+    simd_float Y = Simd::LoadStrided(Position + 4, Stride);
+    simd_float Z = Simd::LoadStrided(Position + 8, Stride);
+
+    // Column major: row r of the result is c[0].e[r] * x + c[1].e[r] * y + c[2].e[r] * z + c[3].e[r]
+    simd_float TX = Simd::MulAdd(Transform[0], X, Simd::MulAdd(Transform[4], Y, Simd::MulAdd(Transform[8],  Z, Transform[12])));
+    simd_float TY = Simd::MulAdd(Transform[1], X, Simd::MulAdd(Transform[5], Y, Simd::MulAdd(Transform[9],  Z, Transform[13])));
+    simd_float TZ = Simd::MulAdd(Transform[2], X, Simd::MulAdd(Transform[6], Y, Simd::MulAdd(Transform[10], Z, Transform[14])));
+    if (!Affine)
     {
-        fprintf(stderr, "Not enough vertices to create quad\n");
-        return Vertices;
+        simd_float TW = Simd::MulAdd(Transform[3], X, Simd::MulAdd(Transform[7], Y, Simd::MulAdd(Transform[11], Z, Transform[15])));
+        TX = Simd::Div(TX, TW);
+        TY = Simd::Div(TY, TW);
+        TZ = Simd::Div(TZ, TW);
     }
+    Simd::StoreStrided(Position + 0, Stride, TX);
+    Simd::StoreStrided(Position + 4, Stride, TY);
+    Simd::StoreStrided(Position + 8, Stride, TZ);
 
-    v3 Normal = { 0.f, 0.f, 1.f };
+    if (Descriptor.HasNormal)
+    {
+        uint8_t* Normal = Vertices + Descriptor.NormalOffset;
+        X = Simd::LoadStrided(Normal + 0, Stride);
+        Y = Simd::LoadStrided(Normal + 4, Stride);
+        Z = Simd::LoadStrided(Normal + 8, Stride);
+
+        simd_float NX = Simd::MulAdd(NormalMatrix[0], X, Simd::MulAdd(NormalMatrix[4], Y, Simd::Mul(NormalMatrix[8],  Z)));
+        simd_float NY = Simd::MulAdd(NormalMatrix[1], X, Simd::MulAdd(NormalMatrix[5], Y, Simd::Mul(NormalMatrix[9],  Z)));
+        simd_float NZ = Simd::MulAdd(NormalMatrix[2], X, Simd::MulAdd(NormalMatrix[6], Y, Simd::Mul(NormalMatrix[10], Z)));
+
+        simd_float Length = Simd::Sqrt(Simd::MulAdd(NX, NX, Simd::MulAdd(NY, NY, Simd::Mul(NZ, NZ))));
+        Length = Simd::Max(Length, Simd::Set1(TRANSFORM_MIN_NORMAL_LENGTH));
+        Simd::StoreStrided(Normal + 0, Stride, Simd::Div(NX, Length));
+        Simd::StoreStrided(Normal + 4, Stride, Simd::Div(NY, Length));
+        Simd::StoreStrided(Normal + 8, Stride, Simd::Div(NZ, Length));
+    }
+}
 
-    vertex_full TopLeft     = { { -0.5f, 0.5f, 0.f }, Normal, { 0.f, 1.f } };
-    vertex_full TopRight    = { {  0.5f, 0.5f, 0.f }, Normal, { 1.f, 1.f } };
-    vertex_full BottomLeft  = { { -0.5f,-0.5f, 0.f }, Normal, { 0.f, 0.f } };
-    vertex_full BottomRight = { {  0.5f,-0.5f, 0.f }, Normal, { 1.f, 0.f } };
+void* Mesh::Transform(void* Vertices, void* End, const vertex_descriptor& Descriptor, const mat4& Transform)
+{
+    uint8_t* Buffer = (uint8_t*)Vertices;
+    int Count = GetVertexCount(Vertices, End, Descriptor);
 
-    vertex_full QuadVertices[] = {
-        TopLeft,
-        BottomLeft,
-        TopRight,
-        BottomLeft,
-        BottomRight,
-        TopRight
-    };
+    if (Descriptor.PositionFormat != VERTEX_FORMAT_FLOAT || (Descriptor.HasNormal && Descriptor.NormalFormat != VERTEX_FORMAT_FLOAT))
+    {
+        fprintf(stderr, "Cannot transform packed vertices\n");
+        return Buffer + Descriptor.Stride * Count;
+    }
 
-    return ConvertVertices(Vertices, Descriptor, QuadVertices, 6);
-}
+    mat4 NormalMatrix = Mat4::Transpose(Mat4::Inverse(Transform));
 
-void* Mesh::BuildCube(void* Vertices, void* End, const vertex_descriptor& Descriptor)
-{
-    if (GetVertexCount(Vertices, End, Descriptor) < (6 * 6))
+    // Broadcast matrices once, SIMD_WIDTH vertices per iteration
+    simd_float TransformLanes[16];
+    simd_float NormalMatrixLanes[16];
+    for (int i = 0; i < 16; ++i)
     {
-        fprintf(stderr, "Not enough vertices to create cube\n");
-        return Vertices;
+        TransformLanes[i] = Simd::Set1(Transform.e[i]);
+        NormalMatrixLanes[i] = Simd::Set1(NormalMatrix.e[i]);
     }
+    bool Affine = IsAffine(Transform); // No homogeneous divide (w is always 1)
 
-    void* V = Vertices;
-
-    // Back face
-    V = Mesh::Transform(V, BuildQuad(V, End, Descriptor), Descriptor,
-        Mat4::Translate({ 0.0f, 0.0f,-0.5f }) * Mat4::RotateY(-1.f, 0.f));
-    // Front face
-    V = Mesh::Transform(V, BuildQuad(V, End, Descriptor), Descriptor,
-        Mat4::Translate({ 0.0f, 0.0f, 0.5f }) * Mat4::RotateY( 1.f, 0.f));
-    // Left face
-    V = Mesh::Transform(V, BuildQuad(V, End, Descriptor), Descriptor,
-        Mat4::Translate({-0.5f, 0.0f, 0.0f }) * Mat4::RotateY( 0.f, 1.f));
-    // Right face
-    V = Mesh::Transform(V, BuildQuad(V, End, Descriptor), Descriptor,
-        Mat4::Translate({ 0.5f, 0.0f, 0.0f }) * Mat4::RotateY( 0.f,-1.f));
-    // Top face
-    V = Mesh::Transform(V, BuildQuad(V, End, Descriptor), Descriptor,
-        Mat4::Translate({ 0.0f, 0.5f, 0.0f }) * Mat4::RotateX( 0.f,-1.f));
-    // Bottom face
-    V = Mesh::Transform(V, BuildQuad(V, End, Descriptor), Descriptor,
-        Mat4::Translate({ 0.0f,-0.5f, 0.0f }) * Mat4::RotateX( 0.f, 1.f));
-
-    return V;
-}
+    int i = 0;
+    for (; i + SIMD_WIDTH <= Count; i += SIMD_WIDTH)
+        TransformBatch(Buffer + i * Descriptor.Stride, Descriptor, TransformLanes, NormalMatrixLanes, Affine);
 
-void* Mesh::BuildInvertedCube(void* Vertices, void* End, const vertex_descriptor& Descriptor)
-{
-    void* V = Vertices;
-
-    // FRONT FACE
-    V = Mesh::Transform(
-        V, Mesh::BuildQuad(V, End, Descriptor),
-        Descriptor, Mat4::Translate({ 0.f, 0.f, -0.5f }));
-    // BACK FACE
-    V = Mesh::Transform(
-        V, Mesh::BuildQuad(V, End, Descriptor),
-        Descriptor, Mat4::RotateY(Math::Pi()) * Mat4::Translate({ 0.f, 0.f, -0.5f }));
-    // RIGHT FACE
-    V = Mesh::Transform(
-        V, Mesh::BuildQuad(V, End, Descriptor),
-        Descriptor, Mat4::RotateY(Math::HalfPi()) * Mat4::Translate({ 0.f, 0.f, -0.5f }));
-    // LEFT FACE
-    V = Mesh::Transform(
-        V, Mesh::BuildQuad(V, End, Descriptor),
-        Descriptor, Mat4::RotateY(-Math::HalfPi()) * Mat4::Translate({ 0.f, 0.f, -0.5f }));
-    // TOP FACE
-    V = Mesh::Transform(
-        V, Mesh::BuildQuad(V, End, Descriptor),
-        Descriptor, Mat4::RotateY(-Math::HalfPi()) * Mat4::RotateX(Math::HalfPi()) * Mat4::Translate({ 0.f, 0.f, -0.5f }));
-    // BOTTOM FACE
-    V = Mesh::Transform(
-        V, Mesh::BuildQuad(V, End, Descriptor),
-        Descriptor, Mat4::RotateY(-Math::HalfPi()) * Mat4::RotateX(-Math::HalfPi()) * Mat4::Translate({ 0.f, 0.f, -0.5f }));
-
-    return V;
+    for (; i < Count; ++i)
+        TransformVertex(Buffer + i * Descriptor.Stride, Descriptor, Transform, NormalMatrix, Affine);
+
+    return Buffer + Descriptor.Stride * Count;
 }
 
-void* Mesh::BuildSphere(void* Vertices, void* End, const vertex_descriptor& Descriptor, int Lon, int Lat)
+// Expand an indexed primitive for unindexed vertex buffers
+static void* BuildPrimitive(void* Vertices, void* End, const vertex_descriptor& Descriptor, primitive_type Type, int Lon = 0, int Lat = 0)
 {
-    if (GetVertexCount(Vertices, End, Descriptor) < (Lon * Lat * 6))
+    int IndexCount = Primitives::GetIndexCount(Type, Lon, Lat);
+    if (GetVertexCount(Vertices, End, Descriptor) < IndexCount)
     {
-        fprintf(stderr, "Not enough vertices to create sphere\n");
+        fprintf(stderr, "Not enough vertices to create primitive\n");
         return Vertices;
     }
 
-    uint8_t* Cur = (uint8_t*)Vertices;
-    for (int i = 0; i < Lat; ++i)
-    {
-        // Theta varies from 0 to 180
-        float Theta        = Math::Pi() * (float)(i+0) / Lat;
-        float ThetaCos     = Math::Cos(Theta);
-        float ThetaSin     = Math::Sin(Theta);
-        
-        float ThetaNext    = Math::Pi() * (float)(i+1) / Lat;
-        float ThetaNextCos = Math::Cos(ThetaNext);
-        float ThetaNextSin = Math::Sin(ThetaNext);
-
-        for (int j = 0; j < Lon; ++j)
-        {
-            // Phi varies from 0 to 360
-            float Phi        = Math::TwoPi() * (float)(j+0) / Lon;
-            float PhiCos     = Math::Cos(Phi);
-            float PhiSin     = Math::Sin(Phi);
-            
-            float PhiNext    = Math::TwoPi() * (float)(j+1) / Lon;
-            float PhiNextCos = Math::Cos(PhiNext);
-            float PhiNextSin = Math::Sin(PhiNext);
-
-            // Compute positions
-            v3 P0 = {     ThetaSin * PhiCos,         ThetaCos,     ThetaSin * PhiSin     };
-            v3 P1 = {     ThetaSin * PhiNextCos,     ThetaCos,     ThetaSin * PhiNextSin };
-            v3 P2 = { ThetaNextSin * PhiCos,     ThetaNextCos, ThetaNextSin * PhiSin     };
-            v3 P3 = { ThetaNextSin * PhiNextCos, ThetaNextCos, ThetaNextSin * PhiNextSin };
-
-            vertex_full Quad[6];
-
-            Quad[0].Position = Quad[0].Normal = P0;
-            Quad[1].Position = Quad[1].Normal = P1;
-            Quad[2].Position = Quad[2].Normal = P2;
-            Quad[3].Position = Quad[3].Normal = P2;
-            Quad[4].Position = Quad[4].Normal = P1;
-            Quad[5].Position = Quad[5].Normal = P3;
-
-            // Set uv
-            float U0 = 1.f - (j + 0.f) / (float)Lon;
-            float U1 = 1.f - (j + 1.f) / (float)Lon;
-            float V0 = 1.f - (i + 0.f) / (float)Lat;
-            float V1 = 1.f - (i + 1.f) / (float)Lat;
-
-            Quad[0].UV = { U0, V0 };
-            Quad[1].UV = { U1, V0 };
-            Quad[2].UV = { U0, V1 };
-            Quad[3].UV = Quad[2].UV;
-            Quad[4].UV = Quad[1].UV;
-            Quad[5].UV = { U1, V1 };
-
-            Cur = (uint8_t*)ConvertVertices(Cur, Descriptor, Quad, 6);
-        }
-    }
+    std::vector<vertex_full> PrimitiveVertices(Primitives::GetVertexCount(Type, Lon, Lat));
+    std::vector<uint32_t> PrimitiveIndices(IndexCount);
+    IndexCount = Primitives::Build(Type, PrimitiveVertices.data(), PrimitiveIndices.data(), Lon, Lat);
 
-    // Transform pos from [-1;+1] to [-0.5;+0.5] to make a unit sphere
-    return Mesh::Transform(Vertices, Cur, Descriptor, Mat4::Scale({ 0.5f, 0.5f, 0.5f }));
+    void* Cur = Vertices;
+    for (int i = 0; i < IndexCount; ++i)
+        Cur = ConvertVertices(Cur, Descriptor, &PrimitiveVertices[PrimitiveIndices[i]], 1);
+    return Cur;
 }
 
-// Implement dumb caching to avoid parsing .obj again and again
-bool LoadObjFromCache(std::vector<vertex_full>& Mesh, const char* Filename)
+void* Mesh::BuildQuad(void* Vertices, void* End, const vertex_descriptor& Descriptor)
 {
-    std::string CachedFile = Filename;
-    CachedFile += ".cache";
-
-    FILE* File = fopen(CachedFile.c_str(), "rb");
-    if (File == nullptr)
-        return false;
-
-    size_t VertexCount = 0;
-    fread(&VertexCount, sizeof(size_t), 1, File);
-    Mesh.resize(VertexCount);
-    fread(&Mesh[0], sizeof(vertex_full), VertexCount, File);
-    fclose(File);
-
-    printf("Loaded from cache: %s (%d vertices)\n", Filename, (int)VertexCount);
-
-    return true;
+    return BuildPrimitive(Vertices, End, Descriptor, PRIMITIVE_QUAD);
 }
 
-void SaveObjToCache(const std::vector<vertex_full>& Mesh, const char* Filename)
+void* Mesh::BuildCube(void* Vertices, void* End, const vertex_descriptor& Descriptor)
 {
-    std::string CachedFile = Filename;
-    CachedFile += ".cache";
+    return BuildPrimitive(Vertices, End, Descriptor, PRIMITIVE_CUBE);
+}
 
-    FILE* File = fopen(CachedFile.c_str(), "wb");
-    size_t VertexCount = Mesh.size();
-    fwrite(&VertexCount, sizeof(size_t), 1, File);
-    fwrite(&Mesh[0], sizeof(vertex_full), VertexCount, File);
-    fclose(File);
+void* Mesh::BuildInvertedCube(void* Vertices, void* End, const vertex_descriptor& Descriptor)
+{
+    return BuildPrimitive(Vertices, End, Descriptor, PRIMITIVE_INVERTED_CUBE);
+}
 
-    printf("Saved to cache: %s (%d vertices)\n", Filename, (int)VertexCount);
+void* Mesh::BuildSphere(void* Vertices, void* End, const vertex_descriptor& Descriptor, int Lon, int Lat)
+{
+    return BuildPrimitive(Vertices, End, Descriptor, PRIMITIVE_SPHERE, Lon, Lat);
 }
 
-bool Mesh::LoadObjNoConvertion(std::vector<vertex_full>& Mesh, const char* Filename, float Scale)
+// Reference (single threaded) parser, also used for files not handled by ObjParser
+static bool ParseObjTinyObj(std::vector<vertex_full>& Mesh, bool* HasNormals, bool* HasTexCoords, const char* Filename, std::vector<uint32_t>* ShapeOffsets)
 {
-    if (!LoadObjFromCache(Mesh, Filename))
+    std::string Warn;
+    std::string Err;
+    tinyobj::attrib_t Attrib;
+    std::vector<tinyobj::shape_t> Shapes;
+    std::vector<tinyobj::material_t> Mats;
+
+    tinyobj::LoadObj(&Attrib, &Shapes, &Mats, &Warn, &Err, Filename, "media/", true);
+    if (!Err.empty())
     {
-        std::string Warn;
-        std::string Err;
-        tinyobj::attrib_t Attrib;
-        std::vector<tinyobj::shape_t> Shapes;
-        std::vector<tinyobj::material_t> Mats;
-
-        tinyobj::LoadObj(&Attrib, &Shapes, &Mats, &Warn, &Err, Filename, "media/", true);
-        if (!Err.empty())
-        {
-            fprintf(stderr, "Warning loading obj: %s\n", Err.c_str());
-        }
-        if (!Err.empty())
-        {
-            fprintf(stderr, "Error loading obj: %s\n", Err.c_str());
-            return false;
-        }
+        fprintf(stderr, "Warning loading obj: %s\n", Err.c_str());
+    }
+    if (!Err.empty())
+    {
+        fprintf(stderr, "Error loading obj: %s\n", Err.c_str());
+        return false;
+    }
+
+    *HasNormals = !Attrib.normals.empty();
+    *HasTexCoords = !Attrib.texcoords.empty();
 
-        bool HasNormals = !Attrib.normals.empty();
-        bool HasTexCoords = !Attrib.texcoords.empty();
+    if (ShapeOffsets)
+        ShapeOffsets->clear();
+
+    // Build all meshes
+    for (int MeshId = 0; MeshId < (int)Shapes.size(); ++MeshId)
+    {
+        const tinyobj::mesh_t& MeshDef = Shapes[MeshId].mesh;
+        if (ShapeOffsets && !MeshDef.indices.empty())
+            ShapeOffsets->push_back((uint32_t)Mesh.size());
 
-        // Build all meshes
-        for (int MeshId = 0; MeshId < (int)Shapes.size(); ++MeshId)
+        int IndexId = 0;
+        for (int FaceId = 0; FaceId < (int)MeshDef.num_face_vertices.size(); ++FaceId)
         {
-            const tinyobj::mesh_t& MeshDef = Shapes[MeshId].mesh;
+            int FaceVertices = MeshDef.num_face_vertices[FaceId];
+            assert(FaceVertices == 3);
 
-            int IndexId = 0;
-            for (int FaceId = 0; FaceId < (int)MeshDef.num_face_vertices.size(); ++FaceId)
+            for (int j = 0; j < FaceVertices; ++j)
             {
-                int FaceVertices = MeshDef.num_face_vertices[FaceId];
-                assert(FaceVertices == 3);
-
-                for (int j = 0; j < FaceVertices; ++j)
+                const tinyobj::index_t& Index = MeshDef.indices[IndexId];
+                vertex_full V = {};
+                V.Position = {
+                    Attrib.vertices[Index.vertex_index * 3 + 0],
+                    Attrib.vertices[Index.vertex_index * 3 + 1],
+                    Attrib.vertices[Index.vertex_index * 3 + 2]
+                };
+
+                if (*HasNormals)
                 {
-                    const tinyobj::index_t& Index = MeshDef.indices[IndexId];
-                    vertex_full V = {};
-                    V.Position = {
-                        Attrib.vertices[Index.vertex_index * 3 + 0],
-                        Attrib.vertices[Index.vertex_index * 3 + 1],
-                        Attrib.vertices[Index.vertex_index * 3 + 2]
+                    V.Normal = {
+                        Attrib.normals[Index.normal_index * 3 + 0],
+                        Attrib.normals[Index.normal_index * 3 + 1],
+                        Attrib.normals[Index.normal_index * 3 + 2]
                     };
+                }
 
-                    if (HasNormals)
-                    {
-                        V.Normal = {
-                            Attrib.normals[Index.normal_index * 3 + 0],
-                            Attrib.normals[Index.normal_index * 3 + 1],
-                            Attrib.normals[Index.normal_index * 3 + 2]
-                        };
-                    }
-
-                    if (HasTexCoords)
-                    {
-                        V.UV = {
-                            Attrib.texcoords[Index.texcoord_index * 2 + 0],
-                            Attrib.texcoords[Index.texcoord_index * 2 + 1]
-                        };
-                    }
-
-                    Mesh.push_back(V);
-
-                    IndexId++;
+                if (*HasTexCoords)
+                {
+                    V.UV = {
+                        Attrib.texcoords[Index.texcoord_index * 2 + 0],
+                        Attrib.texcoords[Index.texcoord_index * 2 + 1]
+                    };
                 }
-            }
-        }
 
-        // Build normals if missing
-        if (!HasNormals)
-        {
-            for (int i = 0; i < (int)Mesh.size(); i += 3)
-            {
-                vertex_full& V0 = Mesh[i + 0];
-                vertex_full& V1 = Mesh[i + 1];
-                vertex_full& V2 = Mesh[i + 2];
+                Mesh.push_back(V);
 
-                v3 Normal = Vec3::Cross((V1.Position - V0.Position), (V2.Position - V0.Position));
-                V0.Normal = V1.Normal = V2.Normal = Normal;
+                IndexId++;
             }
         }
+    }
 
-        // Build UVs if missing
-        if (!HasTexCoords)
-        {
-            // TODO: Maybe triplanar texturing can make best results
-            for (int i = 0; i < (int)Mesh.size(); ++i)
-            {
-                vertex_full& V = Mesh[i];
+    return true;
+}
 
-                float Length = Vec3::Length(V.Position);
-                if (Length != 0.f)
-                {
-                    v3 Pos = V.Position / Length;
-                    V.UV.x = 0.5f + Math::Atan2(Pos.z, Pos.x);
-                    V.UV.y = Pos.y;
-                }
-            }
-        }
+bool Mesh::ParseObj(std::vector<vertex_full>& Mesh, const char* Filename, std::vector<uint32_t>* ShapeOffsets)
+{
+    bool HasNormals = false;
+    bool HasTexCoords = false;
+    if (!ObjParser::Parse(Mesh, &HasNormals, &HasTexCoords, Filename, ShapeOffsets))
+    {
+        Mesh.clear();
+        if (!ParseObjTinyObj(Mesh, &HasNormals, &HasTexCoords, Filename, ShapeOffsets))
+            return false;
+    }
 
-        // Compute tangents coordinate
+    // Build normals if missing
+    if (!HasNormals)
+    {
+        for (int i = 0; i < (int)Mesh.size(); i += 3)
         {
-            for (int i = 0; i < (int)Mesh.size(); i += 3)
-            {
-
-                vertex_full& V0 = Mesh[i + 0];
-                vertex_full& V1 = Mesh[i + 1];
-                vertex_full& V2 = Mesh[i + 2];
-
-                v3 deltaPos1 = V1.Position - V0.Position;
-                v3 deltaPos2 = V2.Position - V0.Position;
+            vertex_full& V0 = Mesh[i + 0];
+            vertex_full& V1 = Mesh[i + 1];
+            vertex_full& V2 = Mesh[i + 2];
 
+            v3 Normal = Vec3::Cross((V1.Position - V0.Position), (V2.Position - V0.Position));
+            V0.Normal = V1.Normal = V2.Normal = Normal;
+        }
+    }
 
-                v2 deltaUV1 = V1.UV - V0.UV;
-                v2 deltaUV2 = V2.UV - V0.UV;
-
-                float f = 1.f / (deltaUV1.x * deltaUV2.y - deltaUV1.y * deltaUV2.x);
-
-                v3 tangent = f * (deltaUV2.y * deltaPos1 - deltaUV1.y * deltaPos2);
+    // Build UVs if missing
+    if (!HasTexCoords)
+    {
+        // TODO: Maybe triplanar texturing can make best results
+        for (int i = 0; i < (int)Mesh.size(); ++i)
+        {
+            vertex_full& V = Mesh[i];
 
-                // Assert if tangent already set, in this case average tangent
-                V0.Tangent = V0.Tangent == v3{ 0.f, 0.f , 0.f } ? tangent : (V0.Tangent + tangent) / 2.f;
-                V1.Tangent = V1.Tangent == v3{ 0.f, 0.f , 0.f } ? tangent : (V1.Tangent + tangent) / 2.f;
-                V2.Tangent = V2.Tangent == v3{ 0.f, 0.f , 0.f } ? tangent : (V2.Tangent + tangent) / 2.f;
+            float Length = Vec3::Length(V.Position);
+            if (Length != 0.f)
+            {
+                v3 Pos = V.Position / Length;
+                V.UV.x = 0.5f + Math::Atan2(Pos.z, Pos.x);
+                V.UV.y = Pos.y;
             }
         }
-
-        SaveObjToCache(Mesh, Filename);
     }
 
-    // Rescale positions
-    for (int i = 0; i < (int)Mesh.size(); ++i)
-    {
-        v3& Position = Mesh[i].Position;
-        Position *= Scale;
-    }
+    return true;
+}
+
+bool Mesh::LoadObjNoConvertion(std::vector<vertex_full>& Mesh, const char* Filename, float Scale)
+{
+    mesh_cache Cache;
+    if (!MeshCache::Load(&Cache, Filename, Scale))
+        return false;
+
+    // Expand indexed mesh (LOD 0 only)
+    int IndexCount = (int)Cache.Header->Lods[0].IndexCount;
+    Mesh.resize(IndexCount);
+    for (int i = 0; i < IndexCount; ++i)
+        Mesh[i] = Cache.Vertices[GetIndex(Cache, i)];
+
+    MeshCache::Release(&Cache);
 
     return true;
 }
@@ -430,3 +544,75 @@ void* Mesh::LoadObj(void* Vertices, void* End, const vertex_descriptor& Descript
     // Convert to output vertex format
     return ConvertVertices(Vertices, Descriptor, &Mesh[0], MeshSize);
 }
+
+// Hash the raw bits of a vertex (bitwise identical vertices are welded, even NaN tangents)
+static uint32_t HashVertex(const vertex_full& Vertex)
+{
+    static_assert(sizeof(vertex_full) == 12 * sizeof(uint32_t), "vertex_full must not have padding");
+
+    uint32_t Words[12];
+    memcpy(Words, &Vertex, sizeof(Words));
+
+    uint32_t Hash = 2166136261u;
+    for (int i = 0; i < 12; ++i)
+        Hash = (Hash ^ Words[i]) * 16777619u;
+
+    // Final avalanche (low bits are used to index the table)
+    Hash ^= Hash >> 16;
+    Hash *= 0x85ebca6bu;
+    Hash ^= Hash >> 13;
+    return Hash;
+}
+
+void Mesh::WeldVertices(std::vector<vertex_full>& Vertices, std::vector<uint32_t>& Indices, const vertex_full* Soup, int Count)
+{
+    Vertices.clear();
+    Indices.resize(Count);
+
+    // Open addressing hash table storing vertex indices (power of two size, load factor <= 0.5)
+    int TableSize = 1;
+    while (TableSize < Count * 2)
+        TableSize <<= 1;
+    const uint32_t EmptySlot = UINT32_MAX;
+    std::vector<uint32_t> Table(TableSize, EmptySlot);
+
+    for (int i = 0; i < Count; ++i)
+    {
+        const vertex_full& Vertex = Soup[i];
+        uint32_t Slot = HashVertex(Vertex) & (TableSize - 1);
+
+        // Linear probing
+        while (Table[Slot] != EmptySlot && memcmp(&Vertices[Table[Slot]], &Vertex, sizeof(vertex_full)) != 0)
+            Slot = (Slot + 1) & (TableSize - 1);
+
+        if (Table[Slot] == EmptySlot)
+        {
+            Table[Slot] = (uint32_t)Vertices.size();
+            Vertices.push_back(Vertex);
+        }
+        Indices[i] = Table[Slot];
+    }
+}
+
+int Mesh::GetIndexSize(int VertexCount)
+{
+    return (VertexCount <= UINT16_MAX + 1) ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+bool Mesh::LoadObjIndexed(std::vector<vertex_full>& Vertices, std::vector<uint32_t>& Indices, const char* Filename, float Scale)
+{
+    mesh_cache Cache;
+    if (!MeshCache::Load(&Cache, Filename, Scale))
+        return false;
+
+    int VertexCount = (int)Cache.Header->VertexCount;
+    int IndexCount = (int)Cache.Header->Lods[0].IndexCount; // LOD 0 only
+    Vertices.assign(Cache.Vertices, Cache.Vertices + VertexCount);
+    Indices.resize(IndexCount);
+    for (int i = 0; i < IndexCount; ++i)
+        Indices[i] = GetIndex(Cache, i);
+
+    MeshCache::Release(&Cache);
+
+    return true;
+}
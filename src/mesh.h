@@ -1,9 +1,20 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 
 #include "types.h"
 
+// Storage format of a vertex attribute
+enum vertex_attribute_format
+{
+	VERTEX_FORMAT_FLOAT,      // float32 components
+	VERTEX_FORMAT_HALF,       // float16 components (positions are padded to 4 components)
+	VERTEX_FORMAT_SNORM16,    // normalized int16 components (positions are padded to 4 components)
+	VERTEX_FORMAT_OCTAHEDRAL, // Normals only: octahedral encoding on 2 x snorm16
+	VERTEX_FORMAT_QTANGENT,   // Tangents only: quaternion of the tangent frame on 4 x snorm16 (the sign of w gives the bitangent direction)
+};
+
 // Descriptor for interleaved vertex formats
 struct vertex_descriptor
 {
@@ -15,6 +26,24 @@ struct vertex_descriptor
 	int UVOffset;
 	bool HasTangent;
 	int TangentOffset;
+
+	// Attribute formats (float by default)
+	vertex_attribute_format PositionFormat;
+	vertex_attribute_format NormalFormat;
+	vertex_attribute_format UVFormat;
+	vertex_attribute_format TangentFormat;
+
+	// Dequantization of half/snorm16 positions: Position = PositionBias + PositionScale * StoredPosition
+	v3 PositionScale;
+	v3 PositionBias;
+};
+
+// Predefined vertex layouts (see Mesh::GetDescriptor)
+enum vertex_layout
+{
+	VERTEX_LAYOUT_FULL,           // vertex_full (48 bytes)
+	VERTEX_LAYOUT_PACKED,         // snorm16 position, octahedral normal, half UV (16 bytes)
+	VERTEX_LAYOUT_PACKED_TANGENT, // snorm16 position, half UV, QTangent (20 bytes, the normal is part of the QTangent)
 };
 
 struct vertex_full
@@ -22,17 +51,29 @@ struct vertex_full
 	v3 Position;
 	v3 Normal;
 	v2 UV;
-	v3 Tangent;
+	v4 Tangent; // w: bitangent sign (see Tangents::Generate)
 };
 
 namespace Mesh
 {
 
-void* Transform(void* Vertices, void* End, const vertex_descriptor& Descriptor, const mat4& Transform);
+// Descriptors (BoundsMin/BoundsMax are used to quantize positions)
+vertex_descriptor GetDescriptor(vertex_layout Layout, v3 BoundsMin = {}, v3 BoundsMax = {});
+int GetAttributeComponents(vertex_attribute_format Format, int FloatComponents); // Number of stored components
+void* ConvertVertices(void* VerticesDst, const vertex_descriptor& Descriptor, const vertex_full* VerticesSrc, int Count);
+
+void* Transform(void* Vertices, void* End, const vertex_descriptor& Descriptor, const mat4& Transform); // Float positions/normals only
+// Unindexed primitives: one vertex per index of the Primitives meshes (Primitives::GetIndexCount vertices)
 void* BuildQuad(void* Vertices, void* End, const vertex_descriptor& Descriptor);
 void* BuildCube(void* Vertices, void* End, const vertex_descriptor& Descriptor);
 void* BuildInvertedCube(void* Vertices, void* End, const vertex_descriptor& Descriptor);
 void* BuildSphere(void* Vertices, void* End, const vertex_descriptor& Descriptor, int Lon, int Lat);
 void* LoadObj(void* Vertices, void* End, const vertex_descriptor& Descriptor, const char* Filename, float Scale);
 bool LoadObjNoConvertion(std::vector<vertex_full>& Mesh, const char* Filename, float Scale);
+bool ParseObj(std::vector<vertex_full>& Mesh, const char* Filename, std::vector<uint32_t>* ShapeOffsets = nullptr); // No cache, no scaling, no tangents (see Tangents::Generate). ShapeOffsets: first vertex of each OBJ shape
+
+// Indexed meshes (identical vertices are welded together)
+bool LoadObjIndexed(std::vector<vertex_full>& Vertices, std::vector<uint32_t>& Indices, const char* Filename, float Scale);
+void WeldVertices(std::vector<vertex_full>& Vertices, std::vector<uint32_t>& Indices, const vertex_full* Soup, int Count);
+int GetIndexSize(int VertexCount); // 2 bytes if indices fit in 16 bits, 4 otherwise
 }
\ No newline at end of file
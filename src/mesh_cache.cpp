@@ -0,0 +1,430 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "platform.h"
+#include "asset_archive.h"
+#include "maths.h"
+#include "jobs.h"
+
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "tangents.h"
+
+static_assert(sizeof(mesh_cache_header) % 16 == 0, "Cache payloads must stay aligned");
+
+static uint64_t AlignOffset(uint64_t Offset)
+{
+    return (Offset + 15) & ~(uint64_t)15;
+}
+
+std::string MeshCache::GetCacheFilename(const char* Filename, float Scale)
+{
+    // Scale is part of the name (bits in hex): vertices are baked scaled, the same mesh can be loaded at several scales
+    uint32_t ScaleBits;
+    memcpy(&ScaleBits, &Scale, sizeof(ScaleBits));
+    char Suffix[32];
+    snprintf(Suffix, sizeof(Suffix), ".%08x.cache", ScaleBits);
+    return std::string(Filename) + Suffix;
+}
+
+static void FillVertexLayout(mesh_cache_header* Header)
+{
+    Header->VertexStride   = sizeof(vertex_full);
+    Header->PositionOffset = OFFSETOF(vertex_full, Position);
+    Header->NormalOffset   = OFFSETOF(vertex_full, Normal);
+    Header->UVOffset       = OFFSETOF(vertex_full, UV);
+    Header->TangentOffset  = OFFSETOF(vertex_full, Tangent);
+}
+
+// Vertex and index payloads as stored in the file
+struct mesh_streams
+{
+    std::vector<uint8_t> Vertices;
+    std::vector<uint8_t> Indices;
+};
+
+static mesh_codec_bounds GetCodecBounds(const mesh_cache_header& Header)
+{
+    mesh_codec_bounds Bounds;
+    Bounds.PositionMin = { Header.BoundsMin[0], Header.BoundsMin[1], Header.BoundsMin[2] };
+    Bounds.PositionMax = { Header.BoundsMax[0], Header.BoundsMax[1], Header.BoundsMax[2] };
+    Bounds.UVMin = { Header.UVMin[0], Header.UVMin[1] };
+    Bounds.UVMax = { Header.UVMax[0], Header.UVMax[1] };
+    return Bounds;
+}
+
+// Write indices with the header index size
+static void PackIndices(void* Dst, const std::vector<uint32_t>& Indices, int IndexSize)
+{
+    if (IndexSize == sizeof(uint16_t))
+    {
+        uint16_t* Indices16 = (uint16_t*)Dst;
+        for (int i = 0; i < (int)Indices.size(); ++i)
+            Indices16[i] = (uint16_t)Indices[i];
+    }
+    else
+    {
+        memcpy(Dst, Indices.data(), Indices.size() * sizeof(uint32_t));
+    }
+}
+
+// Encode the payloads with the header codec and bounds
+static void EncodeStreams(mesh_streams* Streams, const mesh_cache_header& Header, const std::vector<vertex_full>& Vertices, const std::vector<uint32_t>& Indices)
+{
+    if (Header.Codec == MESH_CODEC_COMPACT)
+    {
+        MeshCodec::EncodeVertices(&Streams->Vertices, Vertices.data(), (int)Vertices.size(), GetCodecBounds(Header));
+        MeshCodec::EncodeIndices(&Streams->Indices, Indices.data(), (int)Indices.size());
+        return;
+    }
+
+    Streams->Vertices.resize(Vertices.size() * sizeof(vertex_full));
+    memcpy(Streams->Vertices.data(), Vertices.data(), Streams->Vertices.size());
+    Streams->Indices.resize(Indices.size() * Header.IndexSize);
+    PackIndices(Streams->Indices.data(), Indices, (int)Header.IndexSize);
+}
+
+// Fill header, encode the payloads and compute their offsets
+static void FillHeader(mesh_cache_header* Header, mesh_streams* Streams, const char* Filename, float Scale, const std::vector<vertex_full>& Vertices, const std::vector<uint32_t>& Indices, const std::vector<meshlet>& Meshlets, const std::vector<bounds>& Shapes, const mesh_lod* Lods, int LodCount, mesh_codec Codec)
+{
+    *Header = {};
+    Header->Magic      = MESH_CACHE_MAGIC;
+    Header->Version    = MESH_CACHE_VERSION;
+    Header->EndianTest = MESH_CACHE_ENDIAN_TEST;
+    Header->HeaderSize = sizeof(mesh_cache_header);
+
+    file_stats Stats;
+    if (File::GetStats(&Stats, Filename))
+    {
+        Header->SourceSize = Stats.Size;
+        Header->SourceTime = Stats.ModificationTime;
+        File::HashFile(&Header->SourceHash, Filename);
+    }
+    Header->Scale = Scale;
+
+    FillVertexLayout(Header);
+
+    bounds MeshBounds = Bounds::Compute(Vertices.data(), (int)Vertices.size());
+    memcpy(Header->BoundsMin, MeshBounds.Min.e, sizeof(Header->BoundsMin));
+    memcpy(Header->BoundsMax, MeshBounds.Max.e, sizeof(Header->BoundsMax));
+    memcpy(Header->BoundsCenter, MeshBounds.Center.e, sizeof(Header->BoundsCenter));
+    Header->BoundsRadius = MeshBounds.Radius;
+
+    mesh_codec_bounds CodecBounds = MeshCodec::ComputeBounds(Vertices.data(), (int)Vertices.size());
+    memcpy(Header->UVMin, CodecBounds.UVMin.e, sizeof(Header->UVMin));
+    memcpy(Header->UVMax, CodecBounds.UVMax.e, sizeof(Header->UVMax));
+
+    Header->VertexCount = (uint32_t)Vertices.size();
+    Header->IndexCount  = (uint32_t)Indices.size();
+    Header->IndexSize   = (uint32_t)Mesh::GetIndexSize((int)Vertices.size());
+    Header->MeshletCount = (uint32_t)Meshlets.size();
+    Header->ShapeCount   = (uint32_t)Shapes.size();
+    Header->LodCount     = (uint32_t)LodCount;
+    memcpy(Header->Lods, Lods, LodCount * sizeof(mesh_lod));
+
+    Header->Codec = (uint32_t)Codec;
+    EncodeStreams(Streams, *Header, Vertices, Indices);
+    Header->VertexDataSize = Streams->Vertices.size();
+    Header->IndexDataSize  = Streams->Indices.size();
+
+    Header->VertexDataOffset  = AlignOffset(sizeof(mesh_cache_header));
+    Header->IndexDataOffset   = AlignOffset(Header->VertexDataOffset + Header->VertexDataSize);
+    Header->MeshletDataOffset = AlignOffset(Header->IndexDataOffset + Header->IndexDataSize);
+    Header->ShapeDataOffset   = AlignOffset(Header->MeshletDataOffset + (uint64_t)Header->MeshletCount * sizeof(meshlet));
+    Header->FileSize          = Header->ShapeDataOffset + (uint64_t)Header->ShapeCount * sizeof(bounds);
+}
+
+// Serialize header and payloads (Data must be Header.FileSize bytes, zero initialized)
+static void FillData(uint8_t* Data, const mesh_cache_header& Header, const mesh_streams& Streams, const std::vector<meshlet>& Meshlets, const std::vector<bounds>& Shapes)
+{
+    memcpy(Data, &Header, sizeof(Header));
+    memcpy(Data + Header.VertexDataOffset, Streams.Vertices.data(), Streams.Vertices.size());
+    memcpy(Data + Header.IndexDataOffset, Streams.Indices.data(), Streams.Indices.size());
+    memcpy(Data + Header.MeshletDataOffset, Meshlets.data(), Meshlets.size() * sizeof(meshlet));
+    memcpy(Data + Header.ShapeDataOffset, Shapes.data(), Shapes.size() * sizeof(bounds));
+}
+
+// Raw payloads point into Data, encoded ones are decoded unless KeepEncoded (false if they are corrupted)
+static bool SetPayloadPointers(mesh_cache* Cache, const uint8_t* Data, bool KeepEncoded)
+{
+    Cache->Header   = (const mesh_cache_header*)Data;
+    Cache->Meshlets = (const meshlet*)(Data + Cache->Header->MeshletDataOffset);
+    Cache->Shapes   = (const bounds*)(Data + Cache->Header->ShapeDataOffset);
+    if (Cache->Header->Codec == MESH_CODEC_NONE)
+    {
+        Cache->Vertices = (const vertex_full*)(Data + Cache->Header->VertexDataOffset);
+        Cache->Indices  = Data + Cache->Header->IndexDataOffset;
+        return true;
+    }
+
+    Cache->Vertices = nullptr;
+    Cache->Indices  = nullptr;
+    if (KeepEncoded)
+        return true;
+
+    Cache->DecodedVertices.resize(Cache->Header->VertexCount);
+    Cache->DecodedIndices.resize((size_t)Cache->Header->IndexCount * Cache->Header->IndexSize);
+    if (!MeshCache::DecodeVertices(*Cache, Cache->DecodedVertices.data()) || !MeshCache::DecodeIndices(*Cache, Cache->DecodedIndices.data()))
+        return false;
+
+    Cache->Vertices = Cache->DecodedVertices.data();
+    Cache->Indices  = Cache->DecodedIndices.data();
+    return true;
+}
+
+static bool AreLodsValid(const mesh_cache_header& Header)
+{
+    // LOD 0 is the full mesh at the start of the index buffer (meshlets index into it)
+    if (Header.LodCount < 1 || Header.LodCount > MESH_MAX_LODS || Header.Lods[0].IndexOffset != 0)
+        return false;
+
+    for (uint32_t i = 0; i < Header.LodCount; ++i)
+    {
+        if ((uint64_t)Header.Lods[i].IndexOffset + Header.Lods[i].IndexCount > Header.IndexCount)
+            return false;
+    }
+    return true;
+}
+
+static bool IsHeaderCompatible(const mesh_cache_header& Header, size_t FileSize, float Scale)
+{
+    mesh_cache_header Layout = {};
+    FillVertexLayout(&Layout);
+
+    return Header.Magic          == MESH_CACHE_MAGIC
+        && Header.Version        == MESH_CACHE_VERSION
+        && Header.EndianTest     == MESH_CACHE_ENDIAN_TEST
+        && Header.HeaderSize     == sizeof(mesh_cache_header)
+        && Header.VertexStride   == Layout.VertexStride
+        && Header.PositionOffset == Layout.PositionOffset
+        && Header.NormalOffset   == Layout.NormalOffset
+        && Header.UVOffset       == Layout.UVOffset
+        && Header.TangentOffset  == Layout.TangentOffset
+        && (Header.IndexSize == sizeof(uint16_t) || Header.IndexSize == sizeof(uint32_t))
+        && Header.Scale          == Scale
+        && Header.FileSize       == FileSize
+        && Header.Codec < MESH_CODEC_COUNT
+        && (Header.Codec != MESH_CODEC_NONE || Header.VertexDataSize == (uint64_t)Header.VertexCount * Header.VertexStride)
+        && (Header.Codec != MESH_CODEC_NONE || Header.IndexDataSize  == (uint64_t)Header.IndexCount  * Header.IndexSize)
+        && Header.VertexDataOffset + Header.VertexDataSize <= Header.IndexDataOffset
+        && Header.IndexDataOffset  + Header.IndexDataSize  <= Header.MeshletDataOffset
+        && Header.MeshletDataOffset + (uint64_t)Header.MeshletCount * sizeof(meshlet)   <= Header.ShapeDataOffset
+        && Header.ShapeDataOffset   + (uint64_t)Header.ShapeCount   * sizeof(bounds)    <= FileSize
+        && AreLodsValid(Header);
+}
+
+// Cache is stale if the source has changed (size, then content hash when only the timestamp differs)
+static bool IsSourceUpToDate(const mesh_cache_header& Header, const char* Filename, bool* TimeChanged)
+{
+    *TimeChanged = false;
+
+    file_stats Stats;
+    if (!File::GetStats(&Stats, Filename))
+        return true; // Source not available, cache is all we have
+
+    if (Stats.Size != Header.SourceSize)
+        return false;
+
+    if (Stats.ModificationTime == Header.SourceTime)
+        return true;
+
+    uint64_t SourceHash = 0;
+    if (!File::HashFile(&SourceHash, Filename) || SourceHash != Header.SourceHash)
+        return false;
+
+    *TimeChanged = true;
+    return true;
+}
+
+// Use a mapped cache (archive entry or loose file) if valid and up to date, unmapped otherwise.
+// Archive entries are read only: the bake tool keeps them up to date.
+static bool OpenMapping(mesh_cache* Cache, file_mapping Mapping, const std::string& CachedFile, const char* Filename, float Scale, bool KeepEncoded, bool FromArchive)
+{
+    const mesh_cache_header* Header = (const mesh_cache_header*)Mapping.Data;
+    if (Mapping.Size < sizeof(mesh_cache_header) || !IsHeaderCompatible(*Header, Mapping.Size, Scale))
+    {
+        printf("Incompatible cache: %s\n", CachedFile.c_str());
+        File::Unmap(&Mapping);
+        return false;
+    }
+
+    bool TimeChanged;
+    if (!IsSourceUpToDate(*Header, Filename, &TimeChanged))
+    {
+        printf("Stale cache: %s\n", CachedFile.c_str());
+        File::Unmap(&Mapping);
+        return false;
+    }
+
+    // Same content with a new timestamp (e.g. checkout), update the header to skip hashing next time
+    if (TimeChanged && !FromArchive)
+    {
+        file_stats Stats;
+        FILE* CacheFile = fopen(CachedFile.c_str(), "r+b");
+        if (CacheFile && File::GetStats(&Stats, Filename))
+        {
+            fseek(CacheFile, OFFSETOF(mesh_cache_header, SourceTime), SEEK_SET);
+            fwrite(&Stats.ModificationTime, sizeof(uint64_t), 1, CacheFile);
+        }
+        if (CacheFile)
+            fclose(CacheFile);
+    }
+
+    if (!SetPayloadPointers(Cache, (const uint8_t*)Mapping.Data, KeepEncoded))
+    {
+        printf("Corrupted cache: %s\n", CachedFile.c_str());
+        File::Unmap(&Mapping);
+        MeshCache::Release(Cache);
+        return false;
+    }
+    Cache->Mapping = Mapping;
+
+    printf("Loaded from cache: %s (%d vertices, %d indices, %d meshlets, codec %s)\n", Filename, (int)Header->VertexCount, (int)Header->IndexCount, (int)Header->MeshletCount, MeshCodec::GetName((mesh_codec)Header->Codec));
+
+    return true;
+}
+
+bool MeshCache::Open(mesh_cache* Cache, const char* Filename, float Scale, bool KeepEncoded)
+{
+    std::string CachedFile = GetCacheFilename(Filename, Scale);
+
+    // Mounted archive first, the loose file when the entry is missing or stale
+    file_mapping Mapping;
+    if (AssetArchive::Map(&Mapping, CachedFile.c_str()) && OpenMapping(Cache, Mapping, CachedFile, Filename, Scale, KeepEncoded, true))
+        return true;
+    return File::Map(&Mapping, CachedFile.c_str()) && OpenMapping(Cache, Mapping, CachedFile, Filename, Scale, KeepEncoded, false);
+}
+
+bool MeshCache::Write(const char* Filename, float Scale, const std::vector<vertex_full>& Vertices, const std::vector<uint32_t>& Indices, const std::vector<meshlet>& Meshlets, const std::vector<bounds>& Shapes, const mesh_lod* Lods, int LodCount, mesh_codec Codec)
+{
+    std::string CachedFile = GetCacheFilename(Filename, Scale);
+
+    mesh_cache_header Header;
+    mesh_streams Streams;
+    FillHeader(&Header, &Streams, Filename, Scale, Vertices, Indices, Meshlets, Shapes, Lods, LodCount, Codec);
+
+    std::vector<uint8_t> Data(Header.FileSize, 0);
+    FillData(Data.data(), Header, Streams, Meshlets, Shapes);
+
+    FILE* CacheFile = fopen(CachedFile.c_str(), "wb");
+    if (CacheFile == nullptr)
+    {
+        fprintf(stderr, "Cannot write cache: %s\n", CachedFile.c_str());
+        return false;
+    }
+
+    bool Written = fwrite(Data.data(), 1, Data.size(), CacheFile) == Data.size();
+    fclose(CacheFile);
+
+    if (!Written)
+    {
+        fprintf(stderr, "Cannot write cache: %s\n", CachedFile.c_str());
+        remove(CachedFile.c_str());
+        return false;
+    }
+
+    printf("Saved to cache: %s (%d vertices, %d indices, %d meshlets, %d shapes, codec %s, %d bytes)\n", Filename, (int)Vertices.size(), (int)Indices.size(), (int)Meshlets.size(), (int)Shapes.size(), MeshCodec::GetName(Codec), (int)Data.size());
+
+    return true;
+}
+
+bool MeshCache::Load(mesh_cache* Cache, const char* Filename, float Scale, bool KeepEncoded, mesh_codec Codec)
+{
+    *Cache = {};
+
+    if (MeshCache::Open(Cache, Filename, Scale, KeepEncoded))
+        return true;
+
+    // Build cache
+    std::vector<vertex_full> Soup;
+    std::vector<uint32_t> ShapeOffsets;
+    if (!Mesh::ParseObj(Soup, Filename, &ShapeOffsets))
+        return false;
+
+    for (vertex_full& Vertex : Soup)
+        Vertex.Position *= Scale;
+
+    // Shapes are contiguous in the soup only (triangles are reordered below)
+    std::vector<bounds> Shapes(ShapeOffsets.size());
+    Jobs::ParallelFor((int)Shapes.size(), [&](int i)
+    {
+        uint32_t End = (i + 1 < (int)ShapeOffsets.size()) ? ShapeOffsets[i + 1] : (uint32_t)Soup.size();
+        Shapes[i] = Bounds::Compute(Soup.data() + ShapeOffsets[i], (int)(End - ShapeOffsets[i]));
+    });
+
+    std::vector<vertex_full> Vertices;
+    std::vector<uint32_t> Indices;
+    Mesh::WeldVertices(Vertices, Indices, Soup.data(), (int)Soup.size());
+    printf("Welded: %s (%d vertices -> %d vertices)\n", Filename, (int)Soup.size(), (int)Vertices.size());
+
+    // Tangents are smoothed over welded vertices
+    Tangents::Generate(Vertices, Indices);
+
+    vertex_cache_stats Before = MeshOptimizer::AnalyzeVertexCache(Indices.data(), (int)Indices.size(), (int)Vertices.size());
+    MeshOptimizer::Optimize(Vertices, Indices);
+
+    // Meshlets reorder triangles, vertices are renumbered again to follow the new order
+    std::vector<meshlet> Meshlets;
+    Meshlet::Build(&Meshlets, Indices, Vertices);
+    MeshOptimizer::OptimizeVertexFetch(Vertices, Indices);
+    vertex_cache_stats After = MeshOptimizer::AnalyzeVertexCache(Indices.data(), (int)Indices.size(), (int)Vertices.size());
+    printf("Optimized: %s (ACMR %.3f -> %.3f, ATVR %.3f -> %.3f, %d meshlets)\n", Filename, Before.ACMR, After.ACMR, Before.ATVR, After.ATVR, (int)Meshlets.size());
+
+    // LODs are appended to the index buffer (same vertices)
+    mesh_lod Lods[MESH_MAX_LODS];
+    int LodCount = MeshLod::BuildLods(Lods, Indices, Vertices);
+    for (int i = 1; i < LodCount; ++i)
+        printf("LOD %d: %s (%d triangles, error %f)\n", i, Filename, (int)Lods[i].IndexCount / 3, Lods[i].Error);
+
+    if (MeshCache::Write(Filename, Scale, Vertices, Indices, Meshlets, Shapes, Lods, LodCount, Codec) && MeshCache::Open(Cache, Filename, Scale, KeepEncoded))
+        return true;
+
+    // Cache unavailable, keep the mesh in memory with the same layout as the file (not encoded)
+    mesh_cache_header Header;
+    mesh_streams Streams;
+    FillHeader(&Header, &Streams, Filename, Scale, Vertices, Indices, Meshlets, Shapes, Lods, LodCount, MESH_CODEC_NONE);
+    Cache->Storage.assign(Header.FileSize, 0);
+    FillData(Cache->Storage.data(), Header, Streams, Meshlets, Shapes);
+    SetPayloadPointers(Cache, Cache->Storage.data(), KeepEncoded);
+
+    return true;
+}
+
+void MeshCache::Release(mesh_cache* Cache)
+{
+    File::Unmap(&Cache->Mapping);
+    Cache->Storage.clear();
+    Cache->Storage.shrink_to_fit();
+    Cache->DecodedVertices = std::vector<vertex_full>();
+    Cache->DecodedIndices = std::vector<uint8_t>();
+    Cache->Header = nullptr;
+    Cache->Vertices = nullptr;
+    Cache->Indices = nullptr;
+    Cache->Meshlets = nullptr;
+    Cache->Shapes = nullptr;
+}
+
+bool MeshCache::DecodeVertices(const mesh_cache& Cache, vertex_full* Dst)
+{
+    const mesh_cache_header& Header = *Cache.Header;
+    const uint8_t* Stream = (const uint8_t*)Cache.Header + Header.VertexDataOffset;
+    if (Header.Codec == MESH_CODEC_NONE)
+    {
+        memcpy(Dst, Stream, Header.VertexDataSize);
+        return true;
+    }
+    return MeshCodec::DecodeVertices(Dst, (int)Header.VertexCount, Stream, Header.VertexDataSize, GetCodecBounds(Header));
+}
+
+bool MeshCache::DecodeIndices(const mesh_cache& Cache, void* Dst)
+{
+    const mesh_cache_header& Header = *Cache.Header;
+    const uint8_t* Stream = (const uint8_t*)Cache.Header + Header.IndexDataOffset;
+    if (Header.Codec == MESH_CODEC_NONE)
+    {
+        memcpy(Dst, Stream, Header.IndexDataSize);
+        return true;
+    }
+    return MeshCodec::DecodeIndices(Dst, (int)Header.IndexCount, (int)Header.IndexSize, Stream, Header.IndexDataSize);
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "file.h"
+#include "mesh.h"
+#include "bounds.h"
+#include "meshlet.h"
+#include "mesh_lod.h"
+#include "mesh_codec.h"
+
+// Binary mesh cache, written next to the source file ("<obj>.<scale>.cache") and loaded with a memory mapping.
+// File layout: [mesh_cache_header][vertices][indices][meshlets][shape bounds], payloads are aligned on 16 bytes.
+// Vertices use the vertex_full layout and are already scaled, indices are 16 or 32 bits (ready for glBufferData).
+// With MESH_CODEC_COMPACT (bake tool), the vertex and index payloads are MeshCodec streams, decoded at load.
+// Triangles and vertices are reordered by MeshOptimizer (vertex cache, overdraw and fetch locality),
+// then triangles are grouped in meshlets (contiguous index ranges with culling bounds).
+// Indices of the simplified LODs follow the LOD 0 indices (meshlets only cover LOD 0).
+// Bounds (box and sphere) cover the whole mesh and each OBJ shape ('o'/'g' groups, in file order).
+
+const uint32_t MESH_CACHE_MAGIC       = 0x4853454D; // "MESH"
+const uint32_t MESH_CACHE_VERSION     = 7;
+const uint32_t MESH_CACHE_ENDIAN_TEST = 0x01020304;
+
+struct mesh_cache_header
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t EndianTest;
+    uint32_t HeaderSize;
+
+    // Source file (to detect stale caches)
+    uint64_t SourceSize;
+    uint64_t SourceTime;
+    uint64_t SourceHash;
+    float Scale;
+
+    // Vertex layout descriptor (-1 when the attribute is absent)
+    uint32_t VertexStride;
+    int32_t PositionOffset;
+    int32_t NormalOffset;
+    int32_t UVOffset;
+    int32_t TangentOffset;
+
+    // Bounds (scaled)
+    float BoundsMin[3];
+    float BoundsMax[3];
+    float BoundsCenter[3]; // Bounding sphere
+    float BoundsRadius;
+
+    // Payloads
+    uint32_t VertexCount;
+    uint32_t IndexCount;
+    uint32_t IndexSize;
+    uint32_t MeshletCount;
+    uint32_t ShapeCount;
+    uint32_t Padding0;
+    uint64_t VertexDataOffset;
+    uint64_t IndexDataOffset;
+    uint64_t MeshletDataOffset;
+    uint64_t ShapeDataOffset;
+    uint64_t FileSize;
+
+    // Payload encoding (mesh_codec), sizes of the vertex and index payloads as stored
+    uint32_t Codec;
+    uint32_t Padding1;
+    uint64_t VertexDataSize;
+    uint64_t IndexDataSize;
+    float UVMin[2]; // UV quantization range (MESH_CODEC_COMPACT)
+    float UVMax[2];
+    uint64_t Padding2;
+
+    // Index ranges of the LODs
+    uint32_t LodCount;
+    uint32_t Padding;
+    mesh_lod Lods[MESH_MAX_LODS];
+};
+
+// Indexed mesh loaded from cache
+struct mesh_cache
+{
+    const mesh_cache_header* Header;
+    const vertex_full* Vertices; // nullptr when the payloads are kept encoded
+    const void* Indices; // uint16_t or uint32_t (see Header->IndexSize)
+    const meshlet* Meshlets;
+    const bounds* Shapes; // Header->ShapeCount
+
+    file_mapping Mapping;
+
+    // Fallback storage when the cache file cannot be written
+    std::vector<uint8_t> Storage;
+
+    // Decoded payloads of an encoded cache
+    std::vector<vertex_full> DecodedVertices;
+    std::vector<uint8_t> DecodedIndices;
+};
+
+namespace MeshCache
+{
+// Map cache if valid, otherwise parse .obj and (re)build cache (with Codec, a cache found is used whatever its codec).
+// Encoded payloads are decoded unless KeepEncoded: Vertices and Indices are then nullptr, see DecodeVertices/DecodeIndices.
+bool Load(mesh_cache* Cache, const char* Filename, float Scale, bool KeepEncoded = false, mesh_codec Codec = MESH_CODEC_NONE);
+void Release(mesh_cache* Cache);
+
+std::string GetCacheFilename(const char* Filename, float Scale);
+
+bool Open(mesh_cache* Cache, const char* Filename, float Scale, bool KeepEncoded = false);
+bool Write(const char* Filename, float Scale, const std::vector<vertex_full>& Vertices, const std::vector<uint32_t>& Indices, const std::vector<meshlet>& Meshlets, const std::vector<bounds>& Shapes, const mesh_lod* Lods, int LodCount, mesh_codec Codec = MESH_CODEC_NONE);
+
+// Payloads of an encoded (or raw) cache to Dst: Header->VertexCount vertices, Header->IndexCount indices of Header->IndexSize bytes
+bool DecodeVertices(const mesh_cache& Cache, vertex_full* Dst);
+bool DecodeIndices(const mesh_cache& Cache, void* Dst);
+}
@@ -0,0 +1,376 @@
+#include <atomic>
+#include <cstring>
+
+#include "maths.h"
+#include "simd.h"
+#include "jobs.h"
+
+#include "mesh_codec.h"
+
+const int VERTEX_COMPONENT_COUNT = 10;
+
+const char* MeshCodec::GetName(mesh_codec Codec)
+{
+    switch (Codec)
+    {
+    case MESH_CODEC_NONE:    return "none";
+    case MESH_CODEC_COMPACT: return "compact";
+    default:                 return "unknown";
+    }
+}
+
+static int GetBlockCount(int Count, int BlockSize)
+{
+    return (Count + BlockSize - 1) / BlockSize;
+}
+
+static uint32_t ZigZag(int32_t Value)
+{
+    return ((uint32_t)Value << 1) ^ (uint32_t)(Value >> 31);
+}
+
+static int32_t UnZigZag(uint32_t Value)
+{
+    return (int32_t)(Value >> 1) ^ -(int32_t)(Value & 1);
+}
+
+static void WriteVarint(std::vector<uint8_t>* Stream, uint32_t Value)
+{
+    while (Value >= 0x80)
+    {
+        Stream->push_back((uint8_t)(Value | 0x80));
+        Value >>= 7;
+    }
+    Stream->push_back((uint8_t)Value);
+}
+
+// Returns nullptr past End or on a varint longer than 5 bytes
+static const uint8_t* ReadVarint(const uint8_t* Data, const uint8_t* End, uint32_t* Value)
+{
+    // Fast path, most deltas fit in a byte
+    if (Data < End && *Data < 0x80)
+    {
+        *Value = *Data;
+        return Data + 1;
+    }
+
+    uint32_t Result = 0;
+    for (int Shift = 0; Shift < 35 && Data < End; Shift += 7)
+    {
+        uint8_t Byte = *Data++;
+        Result |= (uint32_t)(Byte & 0x7F) << Shift;
+        if (Byte < 0x80)
+        {
+            *Value = Result;
+            return Data;
+        }
+    }
+    return nullptr;
+}
+
+// Block offsets table, patched once the blocks are written
+static void BeginBlocks(std::vector<uint8_t>* Stream, int BlockCount)
+{
+    Stream->assign((size_t)(BlockCount + 1) * sizeof(uint32_t), 0);
+}
+
+static void SetBlockOffset(std::vector<uint8_t>* Stream, int Block)
+{
+    uint32_t Offset = (uint32_t)Stream->size();
+    memcpy(Stream->data() + Block * sizeof(uint32_t), &Offset, sizeof(Offset));
+}
+
+static bool GetBlock(const uint8_t** Begin, const uint8_t** End, int Block, int BlockCount, const uint8_t* Stream, size_t StreamSize)
+{
+    if ((size_t)(BlockCount + 1) * sizeof(uint32_t) > StreamSize)
+        return false;
+
+    uint32_t Offsets[2];
+    memcpy(Offsets, Stream + Block * sizeof(uint32_t), sizeof(Offsets));
+    if (Offsets[0] > Offsets[1] || Offsets[1] > StreamSize)
+        return false;
+
+    *Begin = Stream + Offsets[0];
+    *End = Stream + Offsets[1];
+    return true;
+}
+
+// Quantization
+
+static uint16_t QuantizeUnorm16(float Value, float Min, float Max)
+{
+    float Range = Max - Min;
+    float Normalized = (Range > 0.f) ? (Value - Min) / Range : 0.f;
+    return (uint16_t)Math::Floor(Math::Clamp(Normalized, 0.f, 1.f) * 65535.f + 0.5f);
+}
+
+static uint16_t QuantizeSnorm16(float Value)
+{
+    return (uint16_t)(int16_t)Math::Floor(Math::Clamp(Value, -1.f, 1.f) * 32767.f + 0.5f);
+}
+
+// Octahedral mapping of a unit vector to [-1;1]^2 (same as the packed vertex layouts)
+static v2 EncodeOctahedral(v3 N)
+{
+    float L1 = Math::Abs(N.x) + Math::Abs(N.y) + Math::Abs(N.z);
+    if (L1 == 0.f)
+        return { 0.f, 0.f };
+
+    v2 E = { N.x / L1, N.y / L1 };
+    if (N.z < 0.f)
+    {
+        v2 Folded = {
+            (1.f - Math::Abs(E.y)) * (E.x >= 0.f ? 1.f : -1.f),
+            (1.f - Math::Abs(E.x)) * (E.y >= 0.f ? 1.f : -1.f)
+        };
+        E = Folded;
+    }
+    return E;
+}
+
+static void QuantizeVertex(uint16_t Components[VERTEX_COMPONENT_COUNT], const vertex_full& Vertex, const mesh_codec_bounds& Bounds)
+{
+    v2 Normal = EncodeOctahedral(Vertex.Normal);
+    v2 Tangent = EncodeOctahedral({ Vertex.Tangent.x, Vertex.Tangent.y, Vertex.Tangent.z });
+
+    Components[0] = QuantizeUnorm16(Vertex.Position.x, Bounds.PositionMin.x, Bounds.PositionMax.x);
+    Components[1] = QuantizeUnorm16(Vertex.Position.y, Bounds.PositionMin.y, Bounds.PositionMax.y);
+    Components[2] = QuantizeUnorm16(Vertex.Position.z, Bounds.PositionMin.z, Bounds.PositionMax.z);
+    Components[3] = QuantizeSnorm16(Normal.x);
+    Components[4] = QuantizeSnorm16(Normal.y);
+    Components[5] = QuantizeUnorm16(Vertex.UV.x, Bounds.UVMin.x, Bounds.UVMax.x);
+    Components[6] = QuantizeUnorm16(Vertex.UV.y, Bounds.UVMin.y, Bounds.UVMax.y);
+    Components[7] = QuantizeSnorm16(Tangent.x);
+    Components[8] = QuantizeSnorm16(Tangent.y);
+    Components[9] = (Vertex.Tangent.w < 0.f) ? 1 : 0;
+}
+
+mesh_codec_bounds MeshCodec::ComputeBounds(const vertex_full* Vertices, int Count)
+{
+    mesh_codec_bounds Bounds = {};
+    if (Count == 0)
+        return Bounds;
+
+    Bounds.PositionMin = Bounds.PositionMax = Vertices[0].Position;
+    Bounds.UVMin = Bounds.UVMax = Vertices[0].UV;
+    for (int i = 1; i < Count; ++i)
+    {
+        for (int c = 0; c < 3; ++c)
+        {
+            Bounds.PositionMin.e[c] = Math::Min(Bounds.PositionMin.e[c], Vertices[i].Position.e[c]);
+            Bounds.PositionMax.e[c] = Math::Max(Bounds.PositionMax.e[c], Vertices[i].Position.e[c]);
+        }
+        for (int c = 0; c < 2; ++c)
+        {
+            Bounds.UVMin.e[c] = Math::Min(Bounds.UVMin.e[c], Vertices[i].UV.e[c]);
+            Bounds.UVMax.e[c] = Math::Max(Bounds.UVMax.e[c], Vertices[i].UV.e[c]);
+        }
+    }
+    return Bounds;
+}
+
+void MeshCodec::EncodeVertices(std::vector<uint8_t>* Stream, const vertex_full* Vertices, int Count, const mesh_codec_bounds& Bounds)
+{
+    int BlockCount = GetBlockCount(Count, MESH_CODEC_VERTEX_BLOCK_SIZE);
+    BeginBlocks(Stream, BlockCount);
+
+    std::vector<uint16_t> Quantized((size_t)MESH_CODEC_VERTEX_BLOCK_SIZE * VERTEX_COMPONENT_COUNT);
+    for (int Block = 0; Block < BlockCount; ++Block)
+    {
+        SetBlockOffset(Stream, Block);
+
+        int First = Block * MESH_CODEC_VERTEX_BLOCK_SIZE;
+        int BlockSize = Math::Min(Count - First, MESH_CODEC_VERTEX_BLOCK_SIZE);
+        for (int i = 0; i < BlockSize; ++i)
+            QuantizeVertex(&Quantized[(size_t)i * VERTEX_COMPONENT_COUNT], Vertices[First + i], Bounds);
+
+        // Component major: each component is predicted by the same component of the previous vertex
+        for (int c = 0; c < VERTEX_COMPONENT_COUNT; ++c)
+        {
+            uint16_t Previous = 0;
+            for (int i = 0; i < BlockSize; ++i)
+            {
+                uint16_t Value = Quantized[(size_t)i * VERTEX_COMPONENT_COUNT + c];
+                WriteVarint(Stream, ZigZag((int16_t)(uint16_t)(Value - Previous)));
+                Previous = Value;
+            }
+        }
+    }
+    SetBlockOffset(Stream, BlockCount);
+}
+
+void MeshCodec::EncodeIndices(std::vector<uint8_t>* Stream, const uint32_t* Indices, int Count)
+{
+    int BlockCount = GetBlockCount(Count, MESH_CODEC_INDEX_BLOCK_SIZE);
+    BeginBlocks(Stream, BlockCount);
+
+    for (int Block = 0; Block < BlockCount; ++Block)
+    {
+        SetBlockOffset(Stream, Block);
+
+        int First = Block * MESH_CODEC_INDEX_BLOCK_SIZE;
+        int End = Math::Min(Count, First + MESH_CODEC_INDEX_BLOCK_SIZE);
+        uint32_t Previous = 0;
+        for (int i = First; i < End; ++i)
+        {
+            WriteVarint(Stream, ZigZag((int32_t)(Indices[i] - Previous)));
+            Previous = Indices[i];
+        }
+    }
+    SetBlockOffset(Stream, BlockCount);
+}
+
+// Decoding
+
+// Prefix sum of the zigzag deltas of one component
+static const uint8_t* DecodeComponent(uint16_t* Dst, int Count, const uint8_t* Data, const uint8_t* End)
+{
+    uint16_t Previous = 0;
+    for (int i = 0; i < Count; ++i)
+    {
+        uint32_t Delta;
+        Data = ReadVarint(Data, End, &Delta);
+        if (Data == nullptr)
+            return nullptr;
+        Previous = (uint16_t)(Previous + UnZigZag(Delta));
+        Dst[i] = Previous;
+    }
+    return Data;
+}
+
+// Unit vectors from octahedral snorm16 pairs, structure of arrays (Z is written to Dst[2])
+static void DecodeOctahedral(float* Dst[3], const uint16_t* QuantizedX, const uint16_t* QuantizedY, int Count)
+{
+    float* X = Dst[0];
+    float* Y = Dst[1];
+    float* Z = Dst[2];
+    for (int i = 0; i < Count; ++i)
+    {
+        float EX = Math::Max((int16_t)QuantizedX[i] / 32767.f, -1.f);
+        float EY = Math::Max((int16_t)QuantizedY[i] / 32767.f, -1.f);
+        float EZ = 1.f - Math::Abs(EX) - Math::Abs(EY);
+        float Fold = Math::Max(-EZ, 0.f);
+        X[i] = EX + (EX >= 0.f ? -Fold : Fold);
+        Y[i] = EY + (EY >= 0.f ? -Fold : Fold);
+        Z[i] = EZ;
+    }
+
+    // Normalization, SIMD_WIDTH vectors at a time
+    int i = 0;
+    for (; i + SIMD_WIDTH <= Count; i += SIMD_WIDTH)
+    {
+        simd_float VX = Simd::Load(X + i);
+        simd_float VY = Simd::Load(Y + i);
+        simd_float VZ = Simd::Load(Z + i);
+        simd_float InvLength = Simd::Div(Simd::Set1(1.f), Simd::Sqrt(Simd::MulAdd(VX, VX, Simd::MulAdd(VY, VY, Simd::Mul(VZ, VZ)))));
+        Simd::Store(X + i, Simd::Mul(VX, InvLength));
+        Simd::Store(Y + i, Simd::Mul(VY, InvLength));
+        Simd::Store(Z + i, Simd::Mul(VZ, InvLength));
+    }
+    for (; i < Count; ++i)
+    {
+        float InvLength = 1.f / Math::Sqrt(X[i] * X[i] + Y[i] * Y[i] + Z[i] * Z[i]);
+        X[i] *= InvLength;
+        Y[i] *= InvLength;
+        Z[i] *= InvLength;
+    }
+}
+
+static bool DecodeVertexBlock(vertex_full* Dst, int Count, const uint8_t* Data, const uint8_t* End, const mesh_codec_bounds& Bounds)
+{
+    // Components then float attributes, structure of arrays
+    std::vector<uint16_t> Quantized((size_t)VERTEX_COMPONENT_COUNT * Count);
+    for (int c = 0; c < VERTEX_COMPONENT_COUNT && Data; ++c)
+        Data = DecodeComponent(&Quantized[(size_t)c * Count], Count, Data, End);
+    if (Data == nullptr)
+        return false;
+
+    std::vector<float> Floats((size_t)12 * Count);
+    float* Attributes[12];
+    for (int a = 0; a < 12; ++a)
+        Attributes[a] = &Floats[(size_t)a * Count];
+
+    // Position and UV: Min + Value * (Max - Min) / 65535
+    const float Mins[5] = { Bounds.PositionMin.x, Bounds.PositionMin.y, Bounds.PositionMin.z, Bounds.UVMin.x, Bounds.UVMin.y };
+    const float Maxs[5] = { Bounds.PositionMax.x, Bounds.PositionMax.y, Bounds.PositionMax.z, Bounds.UVMax.x, Bounds.UVMax.y };
+    const int UnormComponents[5] = { 0, 1, 2, 5, 6 };
+    const int UnormAttributes[5] = { 0, 1, 2, 6, 7 };
+    for (int u = 0; u < 5; ++u)
+    {
+        const uint16_t* Src = &Quantized[(size_t)UnormComponents[u] * Count];
+        float* AttributeDst = Attributes[UnormAttributes[u]];
+        float Min = Mins[u];
+        float Scale = (Maxs[u] - Mins[u]) / 65535.f;
+        for (int i = 0; i < Count; ++i)
+            AttributeDst[i] = Min + Src[i] * Scale;
+    }
+
+    DecodeOctahedral(&Attributes[3], &Quantized[(size_t)3 * Count], &Quantized[(size_t)4 * Count], Count);
+    DecodeOctahedral(&Attributes[8], &Quantized[(size_t)7 * Count], &Quantized[(size_t)8 * Count], Count);
+    const uint16_t* Signs = &Quantized[(size_t)9 * Count];
+    for (int i = 0; i < Count; ++i)
+        Attributes[11][i] = Signs[i] ? -1.f : 1.f;
+
+    // Interleave (vertex_full is 12 floats in attribute order)
+    static_assert(sizeof(vertex_full) == 12 * sizeof(float), "vertex_full must stay 12 floats");
+    for (int i = 0; i < Count; ++i)
+    {
+        float* Vertex = (float*)&Dst[i];
+        for (int a = 0; a < 12; ++a)
+            Vertex[a] = Attributes[a][i];
+    }
+    return true;
+}
+
+bool MeshCodec::DecodeVertices(vertex_full* Dst, int Count, const uint8_t* Stream, size_t StreamSize, const mesh_codec_bounds& Bounds)
+{
+    int BlockCount = GetBlockCount(Count, MESH_CODEC_VERTEX_BLOCK_SIZE);
+    std::atomic<bool> Valid(true);
+    Jobs::ParallelFor(BlockCount, [&](int Block)
+    {
+        const uint8_t* Begin;
+        const uint8_t* End;
+        int First = Block * MESH_CODEC_VERTEX_BLOCK_SIZE;
+        int BlockSize = Math::Min(Count - First, MESH_CODEC_VERTEX_BLOCK_SIZE);
+        if (!GetBlock(&Begin, &End, Block, BlockCount, Stream, StreamSize) || !DecodeVertexBlock(Dst + First, BlockSize, Begin, End, Bounds))
+            Valid = false;
+    });
+    return Valid;
+}
+
+template <typename index_type>
+static bool DecodeIndexBlock(index_type* Dst, int Count, const uint8_t* Data, const uint8_t* End)
+{
+    uint32_t Previous = 0;
+    for (int i = 0; i < Count; ++i)
+    {
+        uint32_t Delta;
+        Data = ReadVarint(Data, End, &Delta);
+        if (Data == nullptr)
+            return false;
+        Previous += (uint32_t)UnZigZag(Delta);
+        Dst[i] = (index_type)Previous;
+    }
+    return true;
+}
+
+bool MeshCodec::DecodeIndices(void* Dst, int Count, int IndexSize, const uint8_t* Stream, size_t StreamSize)
+{
+    int BlockCount = GetBlockCount(Count, MESH_CODEC_INDEX_BLOCK_SIZE);
+    std::atomic<bool> Valid(true);
+    Jobs::ParallelFor(BlockCount, [&](int Block)
+    {
+        const uint8_t* Begin;
+        const uint8_t* End;
+        int First = Block * MESH_CODEC_INDEX_BLOCK_SIZE;
+        int BlockSize = Math::Min(Count - First, MESH_CODEC_INDEX_BLOCK_SIZE);
+        bool Decoded = GetBlock(&Begin, &End, Block, BlockCount, Stream, StreamSize);
+        if (Decoded && IndexSize == sizeof(uint16_t))
+            Decoded = DecodeIndexBlock((uint16_t*)Dst + First, BlockSize, Begin, End);
+        else if (Decoded)
+            Decoded = DecodeIndexBlock((uint32_t*)Dst + First, BlockSize, Begin, End);
+        if (!Decoded)
+            Valid = false;
+    });
+    return Valid;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+// Compact encoding of the mesh cache vertex and index streams (selected per asset by the bake tool).
+// Streams are split in blocks decoded independently (in parallel): [uint32_t BlockOffsets[BlockCount + 1]][blocks].
+// Indices: delta to the previous index of the block, zigzag, LEB128 varint (1 byte for most indices after MeshOptimizer).
+// Vertices: 10 quantized uint16 components (position in the mesh bounds, octahedral normal, UV in the UV bounds,
+// octahedral tangent, bitangent sign), stored component by component as varints of the zigzag delta to the previous vertex.
+// Quantization is close to VERTEX_LAYOUT_PACKED (16 bits per component), FULL vertices are rebuilt in float.
+
+enum mesh_codec
+{
+    MESH_CODEC_NONE,    // Raw vertex_full and 16/32 bits indices (mapped and uploaded as is)
+    MESH_CODEC_COMPACT, // Quantized and predicted vertices, delta varint indices
+    MESH_CODEC_COUNT,
+};
+
+const int MESH_CODEC_VERTEX_BLOCK_SIZE = 4096;
+const int MESH_CODEC_INDEX_BLOCK_SIZE  = 16384;
+
+// Quantization ranges (stored in the cache header)
+struct mesh_codec_bounds
+{
+    v3 PositionMin;
+    v3 PositionMax;
+    v2 UVMin;
+    v2 UVMax;
+};
+
+namespace MeshCodec
+{
+const char* GetName(mesh_codec Codec);
+
+mesh_codec_bounds ComputeBounds(const vertex_full* Vertices, int Count);
+
+void EncodeVertices(std::vector<uint8_t>* Stream, const vertex_full* Vertices, int Count, const mesh_codec_bounds& Bounds);
+void EncodeIndices(std::vector<uint8_t>* Stream, const uint32_t* Indices, int Count);
+
+// Decode to Dst (Count vertices or indices of IndexSize bytes), false if the stream is corrupted
+bool DecodeVertices(vertex_full* Dst, int Count, const uint8_t* Stream, size_t StreamSize, const mesh_codec_bounds& Bounds);
+bool DecodeIndices(void* Dst, int Count, int IndexSize, const uint8_t* Stream, size_t StreamSize);
+}
@@ -0,0 +1,368 @@
+#include <algorithm>
+#include <cstring>
+
+#include "maths.h"
+
+#include "mesh_optimizer.h"
+#include "mesh_lod.h"
+
+// Collapses rotating a triangle normal by more than ~75 degrees are rejected
+const float MESH_LOD_MAX_NORMAL_COS = 0.25f;
+
+enum vertex_kind : uint8_t
+{
+    VERTEX_KIND_MANIFOLD, // Can collapse onto any neighbor
+    VERTEX_KIND_BORDER,   // Can only collapse along an open edge
+    VERTEX_KIND_LOCKED,   // Attribute seams and complex borders
+};
+
+// Symmetric 4x4 matrix of the squared distance to a set of planes, weighted by area
+struct quadric
+{
+    double A2, B2, C2, D2;
+    double AB, AC, AD, BC, BD, CD;
+    double Weight;
+};
+
+struct collapse
+{
+    uint32_t From;
+    uint32_t To;
+    float Error;
+};
+
+static void AddPlane(quadric* Q, v3 Normal, float Distance, float Weight)
+{
+    double A = Normal.x, B = Normal.y, C = Normal.z, D = Distance;
+    Q->A2 += A * A * Weight; Q->B2 += B * B * Weight; Q->C2 += C * C * Weight; Q->D2 += D * D * Weight;
+    Q->AB += A * B * Weight; Q->AC += A * C * Weight; Q->AD += A * D * Weight;
+    Q->BC += B * C * Weight; Q->BD += B * D * Weight; Q->CD += C * D * Weight;
+    Q->Weight += Weight;
+}
+
+static void AddQuadric(quadric* Q, const quadric& Other)
+{
+    Q->A2 += Other.A2; Q->B2 += Other.B2; Q->C2 += Other.C2; Q->D2 += Other.D2;
+    Q->AB += Other.AB; Q->AC += Other.AC; Q->AD += Other.AD;
+    Q->BC += Other.BC; Q->BD += Other.BD; Q->CD += Other.CD;
+    Q->Weight += Other.Weight;
+}
+
+// Mean squared distance of P to the planes
+static float EvaluateQuadric(const quadric& Q, v3 P)
+{
+    double X = P.x, Y = P.y, Z = P.z;
+    double R = Q.A2 * X * X + Q.B2 * Y * Y + Q.C2 * Z * Z + Q.D2
+             + 2.0 * (Q.AB * X * Y + Q.AC * X * Z + Q.AD * X + Q.BC * Y * Z + Q.BD * Y + Q.CD * Z);
+    return Q.Weight > 0.0 ? (float)Math::Abs((float)(R / Q.Weight)) : 0.f;
+}
+
+static uint64_t EdgeKey(uint32_t A, uint32_t B)
+{
+    return ((uint64_t)A << 32) | B;
+}
+
+static bool HasEdge(const std::vector<uint64_t>& SortedEdges, uint32_t A, uint32_t B)
+{
+    return std::binary_search(SortedEdges.begin(), SortedEdges.end(), EdgeKey(A, B));
+}
+
+// Remap vertices sharing the same position onto the first one
+static void BuildPositionRemap(std::vector<uint32_t>* Remap, std::vector<uint8_t>* IsSeam, const vertex_full* Vertices, int VertexCount)
+{
+    Remap->resize(VertexCount);
+    IsSeam->assign(VertexCount, 0);
+
+    int TableSize = 1;
+    while (TableSize < VertexCount * 2)
+        TableSize <<= 1;
+    const uint32_t EmptySlot = UINT32_MAX;
+    std::vector<uint32_t> Table(TableSize, EmptySlot);
+
+    for (int i = 0; i < VertexCount; ++i)
+    {
+        uint32_t Bits[3];
+        memcpy(Bits, Vertices[i].Position.e, sizeof(Bits));
+        uint32_t Slot = ((Bits[0] * 73856093u) ^ (Bits[1] * 19349663u) ^ (Bits[2] * 83492791u)) & (TableSize - 1);
+
+        while (Table[Slot] != EmptySlot && memcmp(Vertices[Table[Slot]].Position.e, Bits, sizeof(Bits)) != 0)
+            Slot = (Slot + 1) & (TableSize - 1);
+
+        if (Table[Slot] == EmptySlot)
+        {
+            Table[Slot] = (uint32_t)i;
+        }
+        else
+        {
+            (*IsSeam)[i] = 1;
+            (*IsSeam)[Table[Slot]] = 1;
+        }
+        (*Remap)[i] = Table[Slot];
+    }
+}
+
+int MeshLod::Simplify(uint32_t* Destination, const uint32_t* Indices, int IndexCount, const vertex_full* Vertices, int VertexCount, int TargetIndexCount, float TargetError, float* ErrorOut)
+{
+    std::vector<uint32_t> Result(Indices, Indices + IndexCount);
+    float ResultError = 0.f;
+
+    std::vector<uint32_t> Remap;
+    std::vector<uint8_t> IsSeam;
+    BuildPositionRemap(&Remap, &IsSeam, Vertices, VertexCount);
+
+    // Open edges (on positions): the opposite half edge does not exist
+    std::vector<uint64_t> Edges;
+    Edges.reserve(IndexCount);
+    for (int i = 0; i < IndexCount; i += 3)
+        for (int j = 0; j < 3; ++j)
+            Edges.push_back(EdgeKey(Remap[Indices[i + j]], Remap[Indices[i + (j + 1) % 3]]));
+    std::sort(Edges.begin(), Edges.end());
+
+    std::vector<uint64_t> OpenEdges;
+    std::vector<int> OpenEdgeCount(VertexCount, 0);
+    for (uint64_t Edge : Edges)
+    {
+        uint32_t A = (uint32_t)(Edge >> 32);
+        uint32_t B = (uint32_t)Edge;
+        if (!HasEdge(Edges, B, A))
+        {
+            OpenEdges.push_back(Edge);
+            OpenEdgeCount[A]++;
+            OpenEdgeCount[B]++;
+        }
+    }
+
+    std::vector<uint8_t> Kind(VertexCount, VERTEX_KIND_MANIFOLD);
+    for (int i = 0; i < VertexCount; ++i)
+    {
+        int Open = OpenEdgeCount[Remap[i]];
+        if (IsSeam[i] || (Open != 0 && Open != 2))
+            Kind[i] = VERTEX_KIND_LOCKED;
+        else if (Open == 2)
+            Kind[i] = VERTEX_KIND_BORDER;
+    }
+
+    // Quadrics (on positions): triangle planes, plus planes perpendicular to open edges to keep borders in place
+    std::vector<quadric> Quadrics(VertexCount, quadric{});
+    for (int i = 0; i < IndexCount; i += 3)
+    {
+        v3 P[3] = { Vertices[Indices[i]].Position, Vertices[Indices[i + 1]].Position, Vertices[Indices[i + 2]].Position };
+        v3 Normal = Vec3::Cross(P[1] - P[0], P[2] - P[0]);
+        float Area = Vec3::Length(Normal);
+        if (Area == 0.f)
+            continue;
+        Normal /= Area;
+
+        for (int j = 0; j < 3; ++j)
+            AddPlane(&Quadrics[Remap[Indices[i + j]]], Normal, -Vec3::Dot(Normal, P[0]), Area);
+
+        for (int j = 0; j < 3; ++j)
+        {
+            uint32_t A = Remap[Indices[i + j]];
+            uint32_t B = Remap[Indices[i + (j + 1) % 3]];
+            if (!std::binary_search(OpenEdges.begin(), OpenEdges.end(), EdgeKey(A, B)))
+                continue;
+
+            v3 Edge = P[(j + 1) % 3] - P[j];
+            float EdgeLength = Vec3::Length(Edge);
+            v3 BorderNormal = Vec3::Normalize(Vec3::Cross(Edge, Normal));
+            AddPlane(&Quadrics[A], BorderNormal, -Vec3::Dot(BorderNormal, P[j]), EdgeLength * EdgeLength * 10.f);
+            AddPlane(&Quadrics[B], BorderNormal, -Vec3::Dot(BorderNormal, P[j]), EdgeLength * EdgeLength * 10.f);
+        }
+    }
+
+    float MaxError = TargetError * TargetError;
+    std::vector<int> AdjacencyOffsets(VertexCount + 1);
+    std::vector<int> Adjacency;
+    std::vector<collapse> Collapses;
+    std::vector<uint32_t> CollapseRemap(VertexCount);
+    std::vector<uint8_t> CollapseLocked(VertexCount);
+
+    while ((int)Result.size() > TargetIndexCount)
+    {
+        int ResultCount = (int)Result.size();
+
+        // Vertex to triangles adjacency of the current result
+        std::fill(AdjacencyOffsets.begin(), AdjacencyOffsets.end(), 0);
+        for (uint32_t Index : Result)
+            AdjacencyOffsets[Index + 1]++;
+        for (int i = 0; i < VertexCount; ++i)
+            AdjacencyOffsets[i + 1] += AdjacencyOffsets[i];
+        Adjacency.resize(ResultCount);
+        {
+            std::vector<int> Fill(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+            for (int i = 0; i < ResultCount; ++i)
+                Adjacency[Fill[Result[i]]++] = i / 3;
+        }
+
+        // Collapse candidates sorted by error
+        Collapses.clear();
+        for (int i = 0; i < ResultCount; i += 3)
+        {
+            for (int j = 0; j < 3; ++j)
+            {
+                uint32_t From = Result[i + j];
+                uint32_t To = Result[i + (j + 1) % 3];
+                for (int Direction = 0; Direction < 2; ++Direction, std::swap(From, To))
+                {
+                    if (Kind[From] == VERTEX_KIND_LOCKED)
+                        continue;
+                    if (Kind[From] == VERTEX_KIND_BORDER && !std::binary_search(OpenEdges.begin(), OpenEdges.end(), EdgeKey(Remap[From], Remap[To]))
+                                                         && !std::binary_search(OpenEdges.begin(), OpenEdges.end(), EdgeKey(Remap[To], Remap[From])))
+                        continue;
+
+                    quadric Q = Quadrics[Remap[From]];
+                    AddQuadric(&Q, Quadrics[Remap[To]]);
+                    Collapses.push_back({ From, To, EvaluateQuadric(Q, Vertices[To].Position) });
+                }
+            }
+        }
+        std::sort(Collapses.begin(), Collapses.end(), [](const collapse& A, const collapse& B) { return A.Error < B.Error; });
+
+        // Apply the cheapest collapses, vertices are only involved in one collapse per pass
+        for (int i = 0; i < VertexCount; ++i)
+            CollapseRemap[i] = (uint32_t)i;
+        std::fill(CollapseLocked.begin(), CollapseLocked.end(), 0);
+
+        int TrianglesToRemove = (ResultCount - TargetIndexCount) / 3;
+        int RemovedTriangles = 0;
+        int CollapseCount = 0;
+        for (const collapse& Collapse : Collapses)
+        {
+            if (Collapse.Error > MaxError || RemovedTriangles >= TrianglesToRemove)
+                break;
+            if (CollapseLocked[Collapse.From] || CollapseLocked[Collapse.To])
+                continue;
+
+            // Reject collapses flipping (or almost flipping) a triangle
+            v3 To = Vertices[Collapse.To].Position;
+            bool Flip = false;
+            int Removed = 0;
+            for (int k = AdjacencyOffsets[Collapse.From]; k < AdjacencyOffsets[Collapse.From + 1] && !Flip; ++k)
+            {
+                const uint32_t* Triangle = &Result[Adjacency[k] * 3];
+                if (Triangle[0] == Collapse.To || Triangle[1] == Collapse.To || Triangle[2] == Collapse.To)
+                {
+                    Removed++;
+                    continue;
+                }
+
+                v3 P[3];
+                for (int j = 0; j < 3; ++j)
+                    P[j] = Vertices[Triangle[j]].Position;
+                v3 Before = Vec3::Cross(P[1] - P[0], P[2] - P[0]);
+                for (int j = 0; j < 3; ++j)
+                    P[j] = (Triangle[j] == Collapse.From) ? To : P[j];
+                v3 After = Vec3::Cross(P[1] - P[0], P[2] - P[0]);
+                Flip = Vec3::Dot(Before, After) <= MESH_LOD_MAX_NORMAL_COS * Vec3::Length(Before) * Vec3::Length(After);
+            }
+            if (Flip)
+                continue;
+
+            // Neighbors keep their triangles for this pass
+            for (int k = AdjacencyOffsets[Collapse.From]; k < AdjacencyOffsets[Collapse.From + 1]; ++k)
+            {
+                const uint32_t* Triangle = &Result[Adjacency[k] * 3];
+                CollapseLocked[Triangle[0]] = CollapseLocked[Triangle[1]] = CollapseLocked[Triangle[2]] = 1;
+            }
+
+            CollapseRemap[Collapse.From] = Collapse.To;
+            AddQuadric(&Quadrics[Remap[Collapse.To]], Quadrics[Remap[Collapse.From]]);
+            ResultError = Math::Max(ResultError, Collapse.Error);
+            RemovedTriangles += Removed;
+            CollapseCount++;
+        }
+
+        if (CollapseCount == 0)
+            break;
+
+        // Remove degenerate triangles
+        int WriteIndex = 0;
+        for (int i = 0; i < ResultCount; i += 3)
+        {
+            uint32_t A = CollapseRemap[Result[i]];
+            uint32_t B = CollapseRemap[Result[i + 1]];
+            uint32_t C = CollapseRemap[Result[i + 2]];
+            if (A == B || B == C || C == A)
+                continue;
+            Result[WriteIndex++] = A;
+            Result[WriteIndex++] = B;
+            Result[WriteIndex++] = C;
+        }
+        Result.resize(WriteIndex);
+    }
+
+    memcpy(Destination, Result.data(), Result.size() * sizeof(uint32_t));
+    if (ErrorOut)
+        *ErrorOut = Math::Sqrt(ResultError);
+    return (int)Result.size();
+}
+
+int MeshLod::BuildLods(mesh_lod* Lods, std::vector<uint32_t>& Indices, const std::vector<vertex_full>& Vertices)
+{
+    int IndexCount = (int)Indices.size();
+    int VertexCount = (int)Vertices.size();
+
+    Lods[0] = { 0, (uint32_t)IndexCount, 0.f, 0 };
+    if (IndexCount == 0)
+        return 1;
+
+    // Error limit relative to the mesh size
+    v3 Min = Vertices[0].Position;
+    v3 Max = Min;
+    for (const vertex_full& Vertex : Vertices)
+    {
+        Min = { Math::Min(Min.x, Vertex.Position.x), Math::Min(Min.y, Vertex.Position.y), Math::Min(Min.z, Vertex.Position.z) };
+        Max = { Math::Max(Max.x, Vertex.Position.x), Math::Max(Max.y, Vertex.Position.y), Math::Max(Max.z, Vertex.Position.z) };
+    }
+    float TargetError = Vec3::Length(Max - Min) * 0.5f * MESH_LOD_TARGET_ERROR;
+
+    std::vector<uint32_t> Previous(Indices);
+    std::vector<uint32_t> Lod(IndexCount);
+    std::vector<int> Clusters;
+    int LodCount = 1;
+    while (LodCount < MESH_MAX_LODS)
+    {
+        int PreviousCount = (int)Previous.size();
+        int TargetCount = PreviousCount / 6 * 3;
+
+        float Error = 0.f;
+        int LodIndexCount = Simplify(Lod.data(), Previous.data(), PreviousCount, Vertices.data(), VertexCount, TargetCount, TargetError, &Error);
+
+        // Stop when the mesh cannot be simplified much more
+        if (LodIndexCount == 0 || LodIndexCount > PreviousCount * 3 / 4)
+            break;
+
+        Previous.resize(LodIndexCount);
+        MeshOptimizer::OptimizeVertexCache(Previous.data(), Lod.data(), LodIndexCount, VertexCount, VERTEX_CACHE_SIZE, &Clusters);
+
+        // Errors are measured against the previous level, accumulate them to get the error against LOD 0
+        Lods[LodCount] = { (uint32_t)Indices.size(), (uint32_t)LodIndexCount, Lods[LodCount - 1].Error + Error, 0 };
+        Indices.insert(Indices.end(), Previous.begin(), Previous.end());
+        LodCount++;
+    }
+
+    return LodCount;
+}
+
+float MeshLod::GetProjectionScale(const mat4& ProjectionMatrix, float ViewportHeight)
+{
+    // ProjectionMatrix[1][1] = 1 / tan(FovY / 2)
+    return ProjectionMatrix.c[1].e[1] * ViewportHeight * 0.5f;
+}
+
+int MeshLod::SelectLod(const mesh_lod* Lods, int LodCount, float Distance, float ObjectScale, float ProjectionScale, float MaxPixelError)
+{
+    if (Distance <= 0.f)
+        return 0;
+
+    int Selected = 0;
+    for (int i = 1; i < LodCount; ++i)
+    {
+        float PixelError = Lods[i].Error * ObjectScale / Distance * ProjectionScale;
+        if (PixelError > MaxPixelError)
+            break;
+        Selected = i;
+    }
+    return Selected;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+// Level of details generated with quadric error metrics (Garland & Heckbert 1997).
+// Edges are collapsed onto one of their vertices, so every LOD is an index buffer referencing the same vertex buffer.
+// Vertices on attribute seams (same position, different attributes) are locked, borders can only collapse along themselves.
+
+const int MESH_MAX_LODS = 5;
+const float MESH_LOD_TARGET_ERROR = 0.05f; // Max error of the last LOD, relative to the mesh radius
+const float MESH_LOD_MAX_PIXEL_ERROR = 1.f; // Default screen space error of the LOD selection
+
+// Same layout in the mesh cache file
+struct mesh_lod
+{
+    uint32_t IndexOffset; // First index in the mesh index buffer
+    uint32_t IndexCount;
+    float Error; // Geometric error in object space
+    uint32_t Padding;
+};
+
+namespace MeshLod
+{
+// Returns the index count written in Destination (can alias Indices), ErrorOut receives the geometric error
+int Simplify(uint32_t* Destination, const uint32_t* Indices, int IndexCount, const vertex_full* Vertices, int VertexCount, int TargetIndexCount, float TargetError, float* ErrorOut);
+
+// Indices holds LOD 0 and receives the other levels after it (each level has half the triangles of the previous one).
+// Returns the number of LODs (LOD 0 included)
+int BuildLods(mesh_lod* Lods, std::vector<uint32_t>& Indices, const std::vector<vertex_full>& Vertices);
+
+// Pixels per object space unit at distance 1
+float GetProjectionScale(const mat4& ProjectionMatrix, float ViewportHeight);
+
+// Coarsest LOD with a projected error below MaxPixelError (Distance and ObjectScale are in world units)
+int SelectLod(const mesh_lod* Lods, int LodCount, float Distance, float ObjectScale, float ProjectionScale, float MaxPixelError = MESH_LOD_MAX_PIXEL_ERROR);
+}
@@ -0,0 +1,286 @@
+#include <algorithm>
+
+#include "maths.h"
+
+#include "mesh_optimizer.h"
+
+// FIFO cache simulated with timestamps: a vertex is in cache if less than CacheSize misses happened since it was loaded
+struct vertex_cache
+{
+    std::vector<uint32_t> LoadTime;
+    uint32_t Timestamp;
+    uint32_t CacheSize;
+};
+
+static void InitCache(vertex_cache* Cache, int VertexCount, int CacheSize)
+{
+    Cache->LoadTime.assign(VertexCount, 0);
+    Cache->CacheSize = (uint32_t)CacheSize;
+    Cache->Timestamp = Cache->CacheSize + 1;
+}
+
+static void FlushCache(vertex_cache* Cache)
+{
+    Cache->Timestamp += Cache->CacheSize + 1;
+}
+
+// Returns the number of cache misses
+static int TransformVertex(vertex_cache* Cache, uint32_t Vertex)
+{
+    if (Cache->Timestamp - Cache->LoadTime[Vertex] > Cache->CacheSize)
+    {
+        Cache->LoadTime[Vertex] = Cache->Timestamp++;
+        return 1;
+    }
+    return 0;
+}
+
+static int TransformTriangle(vertex_cache* Cache, const uint32_t* Triangle)
+{
+    return TransformVertex(Cache, Triangle[0]) + TransformVertex(Cache, Triangle[1]) + TransformVertex(Cache, Triangle[2]);
+}
+
+vertex_cache_stats MeshOptimizer::AnalyzeVertexCache(const uint32_t* Indices, int IndexCount, int VertexCount, int CacheSize)
+{
+    vertex_cache_stats Stats = {};
+    if (IndexCount == 0)
+        return Stats;
+
+    vertex_cache Cache;
+    InitCache(&Cache, VertexCount, CacheSize);
+
+    std::vector<uint8_t> Used(VertexCount, 0);
+    int UsedCount = 0;
+    int Misses = 0;
+    for (int i = 0; i < IndexCount; ++i)
+    {
+        Misses += TransformVertex(&Cache, Indices[i]);
+        UsedCount += Used[Indices[i]] ? 0 : 1;
+        Used[Indices[i]] = 1;
+    }
+
+    Stats.ACMR = (float)Misses / (float)(IndexCount / 3);
+    Stats.ATVR = (float)Misses / (float)UsedCount;
+    return Stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32_t* Destination, const uint32_t* Indices, int IndexCount, int VertexCount, int CacheSize, std::vector<int>* Clusters)
+{
+    int TriangleCount = IndexCount / 3;
+    Clusters->clear();
+
+    // Vertex to triangles adjacency
+    std::vector<int> LiveTriangles(VertexCount, 0);
+    for (int i = 0; i < IndexCount; ++i)
+        LiveTriangles[Indices[i]]++;
+
+    std::vector<int> AdjacencyOffsets(VertexCount + 1, 0);
+    for (int i = 0; i < VertexCount; ++i)
+        AdjacencyOffsets[i + 1] = AdjacencyOffsets[i] + LiveTriangles[i];
+
+    std::vector<int> Adjacency(IndexCount);
+    {
+        std::vector<int> Fill(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+        for (int i = 0; i < IndexCount; ++i)
+            Adjacency[Fill[Indices[i]]++] = i / 3;
+    }
+
+    std::vector<uint8_t> Emitted(TriangleCount, 0);
+    std::vector<uint32_t> DeadEndStack;
+    DeadEndStack.reserve(IndexCount);
+    std::vector<uint32_t> Candidates;
+
+    vertex_cache Cache;
+    InitCache(&Cache, VertexCount, CacheSize);
+
+    int Cursor = 0; // Next vertex to scan when the dead end stack is empty
+    int OutputTriangles = 0;
+    int Fanning = -1;
+    while (OutputTriangles < TriangleCount)
+    {
+        if (Fanning < 0)
+        {
+            // Dead end: restart from a recently used vertex or the next live vertex in input order
+            while (!DeadEndStack.empty() && Fanning < 0)
+            {
+                uint32_t Vertex = DeadEndStack.back();
+                DeadEndStack.pop_back();
+                if (LiveTriangles[Vertex] > 0)
+                    Fanning = (int)Vertex;
+            }
+            while (Fanning < 0 && Cursor < VertexCount)
+            {
+                if (LiveTriangles[Cursor] > 0)
+                    Fanning = Cursor;
+                else
+                    Cursor++;
+            }
+            Clusters->push_back(OutputTriangles);
+        }
+
+        // Emit all remaining triangles around the fanning vertex
+        Candidates.clear();
+        for (int i = AdjacencyOffsets[Fanning]; i < AdjacencyOffsets[Fanning + 1]; ++i)
+        {
+            int Triangle = Adjacency[i];
+            if (Emitted[Triangle])
+                continue;
+
+            for (int j = 0; j < 3; ++j)
+            {
+                uint32_t Vertex = Indices[Triangle * 3 + j];
+                Destination[OutputTriangles * 3 + j] = Vertex;
+                DeadEndStack.push_back(Vertex);
+                Candidates.push_back(Vertex);
+                LiveTriangles[Vertex]--;
+                TransformVertex(&Cache, Vertex);
+            }
+            Emitted[Triangle] = 1;
+            OutputTriangles++;
+        }
+
+        // Next fanning vertex: the oldest candidate still in cache after its own fan is emitted
+        int Best = -1;
+        int BestPriority = -1;
+        for (uint32_t Vertex : Candidates)
+        {
+            if (LiveTriangles[Vertex] == 0)
+                continue;
+
+            int Age = (int)(Cache.Timestamp - Cache.LoadTime[Vertex]);
+            int Priority = (Age + 2 * LiveTriangles[Vertex] <= CacheSize) ? Age : 0;
+            if (Priority > BestPriority)
+            {
+                Best = (int)Vertex;
+                BestPriority = Priority;
+            }
+        }
+        Fanning = Best;
+    }
+}
+
+void MeshOptimizer::OptimizeOverdraw(uint32_t* Destination, const uint32_t* Indices, int IndexCount, const vertex_full* Vertices, int VertexCount, const std::vector<int>& Clusters, int CacheSize, float Threshold)
+{
+    int TriangleCount = IndexCount / 3;
+    if (TriangleCount == 0)
+        return;
+
+    // Split clusters as long as the local ACMR stays close to the mesh ACMR
+    vertex_cache Cache;
+    InitCache(&Cache, VertexCount, CacheSize);
+
+    int MeshMisses = 0;
+    for (int i = 0; i < TriangleCount; ++i)
+        MeshMisses += TransformTriangle(&Cache, &Indices[i * 3]);
+    float ClusterThreshold = Threshold * (float)MeshMisses / (float)TriangleCount;
+
+    std::vector<int> SoftClusters;
+    for (int i = 0; i < (int)Clusters.size(); ++i)
+    {
+        int End = (i + 1 < (int)Clusters.size()) ? Clusters[i + 1] : TriangleCount;
+        int Start = Clusters[i];
+        int Misses = 0;
+
+        SoftClusters.push_back(Start);
+        FlushCache(&Cache);
+        for (int Triangle = Start; Triangle < End; ++Triangle)
+        {
+            Misses += TransformTriangle(&Cache, &Indices[Triangle * 3]);
+            if (Triangle + 1 < End && (float)Misses <= ClusterThreshold * (float)(Triangle + 1 - Start))
+            {
+                Start = Triangle + 1;
+                Misses = 0;
+                SoftClusters.push_back(Start);
+                FlushCache(&Cache);
+            }
+        }
+    }
+
+    // Sort key: clusters on the outside facing away from the mesh center are more likely to occlude the others
+    int ClusterCount = (int)SoftClusters.size();
+    std::vector<v3> Centroids(ClusterCount);
+    std::vector<v3> Normals(ClusterCount);
+    v3 MeshCentroid = {};
+    float MeshArea = 0.f;
+    for (int i = 0; i < ClusterCount; ++i)
+    {
+        int End = (i + 1 < ClusterCount) ? SoftClusters[i + 1] : TriangleCount;
+        v3 Centroid = {};
+        v3 Normal = {};
+        float Area = 0.f;
+        for (int Triangle = SoftClusters[i]; Triangle < End; ++Triangle)
+        {
+            v3 P0 = Vertices[Indices[Triangle * 3 + 0]].Position;
+            v3 P1 = Vertices[Indices[Triangle * 3 + 1]].Position;
+            v3 P2 = Vertices[Indices[Triangle * 3 + 2]].Position;
+            v3 TriangleNormal = Vec3::Cross(P1 - P0, P2 - P0);
+            float TriangleArea = Vec3::Length(TriangleNormal);
+
+            Centroid += (P0 + P1 + P2) * (TriangleArea / 3.f);
+            Normal += TriangleNormal;
+            Area += TriangleArea;
+        }
+
+        MeshCentroid += Centroid;
+        MeshArea += Area;
+        Centroids[i] = Area > 0.f ? Centroid / Area : Centroid;
+        Normals[i] = Normal;
+    }
+    if (MeshArea > 0.f)
+        MeshCentroid /= MeshArea;
+
+    std::vector<float> SortKeys(ClusterCount);
+    for (int i = 0; i < ClusterCount; ++i)
+    {
+        float NormalLength = Vec3::Length(Normals[i]);
+        SortKeys[i] = NormalLength > 0.f ? Vec3::Dot(Centroids[i] - MeshCentroid, Normals[i]) / NormalLength : 0.f;
+    }
+
+    std::vector<int> Order(ClusterCount);
+    for (int i = 0; i < ClusterCount; ++i)
+        Order[i] = i;
+    std::stable_sort(Order.begin(), Order.end(), [&](int A, int B) { return SortKeys[A] > SortKeys[B]; });
+
+    int OutputIndex = 0;
+    for (int Cluster : Order)
+    {
+        int Begin = SoftClusters[Cluster] * 3;
+        int End = (Cluster + 1 < ClusterCount) ? SoftClusters[Cluster + 1] * 3 : IndexCount;
+        for (int i = Begin; i < End; ++i)
+            Destination[OutputIndex++] = Indices[i];
+    }
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<vertex_full>& Vertices, std::vector<uint32_t>& Indices)
+{
+    std::vector<uint32_t> Remap(Vertices.size(), UINT32_MAX);
+    std::vector<vertex_full> Reordered;
+    Reordered.reserve(Vertices.size());
+
+    for (uint32_t& Index : Indices)
+    {
+        if (Remap[Index] == UINT32_MAX)
+        {
+            Remap[Index] = (uint32_t)Reordered.size();
+            Reordered.push_back(Vertices[Index]);
+        }
+        Index = Remap[Index];
+    }
+
+    // Unreferenced vertices are dropped
+    Vertices.swap(Reordered);
+}
+
+void MeshOptimizer::Optimize(std::vector<vertex_full>& Vertices, std::vector<uint32_t>& Indices)
+{
+    int IndexCount = (int)Indices.size();
+    int VertexCount = (int)Vertices.size();
+    if (IndexCount == 0)
+        return;
+
+    std::vector<uint32_t> Reordered(IndexCount);
+    std::vector<int> Clusters;
+    OptimizeVertexCache(Reordered.data(), Indices.data(), IndexCount, VertexCount, VERTEX_CACHE_SIZE, &Clusters);
+    OptimizeOverdraw(Indices.data(), Reordered.data(), IndexCount, Vertices.data(), VertexCount, Clusters, VERTEX_CACHE_SIZE, OVERDRAW_THRESHOLD);
+    OptimizeVertexFetch(Vertices, Indices);
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+// Index/vertex reordering passes run once when the mesh cache is built:
+// - Vertex cache: Tipsify (Sander et al. 2007), triangles are fanned around vertices using a FIFO cache model
+// - Overdraw: Tipsify clusters are split where the cache efficiency allows it, then sorted front to back
+//   with a view independent heuristic (clusters facing away from the mesh center first)
+// - Vertex fetch: vertices are renumbered in the order of first use
+
+const int VERTEX_CACHE_SIZE = 16; // FIFO entries of the simulated post-transform cache
+const float OVERDRAW_THRESHOLD = 1.05f; // Max ACMR degradation allowed by the overdraw pass
+
+struct vertex_cache_stats
+{
+    float ACMR; // Average cache miss ratio (transformed vertices per triangle, 0.5 is optimal on a regular grid)
+    float ATVR; // Average transformed vertex ratio (transformed vertices per vertex, 1.0 is optimal)
+};
+
+namespace MeshOptimizer
+{
+vertex_cache_stats AnalyzeVertexCache(const uint32_t* Indices, int IndexCount, int VertexCount, int CacheSize = VERTEX_CACHE_SIZE);
+
+// Triangle reordering, Destination must not alias Indices. Clusters receives the first triangle of each fan sequence.
+void OptimizeVertexCache(uint32_t* Destination, const uint32_t* Indices, int IndexCount, int VertexCount, int CacheSize, std::vector<int>* Clusters);
+void OptimizeOverdraw(uint32_t* Destination, const uint32_t* Indices, int IndexCount, const vertex_full* Vertices, int VertexCount, const std::vector<int>& Clusters, int CacheSize, float Threshold);
+void OptimizeVertexFetch(std::vector<vertex_full>& Vertices, std::vector<uint32_t>& Indices);
+
+// Run all passes
+void Optimize(std::vector<vertex_full>& Vertices, std::vector<uint32_t>& Indices);
+}
@@ -0,0 +1,280 @@
+#include <algorithm>
+
+#include "maths.h"
+
+#include "meshlet.h"
+
+// Meshlets with a wider normal spread are never backface culled (the cone would almost never be visible from behind)
+const float MESHLET_MIN_CONE_DOT = 0.1f;
+
+static v3 GetTriangleNormal(const vertex_full* Vertices, const uint32_t* Triangle)
+{
+    v3 P0 = Vertices[Triangle[0]].Position;
+    v3 P1 = Vertices[Triangle[1]].Position;
+    v3 P2 = Vertices[Triangle[2]].Position;
+    return Vec3::Cross(P1 - P0, P2 - P0);
+}
+
+static v3 GetTriangleCentroid(const vertex_full* Vertices, const uint32_t* Triangle)
+{
+    return (Vertices[Triangle[0]].Position + Vertices[Triangle[1]].Position + Vertices[Triangle[2]].Position) / 3.f;
+}
+
+// Bounding sphere (centered on the bounding box) and normal cone of a meshlet stored in Indices
+static void ComputeBounds(meshlet* Meshlet, const uint32_t* Indices, const vertex_full* Vertices)
+{
+    const uint32_t* Begin = Indices + Meshlet->IndexOffset;
+    const uint32_t* End = Begin + Meshlet->IndexCount;
+
+    v3 Min = Vertices[Begin[0]].Position;
+    v3 Max = Min;
+    for (const uint32_t* Index = Begin; Index != End; ++Index)
+    {
+        v3 P = Vertices[*Index].Position;
+        Min = { Math::Min(Min.x, P.x), Math::Min(Min.y, P.y), Math::Min(Min.z, P.z) };
+        Max = { Math::Max(Max.x, P.x), Math::Max(Max.y, P.y), Math::Max(Max.z, P.z) };
+    }
+
+    Meshlet->Center = (Min + Max) * 0.5f;
+    Meshlet->Radius = 0.f;
+    for (const uint32_t* Index = Begin; Index != End; ++Index)
+        Meshlet->Radius = Math::Max(Meshlet->Radius, Vec3::Length(Vertices[*Index].Position - Meshlet->Center));
+
+    // Cone axis: average of the triangle normals, the cone angle is given by the normal furthest from the axis
+    v3 Axis = {};
+    for (const uint32_t* Triangle = Begin; Triangle != End; Triangle += 3)
+    {
+        v3 Normal = GetTriangleNormal(Vertices, Triangle);
+        float Length = Vec3::Length(Normal);
+        if (Length > 0.f)
+            Axis += Normal / Length;
+    }
+
+    Meshlet->ConeAxis = {};
+    Meshlet->ConeCutoff = 1.f;
+
+    float AxisLength = Vec3::Length(Axis);
+    if (AxisLength == 0.f)
+        return;
+    Axis /= AxisLength;
+
+    float MinDot = 1.f;
+    for (const uint32_t* Triangle = Begin; Triangle != End; Triangle += 3)
+    {
+        v3 Normal = GetTriangleNormal(Vertices, Triangle);
+        float Length = Vec3::Length(Normal);
+        if (Length > 0.f)
+            MinDot = Math::Min(MinDot, Vec3::Dot(Axis, Normal) / Length);
+    }
+
+    if (MinDot <= MESHLET_MIN_CONE_DOT)
+        return;
+
+    // Backfacing when the view direction is within the complementary angle of the cone: cos(90 - angle) = sin(angle)
+    Meshlet->ConeAxis = Axis;
+    Meshlet->ConeCutoff = Math::Sqrt(1.f - MinDot * MinDot);
+}
+
+void Meshlet::Build(std::vector<meshlet>* Meshlets, std::vector<uint32_t>& Indices, const std::vector<vertex_full>& Vertices, int MaxVertices, int MaxTriangles)
+{
+    Meshlets->clear();
+
+    int IndexCount = (int)Indices.size();
+    int VertexCount = (int)Vertices.size();
+    int TriangleCount = IndexCount / 3;
+    if (TriangleCount == 0)
+        return;
+
+    // Vertex to triangles adjacency
+    std::vector<int> AdjacencyOffsets(VertexCount + 1, 0);
+    for (int i = 0; i < IndexCount; ++i)
+        AdjacencyOffsets[Indices[i] + 1]++;
+    for (int i = 0; i < VertexCount; ++i)
+        AdjacencyOffsets[i + 1] += AdjacencyOffsets[i];
+
+    std::vector<int> Adjacency(IndexCount);
+    {
+        std::vector<int> Fill(AdjacencyOffsets.begin(), AdjacencyOffsets.end() - 1);
+        for (int i = 0; i < IndexCount; ++i)
+            Adjacency[Fill[Indices[i]]++] = i / 3;
+    }
+
+    std::vector<uint32_t> Reordered;
+    Reordered.reserve(IndexCount);
+
+    std::vector<uint8_t> Emitted(TriangleCount, 0);
+    std::vector<int> VertexMeshlet(VertexCount, -1); // Meshlet using the vertex (to count new vertices)
+    std::vector<uint32_t> MeshletVertices;
+    std::vector<int> MeshletTriangles;
+    v3 MeshletMin = {};
+    v3 MeshletMax = {};
+
+    int Cursor = 0; // Next triangle in input order (seed of the next meshlet)
+    int EmittedCount = 0;
+
+    auto CountNewVertices = [&](int Triangle)
+    {
+        int MeshletIndex = (int)Meshlets->size();
+        const uint32_t* Vertex = &Indices[Triangle * 3];
+        return (VertexMeshlet[Vertex[0]] != MeshletIndex)
+             + (VertexMeshlet[Vertex[1]] != MeshletIndex && Vertex[1] != Vertex[0])
+             + (VertexMeshlet[Vertex[2]] != MeshletIndex && Vertex[2] != Vertex[0] && Vertex[2] != Vertex[1]);
+    };
+
+    auto FlushMeshlet = [&]()
+    {
+        // Keep input order inside the meshlet (vertex cache locality from MeshOptimizer)
+        std::sort(MeshletTriangles.begin(), MeshletTriangles.end());
+
+        meshlet Meshlet = {};
+        Meshlet.IndexOffset = (uint32_t)Reordered.size();
+        Meshlet.IndexCount = (uint32_t)MeshletTriangles.size() * 3;
+        Meshlet.VertexCount = (uint32_t)MeshletVertices.size();
+        for (int Triangle : MeshletTriangles)
+            Reordered.insert(Reordered.end(), &Indices[Triangle * 3], &Indices[Triangle * 3 + 3]);
+        Meshlets->push_back(Meshlet);
+
+        MeshletVertices.clear();
+        MeshletTriangles.clear();
+    };
+
+    while (EmittedCount < TriangleCount)
+    {
+        // Best adjacent triangle: fewest new vertices, then input order
+        int Best = -1;
+        int BestNewVertices = 4;
+        for (uint32_t Vertex : MeshletVertices)
+        {
+            for (int i = AdjacencyOffsets[Vertex]; i < AdjacencyOffsets[Vertex + 1] && BestNewVertices > 0; ++i)
+            {
+                int Triangle = Adjacency[i];
+                if (Emitted[Triangle])
+                    continue;
+
+                int NewVertices = CountNewVertices(Triangle);
+                if (NewVertices < BestNewVertices || (NewVertices == BestNewVertices && Triangle < Best))
+                {
+                    Best = Triangle;
+                    BestNewVertices = NewVertices;
+                }
+            }
+            if (BestNewVertices == 0)
+                break;
+        }
+
+        // No connected triangle left: continue with the next triangle in input order if it is close to the meshlet
+        if (Best < 0)
+        {
+            while (Emitted[Cursor])
+                Cursor++;
+
+            if (!MeshletTriangles.empty())
+            {
+                v3 Center = (MeshletMin + MeshletMax) * 0.5f;
+                float Radius = Vec3::Length(MeshletMax - MeshletMin) * 0.5f;
+                bool IsClose = Vec3::Length(GetTriangleCentroid(Vertices.data(), &Indices[Cursor * 3]) - Center) <= 2.f * Radius;
+                if (!IsClose || (int)MeshletTriangles.size() >= MaxTriangles / 2)
+                {
+                    FlushMeshlet();
+                    continue;
+                }
+            }
+
+            Best = Cursor;
+            BestNewVertices = CountNewVertices(Best);
+        }
+
+        if ((int)MeshletVertices.size() + BestNewVertices > MaxVertices || (int)MeshletTriangles.size() + 1 > MaxTriangles)
+        {
+            FlushMeshlet();
+            continue;
+        }
+
+        // Add triangle
+        int MeshletIndex = (int)Meshlets->size();
+        if (MeshletTriangles.empty())
+            MeshletMin = MeshletMax = Vertices[Indices[Best * 3]].Position;
+
+        for (int j = 0; j < 3; ++j)
+        {
+            uint32_t Vertex = Indices[Best * 3 + j];
+            if (VertexMeshlet[Vertex] != MeshletIndex)
+            {
+                VertexMeshlet[Vertex] = MeshletIndex;
+                MeshletVertices.push_back(Vertex);
+            }
+
+            v3 P = Vertices[Vertex].Position;
+            MeshletMin = { Math::Min(MeshletMin.x, P.x), Math::Min(MeshletMin.y, P.y), Math::Min(MeshletMin.z, P.z) };
+            MeshletMax = { Math::Max(MeshletMax.x, P.x), Math::Max(MeshletMax.y, P.y), Math::Max(MeshletMax.z, P.z) };
+        }
+        MeshletTriangles.push_back(Best);
+        Emitted[Best] = 1;
+        EmittedCount++;
+    }
+
+    if (!MeshletTriangles.empty())
+        FlushMeshlet();
+
+    Indices.swap(Reordered);
+
+    for (meshlet& Meshlet : *Meshlets)
+        ComputeBounds(&Meshlet, Indices.data(), Vertices.data());
+}
+
+meshlet_cull_stats Meshlet::Cull(std::vector<draw_range>* Ranges, const meshlet* Meshlets, int MeshletCount, const mat4& ModelViewProj, v3 ViewPosition, bool BackfaceCulling)
+{
+    meshlet_cull_stats Stats = {};
+    Ranges->clear();
+
+    // Frustum planes in model space (Gribb/Hartmann), normalized so distances can be compared with radiuses
+    v4 Planes[6];
+    for (int i = 0; i < 3; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            float Row3 = ModelViewProj.c[j].e[3];
+            float Row = ModelViewProj.c[j].e[i];
+            Planes[i * 2 + 0].e[j] = Row3 + Row;
+            Planes[i * 2 + 1].e[j] = Row3 - Row;
+        }
+    }
+    for (v4& Plane : Planes)
+    {
+        float Length = Vec3::Length(Plane.xyz);
+        if (Length > 0.f)
+            Plane /= Length;
+    }
+
+    for (int i = 0; i < MeshletCount; ++i)
+    {
+        const meshlet& Meshlet = Meshlets[i];
+
+        bool Inside = true;
+        for (int p = 0; p < 6 && Inside; ++p)
+            Inside = Vec3::Dot(Planes[p].xyz, Meshlet.Center) + Planes[p].w >= -Meshlet.Radius;
+        if (!Inside)
+        {
+            Stats.FrustumCulled++;
+            continue;
+        }
+
+        if (BackfaceCulling)
+        {
+            v3 ViewToCenter = Meshlet.Center - ViewPosition;
+            if (Vec3::Dot(ViewToCenter, Meshlet.ConeAxis) >= Meshlet.ConeCutoff * Vec3::Length(ViewToCenter) + Meshlet.Radius)
+            {
+                Stats.BackfaceCulled++;
+                continue;
+            }
+        }
+
+        Stats.Visible++;
+        if (!Ranges->empty() && Ranges->back().IndexOffset + Ranges->back().IndexCount == Meshlet.IndexOffset)
+            Ranges->back().IndexCount += Meshlet.IndexCount;
+        else
+            Ranges->push_back({ Meshlet.IndexOffset, Meshlet.IndexCount });
+    }
+
+    return Stats;
+}
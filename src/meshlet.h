@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+// Meshlets: small clusters of triangles stored as contiguous ranges of the index buffer.
+// Each meshlet has a bounding sphere and a normal cone, so whole clusters can be culled on the cpu
+// (frustum and backface) before drawing the visible index ranges.
+
+const int MESHLET_MAX_VERTICES  = 64;
+const int MESHLET_MAX_TRIANGLES = 124;
+
+// Same layout in the mesh cache file
+struct meshlet
+{
+    uint32_t IndexOffset; // First index in the mesh index buffer
+    uint32_t IndexCount;
+    uint32_t VertexCount; // Unique vertices referenced by the meshlet
+    uint32_t Padding;
+
+    // Bounding sphere
+    v3 Center;
+    float Radius;
+
+    // Normal cone: the meshlet is backfacing when dot(Center - Eye, ConeAxis) >= ConeCutoff * length(Center - Eye) + Radius
+    v3 ConeAxis;
+    float ConeCutoff; // 1 when the normals are too spread to cull
+};
+
+// Index range to draw
+struct draw_range
+{
+    uint32_t IndexOffset;
+    uint32_t IndexCount;
+};
+
+struct meshlet_cull_stats
+{
+    int Visible;
+    int FrustumCulled;
+    int BackfaceCulled;
+};
+
+namespace Meshlet
+{
+// Reorder the triangles of Indices so each meshlet is a contiguous range (triangles keep their relative order inside a meshlet)
+void Build(std::vector<meshlet>* Meshlets, std::vector<uint32_t>& Indices, const std::vector<vertex_full>& Vertices, int MaxVertices = MESHLET_MAX_VERTICES, int MaxTriangles = MESHLET_MAX_TRIANGLES);
+
+// Cull meshlets in model space (ModelViewProj is used to extract frustum planes, ViewPosition is the camera position in model space).
+// Ranges receives the visible index ranges, adjacent ranges are merged.
+meshlet_cull_stats Cull(std::vector<draw_range>* Ranges, const meshlet* Meshlets, int MeshletCount, const mat4& ModelViewProj, v3 ViewPosition, bool BackfaceCulling);
+}
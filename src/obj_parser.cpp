@@ -0,0 +1,1043 @@
+#include <algorithm>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "maths.h"
+#include "file.h"
+#include "jobs.h"
+
+#include "obj_parser.h"
+
+enum obj_attribute
+{
+    OBJ_POSITION,
+    OBJ_TEXCOORD,
+    OBJ_NORMAL,
+    OBJ_ATTRIBUTE_COUNT,
+};
+
+// Zero based indices, -1 when the attribute is absent
+struct obj_corner
+{
+    int Index[OBJ_ATTRIBUTE_COUNT];
+};
+
+// Negative OBJ indices are relative to the attribute count at this line,
+// they are resolved in the chunk and have to be offset by the chunk base once all chunks are parsed
+struct obj_fixup
+{
+    int Corner;
+    int Attribute;
+};
+
+struct obj_chunk
+{
+    const char* Begin;
+    const char* End;
+
+    std::vector<v3> Positions;
+    std::vector<v2> TexCoords;
+    std::vector<v3> Normals;
+    std::vector<obj_corner> Corners; // 3 per triangle
+    std::vector<obj_fixup> Fixups;
+    std::vector<int> ShapeStarts; // Corner count at each 'o'/'g' line
+    bool Supported;
+
+    // Filled by the prefix sums
+    int Base[OBJ_ATTRIBUTE_COUNT];
+    int CornerBase;
+};
+
+static bool IsSpace(char C)
+{
+    return C == ' ' || C == '\t';
+}
+
+static bool IsDigit(char C)
+{
+    return (unsigned int)(C - '0') < 10u;
+}
+
+// Same algorithm as tinyobj's tryParseDouble (results must be bit exact)
+static bool TryParseDouble(const char* S, const char* SEnd, double* Result)
+{
+    if (S >= SEnd)
+        return false;
+
+    double Mantissa = 0.0;
+    int Exponent = 0; // Base 2
+    char Sign = '+';
+    char ExpSign = '+';
+    const char* Curr = S;
+    int Read = 0;
+    bool EndNotReached = false;
+    bool LeadingDecimalDots = false;
+
+    if (*Curr == '+' || *Curr == '-')
+    {
+        Sign = *Curr;
+        Curr++;
+        if (Curr != SEnd && *Curr == '.')
+            LeadingDecimalDots = true;
+    }
+    else if (IsDigit(*Curr))
+    {
+    }
+    else if (*Curr == '.')
+    {
+        LeadingDecimalDots = true;
+    }
+    else
+    {
+        return false;
+    }
+
+    // Integer part
+    EndNotReached = (Curr != SEnd);
+    if (!LeadingDecimalDots)
+    {
+        while (EndNotReached && IsDigit(*Curr))
+        {
+            Mantissa *= 10;
+            Mantissa += (int)(*Curr - '0');
+            Curr++;
+            Read++;
+            EndNotReached = (Curr != SEnd);
+        }
+
+        if (Read == 0)
+            return false;
+    }
+
+    if (EndNotReached)
+    {
+        // Decimal part
+        if (*Curr == '.')
+        {
+            static const double PowLut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+            const int LutEntries = sizeof(PowLut) / sizeof(PowLut[0]);
+
+            Curr++;
+            Read = 1;
+            EndNotReached = (Curr != SEnd);
+            while (EndNotReached && IsDigit(*Curr))
+            {
+                Mantissa += (int)(*Curr - '0') * (Read < LutEntries ? PowLut[Read] : std::pow(10.0, -Read));
+                Read++;
+                Curr++;
+                EndNotReached = (Curr != SEnd);
+            }
+        }
+        else if (*Curr != 'e' && *Curr != 'E')
+        {
+            EndNotReached = false;
+        }
+
+        // Exponent part
+        if (EndNotReached && (*Curr == 'e' || *Curr == 'E'))
+        {
+            Curr++;
+            EndNotReached = (Curr != SEnd);
+            if (EndNotReached && (*Curr == '+' || *Curr == '-'))
+            {
+                ExpSign = *Curr;
+                Curr++;
+            }
+            else if (!EndNotReached || !IsDigit(*Curr))
+            {
+                return false; // Empty exponent
+            }
+
+            Read = 0;
+            EndNotReached = (Curr != SEnd);
+            while (EndNotReached && IsDigit(*Curr))
+            {
+                Exponent *= 10;
+                Exponent += (int)(*Curr - '0');
+                Curr++;
+                Read++;
+                EndNotReached = (Curr != SEnd);
+            }
+            Exponent *= (ExpSign == '+' ? 1 : -1);
+            if (Read == 0)
+                return false;
+        }
+    }
+
+    *Result = (Sign == '+' ? 1 : -1) * (Exponent ? std::ldexp(Mantissa * std::pow(5.0, Exponent), Exponent) : Mantissa);
+    return true;
+}
+
+static float ParseReal(const char** Token, const char* End)
+{
+    const char* Begin = *Token;
+    while (Begin < End && IsSpace(*Begin))
+        Begin++;
+
+    const char* TokenEnd = Begin;
+    while (TokenEnd < End && !IsSpace(*TokenEnd))
+        TokenEnd++;
+
+    double Value = 0.0;
+    TryParseDouble(Begin, TokenEnd, &Value);
+    *Token = TokenEnd;
+    return (float)Value;
+}
+
+// Behaves like atoi (the cursor is not moved)
+static int ParseInt(const char* Token, const char* End)
+{
+    while (Token < End && (IsSpace(*Token) || *Token == '\v' || *Token == '\f'))
+        Token++;
+
+    int Sign = 1;
+    if (Token < End && (*Token == '+' || *Token == '-'))
+    {
+        Sign = *Token == '-' ? -1 : 1;
+        Token++;
+    }
+
+    int Value = 0;
+    while (Token < End && IsDigit(*Token))
+    {
+        Value = Value * 10 + (*Token - '0');
+        Token++;
+    }
+    return Sign * Value;
+}
+
+static void SkipIndex(const char** Token, const char* End)
+{
+    while (*Token < End && **Token != '/' && !IsSpace(**Token))
+        (*Token)++;
+}
+
+// Returns false on 0 indices (tinyobj rejects the file)
+static bool FixIndex(int Index, int Count, int* Result, bool* Relative)
+{
+    if (Index > 0)
+    {
+        *Result = Index - 1;
+        *Relative = false;
+        return true;
+    }
+
+    if (Index == 0)
+        return false;
+
+    *Result = Count + Index;
+    *Relative = true;
+    return true;
+}
+
+// Parse i, i/j, i//k and i/j/k like tinyobj's parseTriple
+static bool ParseTriple(const char** Token, const char* End, const int* Counts, obj_corner* Corner, bool* Relative)
+{
+    *Corner = { { -1, -1, -1 } };
+    Relative[OBJ_POSITION] = Relative[OBJ_TEXCOORD] = Relative[OBJ_NORMAL] = false;
+
+    if (!FixIndex(ParseInt(*Token, End), Counts[OBJ_POSITION], &Corner->Index[OBJ_POSITION], &Relative[OBJ_POSITION]))
+        return false;
+
+    SkipIndex(Token, End);
+    if (*Token >= End || **Token != '/')
+        return true;
+    (*Token)++;
+
+    // i//k
+    if (*Token < End && **Token == '/')
+    {
+        (*Token)++;
+        if (!FixIndex(ParseInt(*Token, End), Counts[OBJ_NORMAL], &Corner->Index[OBJ_NORMAL], &Relative[OBJ_NORMAL]))
+            return false;
+        SkipIndex(Token, End);
+        return true;
+    }
+
+    // i/j or i/j/k
+    if (!FixIndex(ParseInt(*Token, End), Counts[OBJ_TEXCOORD], &Corner->Index[OBJ_TEXCOORD], &Relative[OBJ_TEXCOORD]))
+        return false;
+
+    SkipIndex(Token, End);
+    if (*Token >= End || **Token != '/')
+        return true;
+    (*Token)++;
+
+    if (!FixIndex(ParseInt(*Token, End), Counts[OBJ_NORMAL], &Corner->Index[OBJ_NORMAL], &Relative[OBJ_NORMAL]))
+        return false;
+    SkipIndex(Token, End);
+    return true;
+}
+
+// Returns false when the line cannot be handled here
+static bool ParseLine(obj_chunk* Chunk, const char* Token, const char* End)
+{
+    while (Token < End && IsSpace(*Token))
+        Token++;
+
+    if (Token == End || Token[0] == '#')
+        return true;
+
+    char C1 = (Token + 1 < End) ? Token[1] : '\0';
+    char C2 = (Token + 2 < End) ? Token[2] : '\0';
+
+    // Vertex (optional vertex colors are ignored)
+    if (Token[0] == 'v' && IsSpace(C1))
+    {
+        Token += 2;
+        v3 Position;
+        Position.x = ParseReal(&Token, End);
+        Position.y = ParseReal(&Token, End);
+        Position.z = ParseReal(&Token, End);
+        Chunk->Positions.push_back(Position);
+        return true;
+    }
+
+    if (Token[0] == 'v' && C1 == 'n' && IsSpace(C2))
+    {
+        Token += 3;
+        v3 Normal;
+        Normal.x = ParseReal(&Token, End);
+        Normal.y = ParseReal(&Token, End);
+        Normal.z = ParseReal(&Token, End);
+        Chunk->Normals.push_back(Normal);
+        return true;
+    }
+
+    if (Token[0] == 'v' && C1 == 't' && IsSpace(C2))
+    {
+        Token += 3;
+        v2 TexCoord;
+        TexCoord.x = ParseReal(&Token, End);
+        TexCoord.y = ParseReal(&Token, End);
+        Chunk->TexCoords.push_back(TexCoord);
+        return true;
+    }
+
+    // Lines and points are left to tinyobj
+    if ((Token[0] == 'l' || Token[0] == 'p') && IsSpace(C1))
+        return false;
+
+    if (Token[0] == 'f' && IsSpace(C1))
+    {
+        Token += 2;
+        while (Token < End && IsSpace(*Token))
+            Token++;
+
+        int Counts[OBJ_ATTRIBUTE_COUNT] = { (int)Chunk->Positions.size(), (int)Chunk->TexCoords.size(), (int)Chunk->Normals.size() };
+
+        obj_corner Face[3];
+        bool Relative[3][OBJ_ATTRIBUTE_COUNT];
+        int FaceVertices = 0;
+        while (Token < End)
+        {
+            // Polygons need tinyobj's triangulation
+            if (FaceVertices == 3)
+                return false;
+
+            if (!ParseTriple(&Token, End, Counts, &Face[FaceVertices], Relative[FaceVertices]))
+                return false;
+            FaceVertices++;
+
+            while (Token < End && IsSpace(*Token))
+                Token++;
+        }
+
+        // Degenerated faces are skipped
+        if (FaceVertices < 3)
+            return true;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            for (int Attribute = 0; Attribute < OBJ_ATTRIBUTE_COUNT; ++Attribute)
+            {
+                if (Relative[i][Attribute])
+                    Chunk->Fixups.push_back({ (int)Chunk->Corners.size(), Attribute });
+            }
+            Chunk->Corners.push_back(Face[i]);
+        }
+        return true;
+    }
+
+    // Objects and groups start a new shape (empty shapes are dropped when merging, like tinyobj)
+    if ((Token[0] == 'o' || Token[0] == 'g') && IsSpace(C1))
+    {
+        Chunk->ShapeStarts.push_back((int)Chunk->Corners.size());
+        return true;
+    }
+
+    // Other commands (materials, smoothing groups...) do not change the vertex soup
+    return true;
+}
+
+static void ParseChunk(obj_chunk* Chunk)
+{
+    Chunk->Supported = true;
+
+    const char* Cursor = Chunk->Begin;
+    while (Cursor < Chunk->End)
+    {
+        // Like tinyobj, '\n', '\r\n' and '\r' end lines
+        const char* LineEnd = Cursor;
+        while (LineEnd < Chunk->End && *LineEnd != '\n' && *LineEnd != '\r')
+            LineEnd++;
+
+        if (!ParseLine(Chunk, Cursor, LineEnd))
+        {
+            Chunk->Supported = false;
+            return;
+        }
+
+        Cursor = LineEnd + 1;
+    }
+}
+
+template<typename T>
+static const T* GetAttribute(const std::vector<T>& Attributes, int Index)
+{
+    return (Index >= 0 && Index < (int)Attributes.size()) ? &Attributes[Index] : nullptr;
+}
+
+bool ObjParser::Parse(std::vector<vertex_full>& Soup, bool* HasNormals, bool* HasTexCoords, const char* Filename, std::vector<uint32_t>* ShapeOffsets)
+{
+    auto StartTime = std::chrono::steady_clock::now();
+
+    file_mapping Mapping;
+    if (!File::Map(&Mapping, Filename))
+        return false;
+
+    const char* Data = (const char*)Mapping.Data;
+    size_t Size = Mapping.Size;
+
+    // Split in line-aligned chunks (a few per thread to balance the work)
+    const size_t MinChunkSize = 256 * 1024;
+    int ChunkCount = (int)(Size / MinChunkSize);
+    if (ChunkCount > Jobs::GetWorkerCount() * 4)
+        ChunkCount = Jobs::GetWorkerCount() * 4;
+    if (ChunkCount < 1)
+        ChunkCount = 1;
+
+    std::vector<obj_chunk> Chunks(ChunkCount);
+    size_t ChunkBegin = 0;
+    for (int i = 0; i < ChunkCount; ++i)
+    {
+        size_t ChunkEnd = (i == ChunkCount - 1) ? Size : Size / ChunkCount * (i + 1);
+        if (ChunkEnd < ChunkBegin)
+            ChunkEnd = ChunkBegin;
+        while (ChunkEnd < Size && ChunkEnd > 0 && Data[ChunkEnd - 1] != '\n' && Data[ChunkEnd - 1] != '\r')
+            ChunkEnd++;
+
+        Chunks[i].Begin = Data + ChunkBegin;
+        Chunks[i].End = Data + ChunkEnd;
+        ChunkBegin = ChunkEnd;
+    }
+
+    Jobs::ParallelFor(ChunkCount, [&](int i) { ParseChunk(&Chunks[i]); });
+
+    // Prefix sums to get chunk offsets in the merged arrays
+    int Totals[OBJ_ATTRIBUTE_COUNT] = {};
+    int CornerCount = 0;
+    bool Supported = true;
+    for (obj_chunk& Chunk : Chunks)
+    {
+        Supported &= Chunk.Supported;
+        Chunk.Base[OBJ_POSITION] = Totals[OBJ_POSITION];
+        Chunk.Base[OBJ_TEXCOORD] = Totals[OBJ_TEXCOORD];
+        Chunk.Base[OBJ_NORMAL]   = Totals[OBJ_NORMAL];
+        Chunk.CornerBase = CornerCount;
+        Totals[OBJ_POSITION] += (int)Chunk.Positions.size();
+        Totals[OBJ_TEXCOORD] += (int)Chunk.TexCoords.size();
+        Totals[OBJ_NORMAL]   += (int)Chunk.Normals.size();
+        CornerCount += (int)Chunk.Corners.size();
+    }
+
+    if (!Supported)
+    {
+        File::Unmap(&Mapping);
+        return false;
+    }
+
+    // Merge attributes and resolve relative indices
+    std::vector<v3> Positions(Totals[OBJ_POSITION]);
+    std::vector<v2> TexCoords(Totals[OBJ_TEXCOORD]);
+    std::vector<v3> Normals(Totals[OBJ_NORMAL]);
+    Jobs::ParallelFor(ChunkCount, [&](int i)
+    {
+        obj_chunk& Chunk = Chunks[i];
+        std::copy(Chunk.Positions.begin(), Chunk.Positions.end(), Positions.begin() + Chunk.Base[OBJ_POSITION]);
+        std::copy(Chunk.TexCoords.begin(), Chunk.TexCoords.end(), TexCoords.begin() + Chunk.Base[OBJ_TEXCOORD]);
+        std::copy(Chunk.Normals.begin(), Chunk.Normals.end(), Normals.begin() + Chunk.Base[OBJ_NORMAL]);
+
+        for (const obj_fixup& Fixup : Chunk.Fixups)
+            Chunk.Corners[Fixup.Corner].Index[Fixup.Attribute] += Chunk.Base[Fixup.Attribute];
+    });
+
+    // Build the vertex soup (out of bounds indices give zero attributes)
+    Soup.resize(CornerCount);
+    Jobs::ParallelFor(ChunkCount, [&](int i)
+    {
+        const obj_chunk& Chunk = Chunks[i];
+        for (int CornerId = 0; CornerId < (int)Chunk.Corners.size(); ++CornerId)
+        {
+            const obj_corner& Corner = Chunk.Corners[CornerId];
+            vertex_full V = {};
+            if (const v3* Position = GetAttribute(Positions, Corner.Index[OBJ_POSITION]))
+                V.Position = *Position;
+            if (const v3* Normal = GetAttribute(Normals, Corner.Index[OBJ_NORMAL]))
+                V.Normal = *Normal;
+            if (const v2* TexCoord = GetAttribute(TexCoords, Corner.Index[OBJ_TEXCOORD]))
+                V.UV = *TexCoord;
+            Soup[Chunk.CornerBase + CornerId] = V;
+        }
+    });
+
+    if (ShapeOffsets)
+    {
+        ShapeOffsets->assign(1, 0);
+        for (const obj_chunk& Chunk : Chunks)
+        {
+            for (int Start : Chunk.ShapeStarts)
+            {
+                uint32_t Offset = (uint32_t)(Chunk.CornerBase + Start);
+                if (Offset != ShapeOffsets->back() && Offset != (uint32_t)CornerCount)
+                    ShapeOffsets->push_back(Offset);
+            }
+        }
+    }
+
+    *HasNormals = !Normals.empty();
+    *HasTexCoords = !TexCoords.empty();
+
+    File::Unmap(&Mapping);
+
+    double Duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+    printf("Parsed %s: %d triangles in %.1f ms (%d chunks, %d threads)\n", Filename, CornerCount / 3, Duration, ChunkCount, Jobs::GetWorkerCount());
+    return true;
+}
+
+// Streaming (out-of-core) loader
+
+const size_t OBJ_STREAM_MIN_READ_BUFFER = 64 * 1024;
+const size_t OBJ_STREAM_MAX_READ_BUFFER = 16 * 1024 * 1024;
+const size_t OBJ_STREAM_SPILL_BUFFER = 1024 * 1024; // Per spilled table
+const size_t OBJ_STREAM_MIN_CHUNK_CORNERS = 3 * 1024;
+
+enum obj_line_type
+{
+    OBJ_LINE_OTHER,
+    OBJ_LINE_POSITION,
+    OBJ_LINE_TEXCOORD,
+    OBJ_LINE_NORMAL,
+    OBJ_LINE_FACE,
+};
+
+// Attribute table kept in memory, or written to a temporary file and mapped once complete
+template<typename T>
+struct obj_stream_table
+{
+    std::vector<T> Values;
+    std::string SpillFilename;
+    FILE* SpillFile;
+    file_mapping Mapping;
+
+    const T* Data;
+    int Count;
+};
+
+// Welding of the corners of a chunk (identical OBJ index triples share a vertex)
+struct obj_stream_key
+{
+    obj_corner Corner;
+    uint32_t Vertex; // UINT32_MAX when empty
+};
+
+// Skip the keyword, Token is moved to the first argument
+static obj_line_type GetLineType(const char** Token, const char* End)
+{
+    const char* Cursor = *Token;
+    while (Cursor < End && IsSpace(*Cursor))
+        Cursor++;
+
+    if (Cursor == End)
+        return OBJ_LINE_OTHER;
+
+    char C1 = (Cursor + 1 < End) ? Cursor[1] : '\0';
+    char C2 = (Cursor + 2 < End) ? Cursor[2] : '\0';
+
+    obj_line_type Type = OBJ_LINE_OTHER;
+    if (Cursor[0] == 'v' && IsSpace(C1))
+        Type = OBJ_LINE_POSITION;
+    else if (Cursor[0] == 'v' && C1 == 't' && IsSpace(C2))
+        Type = OBJ_LINE_TEXCOORD;
+    else if (Cursor[0] == 'v' && C1 == 'n' && IsSpace(C2))
+        Type = OBJ_LINE_NORMAL;
+    else if (Cursor[0] == 'f' && IsSpace(C1))
+        Type = OBJ_LINE_FACE;
+
+    *Token = Cursor + ((Type == OBJ_LINE_TEXCOORD || Type == OBJ_LINE_NORMAL) ? 3 : 2);
+    return Type;
+}
+
+// Number of corners of a face line
+static int CountFaceCorners(const char* Token, const char* End)
+{
+    int Count = 0;
+    while (Token < End)
+    {
+        while (Token < End && IsSpace(*Token))
+            Token++;
+        if (Token == End)
+            break;
+        Count++;
+        while (Token < End && !IsSpace(*Token))
+            Token++;
+    }
+    return Count;
+}
+
+// Read the file by blocks of Buffer.size() bytes and call Callback(LineBegin, LineEnd) on every line (stops when it returns false)
+template<typename F>
+static bool ForEachLine(const char* Filename, std::vector<char>& Buffer, F Callback)
+{
+    FILE* File = fopen(Filename, "rb");
+    if (File == nullptr)
+        return false;
+
+    bool Result = true;
+    size_t Used = 0;
+    for (;;)
+    {
+        size_t Read = fread(Buffer.data() + Used, 1, Buffer.size() - Used, File);
+        bool Last = (Read == 0);
+
+        const char* Cursor = Buffer.data();
+        const char* End = Cursor + Used + Read;
+        while (Cursor < End)
+        {
+            // Like tinyobj, '\n', '\r\n' and '\r' end lines
+            const char* LineEnd = Cursor;
+            while (LineEnd < End && *LineEnd != '\n' && *LineEnd != '\r')
+                LineEnd++;
+
+            // Incomplete line, continued in the next block
+            if (LineEnd == End && !Last)
+                break;
+
+            if (!Callback(Cursor, LineEnd))
+            {
+                fclose(File);
+                return false;
+            }
+            Cursor = LineEnd + 1;
+        }
+
+        if (Last)
+            break;
+
+        Used = (Cursor < End) ? (size_t)(End - Cursor) : 0;
+        memmove(Buffer.data(), Cursor, Used);
+        if (Used == Buffer.size())
+        {
+            fprintf(stderr, "Line longer than %zu bytes in '%s'\n", Buffer.size(), Filename);
+            Result = false;
+            break;
+        }
+    }
+
+    Result &= !ferror(File);
+    fclose(File);
+    return Result;
+}
+
+template<typename T>
+static bool BeginTable(obj_stream_table<T>* Table, int Count, bool Spill, const std::string& SpillFilename)
+{
+    *Table = {};
+    Table->SpillFile = nullptr;
+    Table->Mapping = {};
+    if (Count == 0)
+        return true;
+
+    if (!Spill)
+    {
+        Table->Values.reserve(Count);
+        return true;
+    }
+
+    Table->SpillFilename = SpillFilename;
+    Table->SpillFile = fopen(SpillFilename.c_str(), "wb");
+    if (Table->SpillFile == nullptr)
+    {
+        fprintf(stderr, "Cannot create temporary file '%s'\n", SpillFilename.c_str());
+        return false;
+    }
+    Table->Values.reserve(OBJ_STREAM_SPILL_BUFFER / sizeof(T));
+    return true;
+}
+
+template<typename T>
+static bool FlushTable(obj_stream_table<T>* Table)
+{
+    bool Written = fwrite(Table->Values.data(), sizeof(T), Table->Values.size(), Table->SpillFile) == Table->Values.size();
+    Table->Values.clear();
+    return Written;
+}
+
+template<typename T>
+static bool PushTable(obj_stream_table<T>* Table, const T& Value)
+{
+    Table->Values.push_back(Value);
+    if (Table->SpillFile && Table->Values.size() == Table->Values.capacity())
+        return FlushTable(Table);
+    return true;
+}
+
+// Data is valid after this call
+template<typename T>
+static bool EndTable(obj_stream_table<T>* Table)
+{
+    if (Table->SpillFile == nullptr)
+    {
+        Table->Data = Table->Values.data();
+        Table->Count = (int)Table->Values.size();
+        return true;
+    }
+
+    bool Written = FlushTable(Table);
+    Written &= fclose(Table->SpillFile) == 0;
+    Table->SpillFile = nullptr;
+    Table->Values = std::vector<T>();
+
+    if (!Written || !File::Map(&Table->Mapping, Table->SpillFilename.c_str()))
+    {
+        fprintf(stderr, "Cannot write temporary file '%s'\n", Table->SpillFilename.c_str());
+        return false;
+    }
+    Table->Data = (const T*)Table->Mapping.Data;
+    Table->Count = (int)(Table->Mapping.Size / sizeof(T));
+    return true;
+}
+
+template<typename T>
+static void ReleaseTable(obj_stream_table<T>* Table)
+{
+    if (Table->SpillFile)
+        fclose(Table->SpillFile);
+    File::Unmap(&Table->Mapping);
+    if (!Table->SpillFilename.empty())
+        remove(Table->SpillFilename.c_str());
+    *Table = {};
+}
+
+template<typename T>
+static const T* GetAttribute(const obj_stream_table<T>& Table, int Index)
+{
+    return (Index >= 0 && Index < Table.Count) ? &Table.Data[Index] : nullptr;
+}
+
+static uint32_t HashCorner(const obj_corner& Corner)
+{
+    uint32_t Hash = (uint32_t)Corner.Index[OBJ_POSITION] * 73856093u;
+    Hash ^= (uint32_t)Corner.Index[OBJ_TEXCOORD] * 19349663u;
+    Hash ^= (uint32_t)Corner.Index[OBJ_NORMAL] * 83492791u;
+    return Hash;
+}
+
+bool ObjParser::Stream(const char* Filename, float Scale, vertex_layout Layout, size_t MemoryBudget,
+                       const std::function<bool(const obj_stream_info&)>& Begin,
+                       const std::function<void(const obj_stream_chunk&)>& Chunk,
+                       obj_stream_stats* Stats)
+{
+    auto StartTime = std::chrono::steady_clock::now();
+
+    size_t PeakMemory = 0;
+    auto UpdatePeakMemory = [&PeakMemory](size_t Memory) { PeakMemory = std::max(PeakMemory, Memory); };
+
+    std::vector<char> ReadBuffer(std::min(std::max(MemoryBudget / 16, OBJ_STREAM_MIN_READ_BUFFER), OBJ_STREAM_MAX_READ_BUFFER));
+    UpdatePeakMemory(ReadBuffer.capacity());
+
+    // Pass 1: count attributes and triangles
+    uint64_t Counts[OBJ_ATTRIBUTE_COUNT] = {};
+    uint64_t CornerCount = 0;
+    bool Read = ForEachLine(Filename, ReadBuffer, [&](const char* Token, const char* End)
+    {
+        switch (GetLineType(&Token, End))
+        {
+        case OBJ_LINE_POSITION: Counts[OBJ_POSITION]++; break;
+        case OBJ_LINE_TEXCOORD: Counts[OBJ_TEXCOORD]++; break;
+        case OBJ_LINE_NORMAL:   Counts[OBJ_NORMAL]++; break;
+        case OBJ_LINE_FACE:     CornerCount += std::max(CountFaceCorners(Token, End) - 2, 0) * 3; break;
+        default: break;
+        }
+        return true;
+    });
+
+    if (!Read)
+    {
+        fprintf(stderr, "Cannot read '%s'\n", Filename);
+        return false;
+    }
+
+    if (CornerCount > UINT32_MAX || Counts[OBJ_POSITION] > INT32_MAX || Counts[OBJ_TEXCOORD] > INT32_MAX || Counts[OBJ_NORMAL] > INT32_MAX)
+    {
+        fprintf(stderr, "Mesh '%s' is too big for 32 bits indices\n", Filename);
+        return false;
+    }
+
+    // Tables stay in memory if they fit in half of the budget
+    size_t TableSize = Counts[OBJ_POSITION] * sizeof(v3) + Counts[OBJ_TEXCOORD] * sizeof(v2) + Counts[OBJ_NORMAL] * sizeof(v3);
+    bool Spill = TableSize > (MemoryBudget - std::min(MemoryBudget, ReadBuffer.size())) / 2;
+
+    // Pass 2: attribute tables and bounds
+    obj_stream_table<v3> Positions;
+    obj_stream_table<v2> TexCoords;
+    obj_stream_table<v3> Normals;
+    bool Tables = BeginTable(&Positions, (int)Counts[OBJ_POSITION], Spill, std::string(Filename) + ".positions.tmp")
+               && BeginTable(&TexCoords, (int)Counts[OBJ_TEXCOORD], Spill, std::string(Filename) + ".texcoords.tmp")
+               && BeginTable(&Normals,   (int)Counts[OBJ_NORMAL],   Spill, std::string(Filename) + ".normals.tmp");
+    UpdatePeakMemory(ReadBuffer.capacity() + Positions.Values.capacity() * sizeof(v3) + TexCoords.Values.capacity() * sizeof(v2) + Normals.Values.capacity() * sizeof(v3));
+
+    v3 BoundsMin = { FLT_MAX, FLT_MAX, FLT_MAX };
+    v3 BoundsMax = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    Read = Tables && ForEachLine(Filename, ReadBuffer, [&](const char* Token, const char* End)
+    {
+        switch (GetLineType(&Token, End))
+        {
+        case OBJ_LINE_POSITION:
+        {
+            v3 Position;
+            Position.x = ParseReal(&Token, End) * Scale;
+            Position.y = ParseReal(&Token, End) * Scale;
+            Position.z = ParseReal(&Token, End) * Scale;
+            BoundsMin = { std::min(BoundsMin.x, Position.x), std::min(BoundsMin.y, Position.y), std::min(BoundsMin.z, Position.z) };
+            BoundsMax = { std::max(BoundsMax.x, Position.x), std::max(BoundsMax.y, Position.y), std::max(BoundsMax.z, Position.z) };
+            return PushTable(&Positions, Position);
+        }
+        case OBJ_LINE_TEXCOORD:
+        {
+            v2 TexCoord;
+            TexCoord.x = ParseReal(&Token, End);
+            TexCoord.y = ParseReal(&Token, End);
+            return PushTable(&TexCoords, TexCoord);
+        }
+        case OBJ_LINE_NORMAL:
+        {
+            v3 Normal;
+            Normal.x = ParseReal(&Token, End);
+            Normal.y = ParseReal(&Token, End);
+            Normal.z = ParseReal(&Token, End);
+            return PushTable(&Normals, Normal);
+        }
+        default:
+            return true;
+        }
+    }) && EndTable(&Positions) && EndTable(&TexCoords) && EndTable(&Normals);
+
+    auto Release = [&]()
+    {
+        ReleaseTable(&Positions);
+        ReleaseTable(&TexCoords);
+        ReleaseTable(&Normals);
+    };
+
+    if (!Read)
+    {
+        fprintf(stderr, "Cannot read attributes of '%s'\n", Filename);
+        Release();
+        return false;
+    }
+
+    if (Counts[OBJ_POSITION] == 0)
+        BoundsMin = BoundsMax = {};
+
+    bool HasNormals = Normals.Count > 0;
+    bool HasTexCoords = TexCoords.Count > 0;
+    size_t TableMemory = Spill ? 0 : TableSize;
+
+    // Chunk size from the remaining budget (vertices, converted vertices, indices and welding table of up to 4 entries per corner)
+    obj_stream_info Info = {};
+    Info.Descriptor = Mesh::GetDescriptor(Layout, BoundsMin, BoundsMax);
+    Info.IndexCount = (uint32_t)CornerCount;
+    Info.BoundsMin = BoundsMin;
+    Info.BoundsMax = BoundsMax;
+
+    // Vertices are only welded inside chunks (and never without normals, flat normals are generated)
+    uint64_t MaxAttributeCount = std::max(std::max(Counts[OBJ_POSITION], Counts[OBJ_TEXCOORD]), Counts[OBJ_NORMAL]);
+    Info.VertexCountEstimate = HasNormals ? (uint32_t)std::min(CornerCount, MaxAttributeCount + MaxAttributeCount / 4) : (uint32_t)CornerCount;
+
+    size_t CornerSize = sizeof(vertex_full) + Info.Descriptor.Stride + sizeof(uint32_t) + 4 * sizeof(obj_stream_key);
+    size_t UsedMemory = ReadBuffer.size() + TableMemory;
+    size_t ChunkCorners = (MemoryBudget > UsedMemory) ? (MemoryBudget - UsedMemory) / CornerSize : 0;
+    ChunkCorners = std::min<size_t>(ChunkCorners, std::max<uint64_t>(CornerCount, 3));
+    ChunkCorners -= ChunkCorners % 3;
+    if (ChunkCorners < OBJ_STREAM_MIN_CHUNK_CORNERS && CornerCount > ChunkCorners)
+    {
+        fprintf(stderr, "Memory budget of %.1f MB is too small to stream '%s', using %zu vertices per chunk\n", MemoryBudget / (1024.0 * 1024.0), Filename, OBJ_STREAM_MIN_CHUNK_CORNERS);
+        ChunkCorners = OBJ_STREAM_MIN_CHUNK_CORNERS;
+    }
+
+    if (!Begin(Info))
+    {
+        Release();
+        return false;
+    }
+
+    size_t HashSize = 1;
+    while (HashSize < ChunkCorners * 2)
+        HashSize *= 2;
+
+    std::vector<vertex_full> ChunkVertices;
+    std::vector<uint8_t> ChunkConverted(ChunkCorners * Info.Descriptor.Stride);
+    std::vector<uint32_t> ChunkIndices;
+    std::vector<obj_stream_key> HashTable(HashSize, obj_stream_key{ {}, UINT32_MAX });
+    std::vector<obj_corner> FaceCorners;
+    ChunkVertices.reserve(ChunkCorners);
+    ChunkIndices.reserve(ChunkCorners);
+    UpdatePeakMemory(ReadBuffer.capacity() + TableMemory + ChunkVertices.capacity() * sizeof(vertex_full) + ChunkConverted.capacity()
+        + ChunkIndices.capacity() * sizeof(uint32_t) + HashTable.capacity() * sizeof(obj_stream_key));
+
+    uint32_t VertexBase = 0;
+    uint32_t IndexBase = 0;
+    int ChunkCount = 0;
+
+    auto FlushChunk = [&]()
+    {
+        if (ChunkIndices.empty())
+            return;
+
+        Mesh::ConvertVertices(ChunkConverted.data(), Info.Descriptor, ChunkVertices.data(), (int)ChunkVertices.size());
+        Chunk({ ChunkConverted.data(), VertexBase, (uint32_t)ChunkVertices.size(), ChunkIndices.data(), IndexBase, (uint32_t)ChunkIndices.size() });
+
+        VertexBase += (uint32_t)ChunkVertices.size();
+        IndexBase += (uint32_t)ChunkIndices.size();
+        ChunkCount++;
+        ChunkVertices.clear();
+        ChunkIndices.clear();
+        std::fill(HashTable.begin(), HashTable.end(), obj_stream_key{ {}, UINT32_MAX });
+    };
+
+    auto AddCorner = [&](const obj_corner& Corner, v3 FaceNormal)
+    {
+        // Existing vertex of the chunk
+        size_t Slot = 0;
+        if (HasNormals)
+        {
+            Slot = HashCorner(Corner) & (HashSize - 1);
+            while (HashTable[Slot].Vertex != UINT32_MAX)
+            {
+                const obj_corner& Other = HashTable[Slot].Corner;
+                if (Other.Index[0] == Corner.Index[0] && Other.Index[1] == Corner.Index[1] && Other.Index[2] == Corner.Index[2])
+                {
+                    ChunkIndices.push_back(VertexBase + HashTable[Slot].Vertex);
+                    return;
+                }
+                Slot = (Slot + 1) & (HashSize - 1);
+            }
+        }
+
+        // Out of bounds indices give zero attributes, missing normals and UVs are built like Mesh::ParseObj
+        vertex_full V = {};
+        if (const v3* Position = GetAttribute(Positions, Corner.Index[OBJ_POSITION]))
+            V.Position = *Position;
+        if (const v3* Normal = GetAttribute(Normals, Corner.Index[OBJ_NORMAL]))
+            V.Normal = *Normal;
+        if (!HasNormals)
+            V.Normal = FaceNormal;
+        if (const v2* TexCoord = GetAttribute(TexCoords, Corner.Index[OBJ_TEXCOORD]))
+            V.UV = *TexCoord;
+        if (!HasTexCoords)
+        {
+            float Length = Vec3::Length(V.Position);
+            if (Length != 0.f)
+            {
+                v3 Pos = V.Position / Length;
+                V.UV.x = 0.5f + Math::Atan2(Pos.z, Pos.x);
+                V.UV.y = Pos.y;
+            }
+        }
+
+        if (HasNormals)
+            HashTable[Slot] = { Corner, (uint32_t)ChunkVertices.size() };
+        ChunkIndices.push_back(VertexBase + (uint32_t)ChunkVertices.size());
+        ChunkVertices.push_back(V);
+    };
+
+    // Pass 3: faces, converted and sent by chunks
+    int Running[OBJ_ATTRIBUTE_COUNT] = {};
+    Read = ForEachLine(Filename, ReadBuffer, [&](const char* Token, const char* End)
+    {
+        switch (GetLineType(&Token, End))
+        {
+        case OBJ_LINE_POSITION: Running[OBJ_POSITION]++; return true;
+        case OBJ_LINE_TEXCOORD: Running[OBJ_TEXCOORD]++; return true;
+        case OBJ_LINE_NORMAL:   Running[OBJ_NORMAL]++; return true;
+        case OBJ_LINE_FACE:     break;
+        default: return true;
+        }
+
+        FaceCorners.clear();
+        while (Token < End && IsSpace(*Token))
+            Token++;
+        while (Token < End)
+        {
+            obj_corner Corner;
+            bool Relative[OBJ_ATTRIBUTE_COUNT];
+            if (!ParseTriple(&Token, End, Running, &Corner, Relative))
+            {
+                fprintf(stderr, "Invalid face index in '%s'\n", Filename);
+                return false;
+            }
+            FaceCorners.push_back(Corner);
+            while (Token < End && IsSpace(*Token))
+                Token++;
+        }
+
+        // Fan triangulation
+        for (int i = 2; i < (int)FaceCorners.size(); ++i)
+        {
+            if (ChunkIndices.size() + 3 > ChunkCorners)
+                FlushChunk();
+
+            const obj_corner* Triangle[3] = { &FaceCorners[0], &FaceCorners[i - 1], &FaceCorners[i] };
+            v3 FaceNormal = {};
+            if (!HasNormals)
+            {
+                const v3* P[3];
+                for (int j = 0; j < 3; ++j)
+                {
+                    static const v3 Zero = {};
+                    P[j] = GetAttribute(Positions, Triangle[j]->Index[OBJ_POSITION]);
+                    P[j] = P[j] ? P[j] : &Zero;
+                }
+                FaceNormal = Vec3::Cross(*P[1] - *P[0], *P[2] - *P[0]);
+            }
+
+            for (int j = 0; j < 3; ++j)
+                AddCorner(*Triangle[j], FaceNormal);
+        }
+        return true;
+    });
+
+    if (Read)
+        FlushChunk();
+    Release();
+
+    if (!Read)
+    {
+        fprintf(stderr, "Cannot stream faces of '%s'\n", Filename);
+        return false;
+    }
+
+    if (Stats)
+        *Stats = { VertexBase, IndexBase, ChunkCount, PeakMemory, Spill };
+
+    double Duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - StartTime).count();
+    printf("Streamed %s: %u triangles, %u vertices in %.1f ms (%d chunks, loader peak %.1f MB for a %.1f MB budget%s, process peak %.1f MB)\n",
+        Filename, IndexBase / 3, VertexBase, Duration, ChunkCount, PeakMemory / (1024.0 * 1024.0), MemoryBudget / (1024.0 * 1024.0),
+        Spill ? ", attributes spilled to disk" : "", File::GetPeakMemoryUsage() / (1024.0 * 1024.0));
+    return true;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "mesh.h"
+
+const size_t OBJ_STREAM_DEFAULT_BUDGET = 256 * 1024 * 1024;
+
+// Known before the first chunk of ObjParser::Stream
+struct obj_stream_info
+{
+    vertex_descriptor Descriptor; // Quantized with the mesh bounds for packed layouts
+    uint32_t IndexCount;
+    uint32_t VertexCountEstimate; // Vertices are welded per chunk: the final count is only known at the end
+    v3 BoundsMin;
+    v3 BoundsMax;
+};
+
+// Converted vertices and absolute indices (appended after the previous chunks)
+struct obj_stream_chunk
+{
+    const void* Vertices;
+    uint32_t VertexOffset;
+    uint32_t VertexCount;
+    const uint32_t* Indices;
+    uint32_t IndexOffset;
+    uint32_t IndexCount;
+};
+
+struct obj_stream_stats
+{
+    uint32_t VertexCount;
+    uint32_t IndexCount;
+    int ChunkCount;
+    size_t PeakMemory; // Loader buffers
+    bool Spilled; // Attribute tables did not fit in the budget and were written to temporary files
+};
+
+// Multithreaded OBJ parser (positions, normals, texcoords and triangle faces).
+// The file is memory mapped and split in line-aligned chunks parsed in parallel, chunks are then merged with prefix sums.
+// Number parsing and index resolution follow tinyobjloader, so the output is identical to the tinyobj path of Mesh::ParseObj.
+namespace ObjParser
+{
+// Fill Soup with one vertex per triangle corner (Position, Normal and UV only).
+// ShapeOffsets receives the first corner of each non empty shape ('o' and 'g' lines, same shapes as tinyobj).
+// Returns false when the file cannot be read or contains something unsupported (polygons, invalid indices),
+// the caller is expected to fallback on tinyobj in that case.
+bool Parse(std::vector<vertex_full>& Soup, bool* HasNormals, bool* HasTexCoords, const char* Filename, std::vector<uint32_t>* ShapeOffsets = nullptr);
+
+// Out-of-core loading of meshes bigger than memory: the file is read by blocks and converted in fixed size chunks,
+// loader memory stays under MemoryBudget whatever the file size (attribute tables are spilled to disk when needed).
+// Polygons are triangulated as fans, missing normals/UVs are generated like Mesh::ParseObj. No tangents, no LODs.
+// Begin can return false to cancel the load.
+bool Stream(const char* Filename, float Scale, vertex_layout Layout, size_t MemoryBudget,
+            const std::function<bool(const obj_stream_info&)>& Begin,
+            const std::function<void(const obj_stream_chunk&)>& Chunk,
+            obj_stream_stats* Stats = nullptr);
+}
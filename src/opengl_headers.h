@@ -1,2 +1,14 @@
 
-#include <glad/glad.h>
\ No newline at end of file
+#include <glad/glad.h>
+
+// EXT_texture_compression_s3tc (not generated in glad, checked at runtime with GL::HasExtension)
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+// EXT_texture_sRGB, sRGB variants of the S3TC formats
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT       0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
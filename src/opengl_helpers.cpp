@@ -1,13 +1,13 @@
 
 #include <cassert>
+#include <cstring>
 #include <vector>
 #include <string>
 #include <map>
 
-#include <stb_image.h>
-
 #include "platform.h"
 #include "mesh.h"
+#include "texture_compress.h"
 
 #include "opengl_helpers.h"
 #include "opengl_helpers_wireframe.h"
@@ -107,6 +107,51 @@ light_shade_result light_shade(light light, float shininess, vec3 eyePosition, v
 // =================================
 )GLSL";
 
+// Vertex attributes decoding (see vertex_attribute_format and GL::UniformVertexDescriptor)
+static const char* VertexDecodingStr = R"GLSL(
+#line 113
+uniform vec3 uPositionScale = vec3(1.0);
+uniform vec3 uPositionBias = vec3(0.0);
+uniform bool uOctahedralNormal = false;
+uniform bool uQTangent = false;
+
+vec3 decodePosition(vec3 position)
+{
+    return uPositionBias + uPositionScale * position;
+}
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+vec3 decodeNormal(vec3 normal)
+{
+    return uOctahedralNormal ? decodeOctahedral(normal.xy) : normal;
+}
+
+// Float tangents store the bitangent sign in w, QTangents store the frame as a quaternion
+void decodeTangentFrame(vec3 normalIn, vec4 tangentIn, out vec3 normal, out vec3 tangent, out float handedness)
+{
+    if (!uQTangent)
+    {
+        normal = decodeNormal(normalIn);
+        tangent = tangentIn.xyz;
+        handedness = tangentIn.w < 0.0 ? -1.0 : 1.0;
+        return;
+    }
+
+    vec4 q = normalize(tangentIn);
+    tangent = vec3(1.0 - 2.0 * (q.y * q.y + q.z * q.z), 2.0 * (q.x * q.y + q.w * q.z), 2.0 * (q.x * q.z - q.w * q.y));
+    normal  = vec3(2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+    handedness = tangentIn.w < 0.0 ? -1.0 : 1.0;
+}
+)GLSL";
+
 void GL::UniformLight(GLuint Program, const char* LightUniformName, const light& Light)
 {
 	glUseProgram(Program);
@@ -165,6 +210,8 @@ GLuint GL::CompileShaderEx(GLenum ShaderType, int ShaderStrsCount, const char**
 		Sources.push_back(ShaderStructsDefinitionsStr);
 		Sources.push_back(PhongLightingStr);
 	}
+	if (ShaderType == GL_VERTEX_SHADER)
+		Sources.push_back(VertexDecodingStr);
 	for (int i = 0; i < ShaderStrsCount; ++i)
 		Sources.push_back(ShaderStrs[i]);
 
@@ -216,81 +263,174 @@ const char* GL::GetShaderStructsDefinitions()
 	return ShaderStructsDefinitionsStr;
 }
 
-void GL::UploadTexture(const char* Filename, int ImageFlags, int* WidthOut, int* HeightOut)
+void GL::VertexAttribPointer(GLuint Index, const vertex_descriptor& Descriptor, vertex_attribute Attribute)
 {
-    // Flip
-    stbi_set_flip_vertically_on_load((ImageFlags & IMG_FLIP) ? 1 : 0);
+	vertex_attribute_format Format = VERTEX_FORMAT_FLOAT;
+	int FloatComponents = 3;
+	int Offset = 0;
+	switch (Attribute)
+	{
+	case VERTEX_ATTRIBUTE_POSITION: Format = Descriptor.PositionFormat; Offset = Descriptor.PositionOffset; break;
+	case VERTEX_ATTRIBUTE_NORMAL:   Format = Descriptor.NormalFormat;   Offset = Descriptor.NormalOffset;   break;
+	case VERTEX_ATTRIBUTE_UV:       Format = Descriptor.UVFormat;       Offset = Descriptor.UVOffset; FloatComponents = 2; break;
+	case VERTEX_ATTRIBUTE_TANGENT:  Format = Descriptor.TangentFormat;  Offset = Descriptor.TangentOffset; FloatComponents = 4; break;
+	}
 
-    // Desired channels
-    int DesiredChannels = 0;
-	int Channels = 0;
-	if (ImageFlags & IMG_FORCE_GREY)
+	GLenum Type = GL_FLOAT;
+	GLboolean Normalized = GL_FALSE;
+	if (Format == VERTEX_FORMAT_HALF)
 	{
-		DesiredChannels = STBI_grey;
-		Channels = 1;
+		Type = GL_HALF_FLOAT;
 	}
-	if (ImageFlags & IMG_FORCE_GREY_ALPHA)
+	else if (Format != VERTEX_FORMAT_FLOAT)
 	{
-		DesiredChannels = STBI_grey_alpha;
-		Channels = 2;
+		Type = GL_SHORT;
+		Normalized = GL_TRUE;
 	}
-	if (ImageFlags & IMG_FORCE_RGB)
+
+	glEnableVertexAttribArray(Index);
+	glVertexAttribPointer(Index, Mesh::GetAttributeComponents(Format, FloatComponents), Type, Normalized, Descriptor.Stride, (void*)(size_t)Offset);
+}
+
+void GL::UniformVertexDescriptor(GLuint Program, const vertex_descriptor& Descriptor)
+{
+	glUseProgram(Program);
+
+	bool QuantizedPosition = (Descriptor.PositionFormat != VERTEX_FORMAT_FLOAT);
+	v3 PositionScale = QuantizedPosition ? Descriptor.PositionScale : v3{ 1.f, 1.f, 1.f };
+	v3 PositionBias  = QuantizedPosition ? Descriptor.PositionBias  : v3{ 0.f, 0.f, 0.f };
+	glUniform3fv(glGetUniformLocation(Program, "uPositionScale"), 1, PositionScale.e);
+	glUniform3fv(glGetUniformLocation(Program, "uPositionBias"), 1, PositionBias.e);
+	glUniform1i(glGetUniformLocation(Program, "uOctahedralNormal"), Descriptor.HasNormal && Descriptor.NormalFormat == VERTEX_FORMAT_OCTAHEDRAL);
+	glUniform1i(glGetUniformLocation(Program, "uQTangent"), Descriptor.HasTangent && Descriptor.TangentFormat == VERTEX_FORMAT_QTANGENT);
+}
+
+void GL::DrawElementsRanges(GLenum Mode, const std::vector<draw_range>& Ranges, GLenum IndexType)
+{
+	if (Ranges.empty())
+		return;
+
+	int IndexSize = (IndexType == GL_UNSIGNED_INT) ? sizeof(uint32_t) : sizeof(uint16_t);
+
+	std::vector<GLsizei> Counts(Ranges.size());
+	std::vector<const void*> Offsets(Ranges.size());
+	for (int i = 0; i < (int)Ranges.size(); ++i)
 	{
-		DesiredChannels = STBI_rgb;
-		Channels = 3;
+		Counts[i] = (GLsizei)Ranges[i].IndexCount;
+		Offsets[i] = (const void*)((size_t)Ranges[i].IndexOffset * IndexSize);
 	}
-	if (ImageFlags & IMG_FORCE_RGBA)
+
+	glMultiDrawElements(Mode, Counts.data(), IndexType, Offsets.data(), (GLsizei)Ranges.size());
+}
+
+bool GL::HasExtension(const char* Name)
+{
+	GLint ExtensionCount = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &ExtensionCount);
+	for (GLint i = 0; i < ExtensionCount; ++i)
 	{
-		DesiredChannels = STBI_rgb_alpha;
-		Channels = 4;
+		if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, i), Name) == 0)
+			return true;
 	}
+	return false;
+}
 
-    // Loading
-    int Width, Height;
-	void* Image;
-	
-	if (ImageFlags & IMG_LINEAR)
-		Image = stbi_loadf(Filename, &Width, &Height, (DesiredChannels == 0) ? &Channels : nullptr, DesiredChannels);
-	else
-		Image = stbi_load(Filename, &Width, &Height, (DesiredChannels == 0) ? &Channels : nullptr, DesiredChannels);
+// Compressed internal format, 0 if the driver does not support it (RGTC is core since 3.0, S3TC is an extension)
+static GLenum GetCompressedFormat(texture_format Format, bool Srgb)
+{
+	static const bool HasS3TC = GL::HasExtension("GL_EXT_texture_compression_s3tc");
+	static const bool HasS3TCSrgb = HasS3TC && GL::HasExtension("GL_EXT_texture_sRGB");
+	switch (Format)
+	{
+	case TEXTURE_FORMAT_BC1: return Srgb ? (HasS3TCSrgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : 0)       : (HasS3TC ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : 0);
+	case TEXTURE_FORMAT_BC3: return Srgb ? (HasS3TCSrgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : 0) : (HasS3TC ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : 0);
+	case TEXTURE_FORMAT_BC4: return GL_COMPRESSED_RED_RGTC1;
+	case TEXTURE_FORMAT_BC5: return GL_COMPRESSED_RG_RGTC2;
+	default:                 return 0;
+	}
+}
 
-    if (Image == nullptr)
-    {
-        fprintf(stderr, "Image loading failed on '%s'\n", Filename);
-        return;
-    }
-	GLint GLImageFormat[] =
+void GL::UploadTextureCacheLevels(const texture_cache& Cache, uint32_t FirstLevel, uint32_t LastLevel)
+{
+	const texture_cache_header& Header = *Cache.Header;
+	GLint GLImageFormat[] = { -1, GL_RED, GL_RG, GL_RGB, GL_RGBA };
+	GLint GLFloatFormat[] = { -1, GL_R32F, GL_RG32F, GL_RGB32F, GL_RGBA32F };
+	GLint GLHalfFormat[]  = { -1, GL_R16F, GL_RG16F, GL_RGB16F, GL_RGBA16F };
+	GLint GLSrgbFormat[]  = { -1, GL_RED, GL_RG, GL_SRGB8, GL_SRGB8_ALPHA8 }; // No sRGB format for 1 and 2 channels
+
+	texture_format Format = (texture_format)Header.Format;
+	bool IsSrgb = Cache.IsSrgb && !(Header.ImageFlags & (IMG_LINEAR | IMG_NON_COLOR));
+	bool IsCompressed = TextureCompress::IsCompressed(Format);
+	GLenum CompressedFormat = IsCompressed ? GetCompressedFormat(Format, IsSrgb) : 0;
+	GLint InternalFormat = IsSrgb ? GLSrgbFormat[Header.Channels] : GLImageFormat[Header.Channels];
+	GLenum Type = GL_UNSIGNED_BYTE;
+	switch (Format)
 	{
-		-1, // 0 Channels, unused
-		GL_RED,
-		GL_RG,
-		GL_RGB,
-		GL_RGBA,
-
-		GL_R32F,
-		GL_RG32F,
-		GL_RGB32F,
-		GL_RGBA32F
-	};
-	
-    // Uploading
-	if (ImageFlags & IMG_LINEAR)
-		glTexImage2D(GL_TEXTURE_2D, 0, GLImageFormat[Channels+4], Width, Height, 0, GLImageFormat[Channels], GL_FLOAT, Image);
-	else
-		glTexImage2D(GL_TEXTURE_2D, 0, GLImageFormat[Channels], Width, Height, 0, GLImageFormat[Channels], GL_UNSIGNED_BYTE, Image);
-    stbi_image_free(Image);
-
-    // Mipmaps
-    if (ImageFlags & IMG_GEN_MIPMAPS)
-        glGenerateMipmap(GL_TEXTURE_2D);
+	case TEXTURE_FORMAT_FLOAT32:    InternalFormat = GLFloatFormat[Header.Channels]; Type = GL_FLOAT; break;
+	case TEXTURE_FORMAT_FLOAT16:    InternalFormat = GLHalfFormat[Header.Channels];  Type = GL_HALF_FLOAT; break;
+	case TEXTURE_FORMAT_R11G11B10F: InternalFormat = GL_R11F_G11F_B10F; Type = GL_UNSIGNED_INT_10F_11F_11F_REV; break;
+	case TEXTURE_FORMAT_RGB9E5:     InternalFormat = GL_RGB9_E5;        Type = GL_UNSIGNED_INT_5_9_9_9_REV; break;
+	default: break;
+	}
+	GLenum Target = (Header.FaceCount == TEXTURE_CACHE_MAX_FACES) ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+
+	// Unsupported block format: decoded level by level
+	std::vector<uint8_t> Decoded;
+	if (IsCompressed && CompressedFormat == 0)
+		Decoded.resize((size_t)Header.Levels[0][FirstLevel].Width * Header.Levels[0][FirstLevel].Height * Header.Channels);
+
+	// Rows are tightly packed (RGB levels are not 4 bytes aligned)
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	for (uint32_t Face = 0; Face < Header.FaceCount; ++Face)
+	{
+		GLenum FaceTarget = (Target == GL_TEXTURE_CUBE_MAP) ? GL_TEXTURE_CUBE_MAP_POSITIVE_X + Face : GL_TEXTURE_2D;
+		for (uint32_t Level = FirstLevel; Level <= LastLevel && Level < Header.LevelCount; ++Level)
+		{
+			const texture_cache_level& CacheLevel = Header.Levels[Face][Level];
+			const void* Data = TextureCache::GetLevelData(Cache, Face, Level);
+			if (CompressedFormat)
+			{
+				glCompressedTexImage2D(FaceTarget, Level, CompressedFormat, CacheLevel.Width, CacheLevel.Height, 0, (GLsizei)CacheLevel.Size, Data);
+				continue;
+			}
+
+			if (IsCompressed)
+			{
+				TextureCompress::DecodeLevel(Decoded.data(), (const uint8_t*)Data, (int)CacheLevel.Width, (int)CacheLevel.Height, Format);
+				Data = Decoded.data();
+			}
+			glTexImage2D(FaceTarget, Level, InternalFormat, CacheLevel.Width, CacheLevel.Height, 0, GLImageFormat[Header.Channels], Type, Data);
+		}
+	}
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
+
+void GL::UploadTextureCache(const texture_cache& Cache)
+{
+	const texture_cache_header& Header = *Cache.Header;
+	GL::UploadTextureCacheLevels(Cache, 0, Header.LevelCount - 1);
+
+	// Mip chain is complete, levels are not regenerated
+	GLenum Target = (Header.FaceCount == TEXTURE_CACHE_MAX_FACES) ? GL_TEXTURE_CUBE_MAP : GL_TEXTURE_2D;
+	glTexParameteri(Target, GL_TEXTURE_MAX_LEVEL, Header.LevelCount - 1);
+}
+
+void GL::UploadTexture(const char* Filename, int ImageFlags, int* WidthOut, int* HeightOut)
+{
+    // Through the texture cache (mip chain and IMG_COMPRESS)
+    texture_cache Cache;
+    if (!TextureCache::Load(&Cache, &Filename, 1, ImageFlags))
+        return;
+
+    GL::UploadTextureCache(Cache);
 
     if (WidthOut)
-        *WidthOut = Width;
+        *WidthOut = (int)Cache.Header->Width;
 
     if (HeightOut)
-        *HeightOut = Height;
+        *HeightOut = (int)Cache.Header->Height;
 
-    stbi_set_flip_vertically_on_load(0); // Always reset to default value
+    TextureCache::Release(&Cache);
 }
 
 void GL::UploadCheckerboardTexture(int Width, int Height, int SquareSize)
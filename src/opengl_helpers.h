@@ -2,20 +2,20 @@
 
 #include "opengl_headers.h"
 #include "types.h"
+#include "mesh.h"
+#include "texture_cache.h"
 #include "opengl_helpers_cache.h"
 #include "opengl_helpers_wireframe.h"
 #include <vector>
 #include <string>
 
-enum image_flags
+// Attributes of a vertex_descriptor
+enum vertex_attribute
 {
-    IMG_FLIP             = 1 << 0,
-    IMG_FORCE_GREY       = 1 << 1,
-    IMG_FORCE_GREY_ALPHA = 1 << 2,
-    IMG_FORCE_RGB        = 1 << 3,
-    IMG_FORCE_RGBA       = 1 << 4,
-    IMG_GEN_MIPMAPS      = 1 << 5,
-    IMG_LINEAR           = 1 << 6,
+    VERTEX_ATTRIBUTE_POSITION,
+    VERTEX_ATTRIBUTE_NORMAL,
+    VERTEX_ATTRIBUTE_UV,
+    VERTEX_ATTRIBUTE_TANGENT,
 };
 
 namespace GL
@@ -44,15 +44,20 @@ namespace GL
     class debug
     {
     public:
-        void WireframePrepare(GLuint MeshVBO, GLsizei PositionStride, GLsizei PositionOffset, int VertexCount)
+        void WireframePrepare(GLuint MeshVBO, const vertex_descriptor& Descriptor, GLuint IndexBuffer = 0)
         {
-            Wireframe.BindBuffer(MeshVBO, PositionStride, PositionOffset, VertexCount);
+            Wireframe.BindBuffer(MeshVBO, Descriptor, IndexBuffer);
         }
 
         void WireframeDrawArray(GLint First, GLsizei Count, const mat4& MVP)
         {
             Wireframe.DrawArray(First, Count, MVP);
         }
+
+        void WireframeDrawElements(GLsizei Count, GLenum IndexType, const mat4& MVP)
+        {
+            Wireframe.DrawElements(Count, IndexType, MVP);
+        }
         
         GL::wireframe_renderer Wireframe;
     };
@@ -64,6 +69,17 @@ namespace GL
     GLuint CreateProgram(const char* VSString, const char* FSString, bool InjectLightShading = false);
     GLuint CreateProgramEx(int VSStringsCount, const char** VSStrings, int FSStringCount, const char** FSString, bool InjectLightShading = false);
     const char* GetShaderStructsDefinitions();
+    bool HasExtension(const char* Name);
+
+    // Packed vertices: vertex shaders can use decodePosition/decodeNormal/decodeTangentFrame (injected in every vertex shader)
+    void VertexAttribPointer(GLuint Index, const vertex_descriptor& Descriptor, vertex_attribute Attribute); // Also enables the attribute
+    void UniformVertexDescriptor(GLuint Program, const vertex_descriptor& Descriptor); // Decoding uniforms, set before drawing a mesh
+
+    // Draw index ranges of the bound element buffer with a single glMultiDrawElements
+    void DrawElementsRanges(GLenum Mode, const std::vector<draw_range>& Ranges, GLenum IndexType);
+    // Textures are uploaded to the bound GL_TEXTURE_2D
+    void UploadTextureCache(const texture_cache& Cache); // Every face and level, cubemaps to the bound GL_TEXTURE_CUBE_MAP (blocks are decoded when the format is not supported)
+    void UploadTextureCacheLevels(const texture_cache& Cache, uint32_t FirstLevel, uint32_t LastLevel); // Levels in [FirstLevel, LastLevel] only, GL_TEXTURE_MAX_LEVEL is not set
     void UploadTexture(const char* Filename, int ImageFlags = 0, int* WidthOut = nullptr, int* HeightOut = nullptr);
     void UploadCheckerboardTexture(int Width, int Height, int SquareSize);
 
@@ -1,70 +1,531 @@
+#include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include <imgui.h>
 
 #include "platform.h"
+#include "mesh_cache.h"
+#include "asset_archive.h"
+#include "jobs.h"
 
 #include "opengl_helpers.h"
 
 #include "opengl_helpers_cache.h"
 
+// Placeholder of async textures
+const int ASYNC_TEXTURE_PLACEHOLDER_SIZE = 64;
+const int ASYNC_TEXTURE_PLACEHOLDER_SQUARE = 8;
+const int ASYNC_TEXTURE_PLACEHOLDER_LEVELS = 7; // 64x64 to 1x1 with IMG_GEN_MIPMAPS
+
+// Mesh read from the mesh cache, not uploaded yet (can be built on any thread)
+struct mesh_data
+{
+	mesh_cache Cache;
+	vertex_descriptor Descriptor;
+	std::vector<uint8_t> PackedVertices; // Packed layouts, or FULL vertices decoded from an encoded cache
+	std::vector<uint8_t> DecodedIndices; // Encoded cache only
+};
+
+struct GL::cache::async_texture
+{
+	texture_identifier Identifier;
+	std::atomic<bool> Done{ false };
+	bool Loaded = false;
+	texture_cache Cache = {};
+};
+
+struct GL::cache::texture_stream
+{
+	std::shared_ptr<async_texture> Source; // Keeps the texture cache mapped
+	GLuint TextureID;
+	entry* Entry;
+	int TailLevel;       // Levels from TailLevel are always resident
+	int ResidentLevel;   // Finest uploaded level (GL_TEXTURE_BASE_LEVEL)
+	float RequestedSize; // Max of the requests since the last StreamTextures call
+	float MinLod;        // GL_TEXTURE_MIN_LOD (relative to the base level), faded to 0 after an upload
+};
+
+struct GL::cache::async_mesh
+{
+	mesh_identifier Identifier;
+	std::atomic<bool> Done{ false };
+	mesh_data Data;
+};
+
+// MeshCache::Load and TextureCache::Load write the cache file: two jobs must not build the same file at once
+static std::mutex CacheFilesMutex;
+static std::condition_variable CacheFilesCondition;
+static std::set<std::string> CacheFilesLoading;
+
+static void LockCacheFile(const std::string& CachedFile)
+{
+	std::unique_lock<std::mutex> Lock(CacheFilesMutex);
+	CacheFilesCondition.wait(Lock, [&]() { return CacheFilesLoading.count(CachedFile) == 0; });
+	CacheFilesLoading.insert(CachedFile);
+}
+
+static void UnlockCacheFile(const std::string& CachedFile)
+{
+	{
+		std::lock_guard<std::mutex> Lock(CacheFilesMutex);
+		CacheFilesLoading.erase(CachedFile);
+	}
+	CacheFilesCondition.notify_all();
+}
+
+// TextureCache::Load serialized on the cache file (loads with other IMG_SRGB flags share it)
+static bool LoadTextureCache(texture_cache* Cache, const char* const* Sources, int SourceCount, int ImageFlags)
+{
+	std::string CachedFile = TextureCache::GetCacheFilename(Sources, SourceCount, ImageFlags);
+	LockCacheFile(CachedFile);
+	bool Loaded = TextureCache::Load(Cache, Sources, SourceCount, ImageFlags);
+	UnlockCacheFile(CachedFile);
+	return Loaded;
+}
+
+static void ReadMesh(mesh_data* Data, const std::string& Filename, float Scale, vertex_layout Layout)
+{
+	std::string CachedFile = MeshCache::GetCacheFilename(Filename.c_str(), Scale);
+	LockCacheFile(CachedFile);
+	bool Loaded = MeshCache::Load(&Data->Cache, Filename.c_str(), Scale, true);
+	UnlockCacheFile(CachedFile);
+
+	if (!Loaded)
+		fprintf(stderr, "Cannot load mesh '%s'\n", Filename.c_str());
+
+	const mesh_cache_header* Header = Data->Cache.Header;
+	v3 BoundsMin = {};
+	v3 BoundsMax = {};
+	if (Header)
+	{
+		BoundsMin = { Header->BoundsMin[0], Header->BoundsMin[1], Header->BoundsMin[2] };
+		BoundsMax = { Header->BoundsMax[0], Header->BoundsMax[1], Header->BoundsMax[2] };
+	}
+	Data->Descriptor = Mesh::GetDescriptor(Layout, BoundsMin, BoundsMax);
+
+	// Encoded caches are decoded here, straight to the upload buffers for FULL vertices and indices
+	const vertex_full* Vertices = Data->Cache.Vertices;
+	std::vector<vertex_full> DecodedVertices;
+	if (Header && Vertices == nullptr)
+	{
+		bool Decoded;
+		if (Layout == VERTEX_LAYOUT_FULL)
+		{
+			Data->PackedVertices.resize((size_t)Header->VertexCount * sizeof(vertex_full));
+			Decoded = MeshCache::DecodeVertices(Data->Cache, (vertex_full*)Data->PackedVertices.data());
+		}
+		else
+		{
+			DecodedVertices.resize(Header->VertexCount);
+			Decoded = MeshCache::DecodeVertices(Data->Cache, DecodedVertices.data());
+			Vertices = DecodedVertices.data();
+		}
+		Data->DecodedIndices.resize((size_t)Header->IndexCount * Header->IndexSize);
+		Decoded = Decoded && MeshCache::DecodeIndices(Data->Cache, Data->DecodedIndices.data());
+		if (!Decoded)
+		{
+			fprintf(stderr, "Corrupted mesh cache '%s'\n", Filename.c_str());
+			MeshCache::Release(&Data->Cache);
+			Data->PackedVertices.clear();
+			Data->DecodedIndices.clear();
+			Header = nullptr;
+		}
+	}
+
+	// Packed layouts are converted here, FULL vertices are uploaded straight from the mapped cache file
+	if (Header && Layout != VERTEX_LAYOUT_FULL)
+	{
+		Data->PackedVertices.resize((size_t)Header->VertexCount * Data->Descriptor.Stride);
+		Mesh::ConvertVertices(Data->PackedVertices.data(), Data->Descriptor, Vertices, (int)Header->VertexCount);
+	}
+}
+
+// Fill buffers already generated in Mesh (render thread), Data is released. Returns the uploaded bytes
+static size_t UploadMesh(GL::cache::mesh* Mesh, mesh_data* Data)
+{
+	const mesh_cache_header* Header = Data->Cache.Header;
+
+	Mesh->VertexCount = Header ? (int)Header->VertexCount : 0;
+	Mesh->IndexType   = (Header && Header->IndexSize == sizeof(uint32_t)) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+	int IndexSize     = (Mesh->IndexType == GL_UNSIGNED_INT) ? sizeof(uint32_t) : sizeof(uint16_t);
+	Mesh->Descriptor  = Data->Descriptor;
+
+	int TotalIndexCount = Header ? (int)Header->IndexCount : 0;
+	Mesh->LodCount = 1;
+	Mesh->Lods[0] = { 0, (uint32_t)TotalIndexCount, 0.f, 0 };
+	Mesh->BoundsMin = {};
+	Mesh->BoundsMax = {};
+	Mesh->BoundsCenter = {};
+	Mesh->BoundsRadius = 0.f;
+	Mesh->Shapes.clear();
+	if (Header)
+	{
+		Mesh->BoundsMin = { Header->BoundsMin[0], Header->BoundsMin[1], Header->BoundsMin[2] };
+		Mesh->BoundsMax = { Header->BoundsMax[0], Header->BoundsMax[1], Header->BoundsMax[2] };
+		Mesh->BoundsCenter = { Header->BoundsCenter[0], Header->BoundsCenter[1], Header->BoundsCenter[2] };
+		Mesh->BoundsRadius = Header->BoundsRadius;
+		Mesh->Shapes.assign(Data->Cache.Shapes, Data->Cache.Shapes + Header->ShapeCount);
+		Mesh->LodCount = (int)Header->LodCount;
+		for (int i = 0; i < Mesh->LodCount; ++i)
+			Mesh->Lods[i] = Header->Lods[i];
+	}
+	Mesh->IndexCount = (int)Mesh->Lods[0].IndexCount;
+
+	// Upload mesh to gpu
+	glBindBuffer(GL_ARRAY_BUFFER, Mesh->VertexBuffer);
+	if (Data->PackedVertices.empty())
+		glBufferData(GL_ARRAY_BUFFER, Mesh->VertexCount * sizeof(vertex_full), Data->Cache.Vertices, GL_STATIC_DRAW);
+	else
+		glBufferData(GL_ARRAY_BUFFER, Data->PackedVertices.size(), Data->PackedVertices.data(), GL_STATIC_DRAW);
+
+	// Upload indices (all LODs)
+	// NOTE: Use GL_ARRAY_BUFFER target to avoid modifying the element buffer of the currently bound VAO
+	glBindBuffer(GL_ARRAY_BUFFER, Mesh->IndexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, TotalIndexCount * IndexSize, Data->DecodedIndices.empty() ? Data->Cache.Indices : Data->DecodedIndices.data(), GL_STATIC_DRAW);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	if (Header)
+		Mesh->Meshlets.assign(Data->Cache.Meshlets, Data->Cache.Meshlets + Header->MeshletCount);
+
+	MeshCache::Release(&Data->Cache);
+	Data->PackedVertices = std::vector<uint8_t>();
+	Data->DecodedIndices = std::vector<uint8_t>();
+
+	return (size_t)Mesh->VertexCount * Mesh->Descriptor.Stride + (size_t)TotalIndexCount * IndexSize;
+}
+
+// Uploaded bytes of every face and level
+static size_t GetTextureBytes(const texture_cache_header& Header)
+{
+	size_t Bytes = 0;
+	for (uint32_t Face = 0; Face < Header.FaceCount; ++Face)
+		for (uint32_t Level = 0; Level < Header.LevelCount; ++Level)
+			Bytes += (size_t)Header.Levels[Face][Level].Size;
+	return Bytes;
+}
+
+size_t GL::cache::identifier_hash::operator()(const mesh_identifier& Identifier) const
+{
+	uint64_t Seed = File::Hash(&Identifier.Scale, sizeof(Identifier.Scale), (uint64_t)Identifier.Layout * 2 + Identifier.Streamed);
+	return (size_t)File::Hash(Identifier.Filename.data(), Identifier.Filename.size(), Seed);
+}
+
+size_t GL::cache::identifier_hash::operator()(const primitive_identifier& Identifier) const
+{
+	int Parameters[4] = { (int)Identifier.Type, (int)Identifier.Layout, Identifier.Lon, Identifier.Lat };
+	return (size_t)File::Hash(Parameters, sizeof(Parameters));
+}
+
+size_t GL::cache::identifier_hash::operator()(const texture_identifier& Identifier) const
+{
+	return (size_t)File::Hash(Identifier.Filename.data(), Identifier.Filename.size(), (uint64_t)Identifier.ImageFlags * 2 + Identifier.Streamed);
+}
+
 GL::cache::cache()
 {
-	MeshDesc.Stride = sizeof(vertex_full);
-	MeshDesc.HasNormal = true;
-	MeshDesc.HasUV = true;
-	MeshDesc.HasTangent = true;
-	MeshDesc.PositionOffset = OFFSETOF(vertex_full, Position);
-	MeshDesc.UVOffset = OFFSETOF(vertex_full, UV);
-	MeshDesc.NormalOffset = OFFSETOF(vertex_full, Normal);
-	MeshDesc.TangentOffset = OFFSETOF(vertex_full, Tangent);
 }
 
 GL::cache::~cache()
 {
+	// Background jobs still reference pending loads
+	for (const std::shared_ptr<async_texture>& Pending : this->PendingTextures)
+	{
+		while (!Pending->Done)
+			std::this_thread::yield();
+		TextureCache::Release(&Pending->Cache);
+	}
+
+	for (const std::unique_ptr<texture_stream>& Stream : this->Streams)
+		TextureCache::Release(&Stream->Source->Cache);
+
+	for (const std::shared_ptr<async_mesh>& Pending : this->PendingMeshes)
+	{
+		while (!Pending->Done)
+			std::this_thread::yield();
+		MeshCache::Release(&Pending->Data.Cache);
+	}
+
 	for (const auto& KeyValue : this->TextureMap)
 		glDeleteTextures(1, &KeyValue.second.TextureID);
 
+	for (const auto& KeyValue : this->AtlasMap)
+		glDeleteTextures((GLsizei)KeyValue.second.Atlas.Pages.size(), KeyValue.second.Atlas.Pages.data());
+
 	for (const auto& KeyValue : this->VertexBufferMap)
-		glDeleteBuffers(1, &KeyValue.second.VertexBuffer);
+	{
+		glDeleteBuffers(1, &KeyValue.second.Mesh.VertexBuffer);
+		glDeleteBuffers(1, &KeyValue.second.Mesh.IndexBuffer);
+	}
+
+	for (const auto& KeyValue : this->PrimitiveMap)
+	{
+		glDeleteBuffers(1, &KeyValue.second.Mesh.VertexBuffer);
+		glDeleteBuffers(1, &KeyValue.second.Mesh.IndexBuffer);
+	}
+
+	// Released caches above may be views of the archive
+	AssetArchive::Unmount();
+}
+
+bool GL::cache::MountArchive(const char* Filename)
+{
+	return AssetArchive::Mount(Filename);
 }
 
-GLuint GL::cache::LoadObj(const char* Filename, float Scale, int* VertexCountOut, vertex_descriptor* DescOut)
+void GL::cache::Use(entry* Entry, bool Hit)
 {
-	auto Found = this->VertexBufferMap.find(Filename);
+	Entry->RefCount++;
+	Entry->LastUse = ++this->UseClock;
+	if (Hit)
+		this->Stats.Hits++;
+	else
+		this->Stats.Misses++;
+}
+
+GLuint GL::cache::LoadObj(const char* Filename, float Scale, mesh* MeshOut, vertex_descriptor* DescOut, vertex_layout Layout)
+{
+	mesh_identifier MeshIdentifier = { Filename, Scale, Layout, false };
+	this->WaitMesh(MeshIdentifier);
+
+	auto Found = this->VertexBufferMap.find(MeshIdentifier);
 	if (Found != this->VertexBufferMap.end())
 	{
-		if (VertexCountOut)
-			*VertexCountOut = Found->second.Size;
+		this->Use(&Found->second.Entry, true);
+		if (MeshOut)
+			*MeshOut = Found->second.Mesh;
 		if (DescOut)
-			*DescOut = MeshDesc;
-		return Found->second.VertexBuffer;
+			*DescOut = Found->second.Mesh.Descriptor;
+		return Found->second.Mesh.VertexBuffer;
 	}
 
-	this->TmpBuffer.clear();
-	Mesh::LoadObjNoConvertion(this->TmpBuffer, Filename, Scale);
+	mesh_data Data;
+	ReadMesh(&Data, Filename, Scale, Layout);
 
-	// Upload mesh to gpu
-	GLuint MeshBuffer = 0;
-	glGenBuffers(1, &MeshBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, MeshBuffer);
-	glBufferData(GL_ARRAY_BUFFER, this->TmpBuffer.size() * sizeof(vertex_full), &this->TmpBuffer[0], GL_STATIC_DRAW);
+	mesh_entry& MeshEntry = this->VertexBufferMap[MeshIdentifier];
+	MeshEntry = {};
+	mesh& Mesh = MeshEntry.Mesh;
+	glGenBuffers(1, &Mesh.VertexBuffer);
+	glGenBuffers(1, &Mesh.IndexBuffer);
+	MeshEntry.Entry.Bytes = UploadMesh(&Mesh, &Data);
+	this->Use(&MeshEntry.Entry, false);
 
-	if (VertexCountOut)
-		*VertexCountOut = (int)this->TmpBuffer.size();
+	if (MeshOut)
+		*MeshOut = Mesh;
 
 	if (DescOut)
-		*DescOut = MeshDesc;
-	
-	this->VertexBufferMap[Filename] = { MeshBuffer, (int)this->TmpBuffer.size() };
+		*DescOut = Mesh.Descriptor;
+
+	GLuint VertexBuffer = Mesh.VertexBuffer;
+	this->Trim();
+
+	return VertexBuffer;
+}
+
+// Reallocate Buffer with NewSize bytes, the first OldSize bytes are kept
+static void GrowBuffer(GLuint* Buffer, GLsizeiptr OldSize, GLsizeiptr NewSize)
+{
+	GLuint NewBuffer = 0;
+	glGenBuffers(1, &NewBuffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, NewBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, NewSize, nullptr, GL_STATIC_DRAW);
+	glBindBuffer(GL_COPY_READ_BUFFER, *Buffer);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, OldSize);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	glDeleteBuffers(1, Buffer);
+	*Buffer = NewBuffer;
+}
+
+const GL::cache::mesh* GL::cache::LoadObjStreamed(const char* Filename, float Scale, size_t MemoryBudget, vertex_layout Layout)
+{
+	mesh_identifier MeshIdentifier = { Filename, Scale, Layout, true };
+
+	auto Found = this->VertexBufferMap.find(MeshIdentifier);
+	if (Found != this->VertexBufferMap.end())
+	{
+		this->Use(&Found->second.Entry, true);
+		return &Found->second.Mesh;
+	}
+
+	mesh_entry& MeshEntry = this->VertexBufferMap[MeshIdentifier];
+	MeshEntry = {};
+	this->Use(&MeshEntry.Entry, false);
+	mesh& Mesh = MeshEntry.Mesh;
+	glGenBuffers(1, &Mesh.VertexBuffer);
+	glGenBuffers(1, &Mesh.IndexBuffer);
+
+	// Buffers are sized once from the file counts, the vertex buffer grows if welding was less effective than estimated
+	uint32_t VertexCapacity = 0;
+	bool Loaded = ObjParser::Stream(Filename, Scale, Layout, MemoryBudget,
+		[&](const obj_stream_info& Info)
+		{
+			Mesh.Descriptor = Info.Descriptor;
+			Mesh.IndexType  = GL_UNSIGNED_INT;
+			Mesh.BoundsMin  = Info.BoundsMin;
+			Mesh.BoundsMax  = Info.BoundsMax;
+			Mesh.BoundsCenter = (Info.BoundsMin + Info.BoundsMax) * 0.5f; // No second pass over the file, sphere around the box
+			Mesh.BoundsRadius = Vec3::Length(Info.BoundsMax - Info.BoundsMin) * 0.5f;
+			VertexCapacity  = Info.VertexCountEstimate;
+
+			// NOTE: Use GL_ARRAY_BUFFER target to avoid modifying the element buffer of the currently bound VAO
+			glBindBuffer(GL_ARRAY_BUFFER, Mesh.VertexBuffer);
+			glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)VertexCapacity * Info.Descriptor.Stride, nullptr, GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, Mesh.IndexBuffer);
+			glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)Info.IndexCount * sizeof(uint32_t), nullptr, GL_STATIC_DRAW);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+			return true;
+		},
+		[&](const obj_stream_chunk& Chunk)
+		{
+			GLsizeiptr Stride = Mesh.Descriptor.Stride;
+			uint32_t VertexCount = Chunk.VertexOffset + Chunk.VertexCount;
+			if (VertexCount > VertexCapacity)
+			{
+				uint32_t NewCapacity = std::max(VertexCount, VertexCapacity + VertexCapacity / 2);
+				GrowBuffer(&Mesh.VertexBuffer, (GLsizeiptr)Chunk.VertexOffset * Stride, (GLsizeiptr)NewCapacity * Stride);
+				VertexCapacity = NewCapacity;
+			}
+
+			glBindBuffer(GL_ARRAY_BUFFER, Mesh.VertexBuffer);
+			glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)Chunk.VertexOffset * Stride, (GLsizeiptr)Chunk.VertexCount * Stride, Chunk.Vertices);
+			glBindBuffer(GL_ARRAY_BUFFER, Mesh.IndexBuffer);
+			glBufferSubData(GL_ARRAY_BUFFER, (GLintptr)Chunk.IndexOffset * sizeof(uint32_t), (GLsizeiptr)Chunk.IndexCount * sizeof(uint32_t), Chunk.Indices);
+			glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+			Mesh.VertexCount = (int)VertexCount;
+			Mesh.IndexCount = (int)(Chunk.IndexOffset + Chunk.IndexCount);
+		});
+
+	if (!Loaded)
+	{
+		fprintf(stderr, "Cannot stream mesh '%s'\n", Filename);
+		Mesh.VertexCount = 0;
+		Mesh.IndexCount = 0;
+	}
+
+	Mesh.LodCount = 1;
+	Mesh.Lods[0] = { 0, (uint32_t)Mesh.IndexCount, 0.f, 0 };
+	MeshEntry.Entry.Bytes = (size_t)VertexCapacity * Mesh.Descriptor.Stride + (size_t)Mesh.IndexCount * sizeof(uint32_t);
+
+	this->Trim();
+	return &Mesh;
+}
+
+const GL::cache::mesh* GL::cache::LoadPrimitive(primitive_type Type, vertex_layout Layout, int Lon, int Lat)
+{
+	// Tessellation only matters for spheres
+	if (Type != PRIMITIVE_SPHERE)
+		Lon = Lat = 0;
+
+	primitive_identifier PrimitiveIdentifier = { Type, Layout, Lon, Lat };
+	auto Found = this->PrimitiveMap.find(PrimitiveIdentifier);
+	if (Found != this->PrimitiveMap.end())
+	{
+		this->Use(&Found->second.Entry, true);
+		return &Found->second.Mesh;
+	}
+
+	std::vector<vertex_full> Vertices(Primitives::GetVertexCount(Type, Lon, Lat));
+	std::vector<uint32_t> Indices(Primitives::GetIndexCount(Type, Lon, Lat));
+	Indices.resize(Primitives::Build(Type, Vertices.data(), Indices.data(), Lon, Lat));
+
+	mesh_entry& PrimitiveEntry = this->PrimitiveMap[PrimitiveIdentifier];
+	PrimitiveEntry = {};
+	this->Use(&PrimitiveEntry.Entry, false);
+	mesh& Primitive = PrimitiveEntry.Mesh;
+	Primitive.VertexCount = (int)Vertices.size();
+	Primitive.IndexCount = (int)Indices.size();
+	Primitive.LodCount = 1;
+	Primitive.Lods[0] = { 0, (uint32_t)Indices.size(), 0.f, 0 };
+
+	bounds PrimitiveBounds = Bounds::Compute(Vertices.data(), (int)Vertices.size());
+	Primitive.BoundsMin = PrimitiveBounds.Min;
+	Primitive.BoundsMax = PrimitiveBounds.Max;
+	Primitive.BoundsCenter = PrimitiveBounds.Center;
+	Primitive.BoundsRadius = PrimitiveBounds.Radius;
+	Primitive.Descriptor = Mesh::GetDescriptor(Layout, Primitive.BoundsMin, Primitive.BoundsMax);
+
+	std::vector<uint8_t> GpuVertices(Vertices.size() * Primitive.Descriptor.Stride);
+	Mesh::ConvertVertices(GpuVertices.data(), Primitive.Descriptor, Vertices.data(), (int)Vertices.size());
+
+	Primitive.IndexType = (Mesh::GetIndexSize(Primitive.VertexCount) == sizeof(uint32_t)) ? GL_UNSIGNED_INT : GL_UNSIGNED_SHORT;
+
+	glGenBuffers(1, &Primitive.VertexBuffer);
+	glGenBuffers(1, &Primitive.IndexBuffer);
+
+	glBindBuffer(GL_ARRAY_BUFFER, Primitive.VertexBuffer);
+	glBufferData(GL_ARRAY_BUFFER, GpuVertices.size(), GpuVertices.data(), GL_STATIC_DRAW);
+
+	// NOTE: Use GL_ARRAY_BUFFER target to avoid modifying the element buffer of the currently bound VAO
+	glBindBuffer(GL_ARRAY_BUFFER, Primitive.IndexBuffer);
+	if (Primitive.IndexType == GL_UNSIGNED_INT)
+		glBufferData(GL_ARRAY_BUFFER, Indices.size() * sizeof(uint32_t), Indices.data(), GL_STATIC_DRAW);
+	else
+	{
+		std::vector<uint16_t> ShortIndices(Indices.begin(), Indices.end());
+		glBufferData(GL_ARRAY_BUFFER, ShortIndices.size() * sizeof(uint16_t), ShortIndices.data(), GL_STATIC_DRAW);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	int IndexSize = (Primitive.IndexType == GL_UNSIGNED_INT) ? sizeof(uint32_t) : sizeof(uint16_t);
+	PrimitiveEntry.Entry.Bytes = GpuVertices.size() + Indices.size() * IndexSize;
+
+	this->Trim();
+	return &Primitive;
+}
+
+const GL::cache::mesh* GL::cache::LoadObjAsync(const char* Filename, float Scale, vertex_layout Layout)
+{
+	mesh_identifier MeshIdentifier = { Filename, Scale, Layout, false };
+
+	auto Found = this->VertexBufferMap.find(MeshIdentifier);
+	if (Found != this->VertexBufferMap.end())
+	{
+		this->Use(&Found->second.Entry, true);
+		return &Found->second.Mesh;
+	}
 
-	return MeshBuffer;
+	// Empty placeholder, attribute formats are already known (only the position dequantization is missing)
+	mesh_entry& MeshEntry = this->VertexBufferMap[MeshIdentifier];
+	MeshEntry = {};
+	MeshEntry.Entry.Loading = true;
+	this->Use(&MeshEntry.Entry, false);
+	mesh& Mesh = MeshEntry.Mesh;
+	glGenBuffers(1, &Mesh.VertexBuffer);
+	glGenBuffers(1, &Mesh.IndexBuffer);
+	Mesh.IndexType = GL_UNSIGNED_SHORT;
+	Mesh.Descriptor = Mesh::GetDescriptor(Layout);
+	Mesh.LodCount = 1;
+
+	std::shared_ptr<async_mesh> Pending = std::make_shared<async_mesh>();
+	Pending->Identifier = MeshIdentifier;
+	this->PendingMeshes.push_back(Pending);
+
+	Jobs::Submit([Pending]()
+	{
+		ReadMesh(&Pending->Data, Pending->Identifier.Filename, Pending->Identifier.Scale, Pending->Identifier.Layout);
+		Pending->Done = true;
+	});
+
+	return &Mesh;
 }
 
 GLuint GL::cache::LoadTexture(const char* Filename, int ImageFlags, int* WidthOut, int* HeightOut)
 {
-	texture_identifier TextureIdentifier = { Filename, ImageFlags };
+	texture_identifier TextureIdentifier = { Filename, ImageFlags, false };
+	this->WaitTexture(TextureIdentifier);
 	
 	auto Found = this->TextureMap.find(TextureIdentifier);
 	if (Found != this->TextureMap.end())
 	{
+		this->Use(&Found->second.Entry, true);
 		if (WidthOut)  *WidthOut  = Found->second.Width;
 		if (HeightOut) *HeightOut = Found->second.Height;
 		return Found->second.TextureID;
@@ -73,13 +534,624 @@ GLuint GL::cache::LoadTexture(const char* Filename, int ImageFlags, int* WidthOu
 	GLuint Texture;
 	glGenTextures(1, &Texture);
 	glBindTexture(GL_TEXTURE_2D, Texture);
-	int Width, Height;
-	GL::UploadTexture(Filename, ImageFlags, &Width, &Height);
+	int Width = 0, Height = 0;
+	size_t Bytes = 0;
+
+	// Texture cache with the mip chain, built on first load or by the bake tool
+	texture_cache Cache;
+	if (LoadTextureCache(&Cache, &Filename, 1, ImageFlags))
+	{
+		GL::UploadTextureCache(Cache);
+		Width = (int)Cache.Header->Width;
+		Height = (int)Cache.Header->Height;
+		Bytes = GetTextureBytes(*Cache.Header);
+		TextureCache::Release(&Cache);
+	}
 
 	if (WidthOut)  *WidthOut  = Width;
 	if (HeightOut) *HeightOut = Height;
 
-	this->TextureMap[TextureIdentifier] = { Texture, Width, Height };
+	texture& CachedTexture = this->TextureMap[TextureIdentifier];
+	CachedTexture = { Texture, Width, Height, {} };
+	CachedTexture.Entry.Bytes = Bytes;
+	this->Use(&CachedTexture.Entry, false);
+
+	this->Trim();
+	return Texture;
+}
+
+GLuint GL::cache::LoadCubemap(const char* const Faces[6], int ImageFlags)
+{
+	return this->LoadCubemapSources(Faces, TEXTURE_CACHE_MAX_FACES, ImageFlags);
+}
+
+GLuint GL::cache::LoadEquirectCubemap(const char* Filename, int ImageFlags)
+{
+	return this->LoadCubemapSources(&Filename, 1, ImageFlags | IMG_EQUIRECT | IMG_LINEAR);
+}
+
+GLuint GL::cache::LoadCubemapSources(const char* const* Sources, int SourceCount, int ImageFlags)
+{
+	std::string Filenames = Sources[0];
+	for (int Source = 1; Source < SourceCount; ++Source)
+		Filenames += std::string("\n") + Sources[Source];
+
+	texture_identifier TextureIdentifier = { Filenames, ImageFlags, false };
+	auto Found = this->TextureMap.find(TextureIdentifier);
+	if (Found != this->TextureMap.end())
+	{
+		this->Use(&Found->second.Entry, true);
+		return Found->second.TextureID;
+	}
+
+	GLuint Texture;
+	glGenTextures(1, &Texture);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, Texture);
+	int Size = 0;
+	size_t Bytes = 0;
+
+	texture_cache Cache;
+	if (LoadTextureCache(&Cache, Sources, SourceCount, ImageFlags))
+	{
+		GL::UploadTextureCache(Cache);
+		Size = (int)Cache.Header->Width;
+		Bytes = GetTextureBytes(*Cache.Header);
+		TextureCache::Release(&Cache);
+	}
+
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, (ImageFlags & IMG_GEN_MIPMAPS) ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+	texture& CachedTexture = this->TextureMap[TextureIdentifier];
+	CachedTexture = { Texture, Size, Size, {} };
+	CachedTexture.Entry.Bytes = Bytes;
+	this->Use(&CachedTexture.Entry, false);
 
+	this->Trim();
 	return Texture;
 }
+
+const GL::cache::atlas* GL::cache::LoadAtlas(const char* const* Filenames, int Count, int ImageFlags, int PageSize, int Padding)
+{
+	std::string Key;
+	for (int i = 0; i < Count; ++i)
+		Key += std::string(Filenames[i]) + "\n";
+	Key += std::to_string(PageSize) + "\n" + std::to_string(Padding);
+
+	texture_identifier AtlasIdentifier = { Key, ImageFlags, false };
+	auto Found = this->AtlasMap.find(AtlasIdentifier);
+	if (Found != this->AtlasMap.end())
+	{
+		this->Use(&Found->second.Entry, true);
+		return &Found->second.Atlas;
+	}
+
+	// Decoded concurrently, then packed and copied to the pages
+	std::vector<image> Images(Count);
+	std::vector<int> Widths(Count, 0);
+	std::vector<int> Heights(Count, 0);
+	std::vector<uint8_t> Decoded(Count, 0);
+	Jobs::ParallelFor(Count, [&](int i)
+	{
+		Decoded[i] = TextureCache::DecodeImage(&Images[i], Filenames[i], (ImageFlags & IMG_FLIP) | IMG_FORCE_RGBA);
+		if (Decoded[i])
+		{
+			Widths[i] = Images[i].Width;
+			Heights[i] = Images[i].Height;
+		}
+	});
+
+	std::vector<atlas_rect> Rects(Count);
+	int PageCount = TextureAtlas::Pack(Rects.data(), Widths.data(), Heights.data(), Count, PageSize, Padding);
+
+	std::vector<std::vector<uint8_t>> PageTexels(PageCount);
+	for (std::vector<uint8_t>& Texels : PageTexels)
+		Texels.assign((size_t)PageSize * PageSize * 4, 0);
+
+	Jobs::ParallelFor(Count, [&](int i)
+	{
+		if (Decoded[i] && Rects[i].Page >= 0)
+			TextureAtlas::Blit(PageTexels[Rects[i].Page].data(), PageSize, Images[i], Rects[i], Padding);
+	});
+
+	for (int i = 0; i < Count; ++i)
+		if (Decoded[i])
+			TextureCache::FreeImage(&Images[i]);
+
+	atlas_entry& AtlasEntry = this->AtlasMap[AtlasIdentifier];
+	AtlasEntry = {};
+	atlas& Atlas = AtlasEntry.Atlas;
+	Atlas.Pages.resize(PageCount);
+	glGenTextures(PageCount, Atlas.Pages.data());
+
+	// Mips stop where the padding between images is one texel
+	bool Mipmaps = (ImageFlags & IMG_GEN_MIPMAPS) != 0;
+	int MaxLevel = Mipmaps ? TextureAtlas::GetMaxLevel(Padding) : 0;
+	for (int Page = 0; Page < PageCount; ++Page)
+	{
+		glBindTexture(GL_TEXTURE_2D, Atlas.Pages[Page]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, PageSize, PageSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, PageTexels[Page].data());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, MaxLevel);
+		if (Mipmaps)
+			glGenerateMipmap(GL_TEXTURE_2D);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, Mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+		for (int Level = 0; Level <= MaxLevel; ++Level)
+			AtlasEntry.Entry.Bytes += (size_t)(PageSize >> Level) * (PageSize >> Level) * 4;
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	Atlas.Regions.resize(Count);
+	for (int i = 0; i < Count; ++i)
+	{
+		const atlas_rect& Rect = Rects[i];
+		atlas::region& Region = Atlas.Regions[i];
+		Region = {};
+		if (!Decoded[i] || Rect.Page < 0)
+			continue;
+
+		Region.Texture = Atlas.Pages[Rect.Page];
+		Region.UVMin = { (float)Rect.X / PageSize, (float)Rect.Y / PageSize };
+		Region.UVMax = { (float)(Rect.X + Rect.Width) / PageSize, (float)(Rect.Y + Rect.Height) / PageSize };
+		Region.Width = Rect.Width;
+		Region.Height = Rect.Height;
+	}
+
+	this->Use(&AtlasEntry.Entry, false);
+	this->Trim();
+	return &Atlas;
+}
+
+GLuint GL::cache::LoadTextureAsync(const char* Filename, int ImageFlags)
+{
+	return this->StartTextureLoad(texture_identifier{ Filename, ImageFlags, false });
+}
+
+GLuint GL::cache::LoadTextureStreamed(const char* Filename, int ImageFlags)
+{
+	return this->StartTextureLoad(texture_identifier{ Filename, ImageFlags, true });
+}
+
+GLuint GL::cache::StartTextureLoad(const texture_identifier& TextureIdentifier)
+{
+	int ImageFlags = TextureIdentifier.ImageFlags;
+	auto Found = this->TextureMap.find(TextureIdentifier);
+	if (Found != this->TextureMap.end())
+	{
+		this->Use(&Found->second.Entry, true);
+		return Found->second.TextureID;
+	}
+
+	// Checkerboard placeholder (with mipmaps if the final texture has some, so it is complete with the same sampling)
+	GLuint Texture;
+	glGenTextures(1, &Texture);
+	glBindTexture(GL_TEXTURE_2D, Texture);
+	GL::UploadCheckerboardTexture(ASYNC_TEXTURE_PLACEHOLDER_SIZE, ASYNC_TEXTURE_PLACEHOLDER_SIZE, ASYNC_TEXTURE_PLACEHOLDER_SQUARE);
+	if (ImageFlags & IMG_GEN_MIPMAPS)
+		glGenerateMipmap(GL_TEXTURE_2D);
+
+	texture& CachedTexture = this->TextureMap[TextureIdentifier];
+	CachedTexture = { Texture, 0, 0, {} };
+	CachedTexture.Entry.Loading = true;
+	CachedTexture.Entry.Bytes = ASYNC_TEXTURE_PLACEHOLDER_SIZE * ASYNC_TEXTURE_PLACEHOLDER_SIZE * 4 * sizeof(float);
+	this->Use(&CachedTexture.Entry, false);
+
+	std::shared_ptr<async_texture> Pending = std::make_shared<async_texture>();
+	Pending->Identifier = TextureIdentifier;
+	this->PendingTextures.push_back(Pending);
+
+	Jobs::Submit([Pending]()
+	{
+		const char* Filename = Pending->Identifier.Filename.c_str();
+		Pending->Loaded = LoadTextureCache(&Pending->Cache, &Filename, 1, Pending->Identifier.ImageFlags);
+		Pending->Done = true;
+	});
+
+	return Texture;
+}
+
+void GL::cache::FinishTexture(const std::shared_ptr<async_texture>& Pending)
+{
+	texture& Texture = this->TextureMap[Pending->Identifier];
+	Texture.Entry.Loading = false;
+	if (!Pending->Loaded)
+		return;
+
+	if (Pending->Identifier.Streamed)
+	{
+		this->StartStream(Pending, &Texture);
+		return;
+	}
+
+	Texture.Entry.Bytes = GetTextureBytes(*Pending->Cache.Header);
+	glBindTexture(GL_TEXTURE_2D, Texture.TextureID);
+	GL::UploadTextureCache(Pending->Cache);
+	Texture.Width = (int)Pending->Cache.Header->Width;
+	Texture.Height = (int)Pending->Cache.Header->Height;
+	TextureCache::Release(&Pending->Cache);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Free the storage of levels [FirstLevel, LastLevel] of the bound GL_TEXTURE_2D (zero sized images)
+static void ClearTextureLevels(int FirstLevel, int LastLevel)
+{
+	for (int Level = FirstLevel; Level <= LastLevel; ++Level)
+		glTexImage2D(GL_TEXTURE_2D, Level, GL_RGBA8, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+}
+
+// Bytes of levels [FirstLevel, LevelCount) of the first face
+static size_t GetLevelsBytes(const texture_cache_header& Header, int FirstLevel)
+{
+	size_t Bytes = 0;
+	for (uint32_t Level = (uint32_t)FirstLevel; Level < Header.LevelCount; ++Level)
+		Bytes += (size_t)Header.Levels[0][Level].Size;
+	return Bytes;
+}
+
+// Replace the placeholder by the mip tail of a loaded streamed texture
+void GL::cache::StartStream(const std::shared_ptr<async_texture>& Pending, texture* Texture)
+{
+	const texture_cache_header& Header = *Pending->Cache.Header;
+	Texture->Width = (int)Header.Width;
+	Texture->Height = (int)Header.Height;
+	if (Header.FaceCount != 1)
+	{
+		fprintf(stderr, "Only 2D textures can be streamed: '%s'\n", Pending->Identifier.Filename.c_str());
+		TextureCache::Release(&Pending->Cache);
+		return;
+	}
+
+	int TailLevel = (int)Header.LevelCount - 1;
+	while (TailLevel > 0 && (int)Math::Max(Header.Levels[0][TailLevel - 1].Width, Header.Levels[0][TailLevel - 1].Height) <= GL_CACHE_STREAM_TAIL_SIZE)
+		TailLevel--;
+
+	glBindTexture(GL_TEXTURE_2D, Texture->TextureID);
+	ClearTextureLevels(0, ASYNC_TEXTURE_PLACEHOLDER_LEVELS - 1);
+	GL::UploadTextureCacheLevels(Pending->Cache, TailLevel, Header.LevelCount - 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, TailLevel);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, Header.LevelCount - 1);
+	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, 0.f);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	Texture->Entry.Bytes = GetLevelsBytes(Header, TailLevel);
+
+	std::unique_ptr<texture_stream> Stream(new texture_stream());
+	Stream->Source = Pending;
+	Stream->TextureID = Texture->TextureID;
+	Stream->Entry = &Texture->Entry;
+	Stream->TailLevel = TailLevel;
+	Stream->ResidentLevel = TailLevel;
+	Stream->RequestedSize = 0.f;
+	Stream->MinLod = 0.f;
+	this->Streams.push_back(std::move(Stream));
+}
+
+void GL::cache::RequestTextureSize(GLuint Texture, float ScreenSize)
+{
+	for (const std::unique_ptr<texture_stream>& Stream : this->Streams)
+	{
+		if (Stream->TextureID == Texture)
+		{
+			Stream->RequestedSize = Math::Max(Stream->RequestedSize, ScreenSize);
+			return;
+		}
+	}
+}
+
+int GL::cache::StreamTextures(size_t UploadBudget)
+{
+	size_t Uploaded = 0;
+	bool UploadedOne = false;
+	bool Changed = false;
+	int MissingCount = 0;
+
+	for (const std::unique_ptr<texture_stream>& Stream : this->Streams)
+	{
+		const texture_cache& Cache = Stream->Source->Cache;
+		const texture_cache_header& Header = *Cache.Header;
+
+		// Finest level needed: one texel per pixel of the largest on-screen use
+		int WantedLevel = Stream->TailLevel;
+		if (Stream->RequestedSize > 0.f)
+		{
+			float TexelsPerPixel = (float)Math::Max(Header.Width, Header.Height) / Stream->RequestedSize;
+			WantedLevel = Math::Clamp((int)floorf(log2f(Math::Max(TexelsPerPixel, 1.f))), 0, Stream->TailLevel);
+		}
+		Stream->RequestedSize = 0.f;
+
+		int BaseLevel = Stream->ResidentLevel;
+		float MinLod = Stream->MinLod;
+		glBindTexture(GL_TEXTURE_2D, Stream->TextureID);
+
+		// Coarsest missing level first, sampling stays on the previous level until faded in
+		while (Stream->ResidentLevel > WantedLevel)
+		{
+			int Level = Stream->ResidentLevel - 1;
+			size_t LevelSize = (size_t)Header.Levels[0][Level].Size;
+			if (UploadedOne && Uploaded + LevelSize > UploadBudget)
+				break;
+
+			GL::UploadTextureCacheLevels(Cache, Level, Level);
+			Uploaded += LevelSize;
+			UploadedOne = true;
+			Stream->ResidentLevel = Level;
+			Stream->MinLod += 1.f;
+		}
+
+		if (Stream->ResidentLevel > WantedLevel)
+			MissingCount++;
+
+		// Levels are dropped once two levels finer than needed (no upload/drop cycles around a level switch)
+		if (WantedLevel > Stream->ResidentLevel + 1)
+		{
+			ClearTextureLevels(Stream->ResidentLevel, WantedLevel - 1);
+			Stream->ResidentLevel = WantedLevel;
+			Stream->MinLod = 0.f;
+		}
+
+		Stream->MinLod = Math::Max(0.f, Stream->MinLod - GL_CACHE_STREAM_FADE);
+		if (Stream->ResidentLevel != BaseLevel)
+		{
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, Stream->ResidentLevel);
+			Stream->Entry->Bytes = GetLevelsBytes(Header, Stream->ResidentLevel);
+			Changed = true;
+		}
+		if (Stream->MinLod != MinLod)
+			glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_LOD, Stream->MinLod);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	if (Changed)
+		this->Trim();
+
+	return MissingCount;
+}
+
+void GL::cache::FinishMesh(const std::shared_ptr<async_mesh>& Pending)
+{
+	mesh_entry& MeshEntry = this->VertexBufferMap[Pending->Identifier];
+	MeshEntry.Entry.Bytes = UploadMesh(&MeshEntry.Mesh, &Pending->Data);
+	MeshEntry.Entry.Loading = false;
+}
+
+void GL::cache::WaitTexture(const texture_identifier& Identifier)
+{
+	for (auto It = this->PendingTextures.begin(); It != this->PendingTextures.end(); ++It)
+	{
+		const std::shared_ptr<async_texture>& Pending = *It;
+		if (!(Pending->Identifier == Identifier))
+			continue;
+
+		while (!Pending->Done)
+			std::this_thread::yield();
+		this->FinishTexture(Pending);
+		this->PendingTextures.erase(It);
+		return;
+	}
+}
+
+void GL::cache::WaitMesh(const mesh_identifier& Identifier)
+{
+	for (auto It = this->PendingMeshes.begin(); It != this->PendingMeshes.end(); ++It)
+	{
+		const std::shared_ptr<async_mesh>& Pending = *It;
+		if (!(Pending->Identifier == Identifier))
+			continue;
+
+		while (!Pending->Done)
+			std::this_thread::yield();
+		this->FinishMesh(Pending);
+		this->PendingMeshes.erase(It);
+		return;
+	}
+}
+
+int GL::cache::FinishAsyncLoads(double TimeBudget)
+{
+	auto StartTime = std::chrono::steady_clock::now();
+	bool FinishedOne = false;
+	auto HasTimeLeft = [&]()
+	{
+		return !FinishedOne || std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - StartTime).count() < TimeBudget;
+	};
+
+	for (auto It = this->PendingMeshes.begin(); It != this->PendingMeshes.end() && HasTimeLeft();)
+	{
+		if (!(*It)->Done)
+		{
+			++It;
+			continue;
+		}
+		this->FinishMesh(*It);
+		It = this->PendingMeshes.erase(It);
+		FinishedOne = true;
+	}
+
+	for (auto It = this->PendingTextures.begin(); It != this->PendingTextures.end() && HasTimeLeft();)
+	{
+		if (!(*It)->Done)
+		{
+			++It;
+			continue;
+		}
+		this->FinishTexture(*It);
+		It = this->PendingTextures.erase(It);
+		FinishedOne = true;
+	}
+
+	if (FinishedOne)
+		this->Trim();
+
+	return (int)(this->PendingMeshes.size() + this->PendingTextures.size());
+}
+
+void GL::cache::ReleaseTexture(GLuint Texture)
+{
+	for (auto& KeyValue : this->TextureMap)
+	{
+		if (KeyValue.second.TextureID != Texture)
+			continue;
+
+		if (KeyValue.second.Entry.RefCount > 0)
+			KeyValue.second.Entry.RefCount--;
+		else
+			fprintf(stderr, "Texture '%s' released more than loaded\n", KeyValue.first.Filename.c_str());
+		this->Trim();
+		return;
+	}
+}
+
+void GL::cache::ReleaseMesh(GLuint VertexBuffer)
+{
+	entry* Entry = nullptr;
+	for (auto& KeyValue : this->VertexBufferMap)
+		if (KeyValue.second.Mesh.VertexBuffer == VertexBuffer)
+			Entry = &KeyValue.second.Entry;
+	for (auto& KeyValue : this->PrimitiveMap)
+		if (KeyValue.second.Mesh.VertexBuffer == VertexBuffer)
+			Entry = &KeyValue.second.Entry;
+
+	if (Entry == nullptr)
+		return;
+
+	if (Entry->RefCount > 0)
+		Entry->RefCount--;
+	else
+		fprintf(stderr, "Mesh released more than loaded\n");
+	this->Trim();
+}
+
+void GL::cache::ReleaseAtlas(const atlas* Atlas)
+{
+	for (auto& KeyValue : this->AtlasMap)
+	{
+		if (&KeyValue.second.Atlas != Atlas)
+			continue;
+
+		if (KeyValue.second.Entry.RefCount > 0)
+			KeyValue.second.Entry.RefCount--;
+		else
+			fprintf(stderr, "Atlas released more than loaded\n");
+		this->Trim();
+		return;
+	}
+}
+
+void GL::cache::SetBudget(size_t Bytes)
+{
+	this->Budget = Bytes;
+	this->Trim();
+}
+
+// Delete the buffers and erase the mesh entry of Map owning Entry, false if not found
+template<typename mesh_map>
+static bool EraseMesh(mesh_map* Map, const void* Entry)
+{
+	for (auto It = Map->begin(); It != Map->end(); ++It)
+	{
+		if (&It->second.Entry != Entry)
+			continue;
+		glDeleteBuffers(1, &It->second.Mesh.VertexBuffer);
+		glDeleteBuffers(1, &It->second.Mesh.IndexBuffer);
+		Map->erase(It);
+		return true;
+	}
+	return false;
+}
+
+template<typename atlas_map>
+static bool EraseAtlas(atlas_map* Map, const void* Entry)
+{
+	for (auto It = Map->begin(); It != Map->end(); ++It)
+	{
+		if (&It->second.Entry != Entry)
+			continue;
+		glDeleteTextures((GLsizei)It->second.Atlas.Pages.size(), It->second.Atlas.Pages.data());
+		Map->erase(It);
+		return true;
+	}
+	return false;
+}
+
+// Delete the least recently used unreferenced resources while the cache is over budget, and update the stats
+void GL::cache::Trim()
+{
+	for (;;)
+	{
+		this->Stats.TextureBytes = 0;
+		this->Stats.MeshBytes = 0;
+		this->Stats.TextureCount = (int)this->TextureMap.size();
+		for (const auto& KeyValue : this->AtlasMap)
+			this->Stats.TextureCount += (int)KeyValue.second.Atlas.Pages.size();
+		this->Stats.MeshCount = (int)(this->VertexBufferMap.size() + this->PrimitiveMap.size());
+
+		const entry* Oldest = nullptr;
+		auto Visit = [&](const entry& Entry, size_t* Bytes)
+		{
+			*Bytes += Entry.Bytes;
+			if (Entry.RefCount == 0 && !Entry.Loading && (Oldest == nullptr || Entry.LastUse < Oldest->LastUse))
+				Oldest = &Entry;
+		};
+		for (const auto& KeyValue : this->TextureMap)
+			Visit(KeyValue.second.Entry, &this->Stats.TextureBytes);
+		for (const auto& KeyValue : this->AtlasMap)
+			Visit(KeyValue.second.Entry, &this->Stats.TextureBytes);
+		for (const auto& KeyValue : this->VertexBufferMap)
+			Visit(KeyValue.second.Entry, &this->Stats.MeshBytes);
+		for (const auto& KeyValue : this->PrimitiveMap)
+			Visit(KeyValue.second.Entry, &this->Stats.MeshBytes);
+
+		this->Stats.StreamedCount = (int)this->Streams.size();
+		this->Stats.StreamedBytes = 0;
+		this->Stats.StreamedFullBytes = 0;
+		for (const std::unique_ptr<texture_stream>& Stream : this->Streams)
+		{
+			this->Stats.StreamedBytes += Stream->Entry->Bytes;
+			this->Stats.StreamedFullBytes += GetLevelsBytes(*Stream->Source->Cache.Header, 0);
+		}
+
+		if (this->Stats.TextureBytes + this->Stats.MeshBytes <= this->Budget || Oldest == nullptr)
+			return;
+
+		if (!EraseMesh(&this->VertexBufferMap, Oldest) && !EraseMesh(&this->PrimitiveMap, Oldest) && !EraseAtlas(&this->AtlasMap, Oldest))
+		{
+			for (auto It = this->TextureMap.begin(); It != this->TextureMap.end(); ++It)
+			{
+				if (&It->second.Entry != Oldest)
+					continue;
+				for (auto Stream = this->Streams.begin(); Stream != this->Streams.end(); ++Stream)
+				{
+					if ((*Stream)->TextureID != It->second.TextureID)
+						continue;
+					TextureCache::Release(&(*Stream)->Source->Cache);
+					this->Streams.erase(Stream);
+					break;
+				}
+				glDeleteTextures(1, &It->second.TextureID);
+				this->TextureMap.erase(It);
+				break;
+			}
+		}
+		this->Stats.Evictions++;
+	}
+}
+
+void GL::cache::InspectStats()
+{
+	const float MiB = 1024.f * 1024.f;
+	ImGui::Text("Textures: %d (%.1f MiB)", this->Stats.TextureCount, this->Stats.TextureBytes / MiB);
+	ImGui::Text("Meshes: %d (%.1f MiB)", this->Stats.MeshCount, this->Stats.MeshBytes / MiB);
+	ImGui::Text("Hits: %d, misses: %d, evictions: %d", this->Stats.Hits, this->Stats.Misses, this->Stats.Evictions);
+	ImGui::Text("Streamed textures: %d (%.1f / %.1f MiB resident)", this->Stats.StreamedCount, this->Stats.StreamedBytes / MiB, this->Stats.StreamedFullBytes / MiB);
+
+	int BudgetMiB = (int)(this->Budget / (1024 * 1024));
+	if (ImGui::SliderInt("Budget (MiB)", &BudgetMiB, 16, 4096))
+		this->SetBudget((size_t)BudgetMiB * 1024 * 1024);
+}
@@ -2,49 +2,248 @@
 
 #include <string>
 #include <vector>
-#include <map>
+#include <unordered_map>
+#include <memory>
 
 #include "opengl_headers.h"
 #include "mesh.h"
+#include "meshlet.h"
+#include "mesh_lod.h"
+#include "bounds.h"
+#include "primitives.h"
+#include "obj_parser.h"
+#include "texture_atlas.h"
+
+// Default VRAM budget of GL::cache (see SetBudget)
+const size_t GL_CACHE_DEFAULT_BUDGET = (size_t)512 * 1024 * 1024;
+
+// Streamed textures (see LoadTextureStreamed)
+const int GL_CACHE_STREAM_TAIL_SIZE = 64;                              // Levels up to this size are uploaded at once
+const size_t GL_CACHE_DEFAULT_STREAM_BUDGET = (size_t)4 * 1024 * 1024; // Bytes uploaded per StreamTextures call
+const float GL_CACHE_STREAM_FADE = 0.25f;                              // GL_TEXTURE_MIN_LOD step per StreamTextures call
 
 namespace GL
 {
+	// Resources are shared and reference counted: every Load* call adds a reference, released with ReleaseTexture/ReleaseMesh.
+	// Unreferenced resources stay on gpu for later loads until the cache is over its VRAM budget, then the least recently used are deleted.
 	class cache
 	{
 	public:
+		// Indexed mesh on gpu (draw with glDrawElements)
+		struct mesh
+		{
+			GLuint VertexBuffer;
+			GLuint IndexBuffer;
+			GLenum IndexType; // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+			int VertexCount;
+			int IndexCount; // Indices of LOD 0
+			vertex_descriptor Descriptor; // Vertex layout on gpu (packed layouts need GL::UniformVertexDescriptor)
+			std::vector<meshlet> Meshlets; // Index ranges with culling bounds (see Meshlet::Cull)
+			int LodCount; // LOD 0 is the full mesh, other LODs are stored after it in the index buffer
+			mesh_lod Lods[MESH_MAX_LODS];
+			v3 BoundsMin;
+			v3 BoundsMax;
+			v3 BoundsCenter; // Bounding sphere
+			float BoundsRadius;
+			std::vector<bounds> Shapes; // Per OBJ shape ('o'/'g' groups, in file order), empty for primitives and streamed meshes
+		};
+
+		// Images packed in shared pages: sprites of a page can be drawn in one batch without rebinding
+		struct atlas
+		{
+			struct region
+			{
+				GLuint Texture; // Page, 0 if the image could not be loaded or packed
+				v2 UVMin;       // Image corners in the page (padding excluded)
+				v2 UVMax;
+				int Width;
+				int Height;
+			};
+
+			std::vector<GLuint> Pages;   // RGBA8 GL_TEXTURE_2D
+			std::vector<region> Regions; // In the order of the loaded files
+		};
+
+		// Byte counts are estimated from the uploaded data (all levels and faces, vertices and indices of all LODs)
+		struct stats
+		{
+			size_t TextureBytes;
+			size_t MeshBytes;
+			int TextureCount;
+			int MeshCount; // Meshes and primitives
+			int Hits;
+			int Misses;
+			int Evictions;
+			int StreamedCount;
+			size_t StreamedBytes; // Resident levels of streamed textures (part of TextureBytes)
+			size_t StreamedFullBytes; // With every level resident
+		};
+
         cache();
         ~cache();
-        GLuint LoadObj(const char* Filename, float Scale, int* VertexCountOut, vertex_descriptor* DescOut);
+        GLuint LoadObj(const char* Filename, float Scale, mesh* MeshOut, vertex_descriptor* DescOut, vertex_layout Layout = VERTEX_LAYOUT_FULL);
 		GLuint LoadTexture(const char* Filename, int ImageFlags = 0, int* WidthOut = nullptr, int* HeightOut = nullptr);
 
+		// GL_TEXTURE_CUBE_MAP from 6 images (+X, -X, +Y, -Y, +Z, -Z) of the same size, decoded concurrently and cached as one file.
+		// Edges are clamped, filtering is trilinear with IMG_GEN_MIPMAPS and linear otherwise. Released with ReleaseTexture.
+		GLuint LoadCubemap(const char* const Faces[6], int ImageFlags = 0);
+
+		// HDR cubemap from one equirectangular panorama (.hdr decoded in float), converted once on worker threads and cached as half-float faces
+		// with their mip chain (IMG_EQUIRECT | IMG_LINEAR are added, see TextureCache). Released with ReleaseTexture.
+		GLuint LoadEquirectCubemap(const char* Filename, int ImageFlags = IMG_FLOAT16 | IMG_GEN_MIPMAPS);
+
+		// Async loads return at once with a placeholder (checkerboard texture, mesh without indices) which is filled once loaded.
+		// Files are read and decoded on background jobs, the gpu upload happens in FinishAsyncLoads (render thread).
+		// Sync loads of a file being loaded asynchronously wait for it.
+		GLuint LoadTextureAsync(const char* Filename, int ImageFlags = 0);
+		const mesh* LoadObjAsync(const char* Filename, float Scale, vertex_layout Layout = VERTEX_LAYOUT_FULL); // Buffer names are valid at once, IndexCount is 0 until loaded
+
+		// Streamed texture (2D only): the mip tail is uploaded once the file is loaded in background, finer levels are uploaded by
+		// StreamTextures as the renderer asks for them with RequestTextureSize, and dropped once they are not needed anymore.
+		// Sampling is clamped to the resident levels with GL_TEXTURE_BASE_LEVEL, new levels are faded in with GL_TEXTURE_MIN_LOD.
+		GLuint LoadTextureStreamed(const char* Filename, int ImageFlags = IMG_GEN_MIPMAPS);
+
+		// Screen coverage of a streamed texture: size in pixels of its largest on-screen use this frame (the max of the calls is kept).
+		// Textures without request during a frame drop back to their mip tail.
+		void RequestTextureSize(GLuint Texture, float ScreenSize);
+
+		// Upload or drop levels from the requests of the previous frame, until UploadBudget bytes are uploaded (at least one level per call).
+		// Returns the number of textures still missing levels
+		int StreamTextures(size_t UploadBudget = GL_CACHE_DEFAULT_STREAM_BUDGET);
+
+		// Decode Count images concurrently and pack them in atlas pages (see TextureAtlas), shared by loads of the same files and parameters.
+		// IMG_FLIP and IMG_GEN_MIPMAPS are used (mips up to TextureAtlas::GetMaxLevel(Padding)), images are converted to RGBA.
+		const atlas* LoadAtlas(const char* const* Filenames, int Count, int ImageFlags = IMG_FLIP | IMG_GEN_MIPMAPS,
+			int PageSize = TEXTURE_ATLAS_DEFAULT_PAGE_SIZE, int Padding = TEXTURE_ATLAS_DEFAULT_PADDING);
+
+		// Out-of-core load for meshes bigger than memory (see ObjParser::Stream): chunks are uploaded as they are parsed.
+		// No cache file, LODs or meshlets, indices are 32 bits.
+		const mesh* LoadObjStreamed(const char* Filename, float Scale, size_t MemoryBudget = OBJ_STREAM_DEFAULT_BUDGET, vertex_layout Layout = VERTEX_LAYOUT_FULL);
+
+		// Procedural primitives (see Primitives), generated once and shared by every user
+		const mesh* LoadPrimitive(primitive_type Type, vertex_layout Layout = VERTEX_LAYOUT_FULL, int Lon = PRIMITIVE_SPHERE_LON, int Lat = PRIMITIVE_SPHERE_LAT);
+
+		// Upload decoded resources until TimeBudget (ms) is spent (at least one per call), returns the number of loads still pending
+		int FinishAsyncLoads(double TimeBudget);
+
+		// Remove one reference (Texture returned by LoadTexture*, VertexBuffer of a mesh returned by LoadObj*/LoadPrimitive)
+		void ReleaseTexture(GLuint Texture);
+		void ReleaseMesh(GLuint VertexBuffer);
+		void ReleaseAtlas(const atlas* Atlas);
+
+		// Map the archive written by the bake tool (see AssetArchive): baked files are then read from it before the loose files.
+		// Mount before the first load, the archive stays mapped until the cache is destroyed.
+		bool MountArchive(const char* Filename);
+
+		void SetBudget(size_t Bytes); // Unreferenced resources are evicted at once if needed
+		const stats& GetStats() const { return Stats; }
+		void InspectStats(); // ImGui
+
 	private:
-		struct mesh
+		struct async_texture;
+		struct async_mesh;
+		struct texture_stream;
+
+		struct mesh_identifier
 		{
-			GLuint VertexBuffer;
-			int Size;
+			std::string Filename;
+			float Scale;
+			vertex_layout Layout;
+			bool Streamed; // LoadObjStreamed (no LODs and meshlets)
+
+			bool operator==(const mesh_identifier& Other) const
+			{
+				return Filename == Other.Filename && Scale == Other.Scale && Layout == Other.Layout && Streamed == Other.Streamed;
+			}
+		};
+
+		struct primitive_identifier
+		{
+			primitive_type Type;
+			vertex_layout Layout;
+			int Lon;
+			int Lat;
+
+			bool operator==(const primitive_identifier& Other) const
+			{
+				return Type == Other.Type && Layout == Other.Layout && Lon == Other.Lon && Lat == Other.Lat;
+			}
 		};
 
 		struct texture_identifier
 		{
-			std::string Filename;
+			std::string Filename; // Cubemaps: the 6 faces separated by '\n', atlases: the files then page size and padding
 			int ImageFlags;
+			bool Streamed; // LoadTextureStreamed (levels come and go)
 
-			bool operator<(const texture_identifier& Other) const
+			bool operator==(const texture_identifier& Other) const
 			{
-				return Filename < Other.Filename;
+				return Filename == Other.Filename && ImageFlags == Other.ImageFlags && Streamed == Other.Streamed;
 			}
 		};
 
+		// Hash of every load parameter (File::Hash)
+		struct identifier_hash
+		{
+			size_t operator()(const mesh_identifier& Identifier) const;
+			size_t operator()(const primitive_identifier& Identifier) const;
+			size_t operator()(const texture_identifier& Identifier) const;
+		};
+
+		// Bookkeeping of a cached resource
+		struct entry
+		{
+			int RefCount;
+			uint64_t LastUse; // UseClock at the last load
+			size_t Bytes;
+			bool Loading; // Async load not uploaded yet, cannot be evicted
+		};
+
 		struct texture
 		{
 			GLuint TextureID;
 			int Width;
 			int Height;
+			entry Entry;
+		};
+
+		struct mesh_entry
+		{
+			mesh Mesh;
+			entry Entry;
 		};
 
-		std::vector<vertex_full> TmpBuffer;
-		std::map<std::string, mesh> VertexBufferMap;
-		std::map<texture_identifier, texture> TextureMap;
-		vertex_descriptor MeshDesc;
+		struct atlas_entry
+		{
+			atlas Atlas;
+			entry Entry;
+		};
+
+		// Node based: meshes returned by pointer stay valid until evicted
+		std::unordered_map<mesh_identifier, mesh_entry, identifier_hash> VertexBufferMap;
+		std::unordered_map<texture_identifier, texture, identifier_hash> TextureMap;
+		std::unordered_map<primitive_identifier, mesh_entry, identifier_hash> PrimitiveMap;
+		std::unordered_map<texture_identifier, atlas_entry, identifier_hash> AtlasMap;
+
+		size_t Budget = GL_CACHE_DEFAULT_BUDGET;
+		uint64_t UseClock = 0;
+		stats Stats = {};
+
+		// Loads waiting for their upload (shared with the background jobs)
+		std::vector<std::shared_ptr<async_texture>> PendingTextures;
+		std::vector<std::shared_ptr<async_mesh>> PendingMeshes;
+
+		// Loaded streamed textures (the texture cache file stays mapped)
+		std::vector<std::unique_ptr<texture_stream>> Streams;
+
+		void FinishTexture(const std::shared_ptr<async_texture>& Pending);
+		void FinishMesh(const std::shared_ptr<async_mesh>& Pending);
+		void WaitTexture(const texture_identifier& Identifier);
+		void WaitMesh(const mesh_identifier& Identifier);
+		GLuint StartTextureLoad(const texture_identifier& Identifier);
+		GLuint LoadCubemapSources(const char* const* Sources, int SourceCount, int ImageFlags);
+		void StartStream(const std::shared_ptr<async_texture>& Pending, texture* Texture);
+		void Use(entry* Entry, bool Hit);
+		void Trim();
 	};
 }
@@ -9,14 +9,28 @@ using namespace GL;
 
 static const char* gWireframeVertexShaderStr = R"GLSL(
 layout(location = 0) in vec3 aPosition;
-layout(location = 1) in vec3 aBC;
 uniform mat4 uModelViewProj;
+
+void main()
+{
+    gl_Position = uModelViewProj * vec4(decodePosition(aPosition), 1.0);
+})GLSL";
+
+// Barycentric coords are generated per triangle (vertices can be shared by indexed meshes)
+static const char* gWireframeGeometryShaderStr = R"GLSL(
+layout(triangles) in;
+layout(triangle_strip, max_vertices = 3) out;
 out vec3 vBC;
 
 void main()
 {
-    vBC = aBC;
-    gl_Position = uModelViewProj * vec4(aPosition, 1.0);
+    for (int i = 0; i < 3; ++i)
+    {
+        vBC = vec3(i == 0, i == 1, i == 2);
+        gl_Position = gl_in[i].gl_Position;
+        EmitVertex();
+    }
+    EndPrimitive();
 })GLSL";
 
 static const char* gWireframeFragmentShaderStr = R"GLSL(
@@ -39,45 +53,39 @@ void main()
 
 wireframe_renderer::wireframe_renderer()
 {
-	Program = GL::CreateProgram(gWireframeVertexShaderStr, gWireframeFragmentShaderStr);
-	glGenBuffers(1, &BaryBuffer);
+	GLuint VertexShader   = GL::CompileShader(GL_VERTEX_SHADER, gWireframeVertexShaderStr);
+	GLuint GeometryShader = GL::CompileShader(GL_GEOMETRY_SHADER, gWireframeGeometryShaderStr);
+	GLuint FragmentShader = GL::CompileShader(GL_FRAGMENT_SHADER, gWireframeFragmentShaderStr);
+
+	Program = glCreateProgram();
+	glAttachShader(Program, VertexShader);
+	glAttachShader(Program, GeometryShader);
+	glAttachShader(Program, FragmentShader);
+	glLinkProgram(Program);
+
+	glDeleteShader(VertexShader);
+	glDeleteShader(GeometryShader);
+	glDeleteShader(FragmentShader);
+
 	glGenVertexArrays(1, &VAO);
 	glBindVertexArray(VAO);
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
 }
 
 wireframe_renderer::~wireframe_renderer()
 {
 	glDeleteProgram(Program);
 	glDeleteVertexArrays(1, &VAO);
-	glDeleteBuffers(1, &BaryBuffer);
 }
 
 void wireframe_renderer::SendBindBuffer(const wireframe_renderer::cmd_bind_buffer& Cmd)
 {
-	assert(Cmd.VertexCount % 3 == 0);
-
-	// Resize barycentric coords buffer as needed
-	if (Cmd.VertexCount > (int)BaryBufferData.size())
-	{
-		int OldSize = (int)BaryBufferData.size();
-		BaryBufferData.resize(Cmd.VertexCount);
-		for (int i = OldSize; i < Cmd.VertexCount; i += 3)
-		{
-			BaryBufferData[i + 0] = { 1.f, 0.f, 0.f };
-			BaryBufferData[i + 1] = { 0.f, 1.f, 0.f };
-			BaryBufferData[i + 2] = { 0.f, 0.f, 1.f };
-		}
-		glBindBuffer(GL_ARRAY_BUFFER, BaryBuffer);
-		glBufferData(GL_ARRAY_BUFFER, BaryBufferData.size() * sizeof(v3), &BaryBufferData[0], GL_STATIC_DRAW);
-		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
-	}
-
 	// Bind position buffer
 	glBindBuffer(GL_ARRAY_BUFFER, Cmd.MeshVBO);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, Cmd.PositionStride, (void*)(size_t)Cmd.PositionOffset);
+	GL::VertexAttribPointer(0, Cmd.Descriptor, VERTEX_ATTRIBUTE_POSITION);
+	GL::UniformVertexDescriptor(Program, Cmd.Descriptor);
 
+	// Bind index buffer (0 for non indexed meshes)
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, Cmd.IndexBuffer);
 }
 
 void wireframe_renderer::SendDrawArray(const wireframe_renderer::cmd_draw_array& Cmd)
@@ -88,6 +96,12 @@ void wireframe_renderer::SendDrawArray(const wireframe_renderer::cmd_draw_array&
 	glDrawArrays(GL_TRIANGLES, Cmd.First, Cmd.Count);
 }
 
+void wireframe_renderer::SendDrawElements(const wireframe_renderer::cmd_draw_elements& Cmd)
+{
+	glUniformMatrix4fv(glGetUniformLocation(Program, "uModelViewProj"), 1, GL_FALSE, Cmd.MVP.e);
+	glDrawElements(GL_TRIANGLES, Cmd.Count, Cmd.IndexType, nullptr);
+}
+
 void wireframe_renderer::Flush()
 {
 	glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 1234, -1, "Wireframe::flush");
@@ -122,6 +136,10 @@ void wireframe_renderer::Flush()
 		case command_type::DRAW_ARRAY:
 			SendDrawArray(Command.DrawArray);
 			break;
+
+		case command_type::DRAW_ELEMENTS:
+			SendDrawElements(Command.DrawElements);
+			break;
 		}
 	}
 	Commands.clear();
@@ -134,15 +152,14 @@ void wireframe_renderer::Flush()
 	glPopDebugGroup();
 }
 
-void wireframe_renderer::BindBuffer(GLuint MeshVBO, GLsizei PositionStride, GLsizei PositionOffset, int VertexCount)
+void wireframe_renderer::BindBuffer(GLuint MeshVBO, const vertex_descriptor& Descriptor, GLuint IndexBuffer)
 {
 	command Command;
 	Command.Type = command_type::BIND_BUFFER;
 	Command.BindBuffer = {};
 	Command.BindBuffer.MeshVBO = MeshVBO;
-	Command.BindBuffer.PositionStride = PositionStride;
-	Command.BindBuffer.PositionOffset = PositionOffset;
-	Command.BindBuffer.VertexCount = VertexCount;
+	Command.BindBuffer.Descriptor = Descriptor;
+	Command.BindBuffer.IndexBuffer = IndexBuffer;
 	Commands.push_back(Command);
 }
 
@@ -156,3 +173,15 @@ void wireframe_renderer::DrawArray(GLint First, GLsizei Count, const mat4& MVP)
 	Command.DrawArray.MVP = MVP;
 	Commands.push_back(Command);
 }
+
+
+void wireframe_renderer::DrawElements(GLsizei Count, GLenum IndexType, const mat4& MVP)
+{
+	command Command;
+	Command.Type = command_type::DRAW_ELEMENTS;
+	Command.DrawElements = {};
+	Command.DrawElements.Count = Count;
+	Command.DrawElements.IndexType = IndexType;
+	Command.DrawElements.MVP = MVP;
+	Commands.push_back(Command);
+}
@@ -3,6 +3,7 @@
 #include <vector>
 
 #include "maths.h"
+#include "mesh.h"
 
 #include "opengl_headers.h"
 
@@ -14,23 +15,24 @@ namespace GL
 		wireframe_renderer();
 		~wireframe_renderer();
 
-		void BindBuffer(GLuint MeshVBO, GLsizei PositionStride, GLsizei PositionOffset, int VertexCount);
+		void BindBuffer(GLuint MeshVBO, const vertex_descriptor& Descriptor, GLuint IndexBuffer = 0);
 		void DrawArray(GLint First, GLsizei Count, const mat4& MVP);
+		void DrawElements(GLsizei Count, GLenum IndexType, const mat4& MVP);
 		void Flush();
 
 	private:	
 		enum class command_type
 		{
 			BIND_BUFFER,
-			DRAW_ARRAY
+			DRAW_ARRAY,
+			DRAW_ELEMENTS
 		};
 
 		struct cmd_bind_buffer
 		{
 			GLuint MeshVBO;
-			GLsizei PositionStride;
-			GLsizei PositionOffset;
-			int VertexCount;
+			vertex_descriptor Descriptor;
+			GLuint IndexBuffer;
 		};
 		
 		struct cmd_draw_array
@@ -40,6 +42,13 @@ namespace GL
 			mat4 MVP;
 		};
 
+		struct cmd_draw_elements
+		{
+			GLsizei Count;
+			GLenum IndexType;
+			mat4 MVP;
+		};
+
 		struct command
 		{
 			command_type Type;
@@ -47,16 +56,16 @@ namespace GL
 			{
 				cmd_bind_buffer BindBuffer;
 				cmd_draw_array DrawArray;
+				cmd_draw_elements DrawElements;
 			};
 		};
 	
 		void SendBindBuffer(const cmd_bind_buffer& Cmd);
 		void SendDrawArray(const cmd_draw_array& Cmd);
+		void SendDrawElements(const cmd_draw_elements& Cmd);
 
 		GLuint Program = 0;
 		GLuint VAO = 0;
-		std::vector<v3> BaryBufferData;
-		GLuint BaryBuffer = 0;
 		std::vector<command> Commands;
 	};
 }
\ No newline at end of file
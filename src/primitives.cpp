@@ -0,0 +1,158 @@
+#include <cstdio>
+#include <vector>
+
+#include "maths.h"
+
+#include "primitives.h"
+
+// Copy the quad transformed by Transform (rotation and translation only) after Vertices
+static int AddFace(vertex_full* Vertices, uint32_t* Indices, int FaceIndex, const mat4& Transform)
+{
+    vertex_full* FaceVertices = Vertices + FaceIndex * Primitives::GetQuadVertexCount();
+    uint32_t* FaceIndices = Indices + FaceIndex * Primitives::GetQuadIndexCount();
+
+    Primitives::BuildQuad(FaceVertices, FaceIndices);
+    for (int i = 0; i < Primitives::GetQuadVertexCount(); ++i)
+    {
+        vertex_full& Vertex = FaceVertices[i];
+        Vertex.Position = (Transform * Vec4::vec4(Vertex.Position, 1.f)).xyz;
+        Vertex.Normal   = (Transform * Vec4::vec4(Vertex.Normal, 0.f)).xyz;
+        Vertex.Tangent  = Vec4::vec4((Transform * Vec4::vec4(Vertex.Tangent.xyz, 0.f)).xyz, Vertex.Tangent.w);
+    }
+
+    for (int i = 0; i < Primitives::GetQuadIndexCount(); ++i)
+        FaceIndices[i] += FaceIndex * Primitives::GetQuadVertexCount();
+
+    return Primitives::GetQuadIndexCount();
+}
+
+int Primitives::BuildQuad(vertex_full* Vertices, uint32_t* Indices)
+{
+    v3 Normal = { 0.f, 0.f, 1.f };
+    v4 Tangent = { 1.f, 0.f, 0.f, 1.f };
+
+    Vertices[0] = { { -0.5f, 0.5f, 0.f }, Normal, { 0.f, 1.f }, Tangent }; // Top left
+    Vertices[1] = { {  0.5f, 0.5f, 0.f }, Normal, { 1.f, 1.f }, Tangent }; // Top right
+    Vertices[2] = { { -0.5f,-0.5f, 0.f }, Normal, { 0.f, 0.f }, Tangent }; // Bottom left
+    Vertices[3] = { {  0.5f,-0.5f, 0.f }, Normal, { 1.f, 0.f }, Tangent }; // Bottom right
+
+    const uint32_t QuadIndices[] = { 0, 2, 1, 2, 3, 1 };
+    for (int i = 0; i < GetQuadIndexCount(); ++i)
+        Indices[i] = QuadIndices[i];
+
+    return GetQuadIndexCount();
+}
+
+int Primitives::BuildCube(vertex_full* Vertices, uint32_t* Indices)
+{
+    int IndexCount = 0;
+
+    // Back, front, left, right, top and bottom faces
+    IndexCount += AddFace(Vertices, Indices, 0, Mat4::Translate({ 0.0f, 0.0f,-0.5f }) * Mat4::RotateY(-1.f, 0.f));
+    IndexCount += AddFace(Vertices, Indices, 1, Mat4::Translate({ 0.0f, 0.0f, 0.5f }) * Mat4::RotateY( 1.f, 0.f));
+    IndexCount += AddFace(Vertices, Indices, 2, Mat4::Translate({-0.5f, 0.0f, 0.0f }) * Mat4::RotateY( 0.f, 1.f));
+    IndexCount += AddFace(Vertices, Indices, 3, Mat4::Translate({ 0.5f, 0.0f, 0.0f }) * Mat4::RotateY( 0.f,-1.f));
+    IndexCount += AddFace(Vertices, Indices, 4, Mat4::Translate({ 0.0f, 0.5f, 0.0f }) * Mat4::RotateX( 0.f,-1.f));
+    IndexCount += AddFace(Vertices, Indices, 5, Mat4::Translate({ 0.0f,-0.5f, 0.0f }) * Mat4::RotateX( 0.f, 1.f));
+
+    return IndexCount;
+}
+
+int Primitives::BuildInvertedCube(vertex_full* Vertices, uint32_t* Indices)
+{
+    int IndexCount = 0;
+    mat4 Translate = Mat4::Translate({ 0.f, 0.f, -0.5f });
+
+    // Front, back, right, left, top and bottom faces
+    IndexCount += AddFace(Vertices, Indices, 0, Translate);
+    IndexCount += AddFace(Vertices, Indices, 1, Mat4::RotateY(Math::Pi()) * Translate);
+    IndexCount += AddFace(Vertices, Indices, 2, Mat4::RotateY(Math::HalfPi()) * Translate);
+    IndexCount += AddFace(Vertices, Indices, 3, Mat4::RotateY(-Math::HalfPi()) * Translate);
+    IndexCount += AddFace(Vertices, Indices, 4, Mat4::RotateY(-Math::HalfPi()) * Mat4::RotateX(Math::HalfPi()) * Translate);
+    IndexCount += AddFace(Vertices, Indices, 5, Mat4::RotateY(-Math::HalfPi()) * Mat4::RotateX(-Math::HalfPi()) * Translate);
+
+    return IndexCount;
+}
+
+int Primitives::BuildSphere(vertex_full* Vertices, uint32_t* Indices, int Lon, int Lat)
+{
+    if (Lon < 3 || Lat < 2)
+    {
+        fprintf(stderr, "Sphere needs at least 3 longitudes and 2 latitudes\n");
+        return 0;
+    }
+
+    // Sin/cos tables, the last entries match the first ones exactly (no crack on the seam)
+    std::vector<float> PhiCos(Lon + 1);
+    std::vector<float> PhiSin(Lon + 1);
+    for (int j = 0; j <= Lon; ++j)
+    {
+        float Phi = Math::TwoPi() * (float)(j % Lon) / Lon; // Phi varies from 0 to 360
+        PhiCos[j] = Math::Cos(Phi);
+        PhiSin[j] = Math::Sin(Phi);
+    }
+
+    std::vector<float> ThetaCos(Lat + 1);
+    std::vector<float> ThetaSin(Lat + 1);
+    for (int i = 0; i <= Lat; ++i)
+    {
+        float Theta = Math::Pi() * (float)i / Lat; // Theta varies from 0 to 180
+        ThetaCos[i] = Math::Cos(Theta);
+        ThetaSin[i] = (i == Lat) ? 0.f : Math::Sin(Theta);
+    }
+
+    vertex_full* Vertex = Vertices;
+    for (int i = 0; i <= Lat; ++i)
+    {
+        for (int j = 0; j <= Lon; ++j)
+        {
+            v3 Normal = { ThetaSin[i] * PhiCos[j], ThetaCos[i], ThetaSin[i] * PhiSin[j] };
+
+            Vertex->Position = Normal * 0.5f; // Unit sphere
+            Vertex->Normal   = Normal;
+            Vertex->UV       = { 1.f - (float)j / Lon, 1.f - (float)i / Lat };
+            Vertex->Tangent  = { PhiSin[j], 0.f, -PhiCos[j], 1.f }; // Direction of +U, cross(N, T) points to +V
+            Vertex++;
+        }
+    }
+
+    uint32_t* Index = Indices;
+    for (int i = 0; i < Lat; ++i)
+    {
+        for (int j = 0; j < Lon; ++j)
+        {
+            uint32_t V0 = i * (Lon + 1) + j;
+            uint32_t V1 = V0 + 1;
+            uint32_t V2 = V0 + (Lon + 1);
+            uint32_t V3 = V2 + 1;
+
+            // Skip the degenerated triangles at the poles
+            if (i != 0)
+            {
+                *Index++ = V0;
+                *Index++ = V1;
+                *Index++ = V2;
+            }
+            if (i != Lat - 1)
+            {
+                *Index++ = V2;
+                *Index++ = V1;
+                *Index++ = V3;
+            }
+        }
+    }
+
+    return (int)(Index - Indices);
+}
+
+int Primitives::Build(primitive_type Type, vertex_full* Vertices, uint32_t* Indices, int Lon, int Lat)
+{
+    switch (Type)
+    {
+    case PRIMITIVE_QUAD:          return BuildQuad(Vertices, Indices);
+    case PRIMITIVE_CUBE:          return BuildCube(Vertices, Indices);
+    case PRIMITIVE_INVERTED_CUBE: return BuildInvertedCube(Vertices, Indices);
+    case PRIMITIVE_SPHERE:        return BuildSphere(Vertices, Indices, Lon, Lat);
+    }
+    return 0;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+
+#include "mesh.h"
+
+// Indexed procedural primitives (vertices are shared between triangles), unit size and centered on the origin.
+// Counts are constexpr so buffers can be sized at compile time:
+//     vertex_full Vertices[Primitives::GetSphereVertexCount(32, 16)];
+//     uint32_t Indices[Primitives::GetSphereIndexCount(32, 16)];
+
+enum primitive_type
+{
+    PRIMITIVE_QUAD,          // XY plane, facing +Z
+    PRIMITIVE_CUBE,
+    PRIMITIVE_INVERTED_CUBE, // Faces inward (skyboxes)
+    PRIMITIVE_SPHERE,        // Lon/Lat tessellation
+};
+
+// Default sphere tessellation
+const int PRIMITIVE_SPHERE_LON = 32;
+const int PRIMITIVE_SPHERE_LAT = 16;
+
+namespace Primitives
+{
+constexpr int GetQuadVertexCount() { return 4; }
+constexpr int GetQuadIndexCount()  { return 6; }
+
+// Faces do not share vertices (different normals and UVs)
+constexpr int GetCubeVertexCount() { return 6 * GetQuadVertexCount(); }
+constexpr int GetCubeIndexCount()  { return 6 * GetQuadIndexCount(); }
+
+// The UV seam column and the poles are duplicated, pole quads are single triangles
+constexpr int GetSphereVertexCount(int Lon, int Lat) { return (Lon + 1) * (Lat + 1); }
+constexpr int GetSphereIndexCount(int Lon, int Lat)  { return Lat > 1 ? Lon * (Lat - 1) * 6 : 0; }
+
+constexpr int GetVertexCount(primitive_type Type, int Lon = PRIMITIVE_SPHERE_LON, int Lat = PRIMITIVE_SPHERE_LAT)
+{
+    return Type == PRIMITIVE_QUAD ? GetQuadVertexCount() : Type == PRIMITIVE_SPHERE ? GetSphereVertexCount(Lon, Lat) : GetCubeVertexCount();
+}
+
+constexpr int GetIndexCount(primitive_type Type, int Lon = PRIMITIVE_SPHERE_LON, int Lat = PRIMITIVE_SPHERE_LAT)
+{
+    return Type == PRIMITIVE_QUAD ? GetQuadIndexCount() : Type == PRIMITIVE_SPHERE ? GetSphereIndexCount(Lon, Lat) : GetCubeIndexCount();
+}
+
+// Vertices and Indices must hold the counts above (tangents are filled), return the index count
+int BuildQuad(vertex_full* Vertices, uint32_t* Indices);
+int BuildCube(vertex_full* Vertices, uint32_t* Indices);
+int BuildInvertedCube(vertex_full* Vertices, uint32_t* Indices);
+int BuildSphere(vertex_full* Vertices, uint32_t* Indices, int Lon, int Lat);
+int Build(primitive_type Type, vertex_full* Vertices, uint32_t* Indices, int Lon = PRIMITIVE_SPHERE_LON, int Lat = PRIMITIVE_SPHERE_LAT);
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <cstdint>
+#include <cmath>
+
+// Minimal SIMD abstraction for batch processing (structure of arrays): simd_float holds SIMD_WIDTH floats.
+// AVX2 (8 lanes) when compiled with /arch:AVX2 or -mavx2, SSE2 (4 lanes) on x86/x64, NEON (4 lanes) on AArch64, scalar otherwise.
+
+#if defined(__AVX2__)
+#define SIMD_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2
+#include <emmintrin.h>
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SIMD_NEON
+#include <arm_neon.h>
+#endif
+
+#include "maths_extension.h"
+
+#if defined(SIMD_AVX2)
+const int SIMD_WIDTH = 8;
+typedef __m256 simd_float;
+#elif defined(SIMD_SSE2)
+const int SIMD_WIDTH = 4;
+typedef __m128 simd_float;
+#elif defined(SIMD_NEON)
+const int SIMD_WIDTH = 4;
+typedef float32x4_t simd_float;
+#else
+const int SIMD_WIDTH = 1;
+typedef float simd_float;
+#endif
+
+namespace Simd
+{
+#if defined(SIMD_AVX2)
+    inline const char* GetName() { return "AVX2"; }
+    inline simd_float Set1(float Value) { return _mm256_set1_ps(Value); }
+    inline simd_float Add(simd_float A, simd_float B) { return _mm256_add_ps(A, B); }
+    inline simd_float Mul(simd_float A, simd_float B) { return _mm256_mul_ps(A, B); }
+    inline simd_float Div(simd_float A, simd_float B) { return _mm256_div_ps(A, B); }
+#if defined(__FMA__) || defined(_MSC_VER) // FMA comes with /arch:AVX2 but not with -mavx2
+    inline simd_float MulAdd(simd_float A, simd_float B, simd_float C) { return _mm256_fmadd_ps(A, B, C); }
+#else
+    inline simd_float MulAdd(simd_float A, simd_float B, simd_float C) { return _mm256_add_ps(_mm256_mul_ps(A, B), C); }
+#endif
+    inline simd_float Sqrt(simd_float A) { return _mm256_sqrt_ps(A); }
+    inline simd_float Min(simd_float A, simd_float B) { return _mm256_min_ps(A, B); }
+    inline simd_float Max(simd_float A, simd_float B) { return _mm256_max_ps(A, B); }
+
+    // Lane i is the float at Base + i * Stride (bytes)
+    inline simd_float LoadStrided(const uint8_t* Base, int Stride)
+    {
+        __m256i Offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(Stride));
+        return _mm256_i32gather_ps((const float*)Base, Offsets, 1);
+    }
+
+    inline simd_float Load(const float* Values) { return _mm256_loadu_ps(Values); }
+    inline void Store(float* Values, simd_float A) { _mm256_storeu_ps(Values, A); }
+
+#elif defined(SIMD_SSE2)
+    inline const char* GetName() { return "SSE2"; }
+    inline simd_float Set1(float Value) { return _mm_set1_ps(Value); }
+    inline simd_float Add(simd_float A, simd_float B) { return _mm_add_ps(A, B); }
+    inline simd_float Mul(simd_float A, simd_float B) { return _mm_mul_ps(A, B); }
+    inline simd_float Div(simd_float A, simd_float B) { return _mm_div_ps(A, B); }
+    inline simd_float MulAdd(simd_float A, simd_float B, simd_float C) { return _mm_add_ps(_mm_mul_ps(A, B), C); }
+    inline simd_float Sqrt(simd_float A) { return _mm_sqrt_ps(A); }
+    inline simd_float Min(simd_float A, simd_float B) { return _mm_min_ps(A, B); }
+    inline simd_float Max(simd_float A, simd_float B) { return _mm_max_ps(A, B); }
+
+    inline simd_float LoadStrided(const uint8_t* Base, int Stride)
+    {
+        return _mm_setr_ps(*(const float*)(Base), *(const float*)(Base + Stride), *(const float*)(Base + 2 * Stride), *(const float*)(Base + 3 * Stride));
+    }
+
+    inline simd_float Load(const float* Values) { return _mm_loadu_ps(Values); }
+    inline void Store(float* Values, simd_float A) { _mm_storeu_ps(Values, A); }
+
+#elif defined(SIMD_NEON)
+    inline const char* GetName() { return "NEON"; }
+    inline simd_float Set1(float Value) { return vdupq_n_f32(Value); }
+    inline simd_float Add(simd_float A, simd_float B) { return vaddq_f32(A, B); }
+    inline simd_float Mul(simd_float A, simd_float B) { return vmulq_f32(A, B); }
+    inline simd_float Div(simd_float A, simd_float B) { return vdivq_f32(A, B); }
+    inline simd_float MulAdd(simd_float A, simd_float B, simd_float C) { return vfmaq_f32(C, A, B); }
+    inline simd_float Sqrt(simd_float A) { return vsqrtq_f32(A); }
+    inline simd_float Min(simd_float A, simd_float B) { return vminq_f32(A, B); }
+    inline simd_float Max(simd_float A, simd_float B) { return vmaxq_f32(A, B); }
+
+    inline simd_float LoadStrided(const uint8_t* Base, int Stride)
+    {
+        float Values[4] = { *(const float*)(Base), *(const float*)(Base + Stride), *(const float*)(Base + 2 * Stride), *(const float*)(Base + 3 * Stride) };
+        return vld1q_f32(Values);
+    }
+
+    inline simd_float Load(const float* Values) { return vld1q_f32(Values); }
+    inline void Store(float* Values, simd_float A) { vst1q_f32(Values, A); }
+
+#else
+    inline const char* GetName() { return "Scalar"; }
+    inline simd_float Set1(float Value) { return Value; }
+    inline simd_float Add(simd_float A, simd_float B) { return A + B; }
+    inline simd_float Mul(simd_float A, simd_float B) { return A * B; }
+    inline simd_float Div(simd_float A, simd_float B) { return A / B; }
+    inline simd_float MulAdd(simd_float A, simd_float B, simd_float C) { return A * B + C; }
+    inline simd_float Sqrt(simd_float A) { return std::sqrt(A); }
+    inline simd_float Min(simd_float A, simd_float B) { return A < B ? A : B; }
+    inline simd_float Max(simd_float A, simd_float B) { return A > B ? A : B; }
+
+    inline simd_float LoadStrided(const uint8_t* Base, int /*Stride*/) { return *(const float*)Base; }
+    inline simd_float Load(const float* Values) { return Values[0]; }
+    inline void Store(float* Values, simd_float A) { Values[0] = A; }
+#endif
+
+    // Write lane i at Base + i * Stride (bytes). No scatter before AVX-512, lanes are written one by one.
+    inline void StoreStrided(uint8_t* Base, int Stride, simd_float A)
+    {
+        float Values[SIMD_WIDTH];
+        Store(Values, A);
+        for (int i = 0; i < SIMD_WIDTH; ++i)
+            *(float*)(Base + i * Stride) = Values[i];
+    }
+
+    // Write the lanes as IEEE half floats (round to nearest even): F16C with /arch:AVX2 or -mf16c, NEON conversion, scalar otherwise
+    inline void StoreHalf(uint16_t* Values, simd_float A)
+    {
+#if defined(SIMD_AVX2) && (defined(__F16C__) || defined(_MSC_VER))
+        _mm_storeu_si128((__m128i*)Values, _mm256_cvtps_ph(A, _MM_FROUND_TO_NEAREST_INT));
+#elif defined(SIMD_SSE2) && defined(__F16C__)
+        _mm_storel_epi64((__m128i*)Values, _mm_cvtps_ph(A, _MM_FROUND_TO_NEAREST_INT));
+#elif defined(SIMD_NEON)
+        vst1_u16(Values, vreinterpret_u16_f16(vcvt_f16_f32(A)));
+#else
+        float Floats[SIMD_WIDTH];
+        Store(Floats, A);
+        for (int i = 0; i < SIMD_WIDTH; ++i)
+            Values[i] = Math::FloatToHalf(Floats[i]);
+#endif
+    }
+}
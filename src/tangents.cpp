@@ -0,0 +1,117 @@
+#include <algorithm>
+
+#include "maths.h"
+#include "jobs.h"
+
+#include "tangents.h"
+
+// Smaller meshes are not worth starting threads
+const int TANGENTS_MIN_TRIANGLES_PER_JOB = 8192;
+
+struct tangent_sum
+{
+    v3 Tangent;
+    v3 Bitangent;
+};
+
+// Angle between Edge0 and Edge1 (0 when an edge is degenerated)
+static float GetAngle(v3 Edge0, v3 Edge1)
+{
+    float Lengths = Vec3::Length(Edge0) * Vec3::Length(Edge1);
+    if (!(Lengths > 0.f))
+        return 0.f;
+    return Math::Acos(Math::Clamp(Vec3::Dot(Edge0, Edge1) / Lengths, -1.f, 1.f));
+}
+
+// Direction of the tangent and bitangent of a triangle and its corner angles, false without UV area
+static bool GetTriangleFrame(const vertex_full& V0, const vertex_full& V1, const vertex_full& V2, v3* Tangent, v3* Bitangent, float Angles[3])
+{
+    v3 DeltaPos1 = V1.Position - V0.Position;
+    v3 DeltaPos2 = V2.Position - V0.Position;
+    v2 DeltaUV1 = V1.UV - V0.UV;
+    v2 DeltaUV2 = V2.UV - V0.UV;
+
+    // Skip triangles without UV area (the tangent is undefined)
+    float Determinant = DeltaUV1.x * DeltaUV2.y - DeltaUV1.y * DeltaUV2.x;
+    if (Determinant == 0.f)
+        return false;
+
+    v3 T = (DeltaPos1 * DeltaUV2.y - DeltaPos2 * DeltaUV1.y) / Determinant;
+    v3 B = (DeltaPos2 * DeltaUV1.x - DeltaPos1 * DeltaUV2.x) / Determinant;
+    float TangentLength = Vec3::Length(T);
+    float BitangentLength = Vec3::Length(B);
+    if (!(TangentLength > 0.f) || !(BitangentLength > 0.f))
+        return false;
+
+    // Only the direction matters, the weight is the angle of the corner
+    *Tangent = T / TangentLength;
+    *Bitangent = B / BitangentLength;
+    Angles[0] = GetAngle(DeltaPos1, DeltaPos2);
+    Angles[1] = GetAngle(V2.Position - V1.Position, V0.Position - V1.Position);
+    Angles[2] = GetAngle(V0.Position - V2.Position, V1.Position - V2.Position);
+    return true;
+}
+
+// Sum the corners of vertices in [FirstVertex, LastVertex) (Sums is indexed from FirstVertex)
+static void AccumulateTriangles(tangent_sum* Sums, const vertex_full* Vertices, const uint32_t* Indices, int TriangleCount, uint32_t FirstVertex, uint32_t LastVertex)
+{
+    for (int i = 0; i < TriangleCount; ++i)
+    {
+        const uint32_t* Triangle = &Indices[i * 3];
+        bool Inside[3];
+        for (int j = 0; j < 3; ++j)
+            Inside[j] = Triangle[j] >= FirstVertex && Triangle[j] < LastVertex;
+        if (!Inside[0] && !Inside[1] && !Inside[2])
+            continue;
+
+        v3 Tangent, Bitangent;
+        float Angles[3];
+        if (!GetTriangleFrame(Vertices[Triangle[0]], Vertices[Triangle[1]], Vertices[Triangle[2]], &Tangent, &Bitangent, Angles))
+            continue;
+
+        for (int j = 0; j < 3; ++j)
+        {
+            if (!Inside[j])
+                continue;
+            tangent_sum& Sum = Sums[Triangle[j] - FirstVertex];
+            Sum.Tangent += Tangent * Angles[j];
+            Sum.Bitangent += Bitangent * Angles[j];
+        }
+    }
+}
+
+void Tangents::Generate(std::vector<vertex_full>& Vertices, const std::vector<uint32_t>& Indices)
+{
+    int VertexCount = (int)Vertices.size();
+    int TriangleCount = (int)Indices.size() / 3;
+    if (VertexCount == 0)
+        return;
+
+    // Each job owns a vertex range: it scans every triangle but only computes those with a corner in its range,
+    // and sums them in triangle order (no atomics, the result does not depend on scheduling or on the job count)
+    int JobCount = Math::Clamp((TriangleCount + TANGENTS_MIN_TRIANGLES_PER_JOB - 1) / TANGENTS_MIN_TRIANGLES_PER_JOB, 1, Jobs::GetWorkerCount());
+    std::vector<tangent_sum> Sums(VertexCount, tangent_sum{});
+
+    Jobs::ParallelFor(JobCount, [&](int Job)
+    {
+        int FirstVertex = (int)((int64_t)VertexCount * Job / JobCount);
+        int LastVertex = (int)((int64_t)VertexCount * (Job + 1) / JobCount);
+        AccumulateTriangles(&Sums[FirstVertex], Vertices.data(), Indices.data(), TriangleCount, (uint32_t)FirstVertex, (uint32_t)LastVertex);
+
+        for (int i = FirstVertex; i < LastVertex; ++i)
+        {
+            const tangent_sum& Sum = Sums[i];
+            vertex_full& Vertex = Vertices[i];
+            v3 N = Vec3::Length(Vertex.Normal) > 0.f ? Vec3::Normalize(Vertex.Normal) : v3{ 0.f, 0.f, 1.f };
+
+            // Gram-Schmidt (pick any tangent when it is degenerated)
+            v3 T = Sum.Tangent - N * Vec3::Dot(N, Sum.Tangent);
+            if (!(Vec3::Length(T) > 1e-6f))
+                T = Math::Abs(N.x) < 0.9f ? Vec3::Cross(N, { 1.f, 0.f, 0.f }) : Vec3::Cross(N, { 0.f, 1.f, 0.f });
+            T = Vec3::Normalize(T);
+
+            float Handedness = Vec3::Dot(Vec3::Cross(N, T), Sum.Bitangent) < 0.f ? -1.f : 1.f;
+            Vertex.Tangent = { T.x, T.y, T.z, Handedness };
+        }
+    });
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+// Tangent frames of indexed meshes (per-pixel normal mapping).
+// Contributions of the triangles are weighted by their angle at the vertex, so the result does not depend
+// on the triangulation or on the triangle order. The tangent is orthogonalized against the vertex normal
+// and Tangent.w stores the bitangent sign: Bitangent = cross(Normal, Tangent.xyz) * Tangent.w.
+
+namespace Tangents
+{
+// Compute Tangent of every vertex (triangles are processed on several threads)
+void Generate(std::vector<vertex_full>& Vertices, const std::vector<uint32_t>& Indices);
+}
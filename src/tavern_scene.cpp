@@ -4,10 +4,12 @@
 #include "platform.h"
 
 #include "color.h"
+#include "maths.h"
 
 #include "tavern_scene.h"
 
 tavern_scene::tavern_scene(GL::cache& GLCache)
+    : GLCache(GLCache)
 {
     // Init lights
     {
@@ -47,17 +49,17 @@ tavern_scene::tavern_scene(GL::cache& GLCache)
 
     // Create mesh
     {
-        // Use vbo from GLCache
-        MeshBuffer = GLCache.LoadObj("media/fantasy_game_inn.obj", 1.f, &this->MeshVertexCount, &MeshDesc);
+        // Use vbo/ibo from GLCache
+        Mesh = GLCache.LoadObjAsync("media/fantasy_game_inn.obj", 1.f, VERTEX_LAYOUT_PACKED);
     }
 
     // Gen texture
     {
-        // Gamma demostration
-        LinearDiffuseTexture = GLCache.LoadTexture("media/fantasy_game_inn_diffuse_linear.png", IMG_FLIP | IMG_GEN_MIPMAPS | IMG_LINEAR);
+        // Gamma demostration: decoded to linear by the sampler
+        SrgbDiffuseTexture = GLCache.LoadTextureAsync("media/fantasy_game_inn_diffuse.png", IMG_FLIP | IMG_GEN_MIPMAPS | IMG_COMPRESS | IMG_SRGB);
 
-        DiffuseTexture = GLCache.LoadTexture("media/fantasy_game_inn_diffuse.png", IMG_FLIP | IMG_GEN_MIPMAPS);
-        EmissiveTexture = GLCache.LoadTexture("media/fantasy_game_inn_emissive.png", IMG_FLIP | IMG_GEN_MIPMAPS);
+        DiffuseTexture = GLCache.LoadTextureAsync("media/fantasy_game_inn_diffuse.png", IMG_FLIP | IMG_GEN_MIPMAPS | IMG_COMPRESS);
+        EmissiveTexture = GLCache.LoadTextureAsync("media/fantasy_game_inn_emissive.png", IMG_FLIP | IMG_GEN_MIPMAPS | IMG_COMPRESS);
     }
     
     // Gen light uniform buffer
@@ -71,8 +73,31 @@ tavern_scene::tavern_scene(GL::cache& GLCache)
 tavern_scene::~tavern_scene()
 {
     glDeleteBuffers(1, &LightsUniformBuffer);
-    //glDeleteTextures(1, &Texture);   // From cache
-    //glDeleteBuffers(1, &MeshBuffer); // From cache
+
+    // From cache
+    GLCache.ReleaseMesh(Mesh->VertexBuffer);
+    GLCache.ReleaseTexture(DiffuseTexture);
+    GLCache.ReleaseTexture(SrgbDiffuseTexture);
+    GLCache.ReleaseTexture(EmissiveTexture);
+}
+
+void tavern_scene::DrawMesh(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix)
+{
+    const std::vector<meshlet>& Meshlets = Mesh->Meshlets;
+    if (!MeshletCulling || Meshlets.empty())
+    {
+        CullStats = {};
+        CullStats.Visible = (int)Meshlets.size();
+        glDrawElements(GL_TRIANGLES, Mesh->IndexCount, Mesh->IndexType, nullptr);
+        return;
+    }
+
+    // Cull in model space
+    mat4 ModelView = ViewMatrix * ModelMatrix;
+    v3 ViewPosition = Mat4::Inverse(ModelView).c[3].xyz;
+    CullStats = Meshlet::Cull(&DrawRanges, Meshlets.data(), (int)Meshlets.size(), ProjectionMatrix * ModelView, ViewPosition, MeshletBackfaceCulling);
+
+    GL::DrawElementsRanges(GL_TRIANGLES, DrawRanges, Mesh->IndexType);
 }
 
 static bool EditLight(GL::light* Light)
@@ -119,3 +144,17 @@ void tavern_scene::InspectLights()
         ImGui::TreePop();
     }
 }
+
+void tavern_scene::InspectMeshlets()
+{
+    if (ImGui::TreeNodeEx("Meshlets"))
+    {
+        ImGui::Checkbox("Culling", &MeshletCulling);
+        ImGui::Checkbox("Backface culling (single sided)", &MeshletBackfaceCulling);
+        ImGui::Text("Visible: %d / %d", CullStats.Visible, (int)Mesh->Meshlets.size());
+        ImGui::Text("Frustum culled: %d", CullStats.FrustumCulled);
+        ImGui::Text("Backface culled: %d", CullStats.BackfaceCulled);
+        ImGui::Text("Draw ranges: %d", MeshletCulling ? (int)DrawRanges.size() : 1);
+        ImGui::TreePop();
+    }
+}
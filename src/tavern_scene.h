@@ -11,10 +11,14 @@ public:
     tavern_scene(GL::cache& GLCache);
     ~tavern_scene();
     
-    // Mesh
-    GLuint MeshBuffer = 0;
-    int MeshVertexCount = 0;
-    vertex_descriptor MeshDesc;
+    // Mesh (loaded asynchronously by GLCache, empty until then)
+    const GL::cache::mesh* Mesh = nullptr;
+
+    // Meshlets culling (frustum, and backface for single sided rendering)
+    std::vector<draw_range> DrawRanges;
+    meshlet_cull_stats CullStats = {};
+    bool MeshletCulling = true;
+    bool MeshletBackfaceCulling = false;
 
     // Lights buffer
     GLuint LightsUniformBuffer = 0;
@@ -22,13 +26,17 @@ public:
 
     // Textures
     GLuint DiffuseTexture = 0;
-    GLuint LinearDiffuseTexture = 0;
+    GLuint SrgbDiffuseTexture = 0; // IMG_SRGB, for the gamma correct demos
     GLuint EmissiveTexture = 0;
 
+    // Draw the visible meshlets of the tavern (program, uniforms and VAO must be bound)
+    void DrawMesh(const mat4& ProjectionMatrix, const mat4& ViewMatrix, const mat4& ModelMatrix);
+
     // ImGui debug function to edit lights
     void InspectLights();
+    void InspectMeshlets();
 
     std::vector<GL::light> Lights;
 private:
-    // Lights data
+    GL::cache& GLCache;
 };
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "maths.h"
+
+// stb_rect_pack of imgui (compiled static in imgui_draw.cpp, this translation unit has its own copy)
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "../externals/imgui/imstb_rectpack.h" // Not in the include directory
+
+#include "texture_atlas.h"
+
+int TextureAtlas::GetMaxLevel(int Padding)
+{
+    int Level = 0;
+    while ((2 << Level) <= Padding)
+        Level++;
+    return Level;
+}
+
+int TextureAtlas::GetAlignment(int Padding)
+{
+    return 1 << GetMaxLevel(Padding);
+}
+
+// Image size with its padding, rounded up to the alignment
+static int GetBlockSize(int Size, int Padding)
+{
+    int Alignment = TextureAtlas::GetAlignment(Padding);
+    return (Size + 2 * Padding + Alignment - 1) / Alignment * Alignment;
+}
+
+int TextureAtlas::Pack(atlas_rect* Rects, const int* Widths, const int* Heights, int Count, int PageSize, int Padding)
+{
+    int Alignment = GetAlignment(Padding);
+
+    // Remaining images, rects too big for a page are rejected at once
+    std::vector<stbrp_rect> Remaining;
+    for (int i = 0; i < Count; ++i)
+    {
+        Rects[i] = { -1, 0, 0, Widths[i], Heights[i] };
+        int Width = GetBlockSize(Widths[i], Padding);
+        int Height = GetBlockSize(Heights[i], Padding);
+        if (Width > PageSize || Height > PageSize)
+        {
+            fprintf(stderr, "Image %d (%dx%d) does not fit in a %d atlas page\n", i, Widths[i], Heights[i], PageSize);
+            continue;
+        }
+
+        stbrp_rect Rect = {};
+        Rect.id = i;
+        Rect.w = (stbrp_coord)Width;
+        Rect.h = (stbrp_coord)Height;
+        Remaining.push_back(Rect);
+    }
+
+    // Packed in aligned units, so every position stays a multiple of Alignment
+    int PageUnits = PageSize / Alignment;
+    for (stbrp_rect& Rect : Remaining)
+    {
+        Rect.w /= (stbrp_coord)Alignment;
+        Rect.h /= (stbrp_coord)Alignment;
+    }
+
+    std::vector<stbrp_node> Nodes(PageUnits);
+    int PageCount = 0;
+    while (!Remaining.empty())
+    {
+        stbrp_context Context;
+        stbrp_init_target(&Context, PageUnits, PageUnits, Nodes.data(), (int)Nodes.size());
+        stbrp_pack_rects(&Context, Remaining.data(), (int)Remaining.size());
+
+        std::vector<stbrp_rect> NotPacked;
+        for (const stbrp_rect& Rect : Remaining)
+        {
+            if (!Rect.was_packed)
+            {
+                NotPacked.push_back(Rect);
+                continue;
+            }
+            atlas_rect& Placed = Rects[Rect.id];
+            Placed.Page = PageCount;
+            Placed.X = Rect.x * Alignment + Padding;
+            Placed.Y = Rect.y * Alignment + Padding;
+        }
+        PageCount++;
+        Remaining.swap(NotPacked);
+    }
+
+    return PageCount;
+}
+
+void TextureAtlas::Blit(uint8_t* Page, int PageSize, const image& Image, const atlas_rect& Rect, int Padding)
+{
+    // Padding extends to the end of the aligned block (no unset texels averaged in the mips)
+    int PaddingRight = GetBlockSize(Rect.Width, Padding) - Padding - Rect.Width;
+    int PaddingTop = GetBlockSize(Rect.Height, Padding) - Padding - Rect.Height;
+
+    const uint8_t* Src = (const uint8_t*)Image.Data;
+    for (int y = -Padding; y < Rect.Height + PaddingTop; ++y)
+    {
+        int SrcY = Math::Clamp(y, 0, Rect.Height - 1);
+        uint8_t* Row = Page + ((size_t)(Rect.Y + y) * PageSize + Rect.X) * 4;
+        const uint8_t* SrcRow = Src + (size_t)SrcY * Rect.Width * 4;
+
+        // Left and right padding repeat the edge texels
+        for (int x = -Padding; x < 0; ++x)
+            memcpy(Row + x * 4, SrcRow, 4);
+        memcpy(Row, SrcRow, (size_t)Rect.Width * 4);
+        for (int x = Rect.Width; x < Rect.Width + PaddingRight; ++x)
+            memcpy(Row + x * 4, SrcRow + (Rect.Width - 1) * 4, 4);
+    }
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+
+#include "texture_cache.h"
+
+// Atlas pages of small RGBA8 images (sprites, billboards, UI icons), packed with stb_rect_pack (skyline, bottom-left).
+// Every image is surrounded by Padding texels repeating its edges, and image positions and sizes (padding included) are
+// multiples of GetAlignment(Padding), so the mip levels up to GetMaxLevel(Padding) never blend two images.
+
+const int TEXTURE_ATLAS_DEFAULT_PAGE_SIZE = 2048;
+const int TEXTURE_ATLAS_DEFAULT_PADDING = 8;
+
+// Image placement in a page, in texels (padding excluded)
+struct atlas_rect
+{
+    int Page; // -1 when the image does not fit in a page
+    int X;
+    int Y;
+    int Width;
+    int Height;
+};
+
+namespace TextureAtlas
+{
+// Finest mip level where images are still separated by a texel (log2(Padding))
+int GetMaxLevel(int Padding);
+int GetAlignment(int Padding);
+
+// Place Count images of the given sizes, pages are filled one after the other. Returns the page count
+int Pack(atlas_rect* Rects, const int* Widths, const int* Heights, int Count, int PageSize, int Padding);
+
+// Copy an RGBA8 image (Rect.Width x Rect.Height) to its place in an RGBA8 page of PageSize x PageSize texels, padding included
+void Blit(uint8_t* Page, int PageSize, const image& Image, const atlas_rect& Rect, int Padding);
+}
@@ -0,0 +1,846 @@
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <stb_image.h>
+
+#include "platform.h"
+#include "asset_archive.h"
+#include "maths.h"
+#include "simd.h"
+#include "jobs.h"
+#include "texture_compress.h"
+
+#include "texture_cache.h"
+
+static_assert(sizeof(texture_cache_header) % 16 == 0, "Cache payloads must stay aligned");
+
+static uint64_t AlignOffset(uint64_t Offset)
+{
+    return (Offset + 15) & ~(uint64_t)15;
+}
+
+static int GetTexelSize(const texture_cache_header& Header)
+{
+    if (Header.Format == TEXTURE_FORMAT_UNORM8)
+        return (int)Header.Channels;
+    return TextureCompress::GetFloatTexelSize((texture_format)Header.Format, (int)Header.Channels);
+}
+
+static uint64_t GetLevelSize(const texture_cache_header& Header, uint32_t Width, uint32_t Height)
+{
+    texture_format Format = (texture_format)Header.Format;
+    if (TextureCompress::IsCompressed(Format))
+        return TextureCompress::GetLevelSize(Format, Width, Height);
+    return (uint64_t)Width * Height * GetTexelSize(Header);
+}
+
+static int GetLevelCount(int Width, int Height)
+{
+    int LevelCount = 1;
+    while ((Width > 1 || Height > 1) && LevelCount < TEXTURE_CACHE_MAX_LEVELS)
+    {
+        Width = (Width > 1) ? Width / 2 : 1;
+        Height = (Height > 1) ? Height / 2 : 1;
+        LevelCount++;
+    }
+    return LevelCount;
+}
+
+bool TextureCache::DecodeImage(image* Image, const char* Filename, int ImageFlags)
+{
+    *Image = {};
+
+    // Desired channels
+    int DesiredChannels = 0;
+    int Channels = 0;
+    if (ImageFlags & IMG_FORCE_GREY)
+    {
+        DesiredChannels = STBI_grey;
+        Channels = 1;
+    }
+    if (ImageFlags & IMG_FORCE_GREY_ALPHA)
+    {
+        DesiredChannels = STBI_grey_alpha;
+        Channels = 2;
+    }
+    if (ImageFlags & IMG_FORCE_RGB)
+    {
+        DesiredChannels = STBI_rgb;
+        Channels = 3;
+    }
+    if (ImageFlags & IMG_FORCE_RGBA)
+    {
+        DesiredChannels = STBI_rgb_alpha;
+        Channels = 4;
+    }
+
+    // Loading
+    // NOTE: stbi_set_flip_vertically_on_load is global to the process (images are decoded on several threads), rows are flipped below instead
+    int Width, Height;
+    void* Data;
+
+    if (ImageFlags & IMG_LINEAR)
+        Data = stbi_loadf(Filename, &Width, &Height, (DesiredChannels == 0) ? &Channels : nullptr, DesiredChannels);
+    else
+        Data = stbi_load(Filename, &Width, &Height, (DesiredChannels == 0) ? &Channels : nullptr, DesiredChannels);
+
+    if (Data == nullptr)
+    {
+        fprintf(stderr, "Image loading failed on '%s'\n", Filename);
+        return false;
+    }
+
+    Image->Data = Data;
+    Image->Width = Width;
+    Image->Height = Height;
+    Image->Channels = Channels;
+    Image->IsFloat = (ImageFlags & IMG_LINEAR) != 0;
+
+    // Flip
+    if (ImageFlags & IMG_FLIP)
+    {
+        size_t RowSize = (size_t)Width * Channels * (Image->IsFloat ? sizeof(float) : sizeof(uint8_t));
+        std::vector<uint8_t> Row(RowSize);
+        uint8_t* Rows = (uint8_t*)Data;
+        for (int y = 0; y < Height / 2; ++y)
+        {
+            uint8_t* Top = Rows + y * RowSize;
+            uint8_t* Bottom = Rows + (Height - 1 - y) * RowSize;
+            memcpy(Row.data(), Top, RowSize);
+            memcpy(Top, Bottom, RowSize);
+            memcpy(Bottom, Row.data(), RowSize);
+        }
+    }
+
+    return true;
+}
+
+void TextureCache::FreeImage(image* Image)
+{
+    stbi_image_free(Image->Data);
+    *Image = {};
+}
+
+// Faces in the baked file (the sources of a panorama are not its faces)
+static int GetCacheFaceCount(int FaceCount, int ImageFlags)
+{
+    return (ImageFlags & IMG_EQUIRECT) ? TEXTURE_CACHE_MAX_FACES : FaceCount;
+}
+
+// Flags of the baked file (IMG_SRGB only selects the internal format at upload)
+static int GetBakedFlags(int ImageFlags)
+{
+    return ImageFlags & ~IMG_SRGB;
+}
+
+std::string TextureCache::GetCacheFilename(const char* const* Faces, int FaceCount, int ImageFlags)
+{
+    // Flags are part of the name: the same image can be cached with different flags
+    ImageFlags = GetBakedFlags(ImageFlags);
+    if (FaceCount == 1)
+    {
+        char Suffix[32];
+        snprintf(Suffix, sizeof(Suffix), ".%02x%s", ImageFlags, (GetCacheFaceCount(FaceCount, ImageFlags) == TEXTURE_CACHE_MAX_FACES) ? ".cube.tex" : ".tex");
+        return std::string(Faces[0]) + Suffix;
+    }
+
+    // Cubemaps are named after +X, with a hash of every face: cubemaps can share faces
+    std::string Filenames = Faces[0];
+    for (int Face = 1; Face < FaceCount; ++Face)
+        Filenames += std::string("\n") + Faces[Face];
+    char Suffix[48];
+    snprintf(Suffix, sizeof(Suffix), ".%016llx.%02x.cube.tex", (unsigned long long)File::Hash(Filenames.data(), Filenames.size()), ImageFlags);
+    return std::string(Faces[0]) + Suffix;
+}
+
+// Level offsets and sizes from the format and dimensions
+static void ComputeLevels(texture_cache_header* Header)
+{
+    uint64_t Offset = sizeof(texture_cache_header);
+    for (uint32_t Face = 0; Face < Header->FaceCount; ++Face)
+    {
+        uint32_t Width = Header->Width;
+        uint32_t Height = Header->Height;
+        for (uint32_t Level = 0; Level < Header->LevelCount; ++Level)
+        {
+            texture_cache_level& CacheLevel = Header->Levels[Face][Level];
+            CacheLevel.Offset = AlignOffset(Offset);
+            CacheLevel.Size   = GetLevelSize(*Header, Width, Height);
+            CacheLevel.Width  = Width;
+            CacheLevel.Height = Height;
+            Offset = CacheLevel.Offset + CacheLevel.Size;
+
+            Width = (Width > 1) ? Width / 2 : 1;
+            Height = (Height > 1) ? Height / 2 : 1;
+        }
+    }
+    Header->FileSize = Offset;
+}
+
+// Fill header with the sources and the uncompressed level layout
+static void FillHeader(texture_cache_header* Header, const char* const* Faces, int FaceCount, int ImageFlags, const image& Image)
+{
+    *Header = {};
+    Header->Magic      = TEXTURE_CACHE_MAGIC;
+    Header->Version    = TEXTURE_CACHE_VERSION;
+    Header->EndianTest = TEXTURE_CACHE_ENDIAN_TEST;
+    Header->HeaderSize = sizeof(texture_cache_header);
+
+    for (int Face = 0; Face < FaceCount; ++Face)
+    {
+        file_stats Stats;
+        if (File::GetStats(&Stats, Faces[Face]))
+        {
+            Header->SourceSize[Face] = Stats.Size;
+            Header->SourceTime[Face] = Stats.ModificationTime;
+            File::HashFile(&Header->SourceHash[Face], Faces[Face]);
+        }
+    }
+
+    Header->ImageFlags = ImageFlags;
+    Header->Format     = Image.IsFloat ? TEXTURE_FORMAT_FLOAT32 : TEXTURE_FORMAT_UNORM8;
+    Header->Channels   = (uint32_t)Image.Channels;
+    Header->Width      = (uint32_t)Image.Width;
+    Header->Height     = (uint32_t)Image.Height;
+    Header->FaceCount  = (uint32_t)GetCacheFaceCount(FaceCount, ImageFlags);
+    Header->LevelCount = (ImageFlags & IMG_GEN_MIPMAPS) ? (uint32_t)GetLevelCount(Image.Width, Image.Height) : 1;
+
+    ComputeLevels(Header);
+}
+
+// Kaiser windowed sinc, radius and alpha in destination texels (same defaults as NVIDIA Texture Tools)
+const float KAISER_RADIUS = 3.f;
+const float KAISER_ALPHA  = 4.f;
+
+// Modified Bessel function of the first kind, order 0 (power series)
+static float BesselI0(float X)
+{
+    float Sum = 1.f;
+    float Term = 1.f;
+    float HalfX = X * 0.5f;
+    for (int k = 1; k < 32 && Term > Sum * 1e-8f; ++k)
+    {
+        Term *= (HalfX / k) * (HalfX / k);
+        Sum += Term;
+    }
+    return Sum;
+}
+
+static float Kaiser(float X)
+{
+    if (Math::Abs(X) >= KAISER_RADIUS)
+        return 0.f;
+
+    float Sinc = (X == 0.f) ? 1.f : Math::Sin(Math::Pi() * X) / (Math::Pi() * X);
+    float Ratio = X / KAISER_RADIUS;
+    return Sinc * BesselI0(KAISER_ALPHA * Math::Sqrt(1.f - Ratio * Ratio)) / BesselI0(KAISER_ALPHA);
+}
+
+// Filter taps along one axis: destination texel i reads source texels Indices[i * TapCount + k] (clamped to the edges)
+struct filter_taps
+{
+    int TapCount;
+    std::vector<int> Indices;
+    std::vector<float> Weights; // Normalized
+};
+
+static void BuildTaps(filter_taps* Taps, int SrcSize, int DstSize)
+{
+    float Scale = (float)SrcSize / DstSize; // 2 for even sizes, a bit more on odd ones
+    float Support = KAISER_RADIUS * Scale;  // In source texels
+    Taps->TapCount = (int)Math::Ceil(2.f * Support) + 1;
+    Taps->Indices.resize((size_t)DstSize * Taps->TapCount);
+    Taps->Weights.resize((size_t)DstSize * Taps->TapCount);
+
+    for (int i = 0; i < DstSize; ++i)
+    {
+        float Center = (i + 0.5f) * Scale;
+        int First = (int)Math::Floor(Center - Support);
+        int* Indices = &Taps->Indices[(size_t)i * Taps->TapCount];
+        float* Weights = &Taps->Weights[(size_t)i * Taps->TapCount];
+
+        float Sum = 0.f;
+        for (int k = 0; k < Taps->TapCount; ++k)
+        {
+            Indices[k] = Math::Clamp(First + k, 0, SrcSize - 1);
+            Weights[k] = Kaiser((First + k + 0.5f - Center) / Scale);
+            Sum += Weights[k];
+        }
+        for (int k = 0; k < Taps->TapCount; ++k)
+            Weights[k] /= Sum;
+    }
+}
+
+// Separable downsampling of linear texels, rows are processed in parallel.
+// The vertical pass sums whole source rows (SIMD over contiguous floats), the horizontal pass runs on the filtered row.
+static void Downsample(float* Dst, const float* Src, const texture_cache_level& DstLevel, const texture_cache_level& SrcLevel, int Channels)
+{
+    filter_taps Horizontal, Vertical;
+    BuildTaps(&Horizontal, (int)SrcLevel.Width, (int)DstLevel.Width);
+    BuildTaps(&Vertical, (int)SrcLevel.Height, (int)DstLevel.Height);
+
+    const int RowsPerJob = 16;
+    int RowFloats = (int)SrcLevel.Width * Channels;
+    int JobCount = ((int)DstLevel.Height + RowsPerJob - 1) / RowsPerJob;
+    Jobs::ParallelFor(JobCount, [&](int Job)
+    {
+        std::vector<float> Row(RowFloats);
+        int RowEnd = Math::Min((Job + 1) * RowsPerJob, (int)DstLevel.Height);
+        for (int y = Job * RowsPerJob; y < RowEnd; ++y)
+        {
+            const int* RowIndices = &Vertical.Indices[(size_t)y * Vertical.TapCount];
+            const float* RowWeights = &Vertical.Weights[(size_t)y * Vertical.TapCount];
+
+            int i = 0;
+            for (; i + SIMD_WIDTH <= RowFloats; i += SIMD_WIDTH)
+            {
+                simd_float Sum = Simd::Set1(0.f);
+                for (int k = 0; k < Vertical.TapCount; ++k)
+                    Sum = Simd::MulAdd(Simd::Load(Src + (size_t)RowIndices[k] * RowFloats + i), Simd::Set1(RowWeights[k]), Sum);
+                Simd::Store(&Row[i], Sum);
+            }
+            for (; i < RowFloats; ++i)
+            {
+                float Sum = 0.f;
+                for (int k = 0; k < Vertical.TapCount; ++k)
+                    Sum += Src[(size_t)RowIndices[k] * RowFloats + i] * RowWeights[k];
+                Row[i] = Sum;
+            }
+
+            float* Texel = Dst + (size_t)y * DstLevel.Width * Channels;
+            for (uint32_t x = 0; x < DstLevel.Width; ++x, Texel += Channels)
+            {
+                const int* Indices = &Horizontal.Indices[(size_t)x * Horizontal.TapCount];
+                const float* Weights = &Horizontal.Weights[(size_t)x * Horizontal.TapCount];
+                for (int c = 0; c < Channels; ++c)
+                {
+                    float Sum = 0.f;
+                    for (int k = 0; k < Horizontal.TapCount; ++k)
+                        Sum += Row[Indices[k] * Channels + c] * Weights[k];
+                    Texel[c] = Sum;
+                }
+            }
+        }
+    });
+}
+
+static float SRGBToLinear(float Value)
+{
+    return (Value <= 0.04045f) ? Value / 12.92f : Math::Pow((Value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float LinearToSRGB(float Value)
+{
+    return (Value <= 0.0031308f) ? Value * 12.92f : 1.055f * Math::Pow(Value, 1.f / 2.4f) - 0.055f;
+}
+
+// Unorm color channels are sRGB encoded and filtered in linear space (alpha and IMG_NON_COLOR data are already linear)
+static bool IsGammaChannel(const texture_cache_header& Header, int Channel)
+{
+    if (Header.Format != TEXTURE_FORMAT_UNORM8 || (Header.ImageFlags & IMG_NON_COLOR))
+        return false;
+    bool HasAlpha = (Header.Channels == 2 || Header.Channels == 4);
+    return !(HasAlpha && Channel == (int)Header.Channels - 1);
+}
+
+// Conversions between stored texels and linear floats, split in parallel blocks
+const size_t CONVERT_BLOCK_SIZE = 64 * 1024;
+
+static void UnormToLinear(float* Dst, const uint8_t* Src, size_t Count, const texture_cache_header& Header)
+{
+    int Channels = (int)Header.Channels;
+    float ToLinear[4][256];
+    for (int c = 0; c < Channels; ++c)
+    {
+        for (int i = 0; i < 256; ++i)
+            ToLinear[c][i] = IsGammaChannel(Header, c) ? SRGBToLinear(i / 255.f) : i / 255.f;
+    }
+
+    size_t BlockSize = CONVERT_BLOCK_SIZE * Channels;
+    Jobs::ParallelFor((int)((Count + BlockSize - 1) / BlockSize), [&](int Block)
+    {
+        size_t End = Math::Min(Count, (Block + 1) * BlockSize);
+        for (size_t i = Block * BlockSize; i < End; ++i)
+            Dst[i] = ToLinear[i % Channels][Src[i]];
+    });
+}
+
+static void LinearToUnorm(uint8_t* Dst, const float* Src, size_t Count, const texture_cache_header& Header)
+{
+    int Channels = (int)Header.Channels;
+    bool Gamma[4];
+    for (int c = 0; c < Channels; ++c)
+        Gamma[c] = IsGammaChannel(Header, c);
+
+    size_t BlockSize = CONVERT_BLOCK_SIZE * Channels;
+    Jobs::ParallelFor((int)((Count + BlockSize - 1) / BlockSize), [&](int Block)
+    {
+        size_t End = Math::Min(Count, (Block + 1) * BlockSize);
+        for (size_t i = Block * BlockSize; i < End; ++i)
+        {
+            float Value = Math::Clamp(Src[i], 0.f, 1.f); // Negative lobes of the filter overshoot near edges
+            if (Gamma[i % Channels])
+                Value = LinearToSRGB(Value);
+            Dst[i] = (uint8_t)(Value * 255.f + 0.5f);
+        }
+    });
+}
+
+// Build levels 1 to LevelCount-1 of Face from level 0. Each level is filtered from the previous one kept in linear float
+// (no requantization between levels).
+static void BuildMips(uint8_t* Data, const texture_cache_header& Header, int Face)
+{
+    if (Header.LevelCount <= 1)
+        return;
+
+    int Channels = (int)Header.Channels;
+    bool IsFloat = (Header.Format == TEXTURE_FORMAT_FLOAT32);
+
+    const texture_cache_level& BaseLevel = Header.Levels[Face][0];
+    std::vector<float> Src((size_t)BaseLevel.Width * BaseLevel.Height * Channels);
+    if (IsFloat)
+        memcpy(Src.data(), Data + BaseLevel.Offset, BaseLevel.Size);
+    else
+        UnormToLinear(Src.data(), Data + BaseLevel.Offset, Src.size(), Header);
+
+    std::vector<float> Dst;
+    for (uint32_t Level = 1; Level < Header.LevelCount; ++Level)
+    {
+        const texture_cache_level& SrcLevel = Header.Levels[Face][Level - 1];
+        const texture_cache_level& DstLevel = Header.Levels[Face][Level];
+        Dst.resize((size_t)DstLevel.Width * DstLevel.Height * Channels);
+        Downsample(Dst.data(), Src.data(), DstLevel, SrcLevel, Channels);
+
+        if (IsFloat)
+            memcpy(Data + DstLevel.Offset, Dst.data(), DstLevel.Size);
+        else
+            LinearToUnorm(Data + DstLevel.Offset, Dst.data(), Dst.size(), Header);
+
+        Src.swap(Dst);
+    }
+}
+
+static bool IsHeaderCompatible(const texture_cache_header& Header, size_t FileSize, int FaceCount, int ImageFlags)
+{
+    if (!(Header.Magic        == TEXTURE_CACHE_MAGIC
+        && Header.Version     == TEXTURE_CACHE_VERSION
+        && Header.EndianTest  == TEXTURE_CACHE_ENDIAN_TEST
+        && Header.HeaderSize  == sizeof(texture_cache_header)
+        && Header.ImageFlags  == ImageFlags
+        && Header.FaceCount   == (uint32_t)GetCacheFaceCount(FaceCount, ImageFlags)
+        && Header.Format < TEXTURE_FORMAT_COUNT
+        && Header.Channels >= 1 && Header.Channels <= 4
+        && Header.LevelCount >= 1 && Header.LevelCount <= TEXTURE_CACHE_MAX_LEVELS
+        && Header.FileSize    == FileSize))
+        return false;
+
+    for (uint32_t Face = 0; Face < Header.FaceCount; ++Face)
+    {
+        for (uint32_t Level = 0; Level < Header.LevelCount; ++Level)
+        {
+            const texture_cache_level& CacheLevel = Header.Levels[Face][Level];
+            if (CacheLevel.Offset < sizeof(texture_cache_header) || CacheLevel.Offset + CacheLevel.Size > FileSize
+                || CacheLevel.Size != GetLevelSize(Header, CacheLevel.Width, CacheLevel.Height))
+                return false;
+        }
+    }
+    return true;
+}
+
+// Cache is stale if a source has changed (size, then content hash when only the timestamp differs)
+static bool IsSourceUpToDate(const texture_cache_header& Header, int Face, const char* Filename, bool* TimeChanged)
+{
+    *TimeChanged = false;
+
+    file_stats Stats;
+    if (!File::GetStats(&Stats, Filename))
+        return true; // Source not available, cache is all we have
+
+    if (Stats.Size != Header.SourceSize[Face])
+        return false;
+
+    if (Stats.ModificationTime == Header.SourceTime[Face])
+        return true;
+
+    uint64_t SourceHash = 0;
+    if (!File::HashFile(&SourceHash, Filename) || SourceHash != Header.SourceHash[Face])
+        return false;
+
+    *TimeChanged = true;
+    return true;
+}
+
+// Use a mapped cache (archive entry or loose file) if valid and up to date, unmapped otherwise.
+// Archive entries are read only: the bake tool keeps them up to date.
+static bool OpenMapping(texture_cache* Cache, file_mapping Mapping, const std::string& CachedFile, const char* const* Faces, int FaceCount, int ImageFlags, bool FromArchive)
+{
+    const texture_cache_header* Header = (const texture_cache_header*)Mapping.Data;
+    if (Mapping.Size < sizeof(texture_cache_header) || !IsHeaderCompatible(*Header, Mapping.Size, FaceCount, ImageFlags))
+    {
+        printf("Incompatible cache: %s\n", CachedFile.c_str());
+        File::Unmap(&Mapping);
+        return false;
+    }
+
+    for (int Face = 0; Face < FaceCount; ++Face)
+    {
+        bool TimeChanged;
+        if (!IsSourceUpToDate(*Header, Face, Faces[Face], &TimeChanged))
+        {
+            printf("Stale cache: %s\n", CachedFile.c_str());
+            File::Unmap(&Mapping);
+            return false;
+        }
+
+        // Same content with a new timestamp (e.g. checkout), update the header to skip hashing next time
+        if (TimeChanged && !FromArchive)
+        {
+            file_stats Stats;
+            FILE* CacheFile = fopen(CachedFile.c_str(), "r+b");
+            if (CacheFile && File::GetStats(&Stats, Faces[Face]))
+            {
+                fseek(CacheFile, (long)(OFFSETOF(texture_cache_header, SourceTime) + Face * sizeof(uint64_t)), SEEK_SET);
+                fwrite(&Stats.ModificationTime, sizeof(uint64_t), 1, CacheFile);
+            }
+            if (CacheFile)
+                fclose(CacheFile);
+        }
+    }
+
+    Cache->Header = Header;
+    Cache->Mapping = Mapping;
+
+    return true;
+}
+
+bool TextureCache::Open(texture_cache* Cache, const char* const* Faces, int FaceCount, int ImageFlags)
+{
+    *Cache = {};
+    Cache->IsSrgb = (ImageFlags & IMG_SRGB) != 0;
+    ImageFlags = GetBakedFlags(ImageFlags);
+    std::string CachedFile = GetCacheFilename(Faces, FaceCount, ImageFlags);
+
+    // Mounted archive first, the loose file when the entry is missing or stale
+    file_mapping Mapping;
+    if (AssetArchive::Map(&Mapping, CachedFile.c_str()) && OpenMapping(Cache, Mapping, CachedFile, Faces, FaceCount, ImageFlags, true))
+        return true;
+    return File::Map(&Mapping, CachedFile.c_str()) && OpenMapping(Cache, Mapping, CachedFile, Faces, FaceCount, ImageFlags, false);
+}
+
+void TextureCache::Release(texture_cache* Cache)
+{
+    File::Unmap(&Cache->Mapping);
+    Cache->Storage.clear();
+    Cache->Storage.shrink_to_fit();
+    Cache->Header = nullptr;
+}
+
+// Replace the unorm levels by blocks (same header, new format and layout)
+static void Compress(std::vector<uint8_t>* Data)
+{
+    const texture_cache_header& Header = *(const texture_cache_header*)Data->data();
+    texture_format Format = TextureCompress::ChooseFormat((int)Header.Channels, Header.ImageFlags);
+    if (!TextureCompress::IsCompressed(Format))
+        return;
+
+    texture_cache_header CompressedHeader = Header;
+    CompressedHeader.Format = Format;
+    CompressedHeader.Channels = (uint32_t)TextureCompress::GetChannelCount(Format);
+    ComputeLevels(&CompressedHeader);
+
+    std::vector<uint8_t> Compressed(CompressedHeader.FileSize, 0);
+    memcpy(Compressed.data(), &CompressedHeader, sizeof(CompressedHeader));
+    for (uint32_t Face = 0; Face < Header.FaceCount; ++Face)
+    {
+        for (uint32_t Level = 0; Level < Header.LevelCount; ++Level)
+        {
+            const texture_cache_level& Src = Header.Levels[Face][Level];
+            TextureCompress::EncodeLevel(Compressed.data() + CompressedHeader.Levels[Face][Level].Offset, Data->data() + Src.Offset,
+                (int)Src.Width, (int)Src.Height, (int)Header.Channels, Format);
+        }
+    }
+    Data->swap(Compressed);
+}
+
+// Replace the float levels by the IMG_LINEAR storage format (half or packed RGB)
+static void PackFloat(std::vector<uint8_t>* Data)
+{
+    const texture_cache_header& Header = *(const texture_cache_header*)Data->data();
+    texture_format Format = TextureCompress::ChooseFloatFormat((int)Header.Channels, Header.ImageFlags);
+    if (Format == TEXTURE_FORMAT_FLOAT32)
+        return;
+
+    texture_cache_header PackedHeader = Header;
+    PackedHeader.Format = Format;
+    ComputeLevels(&PackedHeader);
+
+    std::vector<uint8_t> Packed(PackedHeader.FileSize, 0);
+    memcpy(Packed.data(), &PackedHeader, sizeof(PackedHeader));
+    for (uint32_t Face = 0; Face < Header.FaceCount; ++Face)
+    {
+        for (uint32_t Level = 0; Level < Header.LevelCount; ++Level)
+        {
+            const texture_cache_level& Src = Header.Levels[Face][Level];
+            TextureCompress::PackFloatLevel(Packed.data() + PackedHeader.Levels[Face][Level].Offset, (const float*)(Data->data() + Src.Offset),
+                (size_t)Src.Width * Src.Height, (int)Header.Channels, Format);
+        }
+    }
+    Data->swap(Packed);
+}
+
+// Cube face of a panorama: power of two, a quarter of the panorama width (same texel density at the equator)
+static int GetEquirectFaceSize(int Width)
+{
+    int Size = 1;
+    while (Size * 2 <= Width / 4)
+        Size *= 2;
+    return Size;
+}
+
+// Bilinear sample of a float panorama, U wraps around and V is clamped at the poles
+static void SampleEquirect(float* Dst, const image& Panorama, float U, float V)
+{
+    float X = U * Panorama.Width - 0.5f;
+    float Y = V * Panorama.Height - 0.5f;
+    int X0 = (int)Math::Floor(X);
+    int Y0 = (int)Math::Floor(Y);
+    float FracX = X - X0;
+    float FracY = Y - Y0;
+
+    int X1 = X0 + 1;
+    X0 = (X0 % Panorama.Width + Panorama.Width) % Panorama.Width;
+    X1 = X1 % Panorama.Width;
+    int Y1 = Math::Min(Y0 + 1, Panorama.Height - 1);
+    Y0 = Math::Max(Y0, 0);
+
+    int Channels = Panorama.Channels;
+    const float* Texels = (const float*)Panorama.Data;
+    const float* T00 = Texels + ((size_t)Y0 * Panorama.Width + X0) * Channels;
+    const float* T10 = Texels + ((size_t)Y0 * Panorama.Width + X1) * Channels;
+    const float* T01 = Texels + ((size_t)Y1 * Panorama.Width + X0) * Channels;
+    const float* T11 = Texels + ((size_t)Y1 * Panorama.Width + X1) * Channels;
+    for (int c = 0; c < Channels; ++c)
+    {
+        float Top = T00[c] + (T10[c] - T00[c]) * FracX;
+        float Bottom = T01[c] + (T11[c] - T01[c]) * FracX;
+        Dst[c] = Top + (Bottom - Top) * FracY;
+    }
+}
+
+// Fill level 0 of the 6 float faces from the panorama, rows of all faces are processed in parallel.
+// Directions are built and normalized SIMD_WIDTH texels at a time, the spherical mapping and the bilinear fetch are per texel.
+static void EquirectToCube(uint8_t* Data, const texture_cache_header& Header, const image& Panorama)
+{
+    // Direction = S * SAxis + T * TAxis + Normal, S and T in [-1, 1] (GL cubemap face orientation, first row is T = -1)
+    static const float Axes[TEXTURE_CACHE_MAX_FACES][3][3] =
+    {
+        { {  0, 0, -1 }, { 0, -1,  0 }, {  1,  0,  0 } }, // +X
+        { {  0, 0,  1 }, { 0, -1,  0 }, { -1,  0,  0 } }, // -X
+        { {  1, 0,  0 }, { 0,  0,  1 }, {  0,  1,  0 } }, // +Y
+        { {  1, 0,  0 }, { 0,  0, -1 }, {  0, -1,  0 } }, // -Y
+        { {  1, 0,  0 }, { 0, -1,  0 }, {  0,  0,  1 } }, // +Z
+        { { -1, 0,  0 }, { 0, -1,  0 }, {  0,  0, -1 } }, // -Z
+    };
+
+    int Size = (int)Header.Width;
+    int Channels = (int)Header.Channels;
+
+    // Texel centers, padded to whole SIMD batches
+    int PaddedSize = (Size + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    std::vector<float> Coords(PaddedSize);
+    for (int i = 0; i < PaddedSize; ++i)
+        Coords[i] = 2.f * (i + 0.5f) / Size - 1.f;
+
+    const int RowsPerJob = 16;
+    int JobsPerFace = (Size + RowsPerJob - 1) / RowsPerJob;
+    Jobs::ParallelFor(TEXTURE_CACHE_MAX_FACES * JobsPerFace, [&](int Job)
+    {
+        int Face = Job / JobsPerFace;
+        const float (*Axis)[3] = Axes[Face];
+        float* Level = (float*)(Data + Header.Levels[Face][0].Offset);
+        std::vector<float> Directions(3 * PaddedSize);
+
+        int RowEnd = Math::Min((Job % JobsPerFace + 1) * RowsPerJob, Size);
+        for (int y = Job % JobsPerFace * RowsPerJob; y < RowEnd; ++y)
+        {
+            float T = Coords[y];
+            simd_float OffsetX = Simd::Set1(T * Axis[1][0] + Axis[2][0]);
+            simd_float OffsetY = Simd::Set1(T * Axis[1][1] + Axis[2][1]);
+            simd_float OffsetZ = Simd::Set1(T * Axis[1][2] + Axis[2][2]);
+            for (int x = 0; x < PaddedSize; x += SIMD_WIDTH)
+            {
+                simd_float S = Simd::Load(&Coords[x]);
+                simd_float DirX = Simd::MulAdd(S, Simd::Set1(Axis[0][0]), OffsetX);
+                simd_float DirY = Simd::MulAdd(S, Simd::Set1(Axis[0][1]), OffsetY);
+                simd_float DirZ = Simd::MulAdd(S, Simd::Set1(Axis[0][2]), OffsetZ);
+                simd_float LengthSq = Simd::MulAdd(DirX, DirX, Simd::MulAdd(DirY, DirY, Simd::Mul(DirZ, DirZ)));
+                simd_float InvLength = Simd::Div(Simd::Set1(1.f), Simd::Sqrt(LengthSq));
+                Simd::Store(&Directions[x], Simd::Mul(DirX, InvLength));
+                Simd::Store(&Directions[PaddedSize + x], Simd::Mul(DirY, InvLength));
+                Simd::Store(&Directions[2 * PaddedSize + x], Simd::Mul(DirZ, InvLength));
+            }
+
+            // Longitude from -Z around +Y, latitude from +Y (first panorama row) to -Y
+            float* Texel = Level + (size_t)y * Size * Channels;
+            for (int x = 0; x < Size; ++x, Texel += Channels)
+            {
+                float DirX = Directions[x];
+                float DirY = Directions[PaddedSize + x];
+                float DirZ = Directions[2 * PaddedSize + x];
+                float U = 0.5f + Math::Atan2(DirX, -DirZ) / Math::TwoPi();
+                float V = Math::Acos(Math::Clamp(DirY, -1.f, 1.f)) / Math::Pi();
+                SampleEquirect(Texel, Panorama, U, V);
+            }
+        }
+    });
+}
+
+// Panorama converted to a float cubemap, then filtered and packed like the other IMG_LINEAR textures
+static bool BuildEquirectData(std::vector<uint8_t>* Data, const char* Filename, int ImageFlags)
+{
+    if (!(ImageFlags & IMG_LINEAR))
+    {
+        fprintf(stderr, "Equirectangular panoramas are converted in float, IMG_LINEAR is needed: '%s'\n", Filename);
+        return false;
+    }
+
+    image Panorama;
+    if (!TextureCache::DecodeImage(&Panorama, Filename, ImageFlags))
+        return false;
+
+    image FaceImage = Panorama;
+    FaceImage.Width = FaceImage.Height = GetEquirectFaceSize(Panorama.Width);
+
+    texture_cache_header Header;
+    FillHeader(&Header, &Filename, 1, ImageFlags, FaceImage);
+    Data->assign(Header.FileSize, 0);
+    memcpy(Data->data(), &Header, sizeof(Header));
+
+    EquirectToCube(Data->data(), Header, Panorama);
+    TextureCache::FreeImage(&Panorama);
+
+    for (int Face = 0; Face < TEXTURE_CACHE_MAX_FACES; ++Face)
+        BuildMips(Data->data(), Header, Face);
+    PackFloat(Data);
+
+    return true;
+}
+
+// Whole file in memory: header, level 0 of every face and the mip chains
+static bool BuildData(std::vector<uint8_t>* Data, const char* const* Faces, int FaceCount, int ImageFlags)
+{
+    if (ImageFlags & IMG_EQUIRECT)
+        return BuildEquirectData(Data, Faces[0], ImageFlags);
+
+    // Cubemap faces are decoded concurrently (file read and stb_image decode are the slow part)
+    image Images[TEXTURE_CACHE_MAX_FACES] = {};
+    bool Decoded[TEXTURE_CACHE_MAX_FACES] = {};
+    Jobs::ParallelFor(FaceCount, [&](int Face)
+    {
+        Decoded[Face] = TextureCache::DecodeImage(&Images[Face], Faces[Face], ImageFlags);
+    });
+
+    bool Success = true;
+    for (int Face = 0; Face < FaceCount; ++Face)
+    {
+        Success = Success && Decoded[Face];
+        if (Success && Face > 0
+            && (Images[Face].Width != Images[0].Width || Images[Face].Height != Images[0].Height || Images[Face].Channels != Images[0].Channels))
+        {
+            fprintf(stderr, "Cubemap faces must have the same size and channels: '%s'\n", Faces[Face]);
+            Success = false;
+        }
+    }
+
+    texture_cache_header Header;
+    if (Success)
+    {
+        FillHeader(&Header, Faces, FaceCount, ImageFlags, Images[0]);
+        Data->assign(Header.FileSize, 0);
+        memcpy(Data->data(), &Header, sizeof(Header));
+    }
+
+    for (int Face = 0; Face < FaceCount; ++Face)
+    {
+        if (Success)
+            memcpy(Data->data() + Header.Levels[Face][0].Offset, Images[Face].Data, Header.Levels[Face][0].Size);
+        if (Decoded[Face])
+            TextureCache::FreeImage(&Images[Face]);
+    }
+
+    if (!Success)
+        return false;
+
+    // Mips are already filtered in parallel
+    for (int Face = 0; Face < FaceCount; ++Face)
+        BuildMips(Data->data(), Header, Face);
+
+    if (ImageFlags & IMG_LINEAR)
+        PackFloat(Data);
+    else if (ImageFlags & IMG_COMPRESS)
+        Compress(Data);
+
+    return true;
+}
+
+static bool WriteData(const std::vector<uint8_t>& Data, const std::string& CachedFile)
+{
+    FILE* CacheFile = fopen(CachedFile.c_str(), "wb");
+    if (CacheFile == nullptr)
+    {
+        fprintf(stderr, "Cannot write cache: %s\n", CachedFile.c_str());
+        return false;
+    }
+
+    bool Written = fwrite(Data.data(), 1, Data.size(), CacheFile) == Data.size();
+    fclose(CacheFile);
+
+    if (!Written)
+    {
+        fprintf(stderr, "Cannot write cache: %s\n", CachedFile.c_str());
+        remove(CachedFile.c_str());
+        return false;
+    }
+
+    const texture_cache_header& Header = *(const texture_cache_header*)Data.data();
+    printf("Saved to cache: %s (%dx%d, %d channels, %d faces, %d levels)\n", CachedFile.c_str(), (int)Header.Width, (int)Header.Height, (int)Header.Channels, (int)Header.FaceCount, (int)Header.LevelCount);
+
+    return true;
+}
+
+bool TextureCache::Bake(const char* const* Faces, int FaceCount, int ImageFlags)
+{
+    ImageFlags = GetBakedFlags(ImageFlags);
+    std::vector<uint8_t> Data;
+    return BuildData(&Data, Faces, FaceCount, ImageFlags) && WriteData(Data, GetCacheFilename(Faces, FaceCount, ImageFlags));
+}
+
+bool TextureCache::Load(texture_cache* Cache, const char* const* Faces, int FaceCount, int ImageFlags)
+{
+    *Cache = {};
+
+    if (TextureCache::Open(Cache, Faces, FaceCount, ImageFlags))
+        return true;
+
+    // Build cache
+    std::vector<uint8_t> Data;
+    if (!BuildData(&Data, Faces, FaceCount, GetBakedFlags(ImageFlags)))
+        return false;
+
+    if (WriteData(Data, GetCacheFilename(Faces, FaceCount, ImageFlags)) && TextureCache::Open(Cache, Faces, FaceCount, ImageFlags))
+        return true;
+
+    // Cache unavailable, keep the texture in memory with the same layout as the file
+    Cache->Storage = std::move(Data);
+    Cache->Header = (const texture_cache_header*)Cache->Storage.data();
+    Cache->IsSrgb = (ImageFlags & IMG_SRGB) != 0;
+
+    return true;
+}
+
+const void* TextureCache::GetLevelData(const texture_cache& Cache, int Face, int Level)
+{
+    return (const uint8_t*)Cache.Header + Cache.Header->Levels[Face][Level].Offset;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "file.h"
+
+enum image_flags
+{
+    IMG_FLIP             = 1 << 0,
+    IMG_FORCE_GREY       = 1 << 1,
+    IMG_FORCE_GREY_ALPHA = 1 << 2,
+    IMG_FORCE_RGB        = 1 << 3,
+    IMG_FORCE_RGBA       = 1 << 4,
+    IMG_GEN_MIPMAPS      = 1 << 5,
+    IMG_LINEAR           = 1 << 6,
+    IMG_NON_COLOR        = 1 << 7, // Data texture (normal map...): mips are filtered without gamma
+    IMG_COMPRESS         = 1 << 8, // Block compressed in the cache (see TextureCompress::ChooseFormat)
+
+    // Storage of IMG_LINEAR images, picked from the channel count when none is set (see TextureCompress::ChooseFloatFormat)
+    IMG_FLOAT32          = 1 << 9,  // 32 bits per channel
+    IMG_FLOAT16          = 1 << 10, // Half per channel (GL_R16F to GL_RGBA16F)
+    IMG_R11G11B10F       = 1 << 11, // RGB, 32 bits per texel, no sign, 6/6/5 bits of mantissa
+    IMG_RGB9E5           = 1 << 12, // RGB, 32 bits per texel, no sign, 9 bits of mantissa with a shared exponent (sampling only)
+
+    IMG_SRGB             = 1 << 13, // RGB(A) unorm8/BC1/BC3 uploaded as sRGB: the sampler decodes to linear (ignored with IMG_LINEAR/IMG_NON_COLOR).
+                                    // Upload setting only: not part of the baked file, shared with the loads without it
+    IMG_EQUIRECT         = 1 << 14, // One equirectangular panorama (.hdr, needs IMG_LINEAR) converted to a cubemap of Width / 4 faces
+};
+
+// Decoded image (cpu side)
+struct image
+{
+    void* Data; // uint8_t or float (IsFloat) texels
+    int Width;
+    int Height;
+    int Channels;
+    bool IsFloat;
+};
+
+// Baked texture, written next to the source ("<image>.<flags>.tex", "<+X face>.<faces hash>.<flags>.cube.tex" for cubemaps, "<panorama>.<flags>.cube.tex" for panoramas) and loaded with a memory mapping.
+// File layout: [texture_cache_header][levels], face major then level, levels are tightly packed rows aligned on 16 bytes.
+// Texels are stored as uploaded by glTexImage2D: image flags are applied (flip, channels) and the mip chain is complete (IMG_GEN_MIPMAPS).
+// Mips are filtered from the previous level in linear float (then packed to the IMG_LINEAR storage format) with a Kaiser windowed sinc (sRGB decoded unless IMG_NON_COLOR/IMG_LINEAR).
+
+const uint32_t TEXTURE_CACHE_MAGIC       = 0x58455454; // "TTEX"
+const uint32_t TEXTURE_CACHE_VERSION     = 4;
+const uint32_t TEXTURE_CACHE_ENDIAN_TEST = 0x01020304;
+const int TEXTURE_CACHE_MAX_FACES  = 6;
+const int TEXTURE_CACHE_MAX_LEVELS = 16;
+
+enum texture_format
+{
+    TEXTURE_FORMAT_UNORM8,  // uint8_t per channel
+    TEXTURE_FORMAT_FLOAT32, // float per channel (IMG_LINEAR)
+    TEXTURE_FORMAT_BC1,     // 4x4 blocks (IMG_COMPRESS), levels are rows of blocks, Channels is the decoded channel count
+    TEXTURE_FORMAT_BC3,
+    TEXTURE_FORMAT_BC4,
+    TEXTURE_FORMAT_BC5,
+    TEXTURE_FORMAT_FLOAT16,    // uint16_t half per channel
+    TEXTURE_FORMAT_R11G11B10F, // uint32_t per texel (GL_UNSIGNED_INT_10F_11F_11F_REV)
+    TEXTURE_FORMAT_RGB9E5,     // uint32_t per texel (GL_UNSIGNED_INT_5_9_9_9_REV)
+    TEXTURE_FORMAT_COUNT,
+};
+
+struct texture_cache_level
+{
+    uint64_t Offset;
+    uint64_t Size;
+    uint32_t Width;
+    uint32_t Height;
+};
+
+struct texture_cache_header
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t EndianTest;
+    uint32_t HeaderSize;
+
+    // Source files, one per face (to detect stale caches)
+    uint64_t SourceSize[TEXTURE_CACHE_MAX_FACES];
+    uint64_t SourceTime[TEXTURE_CACHE_MAX_FACES];
+    uint64_t SourceHash[TEXTURE_CACHE_MAX_FACES];
+
+    int32_t ImageFlags;
+    uint32_t Format; // texture_format
+    uint32_t Channels;
+    uint32_t Width;
+    uint32_t Height;
+    uint32_t FaceCount; // 1 or 6 (cubemap, faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X order)
+    uint32_t LevelCount;
+    uint32_t Padding;
+    uint64_t FileSize;
+    uint64_t Padding2;
+
+    texture_cache_level Levels[TEXTURE_CACHE_MAX_FACES][TEXTURE_CACHE_MAX_LEVELS];
+};
+
+// Texture loaded from a baked file (or built in memory when the file cannot be written)
+struct texture_cache
+{
+    const texture_cache_header* Header;
+    file_mapping Mapping;
+    std::vector<uint8_t> Storage;
+    bool IsSrgb; // IMG_SRGB of the load (Header->ImageFlags never has it)
+};
+
+namespace TextureCache
+{
+// Decode with stb_image (can be called from any thread)
+bool DecodeImage(image* Image, const char* Filename, int ImageFlags = 0);
+void FreeImage(image* Image);
+
+// Faces holds FaceCount file names (1 for a texture or an IMG_EQUIRECT panorama, 6 for a cubemap)
+std::string GetCacheFilename(const char* const* Faces, int FaceCount, int ImageFlags);
+
+// Map the baked file if it is valid and up to date with the sources
+bool Open(texture_cache* Cache, const char* const* Faces, int FaceCount, int ImageFlags);
+void Release(texture_cache* Cache);
+
+// Decode the sources, build the mip chain and write the baked file
+bool Bake(const char* const* Faces, int FaceCount, int ImageFlags);
+
+// Open the baked file, or bake it (kept in memory if it cannot be written)
+bool Load(texture_cache* Cache, const char* const* Faces, int FaceCount, int ImageFlags);
+
+const void* GetLevelData(const texture_cache& Cache, int Face, int Level);
+}
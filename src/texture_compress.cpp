@@ -0,0 +1,524 @@
+#include <cmath>
+#include <cstring>
+
+#include "maths.h"
+#include "simd.h"
+#include "jobs.h"
+
+#include "texture_compress.h"
+
+bool TextureCompress::IsCompressed(texture_format Format)
+{
+    return Format == TEXTURE_FORMAT_BC1 || Format == TEXTURE_FORMAT_BC3 || Format == TEXTURE_FORMAT_BC4 || Format == TEXTURE_FORMAT_BC5;
+}
+
+int TextureCompress::GetBlockSize(texture_format Format)
+{
+    switch (Format)
+    {
+    case TEXTURE_FORMAT_BC1: return 8;
+    case TEXTURE_FORMAT_BC3: return 16;
+    case TEXTURE_FORMAT_BC4: return 8;
+    case TEXTURE_FORMAT_BC5: return 16;
+    default:                 return 0;
+    }
+}
+
+int TextureCompress::GetChannelCount(texture_format Format)
+{
+    switch (Format)
+    {
+    case TEXTURE_FORMAT_BC1: return 3;
+    case TEXTURE_FORMAT_BC3: return 4;
+    case TEXTURE_FORMAT_BC4: return 1;
+    case TEXTURE_FORMAT_BC5: return 2;
+    default:                 return 0;
+    }
+}
+
+texture_format TextureCompress::ChooseFormat(int Channels, int ImageFlags)
+{
+    if (ImageFlags & IMG_LINEAR)
+        return TEXTURE_FORMAT_FLOAT32;
+
+    switch (Channels)
+    {
+    case 1:  return TEXTURE_FORMAT_BC4;
+    case 2:  return TEXTURE_FORMAT_BC5;
+    case 3:  return (ImageFlags & IMG_NON_COLOR) ? TEXTURE_FORMAT_BC5 : TEXTURE_FORMAT_BC1;
+    default: return TEXTURE_FORMAT_BC3;
+    }
+}
+
+uint64_t TextureCompress::GetLevelSize(texture_format Format, uint32_t Width, uint32_t Height)
+{
+    uint64_t BlocksX = (Width + 3) / 4;
+    uint64_t BlocksY = (Height + 3) / 4;
+    return BlocksX * BlocksY * GetBlockSize(Format);
+}
+
+texture_format TextureCompress::ChooseFloatFormat(int Channels, int ImageFlags)
+{
+    if (ImageFlags & IMG_FLOAT32)
+        return TEXTURE_FORMAT_FLOAT32;
+    if ((ImageFlags & IMG_FLOAT16) || Channels != 3)
+        return TEXTURE_FORMAT_FLOAT16;
+    if (ImageFlags & IMG_RGB9E5)
+        return TEXTURE_FORMAT_RGB9E5;
+    return TEXTURE_FORMAT_R11G11B10F;
+}
+
+int TextureCompress::GetFloatTexelSize(texture_format Format, int Channels)
+{
+    switch (Format)
+    {
+    case TEXTURE_FORMAT_FLOAT32:    return Channels * (int)sizeof(float);
+    case TEXTURE_FORMAT_FLOAT16:    return Channels * (int)sizeof(uint16_t);
+    case TEXTURE_FORMAT_R11G11B10F: return (int)sizeof(uint32_t);
+    case TEXTURE_FORMAT_RGB9E5:     return (int)sizeof(uint32_t);
+    default:                        return 0;
+    }
+}
+
+// Unsigned small floats share the exponent bias of half: round the half mantissa to 6 (R, G) or 5 (B) bits.
+// Negative and NaN values give 0, values above the max finite value are clamped.
+static uint32_t HalfToUnsignedFloat(uint16_t Half, int DroppedBits)
+{
+    if ((Half & 0x8000) || (Half & 0x7FFF) > 0x7C00)
+        return 0;
+
+    uint32_t Max = (0x7BFFu >> DroppedBits);
+    uint32_t Rounded = ((uint32_t)Half + (1u << (DroppedBits - 1))) >> DroppedBits;
+    return Math::Min(Rounded, Max);
+}
+
+static uint32_t PackR11G11B10F(const float* Rgb)
+{
+    uint16_t Half[3];
+    for (int i = 0; i < 3; ++i)
+        Half[i] = Math::FloatToHalf(Rgb[i]);
+
+    return HalfToUnsignedFloat(Half[0], 4) | (HalfToUnsignedFloat(Half[1], 4) << 11) | (HalfToUnsignedFloat(Half[2], 5) << 22);
+}
+
+// EXT_texture_shared_exponent: 9 bits of mantissa, 5 bits of exponent with a bias of 15
+static uint32_t PackRGB9E5(const float* Rgb)
+{
+    const int   MantissaBits = 9;
+    const int   ExponentBias = 15;
+    const int   MaxExponent  = 31;
+    const float MaxValue     = 65408.f; // (2^9 - 1) / 2^9 * 2^(31 - 15)
+
+    float Clamped[3];
+    for (int i = 0; i < 3; ++i)
+        Clamped[i] = (Rgb[i] > 0.f) ? Math::Min(Rgb[i], MaxValue) : 0.f; // Also drops NaN
+
+    float MaxChannel = Math::Max(Clamped[0], Math::Max(Clamped[1], Clamped[2]));
+    if (MaxChannel == 0.f)
+        return 0;
+
+    int Exponent;
+    frexpf(MaxChannel, &Exponent);
+    int SharedExponent = Math::Max(-ExponentBias - 1, Exponent - 1) + 1 + ExponentBias;
+
+    float Scale = ldexpf(1.f, SharedExponent - ExponentBias - MantissaBits);
+    if ((int)floorf(MaxChannel / Scale + 0.5f) == (1 << MantissaBits))
+    {
+        SharedExponent += 1;
+        Scale *= 2.f;
+    }
+    SharedExponent = Math::Min(SharedExponent, MaxExponent);
+
+    uint32_t Packed = (uint32_t)SharedExponent << 27;
+    for (int i = 0; i < 3; ++i)
+    {
+        uint32_t Mantissa = (uint32_t)floorf(Clamped[i] / Scale + 0.5f);
+        Packed |= Math::Min(Mantissa, (1u << MantissaBits) - 1) << (MantissaBits * i);
+    }
+    return Packed;
+}
+
+void TextureCompress::PackFloatLevel(void* Dst, const float* Src, size_t TexelCount, int Channels, texture_format Format)
+{
+    if (Format == TEXTURE_FORMAT_FLOAT32)
+    {
+        memcpy(Dst, Src, TexelCount * Channels * sizeof(float));
+        return;
+    }
+
+    // Chunks of 16K texels per job
+    const size_t ChunkSize = 16 * 1024;
+    int ChunkCount = (int)((TexelCount + ChunkSize - 1) / ChunkSize);
+    Jobs::ParallelFor(ChunkCount, [&](int Chunk)
+    {
+        size_t Begin = Chunk * ChunkSize;
+        size_t End = Math::Min(Begin + ChunkSize, TexelCount);
+
+        if (Format == TEXTURE_FORMAT_FLOAT16)
+        {
+            uint16_t* Halfs = (uint16_t*)Dst;
+            size_t i = Begin * Channels;
+            size_t Count = End * Channels;
+            for (; i + SIMD_WIDTH <= Count; i += SIMD_WIDTH)
+                Simd::StoreHalf(Halfs + i, Simd::Load(Src + i));
+            for (; i < Count; ++i)
+                Halfs[i] = Math::FloatToHalf(Src[i]);
+            return;
+        }
+
+        uint32_t* Texels = (uint32_t*)Dst;
+        for (size_t i = Begin; i < End; ++i)
+            Texels[i] = (Format == TEXTURE_FORMAT_RGB9E5) ? PackRGB9E5(Src + i * Channels) : PackR11G11B10F(Src + i * Channels);
+    });
+}
+
+// Texels of the block at (BlockX, BlockY), edges are clamped on levels smaller than a block
+static void FetchBlock(uint8_t Texels[16][4], const uint8_t* Src, int Width, int Height, int SrcChannels, int BlockX, int BlockY)
+{
+    for (int y = 0; y < 4; ++y)
+    {
+        int SrcY = Math::Min(BlockY * 4 + y, Height - 1);
+        for (int x = 0; x < 4; ++x)
+        {
+            int SrcX = Math::Min(BlockX * 4 + x, Width - 1);
+            const uint8_t* Texel = Src + ((size_t)SrcY * Width + SrcX) * SrcChannels;
+            for (int c = 0; c < 4; ++c)
+                Texels[y * 4 + x][c] = (c < SrcChannels) ? Texel[c] : 255;
+        }
+    }
+}
+
+static uint16_t PackRGB565(const float Color[3])
+{
+    int R = (int)(Math::Clamp(Color[0], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+    int G = (int)(Math::Clamp(Color[1], 0.f, 255.f) * 63.f / 255.f + 0.5f);
+    int B = (int)(Math::Clamp(Color[2], 0.f, 255.f) * 31.f / 255.f + 0.5f);
+    return (uint16_t)((R << 11) | (G << 5) | B);
+}
+
+static void UnpackRGB565(int Color[3], uint16_t Packed)
+{
+    int R = (Packed >> 11) & 31;
+    int G = (Packed >> 5) & 63;
+    int B = Packed & 31;
+    Color[0] = (R << 3) | (R >> 2);
+    Color[1] = (G << 2) | (G >> 4);
+    Color[2] = (B << 3) | (B >> 2);
+}
+
+// 4 color palette (Color0 > Color1) or 3 colors and black
+static void BuildBC1Palette(int Palette[4][3], uint16_t Color0, uint16_t Color1, bool FourColors)
+{
+    UnpackRGB565(Palette[0], Color0);
+    UnpackRGB565(Palette[1], Color1);
+    for (int c = 0; c < 3; ++c)
+    {
+        if (FourColors)
+        {
+            Palette[2][c] = (2 * Palette[0][c] + Palette[1][c]) / 3;
+            Palette[3][c] = (Palette[0][c] + 2 * Palette[1][c]) / 3;
+        }
+        else
+        {
+            Palette[2][c] = (Palette[0][c] + Palette[1][c]) / 2;
+            Palette[3][c] = 0;
+        }
+    }
+}
+
+// Nearest palette entry per texel, returns the squared error
+static int SelectBC1Indices(uint32_t* Indices, const uint8_t Texels[16][4], uint16_t Color0, uint16_t Color1)
+{
+    int Palette[4][3];
+    BuildBC1Palette(Palette, Color0, Color1, true);
+
+    int TotalError = 0;
+    *Indices = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        int BestIndex = 0;
+        int BestError = INT32_MAX;
+        for (int p = 0; p < 4; ++p)
+        {
+            int Error = 0;
+            for (int c = 0; c < 3; ++c)
+            {
+                int Delta = (int)Texels[i][c] - Palette[p][c];
+                Error += Delta * Delta;
+            }
+            if (Error < BestError)
+            {
+                BestError = Error;
+                BestIndex = p;
+            }
+        }
+        *Indices |= (uint32_t)BestIndex << (2 * i);
+        TotalError += BestError;
+    }
+    return TotalError;
+}
+
+// Least squares endpoints for fixed indices, false if the system is degenerated (every texel on the same weight)
+static bool RefineBC1Endpoints(float Color0[3], float Color1[3], const uint8_t Texels[16][4], uint32_t Indices)
+{
+    const float Weights[4] = { 1.f, 0.f, 2.f / 3.f, 1.f / 3.f }; // Weight of Color0 per index
+
+    float AA = 0.f, BB = 0.f, AB = 0.f;
+    float AX[3] = {}, BX[3] = {};
+    for (int i = 0; i < 16; ++i)
+    {
+        float A = Weights[(Indices >> (2 * i)) & 3];
+        float B = 1.f - A;
+        AA += A * A;
+        BB += B * B;
+        AB += A * B;
+        for (int c = 0; c < 3; ++c)
+        {
+            AX[c] += A * Texels[i][c];
+            BX[c] += B * Texels[i][c];
+        }
+    }
+
+    float Determinant = AA * BB - AB * AB;
+    if (Math::Abs(Determinant) < 1e-6f)
+        return false;
+
+    for (int c = 0; c < 3; ++c)
+    {
+        Color0[c] = (AX[c] * BB - BX[c] * AB) / Determinant;
+        Color1[c] = (BX[c] * AA - AX[c] * AB) / Determinant;
+    }
+    return true;
+}
+
+// Endpoints ordered for the 4 color mode (Color0 > Color1), indices remapped when swapped
+static void WriteBC1Block(uint8_t* Dst, uint16_t Color0, uint16_t Color1, uint32_t Indices)
+{
+    if (Color0 < Color1)
+    {
+        uint16_t Swap = Color0;
+        Color0 = Color1;
+        Color1 = Swap;
+        Indices ^= 0x55555555; // 0 <-> 1, 2 <-> 3
+    }
+    else if (Color0 == Color1)
+    {
+        Indices = 0;
+    }
+
+    memcpy(Dst + 0, &Color0, sizeof(Color0));
+    memcpy(Dst + 2, &Color1, sizeof(Color1));
+    memcpy(Dst + 4, &Indices, sizeof(Indices));
+}
+
+// Endpoints on the principal axis of the block colors (inset to reduce the error at the extremities), then one least squares refinement
+static void EncodeBC1Block(uint8_t* Dst, const uint8_t Texels[16][4])
+{
+    float Mean[3] = {};
+    for (int i = 0; i < 16; ++i)
+        for (int c = 0; c < 3; ++c)
+            Mean[c] += Texels[i][c] / 16.f;
+
+    float Covariance[6] = {}; // RR, RG, RB, GG, GB, BB
+    for (int i = 0; i < 16; ++i)
+    {
+        float R = Texels[i][0] - Mean[0];
+        float G = Texels[i][1] - Mean[1];
+        float B = Texels[i][2] - Mean[2];
+        Covariance[0] += R * R; Covariance[1] += R * G; Covariance[2] += R * B;
+        Covariance[3] += G * G; Covariance[4] += G * B; Covariance[5] += B * B;
+    }
+
+    // Power iteration
+    float Axis[3] = { 1.f, 1.f, 1.f };
+    for (int Iteration = 0; Iteration < 8; ++Iteration)
+    {
+        float X = Covariance[0] * Axis[0] + Covariance[1] * Axis[1] + Covariance[2] * Axis[2];
+        float Y = Covariance[1] * Axis[0] + Covariance[3] * Axis[1] + Covariance[4] * Axis[2];
+        float Z = Covariance[2] * Axis[0] + Covariance[4] * Axis[1] + Covariance[5] * Axis[2];
+        float Length = Math::Max(Math::Abs(X), Math::Max(Math::Abs(Y), Math::Abs(Z)));
+        if (Length < 1e-6f)
+            break;
+        Axis[0] = X / Length;
+        Axis[1] = Y / Length;
+        Axis[2] = Z / Length;
+    }
+    float AxisLengthSq = Axis[0] * Axis[0] + Axis[1] * Axis[1] + Axis[2] * Axis[2];
+
+    float MinProjection = 0.f, MaxProjection = 0.f;
+    for (int i = 0; i < 16; ++i)
+    {
+        float Projection = 0.f;
+        for (int c = 0; c < 3; ++c)
+            Projection += (Texels[i][c] - Mean[c]) * Axis[c];
+        Projection /= AxisLengthSq;
+        MinProjection = Math::Min(MinProjection, Projection);
+        MaxProjection = Math::Max(MaxProjection, Projection);
+    }
+
+    float Inset = (MaxProjection - MinProjection) / 16.f;
+    float Color0[3], Color1[3];
+    for (int c = 0; c < 3; ++c)
+    {
+        Color0[c] = Mean[c] + (MaxProjection - Inset) * Axis[c];
+        Color1[c] = Mean[c] + (MinProjection + Inset) * Axis[c];
+    }
+
+    uint16_t Packed0 = PackRGB565(Color0);
+    uint16_t Packed1 = PackRGB565(Color1);
+    uint32_t Indices;
+    int Error = SelectBC1Indices(&Indices, Texels, Packed0, Packed1);
+
+    float Refined0[3], Refined1[3];
+    if (Error > 0 && RefineBC1Endpoints(Refined0, Refined1, Texels, Indices))
+    {
+        uint16_t RefinedPacked0 = PackRGB565(Refined0);
+        uint16_t RefinedPacked1 = PackRGB565(Refined1);
+        uint32_t RefinedIndices;
+        if (SelectBC1Indices(&RefinedIndices, Texels, RefinedPacked0, RefinedPacked1) < Error)
+        {
+            Packed0 = RefinedPacked0;
+            Packed1 = RefinedPacked1;
+            Indices = RefinedIndices;
+        }
+    }
+
+    WriteBC1Block(Dst, Packed0, Packed1, Indices);
+}
+
+// 8 values mode (Max, Min and 6 interpolated values), indices from the rounded position between Min and Max
+static void EncodeBC4Block(uint8_t* Dst, const uint8_t Texels[16][4], int Channel)
+{
+    int Min = 255, Max = 0;
+    for (int i = 0; i < 16; ++i)
+    {
+        Min = Math::Min(Min, (int)Texels[i][Channel]);
+        Max = Math::Max(Max, (int)Texels[i][Channel]);
+    }
+
+    Dst[0] = (uint8_t)Max;
+    Dst[1] = (uint8_t)Min;
+
+    uint64_t Indices = 0;
+    if (Max > Min)
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            int Step = ((Texels[i][Channel] - Min) * 14 + (Max - Min)) / (2 * (Max - Min)); // 0 (Min) to 7 (Max)
+            int Index = (Step == 7) ? 0 : (Step == 0) ? 1 : 8 - Step;
+            Indices |= (uint64_t)Index << (3 * i);
+        }
+    }
+
+    for (int i = 0; i < 6; ++i)
+        Dst[2 + i] = (uint8_t)(Indices >> (8 * i));
+}
+
+static void DecodeBC1Block(uint8_t Texels[16][4], const uint8_t* Src, bool ForceFourColors)
+{
+    uint16_t Color0, Color1;
+    uint32_t Indices;
+    memcpy(&Color0, Src + 0, sizeof(Color0));
+    memcpy(&Color1, Src + 2, sizeof(Color1));
+    memcpy(&Indices, Src + 4, sizeof(Indices));
+
+    bool FourColors = ForceFourColors || Color0 > Color1;
+    int Palette[4][3];
+    BuildBC1Palette(Palette, Color0, Color1, FourColors);
+
+    for (int i = 0; i < 16; ++i)
+    {
+        int Index = (Indices >> (2 * i)) & 3;
+        for (int c = 0; c < 3; ++c)
+            Texels[i][c] = (uint8_t)Palette[Index][c];
+        Texels[i][3] = (!FourColors && Index == 3) ? 0 : 255;
+    }
+}
+
+static void DecodeBC4Block(uint8_t Texels[16][4], const uint8_t* Src, int Channel)
+{
+    int Palette[8];
+    Palette[0] = Src[0];
+    Palette[1] = Src[1];
+    if (Palette[0] > Palette[1])
+    {
+        for (int i = 1; i < 7; ++i)
+            Palette[i + 1] = ((7 - i) * Palette[0] + i * Palette[1]) / 7;
+    }
+    else
+    {
+        for (int i = 1; i < 5; ++i)
+            Palette[i + 1] = ((5 - i) * Palette[0] + i * Palette[1]) / 5;
+        Palette[6] = 0;
+        Palette[7] = 255;
+    }
+
+    uint64_t Indices = 0;
+    for (int i = 0; i < 6; ++i)
+        Indices |= (uint64_t)Src[2 + i] << (8 * i);
+
+    for (int i = 0; i < 16; ++i)
+        Texels[i][Channel] = (uint8_t)Palette[(Indices >> (3 * i)) & 7];
+}
+
+void TextureCompress::EncodeLevel(uint8_t* Dst, const uint8_t* Src, int Width, int Height, int SrcChannels, texture_format Format)
+{
+    int BlocksX = (Width + 3) / 4;
+    int BlocksY = (Height + 3) / 4;
+    int BlockSize = GetBlockSize(Format);
+
+    // One row of blocks per job
+    Jobs::ParallelFor(BlocksY, [&](int BlockY)
+    {
+        for (int BlockX = 0; BlockX < BlocksX; ++BlockX)
+        {
+            uint8_t Texels[16][4];
+            FetchBlock(Texels, Src, Width, Height, SrcChannels, BlockX, BlockY);
+
+            uint8_t* Block = Dst + ((size_t)BlockY * BlocksX + BlockX) * BlockSize;
+            switch (Format)
+            {
+            case TEXTURE_FORMAT_BC1: EncodeBC1Block(Block, Texels); break;
+            case TEXTURE_FORMAT_BC3: EncodeBC4Block(Block, Texels, 3); EncodeBC1Block(Block + 8, Texels); break;
+            case TEXTURE_FORMAT_BC4: EncodeBC4Block(Block, Texels, 0); break;
+            case TEXTURE_FORMAT_BC5: EncodeBC4Block(Block, Texels, 0); EncodeBC4Block(Block + 8, Texels, 1); break;
+            default: break;
+            }
+        }
+    });
+}
+
+void TextureCompress::DecodeLevel(uint8_t* Dst, const uint8_t* Src, int Width, int Height, texture_format Format)
+{
+    int BlocksX = (Width + 3) / 4;
+    int BlocksY = (Height + 3) / 4;
+    int BlockSize = GetBlockSize(Format);
+    int Channels = GetChannelCount(Format);
+
+    Jobs::ParallelFor(BlocksY, [&](int BlockY)
+    {
+        for (int BlockX = 0; BlockX < BlocksX; ++BlockX)
+        {
+            const uint8_t* Block = Src + ((size_t)BlockY * BlocksX + BlockX) * BlockSize;
+            uint8_t Texels[16][4] = {};
+            switch (Format)
+            {
+            case TEXTURE_FORMAT_BC1: DecodeBC1Block(Texels, Block, false); break;
+            case TEXTURE_FORMAT_BC3: DecodeBC1Block(Texels, Block + 8, true); DecodeBC4Block(Texels, Block, 3); break;
+            case TEXTURE_FORMAT_BC4: DecodeBC4Block(Texels, Block, 0); break;
+            case TEXTURE_FORMAT_BC5: DecodeBC4Block(Texels, Block, 0); DecodeBC4Block(Texels, Block + 8, 1); break;
+            default: break;
+            }
+
+            // Texels outside of the level are dropped
+            for (int y = 0; y < 4 && BlockY * 4 + y < Height; ++y)
+            {
+                for (int x = 0; x < 4 && BlockX * 4 + x < Width; ++x)
+                {
+                    uint8_t* Texel = Dst + ((size_t)(BlockY * 4 + y) * Width + BlockX * 4 + x) * Channels;
+                    memcpy(Texel, Texels[y * 4 + x], Channels);
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+#include "texture_cache.h"
+
+// Block compression (BC1/BC3/BC4/BC5) of unorm8 texture levels, 4x4 texel blocks, and compact float formats.
+// BC1: RGB, 8 bytes per block. BC3: RGBA (BC1 color + BC4 alpha), 16 bytes.
+// BC4: one channel, 8 bytes. BC5: two channels (BC4 each), 16 bytes.
+namespace TextureCompress
+{
+bool IsCompressed(texture_format Format);
+
+// Bytes per 4x4 block
+int GetBlockSize(texture_format Format);
+
+// Channels stored in the blocks (and decoded by DecodeLevel)
+int GetChannelCount(texture_format Format);
+
+// Format used for IMG_COMPRESS: BC4 for 1 channel, BC5 for 2 channels and normal maps (IMG_NON_COLOR, z is rebuilt in the shader),
+// BC1 for RGB and BC3 for RGBA. Float images are not compressed (TEXTURE_FORMAT_FLOAT32 returned).
+texture_format ChooseFormat(int Channels, int ImageFlags);
+
+uint64_t GetLevelSize(texture_format Format, uint32_t Width, uint32_t Height);
+
+// Storage of float images: the IMG_FLOAT32/IMG_FLOAT16/IMG_R11G11B10F/IMG_RGB9E5 flag, or R11G11B10F for RGB and half otherwise.
+// Packed RGB formats need 3 channels (half is used otherwise).
+texture_format ChooseFloatFormat(int Channels, int ImageFlags);
+
+// Bytes per texel of the float formats
+int GetFloatTexelSize(texture_format Format, int Channels);
+
+// Convert TexelCount texels of Channels floats to Format (negative values are clamped to 0 by the packed RGB formats)
+void PackFloatLevel(void* Dst, const float* Src, size_t TexelCount, int Channels, texture_format Format);
+
+// Encode Width x Height texels of SrcChannels uint8_t channels (the first GetChannelCount(Format) are used)
+void EncodeLevel(uint8_t* Dst, const uint8_t* Src, int Width, int Height, int SrcChannels, texture_format Format);
+
+// Decode to GetChannelCount(Format) uint8_t channels per texel (fallback when the format is not supported by the driver)
+void DecodeLevel(uint8_t* Dst, const uint8_t* Src, int Width, int Height, texture_format Format);
+}